@@ -1,9 +1,135 @@
 #include "attrs.hpp"
 
+#include <algorithm>
+#include <functional>
+
 namespace os2cx {
 
+bool AttrBitset::test(AttrBitIndex i) const {
+    assert(i >= 0);
+    return (word(i / 64) >> (i % 64)) & 1;
+}
+
+AttrBitset &AttrBitset::set() {
+    low = ~uint64_t(0);
+    high.clear();
+    fill = true;
+    return *this;
+}
+
+AttrBitset &AttrBitset::set(AttrBitIndex i, bool value) {
+    assert(i >= 0);
+    if (test(i) == value) {
+        return *this;
+    }
+    int w = i / 64;
+    uint64_t mask = uint64_t(1) << (i % 64);
+    if (w == 0) {
+        low ^= mask;
+        return *this;
+    }
+    if (w - 1 >= static_cast<int>(high.size())) {
+        high.resize(w, fill_word());
+    }
+    high[w - 1] ^= mask;
+    normalize();
+    return *this;
+}
+
+AttrBitset &AttrBitset::reset() {
+    low = 0;
+    high.clear();
+    fill = false;
+    return *this;
+}
+
+AttrBitset AttrBitset::operator~() const {
+    AttrBitset result;
+    result.low = ~low;
+    result.high.reserve(high.size());
+    for (uint64_t w : high) {
+        result.high.push_back(~w);
+    }
+    result.fill = !fill;
+    return result;
+}
+
+template<class Op>
+AttrBitset AttrBitset::combine(const AttrBitset &o, Op op) const {
+    AttrBitset result;
+    result.low = op(low, o.low);
+    result.fill = op(fill_word(), o.fill_word()) != 0;
+    int num_high = std::max(high.size(), o.high.size());
+    result.high.reserve(num_high);
+    for (int w = 1; w <= num_high; ++w) {
+        result.high.push_back(op(word(w), o.word(w)));
+    }
+    result.normalize();
+    return result;
+}
+
+AttrBitset AttrBitset::operator&(const AttrBitset &o) const {
+    return combine(o, [](uint64_t a, uint64_t b) { return a & b; });
+}
+
+AttrBitset AttrBitset::operator|(const AttrBitset &o) const {
+    return combine(o, [](uint64_t a, uint64_t b) { return a | b; });
+}
+
+AttrBitset AttrBitset::operator^(const AttrBitset &o) const {
+    return combine(o, [](uint64_t a, uint64_t b) { return a ^ b; });
+}
+
+void AttrBitset::normalize() {
+    while (!high.empty() && high.back() == fill_word()) {
+        high.pop_back();
+    }
+}
+
+size_t AttrBitset::Hash::operator()(const AttrBitset &bs) const {
+    std::hash<uint64_t> hasher;
+    size_t h = hasher(bs.low) ^ (bs.fill ? 0x9e3779b97f4a7c15ull : 0);
+    for (uint64_t w : bs.high) {
+        h = h * 31 + hasher(w);
+    }
+    return h;
+}
+
+std::ostream &operator<<(std::ostream &stream, const AttrBitset &bs) {
+    stream << '[';
+    bool is_first = true;
+    for (AttrBitIndex i = 0; i < bs.width(); ++i) {
+        if (bs[i]) {
+            if (is_first) is_first = false;
+            else stream << ' ';
+            stream << i;
+        }
+    }
+    if (bs.fill_value()) {
+        stream << (is_first ? "" : " ") << "...";
+    }
+    stream << ']';
+    return stream;
+}
+
 AttrBitIndex attr_bit_solid() {
     return 0;
 }
 
+AttrTable::AttrTable() {
+    intern(AttrBitset());
+    assert(intern(AttrBitset()) == AttrSetId::empty());
+}
+
+AttrSetId AttrTable::intern(const AttrBitset &attrs) {
+    auto it = ids.find(attrs);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    AttrSetId id = AttrSetId::from_int(bitsets.size());
+    bitsets.push_back(attrs);
+    ids.insert(std::make_pair(attrs, id));
+    return id;
+}
+
 } /* namespace os2cx */
@@ -1,18 +1,123 @@
 #ifndef OS2CX_ATTRS_HPP_
 #define OS2CX_ATTRS_HPP_
 
-#include <bitset>
-#include <cassert>
+#include <assert.h>
+#include <stdint.h>
+
+#include <map>
+#include <ostream>
+#include <unordered_map>
 #include <vector>
 
 namespace os2cx {
 
-static const int num_attr_bits = 64;
 typedef int AttrBitIndex;
-typedef std::bitset<num_attr_bits> AttrBitset;
+
+/* AttrBitset is a set of attribute bits with no upper limit on the bit index.
+Conceptually it's infinitely wide: every bit past the explicitly-stored words
+has the value 'fill'. This lets set() and operator~() behave like they would for
+a fixed-width bitset, without anyone having to know the width in advance. The
+first 64 bits are stored inline, so small projects never allocate. */
+class AttrBitset {
+public:
+    AttrBitset() : low(0), fill(false) { }
+    explicit AttrBitset(uint64_t bits) : low(bits), fill(false) { }
+
+    bool operator[](AttrBitIndex i) const { return test(i); }
+    bool test(AttrBitIndex i) const;
+
+    AttrBitset &set();
+    AttrBitset &set(AttrBitIndex i, bool value = true);
+    AttrBitset &reset();
+    AttrBitset &reset(AttrBitIndex i) { return set(i, false); }
+
+    bool any() const { return low != 0 || fill || !high.empty(); }
+    bool none() const { return !any(); }
+
+    /* Number of bits that are stored explicitly; every bit at or beyond this
+    index has the same value. */
+    AttrBitIndex width() const { return 64 * (1 + high.size()); }
+    bool fill_value() const { return fill; }
+
+    bool operator==(const AttrBitset &o) const {
+        return low == o.low && fill == o.fill && high == o.high;
+    }
+    bool operator!=(const AttrBitset &o) const { return !(*this == o); }
+
+    AttrBitset operator~() const;
+    AttrBitset operator&(const AttrBitset &o) const;
+    AttrBitset operator|(const AttrBitset &o) const;
+    AttrBitset operator^(const AttrBitset &o) const;
+    AttrBitset &operator&=(const AttrBitset &o) { return *this = *this & o; }
+    AttrBitset &operator|=(const AttrBitset &o) { return *this = *this | o; }
+    AttrBitset &operator^=(const AttrBitset &o) { return *this = *this ^ o; }
+
+    class Hash {
+    public:
+        size_t operator()(const AttrBitset &bs) const;
+    };
+
+private:
+    uint64_t word(int w) const {
+        if (w == 0) return low;
+        if (w - 1 < static_cast<int>(high.size())) return high[w - 1];
+        return fill_word();
+    }
+    uint64_t fill_word() const { return fill ? ~uint64_t(0) : 0; }
+
+    /* Drops trailing words of 'high' that are equal to the fill word, so that
+    equal bitsets always have equal representations. */
+    void normalize();
+
+    template<class Op>
+    AttrBitset combine(const AttrBitset &o, Op op) const;
+
+    uint64_t low;
+    std::vector<uint64_t> high;
+    bool fill;
+};
+
+std::ostream &operator<<(std::ostream &stream, const AttrBitset &bs);
 
 AttrBitIndex attr_bit_solid();
 
+/* Nodes, elements, and element faces in a Mesh3 don't store AttrBitsets
+directly. A mesh typically has only a handful of distinct combinations of
+attributes, so instead we store each distinct combination once in an AttrTable
+and refer to it by AttrSetId. */
+class AttrSetId {
+public:
+    AttrSetId() : id(0) { }
+    static AttrSetId from_int(int id) { AttrSetId ai; ai.id = id; return ai; }
+    /* The empty AttrBitset always has this ID in every AttrTable */
+    static AttrSetId empty() { return AttrSetId::from_int(0); }
+    int to_int() const { return id; }
+    bool operator==(AttrSetId other) const { return id == other.id; }
+    bool operator!=(AttrSetId other) const { return id != other.id; }
+    bool operator<(AttrSetId other) const { return id < other.id; }
+private:
+    int id;
+};
+
+class AttrTable {
+public:
+    AttrTable();
+
+    /* Returns the ID of 'attrs', adding it to the table if necessary. */
+    AttrSetId intern(const AttrBitset &attrs);
+
+    const AttrBitset &operator[](AttrSetId id) const {
+        assert(id.to_int() >= 0 && id.to_int() < size());
+        return bitsets[id.to_int()];
+    }
+
+    int size() const { return bitsets.size(); }
+
+private:
+    std::vector<AttrBitset> bitsets;
+    std::unordered_map<AttrBitset, AttrSetId, AttrBitset::Hash> ids;
+};
+
 template<class T>
 class AttrOverrides {
 public:
@@ -22,17 +127,31 @@ public:
         values[attr_index] = value;
     }
 
-    T lookup(AttrBitset attrs, T default_value) const {
-        for (AttrBitIndex i = num_attr_bits - 1; i >= 0; --i) {
-            if (attrs[i] && overridden_attrs[i]) {
-                return values[i];
+    T lookup(const AttrBitset &attrs, T default_value) const {
+        /* If several overridden attrs are set, the highest-indexed one wins */
+        for (auto it = values.rbegin(); it != values.rend(); ++it) {
+            if (attrs[it->first]) {
+                return it->second;
             }
         }
         return default_value;
     }
 
+    /* Equivalent to calling lookup() on every entry of 'table', but the result
+    is indexed by AttrSetId, so callers can look up per-element values without
+    re-scanning the attribute bits for every element. */
+    std::vector<T> lookup_table(const AttrTable &table, T default_value) const {
+        std::vector<T> result;
+        result.reserve(table.size());
+        for (int i = 0; i < table.size(); ++i) {
+            result.push_back(
+                lookup(table[AttrSetId::from_int(i)], default_value));
+        }
+        return result;
+    }
+
     AttrBitset overridden_attrs;
-    T values[num_attr_bits];
+    std::map<AttrBitIndex, T> values;
 };
 
 typedef double MaxElementSize;
@@ -0,0 +1,157 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace os2cx {
+
+static float round_down(double value) {
+    float f = value;
+    return f > value
+        ? std::nextafter(f, -std::numeric_limits<float>::infinity())
+        : f;
+}
+
+static float round_up(double value) {
+    float f = value;
+    return f < value
+        ? std::nextafter(f, std::numeric_limits<float>::infinity())
+        : f;
+}
+
+Bvh::NodeBox::NodeBox(const Box &box) {
+    lo[0] = round_down(box.xl);
+    lo[1] = round_down(box.yl);
+    lo[2] = round_down(box.zl);
+    hi[0] = round_up(box.xh);
+    hi[1] = round_up(box.yh);
+    hi[2] = round_up(box.zh);
+}
+
+void Bvh::NodeBox::add(const NodeBox &other) {
+    for (int i = 0; i < 3; ++i) {
+        lo[i] = std::min(lo[i], other.lo[i]);
+        hi[i] = std::max(hi[i], other.hi[i]);
+    }
+}
+
+Bvh::Ray::Ray(Point o, Vector direction) {
+    origin[0] = o.x;
+    origin[1] = o.y;
+    origin[2] = o.z;
+    inverse[0] = 1 / direction.x;
+    inverse[1] = 1 / direction.y;
+    inverse[2] = 1 / direction.z;
+}
+
+int Bvh::NodeCounter::operator()(int num_items) {
+    if (num_items <= max_leaf_items) {
+        return 1;
+    }
+    auto it = cache.find(num_items);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    int half = num_items / 2;
+    int count = 1 + (*this)(half) + (*this)(num_items - half);
+    cache[num_items] = count;
+    return count;
+}
+
+void Bvh::build(std::vector<BuildItem> *build_items) {
+    nodes.clear();
+    items.clear();
+    if (build_items->empty()) {
+        return;
+    }
+
+    /* Each level of threads doubles the number of subtrees being built at
+    once */
+    int parallel_depth = 0;
+    while ((1 << parallel_depth) < parallel_num_threads()) {
+        ++parallel_depth;
+    }
+
+    NodeCounter node_counter;
+    nodes.resize(node_counter(build_items->size()));
+    BuildItem *all = build_items->data();
+    build_node(all, all + build_items->size(), all, 0, parallel_depth,
+        &node_counter);
+
+    items.reserve(build_items->size());
+    for (const BuildItem &build_item : *build_items) {
+        items.push_back(build_item.item);
+    }
+}
+
+void Bvh::build_node(
+    BuildItem *begin,
+    BuildItem *end,
+    BuildItem *all,
+    int index,
+    int parallel_depth,
+    NodeCounter *node_counter
+) {
+    Node &node = nodes[index];
+    if (end - begin <= max_leaf_items) {
+        node.box = begin->box;
+        for (BuildItem *it = begin + 1; it != end; ++it) {
+            node.box.add(it->box);
+        }
+        node.first = begin - all;
+        node.count = end - begin;
+        return;
+    }
+
+    /* Split along whichever axis the box centers are most spread out on.
+    (Twice the center is just as good for comparing.) */
+    float center_lo[3], center_hi[3];
+    for (int i = 0; i < 3; ++i) {
+        center_lo[i] = std::numeric_limits<float>::infinity();
+        center_hi[i] = -std::numeric_limits<float>::infinity();
+    }
+    for (BuildItem *it = begin; it != end; ++it) {
+        for (int i = 0; i < 3; ++i) {
+            float center = it->box.lo[i] + it->box.hi[i];
+            center_lo[i] = std::min(center_lo[i], center);
+            center_hi[i] = std::max(center_hi[i], center);
+        }
+    }
+    int axis = 0;
+    for (int i = 1; i < 3; ++i) {
+        if (center_hi[i] - center_lo[i] > center_hi[axis] - center_lo[axis]) {
+            axis = i;
+        }
+    }
+    BuildItem *middle = begin + (end - begin) / 2;
+    std::nth_element(begin, middle, end,
+        [axis](const BuildItem &a, const BuildItem &b) {
+            return a.box.lo[axis] + a.box.hi[axis]
+                < b.box.lo[axis] + b.box.hi[axis];
+        });
+
+    /* The NodeCounter isn't thread-safe, so each thread gets its own */
+    int first_child = index + 1;
+    int second_child = first_child + (*node_counter)(middle - begin);
+    static const int min_parallel_items = 1 << 16;
+    if (parallel_depth > 0 && end - begin >= min_parallel_items) {
+        std::thread thread([&]() {
+            NodeCounter thread_node_counter;
+            build_node(begin, middle, all, first_child, parallel_depth - 1,
+                &thread_node_counter);
+        });
+        build_node(middle, end, all, second_child, parallel_depth - 1,
+            node_counter);
+        thread.join();
+    } else {
+        build_node(begin, middle, all, first_child, 0, node_counter);
+        build_node(middle, end, all, second_child, 0, node_counter);
+    }
+
+    node.box = nodes[first_child].box;
+    node.box.add(nodes[second_child].box);
+    node.first = second_child;
+    node.count = 0;
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,247 @@
+#ifndef OS2CX_BVH_HPP_
+#define OS2CX_BVH_HPP_
+
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "calc.hpp"
+#include "util.hpp"
+
+namespace os2cx {
+
+/* A bounding volume hierarchy over a list of boxes, for finding which of them
+a ray passes through without looking at all of them. It only knows about the
+boxes; the caller does the exact test against whatever each box holds (e.g. a
+triangle) in a callback. Building one takes O(n log n) time, and a ray usually
+visits O(log n) nodes. */
+class Bvh {
+public:
+    /* Makes a BVH with no items */
+    Bvh() { }
+
+    /* 'item_box(i)' returns the box of item 'i', for 0 <= i < 'num_items'. It
+    is called from several threads at once. */
+    template<class ItemBox>
+    Bvh(int num_items, const ItemBox &item_box) {
+        std::vector<BuildItem> build_items(num_items);
+        parallel_for_chunks(0, num_items, 1 << 14,
+            [&](int item_begin, int item_end, int) {
+                for (int item = item_begin; item < item_end; ++item) {
+                    build_items[item].box = NodeBox(item_box(item));
+                    build_items[item].item = item;
+                }
+            });
+        build(&build_items);
+    }
+
+    /* Finds the first item that the ray 'origin + t * direction' hits, for
+    0 <= t <= 't_max'. 'hit(i)' returns the 't' at which the ray hits item
+    'i', or infinity if it misses. Boxes are visited nearest first, and boxes
+    that start beyond the closest hit so far are skipped, so usually only a
+    few items are tested. Returns the item, or -1 if nothing was hit; '*t_out'
+    gets the 't' of the hit. */
+    template<class Hit>
+    int ray_cast(
+        Point origin,
+        Vector direction,
+        double t_max,
+        const Hit &hit,
+        double *t_out = nullptr
+    ) const;
+
+    /* Calls 'visit(i)' once for each item whose box might touch the plane of
+    points 'p' where 'normal.dot(p - Point::origin()) == offset', in no
+    particular order. Subtrees whose boxes lie entirely to one side are
+    skipped, but the items in a leaf are all visited together, so a few items
+    near the plane may be visited that don't actually touch it. */
+    template<class Visit>
+    void plane_query(Vector normal, double offset, const Visit &visit) const;
+
+    int num_items() const { return items.size(); }
+
+private:
+    /* Floats halve the size of the tree. They're rounded outwards, so a box
+    never ends up smaller than the one it was made from. */
+    class NodeBox {
+    public:
+        NodeBox() { }
+        explicit NodeBox(const Box &box);
+        void add(const NodeBox &other);
+        float lo[3], hi[3];
+    };
+
+    class Node {
+    public:
+        NodeBox box;
+        /* A leaf holds 'items[first]' through 'items[first + count - 1]'.
+        Otherwise 'count' is zero; the first child comes right after this node,
+        and the second child is at 'first'. */
+        int first, count;
+    };
+
+    class BuildItem {
+    public:
+        NodeBox box;
+        int item;
+    };
+
+    /* The inverse of the direction is precomputed, so testing a box is just
+    multiplications and comparisons */
+    class Ray {
+    public:
+        Ray(Point origin, Vector direction);
+
+        /* Returns where the ray enters 'box', clipped to [0, t_max]; or
+        infinity if it misses the box or only enters it after 't_max' */
+        double enter(const NodeBox &box, double t_max) const {
+            double t_begin = 0, t_end = t_max;
+            for (int i = 0; i < 3; ++i) {
+                double a = (box.lo[i] - origin[i]) * inverse[i];
+                double b = (box.hi[i] - origin[i]) * inverse[i];
+                if (a > b) std::swap(a, b);
+                /* Written so that a NaN (from a ray that lies exactly in the
+                plane of a face) doesn't clip anything */
+                if (a > t_begin) t_begin = a;
+                if (b < t_end) t_end = b;
+            }
+            return t_begin <= t_end
+                ? t_begin
+                : std::numeric_limits<double>::infinity();
+        }
+
+    private:
+        double origin[3], inverse[3];
+    };
+
+    static const int max_leaf_items = 8;
+
+    /* Splits always put half the items (rounded down) in the first child, so
+    the shape of the tree depends only on the number of items. That means
+    each subtree's place in 'nodes' is known before anything is built, so
+    subtrees can be built on separate threads. */
+    class NodeCounter {
+    public:
+        /* Returns the number of nodes in a tree with 'num_items' items */
+        int operator()(int num_items);
+    private:
+        std::map<int, int> cache;
+    };
+
+    void build(std::vector<BuildItem> *build_items);
+    void build_node(
+        BuildItem *begin,
+        BuildItem *end,
+        BuildItem *all,
+        int index,
+        int parallel_depth,
+        NodeCounter *node_counter);
+
+    std::vector<Node> nodes;
+    /* Item indices, in the order that the leaves refer to them */
+    std::vector<int> items;
+};
+
+template<class Hit>
+int Bvh::ray_cast(
+    Point origin,
+    Vector direction,
+    double t_max,
+    const Hit &hit,
+    double *t_out
+) const {
+    if (nodes.empty()) {
+        return -1;
+    }
+    Ray ray(origin, direction);
+
+    /* Each level pushes at most one node besides the one it descends into,
+    and the tree is at most about log2(num_items) levels deep */
+    struct StackEntry {
+        int node;
+        double t;
+    };
+    StackEntry stack[64];
+    int stack_size = 0;
+
+    int best_item = -1;
+    double t = ray.enter(nodes[0].box, t_max);
+    if (t <= t_max) {
+        stack[stack_size++] = {0, t};
+    }
+    while (stack_size > 0) {
+        StackEntry entry = stack[--stack_size];
+        if (entry.t > t_max) {
+            continue;
+        }
+        const Node &node = nodes[entry.node];
+        if (node.count != 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                double item_t = hit(items[i]);
+                if (item_t >= 0 && item_t <= t_max) {
+                    t_max = item_t;
+                    best_item = items[i];
+                }
+            }
+            continue;
+        }
+        int near = entry.node + 1, far = node.first;
+        double near_t = ray.enter(nodes[near].box, t_max);
+        double far_t = ray.enter(nodes[far].box, t_max);
+        if (far_t < near_t) {
+            std::swap(near, far);
+            std::swap(near_t, far_t);
+        }
+        if (far_t <= t_max) {
+            stack[stack_size++] = {far, far_t};
+        }
+        if (near_t <= t_max) {
+            stack[stack_size++] = {near, near_t};
+        }
+    }
+
+    if (t_out != nullptr) {
+        *t_out = t_max;
+    }
+    return best_item;
+}
+
+template<class Visit>
+void Bvh::plane_query(
+    Vector normal,
+    double offset,
+    const Visit &visit
+) const {
+    if (nodes.empty()) {
+        return;
+    }
+    double n[3] = {normal.x, normal.y, normal.z};
+
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const Node &node = nodes[stack[--stack_size]];
+        double lo = 0, hi = 0;
+        for (int i = 0; i < 3; ++i) {
+            double a = n[i] * node.box.lo[i], b = n[i] * node.box.hi[i];
+            lo += std::min(a, b);
+            hi += std::max(a, b);
+        }
+        if (lo > offset || hi < offset) {
+            continue;
+        }
+        if (node.count != 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                visit(items[i]);
+            }
+            continue;
+        }
+        stack[stack_size++] = node.first;
+        stack[stack_size++] = &node - nodes.data() + 1;
+    }
+}
+
+} /* namespace os2cx */
+
+#endif
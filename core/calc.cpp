@@ -2,6 +2,9 @@
 
 #include <assert.h>
 
+#include <algorithm>
+#include <limits>
+
 namespace os2cx {
 
 std::ostream &operator<<(std::ostream &stream, Dimension dimension) {
@@ -34,6 +37,32 @@ Vector triangle_normal(Point p1, Point p2, Point p3) {
     return c / c.magnitude();
 }
 
+double ray_triangle_intersection(
+    Point origin, Vector direction, Point p1, Point p2, Point p3
+) {
+    /* Moller and Trumbore's method: solve origin + t * direction =
+    p1 + u * e1 + v * e2 for (t, u, v) by Cramer's rule */
+    static const double miss = std::numeric_limits<double>::infinity();
+    LengthVector e1 = p2 - p1;
+    LengthVector e2 = p3 - p1;
+    Vector pv = direction.cross(e2);
+    double det = e1.dot(pv);
+    if (det == 0) {
+        return miss;
+    }
+    LengthVector tv = origin - p1;
+    double u = tv.dot(pv) / det;
+    if (!(u >= 0 && u <= 1)) {
+        return miss;
+    }
+    Vector qv = tv.cross(e1);
+    double v = direction.dot(qv) / det;
+    if (!(v >= 0 && u + v <= 1)) {
+        return miss;
+    }
+    return e2.dot(qv) / det;
+}
+
 std::ostream &operator<<(std::ostream &stream, Point point) {
     return stream << '('
         << point.x << ' '
@@ -109,6 +138,44 @@ double von_mises_stress(const Matrix &m) {
     return sqrt(3 * j2);
 }
 
+void principal_stresses(const Matrix &m, double *s1, double *s2, double *s3) {
+    /* Closed-form eigenvalues of a symmetric 3x3 matrix; see "Eigenvalues of
+    a symmetric 3x3 matrix", O. K. Smith, CACM 4(4), 1961. */
+    double xx = m.cols[0].x, yy = m.cols[1].y, zz = m.cols[2].z;
+    double xy = m.cols[0].y, yz = m.cols[1].z, zx = m.cols[2].x;
+    double off_diagonal = xy * xy + yz * yz + zx * zx;
+    if (off_diagonal == 0) {
+        double diagonal[3] = {xx, yy, zz};
+        std::sort(diagonal, diagonal + 3);
+        *s1 = diagonal[2];
+        *s2 = diagonal[1];
+        *s3 = diagonal[0];
+        return;
+    }
+    double q = (xx + yy + zz) / 3;
+    double p = sqrt(
+        (pow(xx - q, 2) + pow(yy - q, 2) + pow(zz - q, 2)
+            + 2 * off_diagonal) / 6);
+    /* B = (m - q*I) / p; then r = det(B) / 2 */
+    double bxx = (xx - q) / p, byy = (yy - q) / p, bzz = (zz - q) / p;
+    double bxy = xy / p, byz = yz / p, bzx = zx / p;
+    double r = (bxx * (byy * bzz - byz * byz)
+        - bxy * (bxy * bzz - byz * bzx)
+        + bzx * (bxy * byz - byy * bzx)) / 2;
+    double phi;
+    if (r <= -1) {
+        phi = M_PI / 3;
+    } else if (r >= 1) {
+        phi = 0;
+    } else {
+        /* This also passes NaN through */
+        phi = acos(r) / 3;
+    }
+    *s1 = q + 2 * p * cos(phi);
+    *s3 = q + 2 * p * cos(phi + (2 * M_PI / 3));
+    *s2 = 3 * q - *s1 - *s3;
+}
+
 std::ostream &operator<<(std::ostream &stream, Box box) {
     return stream << "Box("
         << box.xl << ", " << box.yl << ", " << box.zl << ", "
@@ -168,6 +168,12 @@ inline Point operator+(LengthVector a, Point b) {
 
 Vector triangle_normal(Point p1, Point p2, Point p3);
 
+/* Returns the 't' at which the ray 'origin + t * direction' passes through the
+triangle (p1, p2, p3), from either side; or infinity if it misses, or if the
+triangle is degenerate. 't' may be negative. */
+double ray_triangle_intersection(
+    Point origin, Vector direction, Point p1, Point p2, Point p3);
+
 std::ostream &operator<<(std::ostream &stream, Point point);
 
 class ComplexVector {
@@ -289,6 +295,9 @@ public:
 
 double von_mises_stress(const Matrix &m);
 
+/* Computes the eigenvalues of the symmetric matrix 'm', in decreasing order */
+void principal_stresses(const Matrix &m, double *s1, double *s2, double *s3);
+
 class AffineTransform {
 public:
     AffineTransform() { }
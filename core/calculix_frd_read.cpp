@@ -1,149 +1,270 @@
 #include "calculix_frd_read.hpp"
 
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
 #include <sstream>
 
 namespace os2cx {
 
+/* CalculixFrdReader parses an FRD file that's held entirely in memory. It never
+copies the file or tracks line numbers as it goes; the line number is only
+computed when an error message needs it. Several readers can work on different
+parts of the same buffer at once. */
 class CalculixFrdReader {
 public:
-    CalculixFrdReader(std::istream *s) : stream(s), line_no(1) { }
-
-    template<int size>
-    void read_text(char *buf) {
-        int remaining = size;
-        while (remaining > 0 && stream->peek() == ' ') {
-            stream->ignore();
-            --remaining;
-        }
-        char *insert_nul_at = buf;
-        while (remaining > 0) {
-            int c = stream->peek();
+    CalculixFrdReader(const char *file_begin, const char *file_end) :
+        file_begin(file_begin), pos(file_begin), file_end(file_end) { }
+
+    /* Returns the length of the next fixed-width field, which is 'size'
+    characters unless the line ends sooner. */
+    int field_length(int size) {
+        int length = 0;
+        for (; length < size; ++length) {
+            if (pos + length == file_end) {
+                pos += length;
+                fail("unexpected EOF");
+            }
+            char c = pos[length];
             if (c == '\n') {
                 break;
             }
-            if (c == -1) {
-                fail("unexpected EOF");
-            }
             if (c == '\0') {
+                pos += length;
                 fail("unexpected NUL byte");
             }
-            *buf = stream->get();
-            ++buf;
-            if (c != ' ') {
-                /* don't update insert_nul_at unless we found a non-space
-                character; this will ensure that we strip trailing spaces */
-                insert_nul_at = buf;
-            }
-            --remaining;
         }
-        *insert_nul_at = '\0';
+        return length;
+    }
+
+    /* Reads a fixed-width text field, stripping leading and trailing spaces */
+    template<int size>
+    void read_text(char *buf) {
+        int length = field_length(size);
+        const char *field_begin = pos, *field_end = pos + length;
+        pos = field_end;
+        while (field_begin != field_end && *field_begin == ' ') {
+            ++field_begin;
+        }
+        while (field_end != field_begin && field_end[-1] == ' ') {
+            --field_end;
+        }
+        memcpy(buf, field_begin, field_end - field_begin);
+        buf[field_end - field_begin] = '\0';
     }
 
     template<int size>
     int read_text_int() {
-        char buffer[size + 1];
-        read_text<size>(buffer);
-        char *endptr;
-        int value = strtol(buffer, &endptr, 10);
-        if (*buffer == '\0' || *endptr != '\0') {
-            fail(std::string("invalid integer: '") + buffer + "'");
+        int length = field_length(size);
+        const char *field_begin = pos, *field_end = pos + length;
+        pos = field_end;
+
+        const char *p = field_begin;
+        while (p != field_end && *p == ' ') ++p;
+        bool negative = false;
+        if (p != field_end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            ++p;
         }
-        return value;
+        const char *digits_begin = p;
+        int value = 0;
+        while (p != field_end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p - '0');
+            ++p;
+        }
+        const char *digits_end = p;
+        while (p != field_end && *p == ' ') ++p;
+        if (digits_begin == digits_end || p != field_end) {
+            fail("invalid integer: '" + trimmed(field_begin, field_end) + "'");
+        }
+        return negative ? -value : value;
     }
 
     template<int size>
     double read_text_double() {
-        char buffer[size + 1];
-        read_text<size>(buffer);
-        char *endptr;
-        double value = strtod(buffer, &endptr);
-        if (*buffer == '\0' || *endptr != '\0') {
-            fail(std::string("invalid double: '") + buffer + "'");
+        int length = field_length(size);
+        const char *field_begin = pos, *field_end = pos + length;
+        pos = field_end;
+
+        double value;
+        if (!parse_simple_double(field_begin, field_end, &value)) {
+            /* Anything unusual (NaN, infinity, very long mantissas, extreme
+            exponents) goes through strtod() to get exactly its behavior. */
+            std::string buffer = trimmed(field_begin, field_end);
+            char *endptr;
+            value = strtod(buffer.c_str(), &endptr);
+            if (buffer.empty() || *endptr != '\0') {
+                fail("invalid double: '" + buffer + "'");
+            }
         }
         return value;
     }
 
-    template<int size>
-    void read_bin(char *buf) {
-        stream->read(buf, size);
-        if (stream->eof()) {
+    void read_bin(char *buf, int size) {
+        if (file_end - pos < size) {
             fail("unexpected EOF");
         }
-        for (int i = 0; i < size; ++i) {
-            if (buf[i] == '\n') {
-                ++line_no;
-            }
-        }
+        memcpy(buf, pos, size);
+        pos += size;
     }
 
     int read_bin_int() {
-        union {
-            int value;
-            char buf[sizeof(int)];
-        };
-        read_bin<sizeof(int)>(buf);
+        int value;
+        read_bin(reinterpret_cast<char *>(&value), sizeof(value));
         return value;
     }
 
-    float read_bin_float() {
-        union {
-            float value;
-            char buf[sizeof(float)];
-        };
-        read_bin<sizeof(float)>(buf);
-        return value;
-    }
-
-    double read_bin_double() {
-        union {
-            double value;
-            char buf[sizeof(double)];
-        };
-        read_bin<sizeof(double)>(buf);
-        return value;
+    void skip_bin(int64_t size) {
+        if (file_end - pos < size) {
+            fail("unexpected EOF");
+        }
+        pos += size;
     }
 
     void read_indent(int indent) {
-        while (indent > 0) {
-            int c = stream->get();
-            if (c == -1) {
+        for (; indent > 0; --indent, ++pos) {
+            if (pos == file_end) {
                 fail("unexpected EOF");
             }
-            if (c != ' ') {
+            if (*pos != ' ') {
                 fail("expected space, got something else");
             }
-            --indent;
         }
     }
 
     void read_eol() {
         while (true) {
-            int c = stream->get();
-            if (c == -1) {
+            if (pos == file_end) {
                 fail("expected EOL, got EOF");
-            } else if (c == '\n') {
+            }
+            char c = *pos;
+            if (c == '\n') {
+                ++pos;
                 break;
             } else if (c != ' ') {
                 fail("expected EOL, got '" + std::string(1, c) + "'");
             }
+            ++pos;
+        }
+    }
+
+    /* Skips the rest of the current line, including the newline */
+    void skip_line() {
+        const char *newline = static_cast<const char *>(
+            memchr(pos, '\n', file_end - pos));
+        if (newline == nullptr) {
+            pos = file_end;
+            fail("unexpected EOF");
         }
-        ++line_no;
+        pos = newline + 1;
     }
 
     void read_eof() {
-        if (stream->peek() != -1) {
+        if (pos != file_end) {
             fail("expected EOF");
         }
     }
 
     void fail(const std::string &message) {
+        int line_no = 1 + std::count(file_begin, pos, '\n');
         std::stringstream ss;
         ss << message << " (at line " << line_no << ")";
         throw CalculixFrdFileReadError(ss.str());
     }
 
-    std::istream *stream;
-    int line_no;
+    const char *file_begin;
+    const char *pos;
+    const char *file_end;
+
+private:
+    static std::string trimmed(const char *begin, const char *end) {
+        while (begin != end && *begin == ' ') ++begin;
+        while (end != begin && end[-1] == ' ') --end;
+        return std::string(begin, end);
+    }
+
+    /* Parses fields like "-1.23456E+01" without going through strtod(). This
+    only handles the cases where the result is guaranteed to be exactly what
+    strtod() would return: the mantissa's digits fit in 53 bits and the
+    decimal exponent is small enough that 10^exponent is exactly representable,
+    so a single multiplication or division rounds correctly. Returns false for
+    everything else. */
+    static bool parse_simple_double(
+        const char *p,
+        const char *end,
+        double *value_out
+    ) {
+        static const double powers_of_10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        while (p != end && *p == ' ') ++p;
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        uint64_t mantissa = 0;
+        int num_digits = 0, exponent = 0;
+        while (p != end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p - '0');
+            ++num_digits;
+            ++p;
+        }
+        if (p != end && *p == '.') {
+            ++p;
+            while (p != end && *p >= '0' && *p <= '9') {
+                mantissa = mantissa * 10 + (*p - '0');
+                ++num_digits;
+                --exponent;
+                ++p;
+            }
+        }
+        if (num_digits == 0 || num_digits > 18) {
+            return false;
+        }
+
+        if (p != end && (*p == 'E' || *p == 'e')) {
+            ++p;
+            bool exponent_negative = false;
+            if (p != end && (*p == '-' || *p == '+')) {
+                exponent_negative = (*p == '-');
+                ++p;
+            }
+            int explicit_exponent = 0, num_exponent_digits = 0;
+            while (p != end && *p >= '0' && *p <= '9') {
+                explicit_exponent = explicit_exponent * 10 + (*p - '0');
+                ++num_exponent_digits;
+                ++p;
+            }
+            if (num_exponent_digits == 0 || num_exponent_digits > 4) {
+                return false;
+            }
+            exponent += exponent_negative
+                ? -explicit_exponent : explicit_exponent;
+        }
+        while (p != end && *p == ' ') ++p;
+        if (p != end) {
+            return false;
+        }
+
+        if (mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22) {
+            return false;
+        }
+        double value = static_cast<double>(mantissa);
+        if (exponent >= 0) {
+            value *= powers_of_10[exponent];
+        } else {
+            value /= powers_of_10[-exponent];
+        }
+        *value_out = negative ? -value : value;
+        return true;
+    }
 };
 
 void read_user_header_record(CalculixFrdReader &r) {
@@ -152,13 +273,26 @@ void read_user_header_record(CalculixFrdReader &r) {
     r.read_eol();
 }
 
-enum class FrdFormat {
-    TextShort = 0,
-    TextLong = 1,
-    BinaryFloat = 2,
-    BinaryDouble = 3
-};
+/* Skips the text records of a block, up to and including the record with key
+-3 that ends it. Callers that only need to get past a block use this to avoid
+parsing every field. */
+void skip_text_records(CalculixFrdReader &r, const char *bad_code_message) {
+    while (true) {
+        r.read_indent(1);
+        int code = r.read_text_int<2>();
+        if (code == -1 || code == -2) {
+            r.skip_line();
+        } else if (code == -3) {
+            r.read_eol();
+            break;
+        } else {
+            r.fail(bad_code_message);
+        }
+    }
+}
 
+/* We take node coordinates from the mesh we wrote, so the coordinate block is
+skipped rather than parsed. */
 void read_nodal_point_coordinate_block(CalculixFrdReader &r) {
     r.read_indent(18);
     int numnod = r.read_text_int<12>();
@@ -167,38 +301,12 @@ void read_nodal_point_coordinate_block(CalculixFrdReader &r) {
     r.read_eol();
 
     if (format == FrdFormat::TextShort || format == FrdFormat::TextLong) {
-        while (true) {
-            r.read_indent(1);
-            int code = r.read_text_int<2>();
-            if (code == -1) {
-                if (format == FrdFormat::TextShort) {
-                    r.read_text_int<5>();
-                } else {
-                    r.read_text_int<10>();
-                }
-                r.read_text_double<12>();
-                r.read_text_double<12>();
-                r.read_text_double<12>();
-                r.read_eol();
-            } else if (code == -3) {
-                r.read_eol();
-                break;
-            } else {
-                r.fail("bad code in nodal point coordinate block");
-            }
-        }
+        skip_text_records(r, "bad code in nodal point coordinate block");
     } else if (format == FrdFormat::BinaryFloat ||
             format == FrdFormat::BinaryDouble) {
-        for (int i = 0; i < numnod; ++i) {
-            r.read_bin_int();
-            for (int i = 0; i < 3; ++i) {
-                if (format == FrdFormat::BinaryFloat) {
-                    r.read_bin_float();
-                } else {
-                    r.read_bin_double();
-                }
-            }
-        }
+        int64_t record_size = sizeof(int) + 3 *
+            (format == FrdFormat::BinaryFloat ? sizeof(float) : sizeof(double));
+        r.skip_bin(record_size * numnod);
     } else {
         r.fail("bad format in nodal point coordinate block");
     }
@@ -241,6 +349,7 @@ int nodes_for_frd_element_type(CalculixFrdElementType type) {
     }
 }
 
+/* Like the coordinate block, the element definition block is skipped. */
 void read_element_definition_block(CalculixFrdReader &r) {
     r.read_indent(18);
     int numelem = r.read_text_int<12>();
@@ -249,65 +358,19 @@ void read_element_definition_block(CalculixFrdReader &r) {
     r.read_eol();
 
     if (format == FrdFormat::TextShort || format == FrdFormat::TextLong) {
-        while (true) {
-            r.read_indent(1);
-            int code = r.read_text_int<2>();
-            if (code == -1) {
-                if (format == FrdFormat::TextShort) {
-                    r.read_text_int<5>();
-                } else {
-                    r.read_text_int<10>();
-                }
-                int frd_element_type = r.read_text_int<5>();
-                if (!valid_frd_element_type(frd_element_type)) {
-                    r.fail("unrecognized element type");
-                }
-                r.read_text_int<5>();
-                r.read_text_int<5>();
-                r.read_eol();
-
-                int num_nodes = nodes_for_frd_element_type(
-                    static_cast<CalculixFrdElementType>(frd_element_type));
-                while (num_nodes > 0) {
-                    r.read_indent(1);
-                    code = r.read_text_int<2>();
-                    if (code != -2) {
-                        r.fail("expected nodes for element");
-                    }
-                    int num_nodes_this_line;
-                    if (format == FrdFormat::TextShort) {
-                        num_nodes_this_line = std::min(num_nodes, 15);
-                    } else {
-                        num_nodes_this_line = std::min(num_nodes, 10);
-                    }
-                    num_nodes -= num_nodes_this_line;
-                    for (int i = 0; i < num_nodes_this_line; ++i) {
-                        if (format == FrdFormat::TextShort) {
-                            r.read_text_int<5>();
-                        } else {
-                            r.read_text_int<10>();
-                        }
-                    }
-                    r.read_eol();
-                }
-            } else if (code == -3) {
-                r.read_eol();
-                break;
-            } else {
-                r.fail("bad code in element definition block");
-            }
-        }
+        skip_text_records(r, "bad code in element definition block");
     } else if (format == FrdFormat::BinaryFloat) {
         for (int i = 0; i < numelem; ++i) {
-            r.read_bin_int();
+            /* Each element is its number, type, group, and material, followed
+            by its nodes */
+            r.skip_bin(sizeof(int));
             int frd_element_type = r.read_bin_int();
-            r.read_bin_int();
-            r.read_bin_int();
+            if (!valid_frd_element_type(frd_element_type)) {
+                r.fail("unrecognized element type");
+            }
             int num_nodes = nodes_for_frd_element_type(
                 static_cast<CalculixFrdElementType>(frd_element_type));
-            for (int i = 0; i < num_nodes; ++i) {
-                r.read_bin_int();
-            }
+            r.skip_bin(sizeof(int) * (2 + num_nodes));
         }
     } else {
         r.fail("bad format in element definition block");
@@ -359,61 +422,82 @@ void read_nodal_results_block_entity(
     r.read_eol();
 }
 
-void read_nodal_results_block_data(
+void read_nodal_results_block_text_record(
     CalculixFrdReader &r,
     FrdFormat format,
     int num_values,
     NodeId *node_id_out,
     double *values_out
 ) {
-    if (format == FrdFormat::TextShort || format == FrdFormat::TextLong) {
+    r.read_indent(1);
+    int key = r.read_text_int<2>();
+    if (key != -1) {
+        r.fail("expected key=-1 in nodal results block");
+    }
+    if (format == FrdFormat::TextShort) {
+        *node_id_out = NodeId::from_int(r.read_text_int<5>());
+    } else {
+        *node_id_out = NodeId::from_int(r.read_text_int<10>());
+    }
+    int i = 0;
+    for (; i < num_values && i < 6; ++i) {
+        values_out[i] = r.read_text_double<12>();
+    }
+    r.read_eol();
+
+    while (i < num_values) {
         r.read_indent(1);
         int key = r.read_text_int<2>();
-        if (key != -1) {
-            r.fail("expected key=-1 in nodal results block");
+        if (key != -2) {
+            r.fail("expected key=-2 in nodal results block");
         }
-        if (format == FrdFormat::TextShort) {
-            *node_id_out = NodeId::from_int(r.read_text_int<5>());
-        } else {
-            *node_id_out = NodeId::from_int(r.read_text_int<10>());
-        }
-        int i = 0;
-        for (; i < num_values && i < 6; ++i) {
+        for (int j = 0; i < num_values && j < 6; ++i, ++j) {
             values_out[i] = r.read_text_double<12>();
         }
         r.read_eol();
+    }
+}
 
-        while (i < num_values) {
-            r.read_indent(1);
-            int key = r.read_text_int<2>();
-            if (key != -2) {
-                r.fail("expected key=-2 in nodal results block");
-            }
-            for (int j = 0; i < num_values && j < 6; ++i, ++j) {
-                values_out[i] = r.read_text_double<12>();
-            }
-            r.read_eol();
+/* In the binary formats every node record has the same size: the node number,
+followed by one 'Value' per component. The bounds of the whole block are
+checked once, and then each record's values are copied out in one go. */
+template<class Value>
+void read_nodal_results_block_binary_records(
+    CalculixFrdReader &r,
+    int numnod,
+    NodeId node_id_begin,
+    NodeId node_id_end,
+    const std::vector<ContiguousMap<NodeId, double> *> &present
+) {
+    int ncomps_present = present.size();
+    int record_size = sizeof(int) + ncomps_present * sizeof(Value);
+    const char *record = r.pos;
+    r.skip_bin(static_cast<int64_t>(record_size) * numnod);
+
+    std::vector<Value> values(ncomps_present);
+    for (int i = 0; i < numnod; ++i, record += record_size) {
+        int node;
+        memcpy(&node, record, sizeof(int));
+        memcpy(values.data(), record + sizeof(int),
+            ncomps_present * sizeof(Value));
+
+        NodeId node_id = NodeId::from_int(node);
+        if (node_id < node_id_begin || !(node_id < node_id_end)) {
+            r.pos = record + record_size;
+            r.fail("node id out of range");
         }
-    } else if (format == FrdFormat::BinaryFloat ||
-            format == FrdFormat::BinaryDouble) {
-        *node_id_out = NodeId::from_int(r.read_bin_int());
-        for (int i = 0; i < num_values; ++i) {
-            if (format == FrdFormat::BinaryFloat) {
-                values_out[i] = r.read_bin_float();
-            } else {
-                values_out[i] = r.read_bin_double();
-            }
+        for (int j = 0; j < ncomps_present; ++j) {
+            (*present[j])[node_id] = values[j];
         }
-    } else {
-        r.fail("bad format in nodal results block");
     }
 }
 
-void read_nodal_results_block(
+/* Reads the header and entity records of a nodal results block, and skips over
+its node records without parsing them. */
+void read_nodal_results_block_header(
     CalculixFrdReader &r,
-    NodeId node_id_begin,
-    NodeId node_id_end,
-    FrdAnalysis *analysis_out
+    FrdAnalysis *analysis_out,
+    FrdNodalResultsBlockData *data_out
 ) {
     char setname[6 + 1];
     r.read_text<6>(setname);
@@ -459,49 +543,88 @@ void read_nodal_results_block(
     int ncomps_present = 0;
     for (int i = 0; i < ncomps; ++i) {
         read_nodal_results_block_entity(r, &analysis_out->entities[i]);
-
         if (analysis_out->entities[i].exist == FrdEntity::Exist::Provided) {
-            analysis_out->entities[i].data =
-                ContiguousMap<NodeId, double>(node_id_begin, node_id_end, NAN);
             ++ncomps_present;
         }
     }
 
-    std::vector<double> values(ncomps_present);
-    for (int i = 0; i < numnod; ++i) {
+    data_out->begin = r.pos;
+    data_out->format = format;
+    data_out->numnod = numnod;
+    data_out->ncomps_present = ncomps_present;
+
+    if (format == FrdFormat::TextShort || format == FrdFormat::TextLong) {
+        skip_text_records(r, "expected key=-3 in nodal results block");
+    } else if (format == FrdFormat::BinaryFloat ||
+            format == FrdFormat::BinaryDouble) {
+        int64_t record_size = sizeof(int) + ncomps_present *
+            (format == FrdFormat::BinaryFloat ? sizeof(float) : sizeof(double));
+        r.skip_bin(record_size * numnod);
+    } else {
+        r.fail("bad format in nodal results block");
+    }
+}
+
+/* Parses the node records that read_nodal_results_block_header() skipped */
+void read_nodal_results_block_data_records(
+    CalculixFrdReader &r,
+    const FrdNodalResultsBlockData &data,
+    NodeId node_id_begin,
+    NodeId node_id_end,
+    FrdAnalysis *analysis
+) {
+    std::vector<ContiguousMap<NodeId, double> *> present;
+    for (FrdEntity &entity : analysis->entities) {
+        if (entity.exist == FrdEntity::Exist::Provided) {
+            entity.data =
+                ContiguousMap<NodeId, double>(node_id_begin, node_id_end, NAN);
+            present.push_back(&entity.data);
+        }
+    }
+    assert(static_cast<int>(present.size()) == data.ncomps_present);
+
+    r.pos = data.begin;
+    if (data.format == FrdFormat::BinaryFloat) {
+        read_nodal_results_block_binary_records<float>(
+            r, data.numnod, node_id_begin, node_id_end, present);
+        return;
+    } else if (data.format == FrdFormat::BinaryDouble) {
+        read_nodal_results_block_binary_records<double>(
+            r, data.numnod, node_id_begin, node_id_end, present);
+        return;
+    }
+
+    std::vector<double> values(data.ncomps_present);
+    for (int i = 0; i < data.numnod; ++i) {
         NodeId node_id;
-        read_nodal_results_block_data(
-            r, format, ncomps_present, &node_id, values.data());
+        read_nodal_results_block_text_record(
+            r, data.format, data.ncomps_present, &node_id, values.data());
         if (node_id < node_id_begin || !(node_id < node_id_end)) {
             r.fail("node id out of range");
         }
-
-        int i_present = 0;
-        for (int i = 0; i < ncomps; ++i) {
-            if (analysis_out->entities[i].exist == FrdEntity::Exist::Provided) {
-                analysis_out->entities[i].data[node_id] = values[i_present];
-                ++i_present;
-            }
+        for (int j = 0; j < data.ncomps_present; ++j) {
+            (*present[j])[node_id] = values[j];
         }
     }
 
-    if (format == FrdFormat::TextShort || format == FrdFormat::TextLong) {
-        r.read_indent(1);
-        int key = r.read_text_int<2>();
-        if (key != -3) {
-            r.fail("expected key=-3 in nodal results block");
-        }
-        r.read_eol();
+    r.read_indent(1);
+    int key = r.read_text_int<2>();
+    if (key != -3) {
+        r.fail("expected key=-3 in nodal results block");
     }
+    r.read_eol();
 }
 
-void read_calculix_frd(
-    std::istream &stream,
-    NodeId node_id_begin,
-    NodeId node_id_end,
-    std::vector<FrdAnalysis> *analyses_out
+/* Scans through the whole file, reading the small records and skipping over the
+bulk of every block. Returns the header of every nodal results block, and where
+to find its node records. */
+void scan_calculix_frd(
+    const char *begin,
+    const char *end,
+    std::vector<FrdAnalysis> *analyses_out,
+    std::vector<FrdNodalResultsBlockData> *analyses_data_out
 ) {
-    CalculixFrdReader r(&stream);
+    CalculixFrdReader r(begin, end);
 
     r.read_indent(1);
     int key = r.read_text_int<4>();
@@ -532,13 +655,100 @@ void read_calculix_frd(
             read_parameter_header_record(r);
         } else if (key == 100 && code[0] == 'C') {
             FrdAnalysis analysis;
-            read_nodal_results_block(r, node_id_begin, node_id_end, &analysis);
+            FrdNodalResultsBlockData data;
+            read_nodal_results_block_header(r, &analysis, &data);
             analyses_out->push_back(std::move(analysis));
+            analyses_data_out->push_back(data);
         } else {
             r.fail("unrecognized block code");
         }
     }
 }
 
-} /* namespace os2cx */
+void read_calculix_frd(
+    const char *begin,
+    const char *end,
+    NodeId node_id_begin,
+    NodeId node_id_end,
+    std::vector<FrdAnalysis> *analyses_out
+) {
+    std::vector<FrdAnalysis> analyses;
+    std::vector<FrdNodalResultsBlockData> analyses_data;
+    scan_calculix_frd(begin, end, &analyses, &analyses_data);
+
+    /* Then parse the node records of the nodal results blocks. The blocks are
+    independent of each other, so they're parsed in parallel. */
+    parallel_for_chunks(0, analyses.size(), 1,
+        [&](int chunk_begin, int chunk_end, int) {
+            CalculixFrdReader chunk_reader(begin, end);
+            for (int i = chunk_begin; i < chunk_end; ++i) {
+                read_nodal_results_block_data_records(
+                    chunk_reader, analyses_data[i],
+                    node_id_begin, node_id_end, &analyses[i]);
+            }
+        });
+
+    for (FrdAnalysis &analysis : analyses) {
+        analyses_out->push_back(std::move(analysis));
+    }
+}
+
+void read_calculix_frd(
+    std::istream &stream,
+    NodeId node_id_begin,
+    NodeId node_id_end,
+    std::vector<FrdAnalysis> *analyses_out
+) {
+    std::string contents(
+        (std::istreambuf_iterator<char>(stream)),
+        std::istreambuf_iterator<char>());
+    read_calculix_frd(
+        contents.data(), contents.data() + contents.size(),
+        node_id_begin, node_id_end, analyses_out);
+}
+
+void read_calculix_frd_file(
+    const FilePath &path,
+    NodeId node_id_begin,
+    NodeId node_id_end,
+    std::vector<FrdAnalysis> *analyses_out
+) {
+    std::unique_ptr<MappedFile> file;
+    try {
+        file.reset(new MappedFile(path));
+    } catch (const std::runtime_error &error) {
+        throw CalculixFrdFileReadError(error.what());
+    }
+    read_calculix_frd(
+        file->data(), file->data() + file->size(),
+        node_id_begin, node_id_end, analyses_out);
+}
 
+FrdFile::FrdFile(
+    const FilePath &path,
+    NodeId node_id_begin,
+    NodeId node_id_end
+) :
+    node_id_begin(node_id_begin),
+    node_id_end(node_id_end)
+{
+    try {
+        file.reset(new MappedFile(path));
+    } catch (const std::runtime_error &error) {
+        throw CalculixFrdFileReadError(error.what());
+    }
+    scan_calculix_frd(
+        file->data(), file->data() + file->size(),
+        &headers, &headers_data);
+}
+
+FrdAnalysis FrdFile::load_analysis(int index) const {
+    assert(index >= 0 && index < static_cast<int>(headers.size()));
+    FrdAnalysis analysis = headers[index];
+    CalculixFrdReader r(file->data(), file->data() + file->size());
+    read_nodal_results_block_data_records(
+        r, headers_data[index], node_id_begin, node_id_end, &analysis);
+    return analysis;
+}
+
+} /* namespace os2cx */
@@ -2,6 +2,7 @@
 #define OS2CX_CALCULIX_FRD_READ_HPP_
 
 #include <iostream>
+#include <memory>
 
 #include "calc.hpp"
 #include "mesh.hpp"
@@ -70,18 +71,78 @@ public:
     std::vector<FrdEntity> entities;
 };
 
+enum class FrdFormat {
+    TextShort = 0,
+    TextLong = 1,
+    BinaryFloat = 2,
+    BinaryDouble = 3
+};
+
+/* Records where the node records of a nodal results block are, so that they
+can be parsed after the rest of the file has been scanned. */
+class FrdNodalResultsBlockData {
+public:
+    const char *begin;
+    FrdFormat format;
+    int numnod;
+    int ncomps_present;
+};
+
 class CalculixFrdFileReadError : public std::runtime_error {
 public:
     CalculixFrdFileReadError(const std::string &msg) :
         std::runtime_error(msg) { }
 };
 
+/* Parses the FRD file held in memory at [begin, end). The nodal results blocks
+are parsed in parallel. */
+void read_calculix_frd(
+    const char *begin,
+    const char *end,
+    NodeId node_id_begin,
+    NodeId node_id_end,
+    std::vector<FrdAnalysis> *analyses_out);
+
 void read_calculix_frd(
     std::istream &stream,
     NodeId node_id_begin,
     NodeId node_id_end,
     std::vector<FrdAnalysis> *analyses_out);
 
+/* Memory-maps the FRD file at 'path' and parses it in place. This is the
+fastest way to read large result files. */
+void read_calculix_frd_file(
+    const FilePath &path,
+    NodeId node_id_begin,
+    NodeId node_id_end,
+    std::vector<FrdAnalysis> *analyses_out);
+
+/* FrdFile scans an FRD file once, reading only the headers of its nodal results
+blocks and noting where each block's node records are. The file stays mapped,
+so the node records of any one block can be parsed later, when that block is
+actually needed. */
+class FrdFile {
+public:
+    FrdFile(const FilePath &path, NodeId node_id_begin, NodeId node_id_end);
+
+    /* The headers of all the nodal results blocks, in the order they appear in
+    the file. The entities' 'data' fields are left empty. */
+    const std::vector<FrdAnalysis> &analyses() const { return headers; }
+
+    NodeId node_begin() const { return node_id_begin; }
+    NodeId node_end() const { return node_id_end; }
+
+    /* Returns a copy of analyses()[index] with the entities' data filled in.
+    This can be called from several threads at once. */
+    FrdAnalysis load_analysis(int index) const;
+
+private:
+    std::unique_ptr<MappedFile> file;
+    NodeId node_id_begin, node_id_end;
+    std::vector<FrdAnalysis> headers;
+    std::vector<FrdNodalResultsBlockData> headers_data;
+};
+
 } /* namespace os2cx */
 
 #endif
@@ -1,9 +1,91 @@
 #include "calculix_inp_write.hpp"
 
-#include <fstream>
+#include <stdio.h>
+
+#include <map>
 
 namespace os2cx {
 
+/* Inputs for big meshes run to hundreds of megabytes, so the bulk of the file
+(nodes, elements, sets, and loads) is formatted into plain string buffers and
+handed to the stream in large writes, instead of going through the stream's
+formatting one number at a time. Doubles are formatted the same way that
+std::ostream formats them by default, so the output is unchanged. */
+class InpBuffer {
+public:
+    void append(const char *str) { text += str; }
+    void append(const std::string &str) { text += str; }
+    void append(char c) { text += c; }
+
+    void append_int(int value) {
+        char digits[16];
+        char *end = digits + sizeof(digits), *p = end;
+        unsigned int magnitude = value < 0
+            ? -static_cast<unsigned int>(value)
+            : static_cast<unsigned int>(value);
+        do {
+            *--p = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0) {
+            *--p = '-';
+        }
+        text.append(p, end - p);
+    }
+
+    void append_double(double value) {
+        char digits[32];
+        int length = snprintf(digits, sizeof(digits), "%g", value);
+        text.append(digits, length);
+    }
+
+    /* Writes the buffer's contents to 'stream' once it's big enough to be
+    worth a write() call */
+    void maybe_write_to(std::ostream &stream) {
+        if (text.size() >= 1 << 16) {
+            write_to(stream);
+        }
+    }
+
+    void write_to(std::ostream &stream) {
+        stream.write(text.data(), text.size());
+        text.clear();
+    }
+
+    std::string text;
+};
+
+/* Calls 'func(i, buffer)' for each 'i' in [begin, end) to format one line
+each, and writes the lines to 'stream' in order. The formatting is split into
+chunks that run in parallel; to bound memory use, only a limited number of
+lines are held in memory at once. */
+template<class Func>
+static void write_lines_in_parallel(
+    std::ostream &stream,
+    int begin,
+    int end,
+    const Func &func
+) {
+    static const int min_chunk_size = 8192;
+    static const int max_lines_per_round = 1 << 18;
+    for (int round_begin = begin; round_begin < end;
+            round_begin += max_lines_per_round) {
+        int round_end = std::min(end, round_begin + max_lines_per_round);
+        std::vector<InpBuffer> chunks(
+            parallel_num_chunks(round_begin, round_end, min_chunk_size));
+        parallel_for_chunks(round_begin, round_end, min_chunk_size,
+            [&](int chunk_begin, int chunk_end, int chunk_index) {
+                InpBuffer *buffer = &chunks[chunk_index];
+                for (int i = chunk_begin; i < chunk_end; ++i) {
+                    func(i, buffer);
+                }
+            });
+        for (InpBuffer &chunk : chunks) {
+            chunk.write_to(stream);
+        }
+    }
+}
+
 void write_calculix_create_node(
     std::ostream &stream,
     const std::string &name,
@@ -28,41 +110,104 @@ void write_calculix_nodes_and_elements(
     ElementId element_end
 ) {
     stream << "*NODE, NSET=N" << name << '\n';
-    for (NodeId nid = node_begin; nid != node_end; ++nid) {
-        const Node3 &node = mesh.nodes[nid];
-        stream << nid.to_int()
-            << ", " << node.point.x
-            << ", " << node.point.y
-            << ", " << node.point.z
-            << '\n';
-    }
-
-    std::set<ElementType> types_present;
+    write_lines_in_parallel(stream, node_begin.to_int(), node_end.to_int(),
+        [&](int i, InpBuffer *buffer) {
+            const Node3 &node = mesh.nodes[NodeId::from_int(i)];
+            buffer->append_int(i);
+            buffer->append(", ");
+            buffer->append_double(node.point.x);
+            buffer->append(", ");
+            buffer->append_double(node.point.y);
+            buffer->append(", ");
+            buffer->append_double(node.point.z);
+            buffer->append('\n');
+        });
+
+    /* Bucket the elements by type in a single pass */
+    std::map<ElementType, std::vector<ElementId> > elements_by_type;
     for (ElementId eid = element_begin; eid != element_end; ++eid) {
-        types_present.insert(mesh.elements[eid].type);
+        elements_by_type[mesh.elements[eid].type].push_back(eid);
     }
 
-    for (ElementType type : types_present) {
-        const ElementTypeShape &shape = element_type_shape(type);
+    for (const auto &pair : elements_by_type) {
+        const ElementTypeShape &shape = element_type_shape(pair.first);
+        const std::vector<ElementId> &element_ids = pair.second;
+        int num_vertices = shape.vertices.size();
         stream << "*ELEMENT, TYPE=" << shape.name
             << ", ELSET=E" << name << '\n';
-        for (ElementId eid = element_begin; eid != element_end; ++eid) {
-            const Element3 *element = &mesh.elements[eid];
-            if (element->type != type) continue;
-            stream << eid.to_int();
-            for (size_t i = 0; i < shape.vertices.size(); ++i) {
-                if (i == 15) {
-                    /* If there would be more than 16 entries on a single line,
-                    CalculiX expects it to be split into two lines */
-                    stream << "\n";
-                } else {
-                    stream << ", ";
+        write_lines_in_parallel(stream, 0, element_ids.size(),
+            [&](int i, InpBuffer *buffer) {
+                ElementId eid = element_ids[i];
+                const Element3 &element = mesh.elements[eid];
+                buffer->append_int(eid.to_int());
+                for (int j = 0; j < num_vertices; ++j) {
+                    if (j == 15) {
+                        /* If there would be more than 16 entries on a single
+                        line, CalculiX expects it to be split into two lines */
+                        buffer->append('\n');
+                    } else {
+                        buffer->append(", ");
+                    }
+                    buffer->append_int(element.nodes[j].to_int());
                 }
-                stream << element->nodes[i].to_int();
+                buffer->append('\n');
+            });
+    }
+}
+
+/* Writes a *NSET or *ELSET. 'header' is the keyword line without the newline,
+e.g. "*NSET, NSET=Nfoo". Runs of consecutive IDs are written as "first, last, 1"
+lines under a copy of the header with GENERATE added, and any IDs in shorter
+runs are listed one per line under the plain header. CalculiX adds to the
+existing set when the same set name appears again, so mixing the two works. */
+template<class Key>
+static void write_calculix_set_ranges(
+    std::ostream &stream,
+    const std::string &header,
+    const RangeSet<Key> &set
+) {
+    static const int min_generate_run_size = 3;
+    typedef typename RangeSet<Key>::Run Run;
+
+    bool any_listed = false, any_generated = false;
+    for (const Run *run = set.runs_begin(); run != set.runs_end(); ++run) {
+        if (run->size() >= min_generate_run_size) {
+            any_generated = true;
+        } else {
+            any_listed = true;
+        }
+    }
+
+    InpBuffer buffer;
+    if (any_listed || !any_generated) {
+        buffer.append(header);
+        buffer.append('\n');
+        for (const Run *run = set.runs_begin(); run != set.runs_end(); ++run) {
+            if (run->size() >= min_generate_run_size) {
+                continue;
             }
-            stream << '\n';
+            for (int id = run->begin; id != run->end; ++id) {
+                buffer.append_int(id);
+                buffer.append('\n');
+            }
+            buffer.maybe_write_to(stream);
         }
     }
+    if (any_generated) {
+        buffer.append(header);
+        buffer.append(", GENERATE\n");
+        for (const Run *run = set.runs_begin(); run != set.runs_end(); ++run) {
+            if (run->size() < min_generate_run_size) {
+                continue;
+            }
+            buffer.append_int(run->begin);
+            buffer.append(", ");
+            buffer.append_int(run->end - 1);
+            buffer.append(", 1\n");
+            buffer.maybe_write_to(stream);
+        }
+    }
+    buffer.write_to(stream);
 }
 
 void write_calculix_nset(
@@ -70,10 +215,7 @@ void write_calculix_nset(
     const std::string &name,
     const NodeSet &node_set
 ) {
-    stream << "*NSET, NSET=N" << name << '\n';
-    for (NodeId node_id : node_set.nodes) {
-        stream << node_id.to_int() << "\n";
-    }
+    write_calculix_set_ranges(stream, "*NSET, NSET=N" + name, node_set.nodes);
 }
 
 void write_calculix_elset(
@@ -81,10 +223,8 @@ void write_calculix_elset(
     const std::string &name,
     const ElementSet &element_set
 ) {
-    stream << "*ELSET, ELSET=E" << name << '\n';
-    for (ElementId element_id : element_set.elements) {
-        stream << element_id.to_int() << "\n";
-    }
+    write_calculix_set_ranges(
+        stream, "*ELSET, ELSET=E" + name, element_set.elements);
 }
 
 
@@ -94,28 +234,66 @@ void write_calculix_surface(
     const FaceSet &face_set
 ) {
     stream << "*SURFACE,NAME=S" << name << ",TYPE=ELEMENT\n";
+    InpBuffer buffer;
     for (FaceId face_id : face_set.faces) {
       /* Note we number faces starting from 0, but CalculiX numbers faces starting
       from 1, which is why we write "face_id.face + 1". */
-      stream << face_id.element_id.to_int() << ",S" << face_id.face + 1 << '\n';
+      buffer.append_int(face_id.element_id.to_int());
+      buffer.append(",S");
+      buffer.append_int(face_id.face + 1);
+      buffer.append('\n');
+      buffer.maybe_write_to(stream);
     }
+    buffer.write_to(stream);
 }
 
 void write_calculix_cload(
     std::ostream &stream,
     const ConcentratedLoad &cload
 ) {
+    InpBuffer buffer;
+    buffer.append("*CLOAD\n");
     for (const auto &pair : cload.loads) {
         const Vector &force = pair.second.force;
-        if (force.x != 0) {
-            stream << pair.first.to_int() << ",1," << force.x << std::endl;
-        }
-        if (force.y != 0) {
-            stream << pair.first.to_int() << ",2," << force.y << std::endl;
+        double components[3] = {force.x, force.y, force.z};
+        for (int i = 0; i < 3; ++i) {
+            if (components[i] != 0) {
+                buffer.append_int(pair.first.to_int());
+                buffer.append(',');
+                buffer.append_int(i + 1);
+                buffer.append(',');
+                buffer.append_double(components[i]);
+                buffer.append('\n');
+            }
         }
-        if (force.z != 0) {
-            stream << pair.first.to_int() << ",3," << force.z << std::endl;
+        buffer.maybe_write_to(stream);
+    }
+    buffer.write_to(stream);
+}
+
+void write_calculix_dload(
+    std::ostream &stream,
+    const std::string &set_name,
+    const DistributedLoad &dload
+) {
+    stream << "*DLOAD\n";
+    switch (dload.type) {
+    case DistributedLoad::Type::BodyForce: {
+        static const char *labels[3] = {"BX", "BY", "BZ"};
+        double components[3] =
+            {dload.body_force.x, dload.body_force.y, dload.body_force.z};
+        for (int i = 0; i < 3; ++i) {
+            if (components[i] != 0) {
+                stream << set_name << ',' << labels[i] << ','
+                    << components[i] << '\n';
+            }
         }
+        break;
+    }
+    case DistributedLoad::Type::Pressure:
+        stream << set_name << ",P," << dload.pressure << '\n';
+        break;
+    default: assert(false);
     }
 }
 
@@ -132,25 +310,25 @@ void write_calculix_material_and_solid_section(
         << "*DENSITY\n"
         << project.unit_system.unit_to_system(material.density) << '\n';
 
-    bool any_element = false;
+    RangeSet<ElementId> elements;
     for (const auto &pair : project.mesh_objects) {
+        std::vector<MaterialId> materials_by_attrs =
+            project.material_overrides.lookup_table(
+                project.mesh->attr_sets, pair.second.material);
+        RangeSet<ElementId> object_elements;
         for (ElementId eid = pair.second.element_begin;
                 eid != pair.second.element_end; ++eid) {
-            MaterialId element_material = project.material_overrides.lookup(
-                project.mesh->elements[eid].attrs,
-                pair.second.material);
-            if (element_material != material.id) {
-                continue;
-            }
-            if (!any_element) {
-                stream << "*ELSET, ELSET=M" << name << '\n';
-                any_element = true;
+            MaterialId element_material = materials_by_attrs[
+                project.mesh->elements[eid].attrs.to_int()];
+            if (element_material == material.id) {
+                object_elements.insert(eid);
             }
-            stream << eid.to_int() << "\n";
         }
+        elements |= object_elements;
     }
 
-    if (any_element) {
+    if (!elements.empty()) {
+        write_calculix_set_ranges(stream, "*ELSET, ELSET=M" + name, elements);
         stream << "*SOLID SECTION,"
             << "MATERIAL=" << name << ','
             << "ELSET=M" << name << '\n';
@@ -205,81 +383,297 @@ void write_calculix_equation(
     variables_used->insert(dependent_variable);
 }
 
-void write_calculix_job(
-    const FilePath &dir_path,
-    const std::string &main_file_name,
-    const Project &project
+/* Mixed into every inputs key. Bump this when the way the objects are
+formatted changes, so that files written by an older version get rewritten even
+though their inputs didn't change. */
+static const int inputs_key_version = 2;
+
+/* Calls 'func(i, hash)' for each 'i' in [begin, end) and adds the results to
+'hash'. The work is split into fixed-size blocks that run in parallel; the
+blocks don't depend on the number of threads, so neither does the result. */
+template<class Func>
+static void hash_in_parallel(
+    InputsHash *hash,
+    int begin,
+    int end,
+    const Func &func
 ) {
-    {
-        FilePath geometry_file_path = dir_path + "/objects.inp";
-        std::ofstream geometry_stream(geometry_file_path);
-
-        for (const auto &pair : project.create_node_objects) {
-            write_calculix_create_node(
-                geometry_stream, pair.first,
-                pair.second.node_id, pair.second.point);
-        }
+    static const int block_size = 1 << 16;
+    int num_blocks = std::max(0, end - begin + block_size - 1) / block_size;
+    std::vector<InputsHash> blocks(num_blocks);
+    parallel_for_chunks(0, num_blocks, 1,
+        [&](int chunk_begin, int chunk_end, int) {
+            for (int block = chunk_begin; block < chunk_end; ++block) {
+                int block_begin = begin + block * block_size;
+                int block_end = std::min(end, block_begin + block_size);
+                for (int i = block_begin; i < block_end; ++i) {
+                    func(i, &blocks[block]);
+                }
+            }
+        });
+    hash->add_int(end - begin);
+    for (const InputsHash &block : blocks) {
+        hash->add_hash(block);
+    }
+}
 
-        for (const auto &pair : project.mesh_objects) {
-            write_calculix_nodes_and_elements(
-                geometry_stream, pair.first, *project.mesh,
-                pair.second.node_begin, pair.second.node_end,
-                pair.second.element_begin, pair.second.element_end);
-        }
+static void hash_vector(InputsHash *hash, Vector vector) {
+    hash->add_double(vector.x);
+    hash->add_double(vector.y);
+    hash->add_double(vector.z);
+}
 
-        std::set<LinearEquation::Variable> variables_used;
-        for (const auto &pair : project.slice_objects) {
-            for (const LinearEquation &equation : *pair.second.equations) {
-                write_calculix_equation(
-                    geometry_stream, equation, &variables_used);
-            }
-        }
+static void hash_point(InputsHash *hash, Point point) {
+    hash->add_double(point.x);
+    hash->add_double(point.y);
+    hash->add_double(point.z);
+}
 
-        for (const auto &pair : project.select_volume_objects) {
-            write_calculix_nset(
-                geometry_stream, pair.first, *pair.second.node_set);
-            write_calculix_elset(
-                geometry_stream, pair.first, *pair.second.element_set);
-        }
+template<class Key>
+static void hash_range_set(InputsHash *hash, const RangeSet<Key> &set) {
+    hash->add_int(set.num_runs());
+    for (const auto *run = set.runs_begin(); run != set.runs_end(); ++run) {
+        hash->add_int(run->begin);
+        hash->add_int(run->end);
+    }
+}
 
-        for (const auto &pair : project.select_surface_objects) {
-            write_calculix_nset(
-                geometry_stream, pair.first, *pair.second.node_set);
-            write_calculix_surface(
-                geometry_stream, pair.first, *pair.second.face_set);
+static std::string mesh_inputs_key(const Project &project) {
+    InputsHash hash;
+    hash.add_int(inputs_key_version);
+    for (const auto &pair : project.create_node_objects) {
+        hash.add_string(pair.first);
+        hash.add_int(pair.second.node_id.to_int());
+        hash_point(&hash, pair.second.point);
+    }
+    for (const auto &pair : project.mesh_objects) {
+        const Project::MeshObject &object = pair.second;
+        hash.add_string(pair.first);
+        hash_in_parallel(&hash,
+            object.node_begin.to_int(), object.node_end.to_int(),
+            [&](int i, InputsHash *block_hash) {
+                hash_point(block_hash,
+                    project.mesh->nodes[NodeId::from_int(i)].point);
+            });
+        hash_in_parallel(&hash,
+            object.element_begin.to_int(), object.element_end.to_int(),
+            [&](int i, InputsHash *block_hash) {
+                const Element3 &element =
+                    project.mesh->elements[ElementId::from_int(i)];
+                block_hash->add_int(static_cast<int>(element.type));
+                for (int j = 0; j < element.num_nodes(); ++j) {
+                    block_hash->add_int(element.nodes[j].to_int());
+                }
+            });
+    }
+    return hash.key();
+}
+
+static std::string equations_inputs_key(const Project &project) {
+    InputsHash hash;
+    hash.add_int(inputs_key_version);
+    for (const auto &pair : project.slice_objects) {
+        hash.add_int(pair.second.equations->size());
+        for (const LinearEquation &equation : *pair.second.equations) {
+            hash.add_int(equation.terms.size());
+            for (const auto &term : equation.terms) {
+                hash.add_int(term.first.node_id.to_int());
+                hash.add_int(static_cast<int>(term.first.dimension));
+                hash.add_double(term.second);
+            }
         }
+    }
+    return hash.key();
+}
 
-        for (const auto &pair : project.select_node_objects) {
-            write_calculix_nset(
-                geometry_stream,
-                pair.first,
-                compute_node_set_singleton(pair.second.node_id)
-                );
+static std::string sets_inputs_key(const Project &project) {
+    InputsHash hash;
+    hash.add_int(inputs_key_version);
+    for (const auto &pair : project.select_volume_objects) {
+        hash.add_string(pair.first);
+        hash_range_set(&hash, pair.second.node_set->nodes);
+        hash_range_set(&hash, pair.second.element_set->elements);
+    }
+    for (const auto &pair : project.select_surface_objects) {
+        hash.add_string(pair.first);
+        hash_range_set(&hash, pair.second.node_set->nodes);
+        hash_range_set(&hash, pair.second.face_set->faces);
+    }
+    for (const auto &pair : project.select_node_objects) {
+        hash.add_string(pair.first);
+        hash.add_int(pair.second.node_id.to_int());
+    }
+    return hash.key();
+}
+
+static std::string materials_inputs_key(const Project &project) {
+    InputsHash hash;
+    hash.add_int(inputs_key_version);
+    for (const auto &pair : project.material_objects) {
+        const Project::MaterialObject &material = pair.second;
+        hash.add_string(pair.first);
+        hash.add_int(material.id);
+        hash.add_double(
+            project.unit_system.unit_to_system(material.youngs_modulus));
+        hash.add_double(material.poissons_ratio);
+        hash.add_double(project.unit_system.unit_to_system(material.density));
+    }
+    /* Which elements get which material depends on the overrides and on each
+    element's attributes */
+    for (const auto &pair : project.mesh_objects) {
+        for (MaterialId material : project.material_overrides.lookup_table(
+                project.mesh->attr_sets, pair.second.material)) {
+            hash.add_int(material);
         }
+        hash_in_parallel(&hash,
+            pair.second.element_begin.to_int(),
+            pair.second.element_end.to_int(),
+            [&](int i, InputsHash *block_hash) {
+                block_hash->add_int(project.mesh->elements[
+                    ElementId::from_int(i)].attrs.to_int());
+            });
+    }
+    return hash.key();
+}
 
-        for (const auto &pair : project.material_objects) {
-            write_calculix_material_and_solid_section(
-                geometry_stream, pair.first, pair.second, project);
+static std::string load_inputs_key(
+    const std::string &set_name,
+    const DistributedLoad *dload,
+    const ConcentratedLoad *cload
+) {
+    InputsHash hash;
+    hash.add_int(inputs_key_version);
+    if (dload) {
+        hash.add_string(set_name);
+        hash.add_int(static_cast<int>(dload->type));
+        hash_vector(&hash, dload->body_force);
+        hash.add_double(dload->pressure);
+    } else {
+        hash.add_int(cload->loads.size());
+        for (const auto &pair : cload->loads) {
+            hash.add_int(pair.first.to_int());
+            hash_vector(&hash, pair.second.force);
         }
     }
+    return hash.key();
+}
+
+void write_calculix_job(
+    const FilePath &dir_path,
+    const std::string &main_file_name,
+    const Project &project
+) {
+    /* The deck includes objects.inp, which in turn includes one file for each
+    kind of object. Each file is keyed on a hash of the objects it's formatted
+    from, and is only formatted and written again if they changed since the
+    last run; so e.g. editing a load doesn't touch the (much bigger) mesh file.
+    When a file is written, it's streamed to disk as it's formatted. */
+    write_file_if_inputs_changed(dir_path + "/objects_mesh.inp",
+        mesh_inputs_key(project),
+        [&](std::ostream &stream) {
+            for (const auto &pair : project.create_node_objects) {
+                write_calculix_create_node(stream, pair.first,
+                    pair.second.node_id, pair.second.point);
+            }
+            for (const auto &pair : project.mesh_objects) {
+                write_calculix_nodes_and_elements(
+                    stream, pair.first, *project.mesh,
+                    pair.second.node_begin, pair.second.node_end,
+                    pair.second.element_begin, pair.second.element_end);
+            }
+        });
+
+    write_file_if_inputs_changed(dir_path + "/objects_equations.inp",
+        equations_inputs_key(project),
+        [&](std::ostream &stream) {
+            std::set<LinearEquation::Variable> variables_used;
+            for (const auto &pair : project.slice_objects) {
+                for (const LinearEquation &equation
+                        : *pair.second.equations) {
+                    write_calculix_equation(
+                        stream, equation, &variables_used);
+                }
+            }
+        });
+
+    write_file_if_inputs_changed(dir_path + "/objects_sets.inp",
+        sets_inputs_key(project),
+        [&](std::ostream &stream) {
+            for (const auto &pair : project.select_volume_objects) {
+                write_calculix_nset(
+                    stream, pair.first, *pair.second.node_set);
+                write_calculix_elset(
+                    stream, pair.first, *pair.second.element_set);
+            }
+            for (const auto &pair : project.select_surface_objects) {
+                write_calculix_nset(
+                    stream, pair.first, *pair.second.node_set);
+                write_calculix_surface(
+                    stream, pair.first, *pair.second.face_set);
+            }
+            for (const auto &pair : project.select_node_objects) {
+                write_calculix_nset(
+                    stream,
+                    pair.first,
+                    compute_node_set_singleton(pair.second.node_id));
+            }
+        });
+
+    write_file_if_inputs_changed(dir_path + "/objects_materials.inp",
+        materials_inputs_key(project),
+        [&](std::ostream &stream) {
+            for (const auto &pair : project.material_objects) {
+                write_calculix_material_and_solid_section(
+                    stream, pair.first, pair.second, project);
+            }
+        });
+
+    write_file_if_changed(dir_path + "/objects.inp",
+        "*INCLUDE, INPUT=objects_mesh.inp\n"
+        "*INCLUDE, INPUT=objects_equations.inp\n"
+        "*INCLUDE, INPUT=objects_sets.inp\n"
+        "*INCLUDE, INPUT=objects_materials.inp\n");
 
+    /* Each load's file starts with its own *CLOAD or *DLOAD keyword, so the
+    deck just includes it inside the step */
     for (const auto &pair : project.load_volume_objects) {
-        FilePath load_file_path = dir_path + "/" + pair.first + ".clo";
-        std::ofstream load_stream(load_file_path);
-        write_calculix_cload(load_stream, *pair.second.load);
+        const Project::LoadVolumeObject &object = pair.second;
+        std::string set_name = "E" + object.volume;
+        write_file_if_inputs_changed(dir_path + "/" + pair.first + ".clo",
+            load_inputs_key(set_name, object.distributed_load.get(),
+                object.load.get()),
+            [&](std::ostream &stream) {
+                if (object.distributed_load) {
+                    write_calculix_dload(
+                        stream, set_name, *object.distributed_load);
+                } else {
+                    write_calculix_cload(stream, *object.load);
+                }
+            });
     }
 
     for (const auto &pair : project.load_surface_objects) {
-        FilePath load_file_path = dir_path + "/" + pair.first + ".clo";
-        std::ofstream load_stream(load_file_path);
-        write_calculix_cload(load_stream, *pair.second.load);
+        const Project::LoadSurfaceObject &object = pair.second;
+        std::string set_name = "S" + object.surface;
+        write_file_if_inputs_changed(dir_path + "/" + pair.first + ".clo",
+            load_inputs_key(set_name, object.distributed_load.get(),
+                object.load.get()),
+            [&](std::ostream &stream) {
+                if (object.distributed_load) {
+                    write_calculix_dload(
+                        stream, set_name, *object.distributed_load);
+                } else {
+                    write_calculix_cload(stream, *object.load);
+                }
+            });
     }
 
-    FilePath main_file_path = dir_path + "/" + main_file_name + ".inp";
-    std::ofstream main_stream(main_file_path);
+    std::string main_contents;
     for (const std::string &line : project.calculix_deck) {
-        main_stream << line << '\n';
+        main_contents += line + '\n';
     }
+    write_file_if_changed(
+        dir_path + "/" + main_file_name + ".inp", main_contents);
 }
 
 } /* namespace os2cx */
@@ -38,10 +38,18 @@ void write_calculix_surface(
     const std::string &name,
     const FaceSet &face_set);
 
+/* Starts with its own *CLOAD keyword, like write_calculix_dload() does with
+*DLOAD, so that the deck can include either kind of load file the same way */
 void write_calculix_cload(
     std::ostream &stream,
     const ConcentratedLoad &cload);
 
+/* 'set_name' is the *ELSET for a body force, or the *SURFACE for a pressure */
+void write_calculix_dload(
+    std::ostream &stream,
+    const std::string &set_name,
+    const DistributedLoad &dload);
+
 void write_calculix_material(
     std::ostream &stream,
     const std::string &name,
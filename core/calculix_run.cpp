@@ -8,11 +8,16 @@ namespace os2cx {
 
 void run_calculix(
     const std::string &temp_dir,
-    const std::string &filename
+    const std::string &filename,
+    bool binary_output
 ) {
     QStringList args;
     args.push_back("-i");
     args.push_back(filename.c_str());
+    if (binary_output) {
+        args.push_back("-o");
+        args.push_back("bin");
+    }
     QProcess process;
     process.setWorkingDirectory(temp_dir.c_str());
     process.setProcessChannelMode(QProcess::ForwardedChannels);
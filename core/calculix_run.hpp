@@ -13,9 +13,12 @@ public:
         std::runtime_error(msg) { }
 };
 
+/* If 'binary_output' is true, CalculiX is asked to write the .frd file in its
+binary format, which is much smaller and faster to read than the text one. */
 void run_calculix(
     const std::string &temp_dir,
-    const std::string &filename);
+    const std::string &filename,
+    bool binary_output);
 
 } /* namespace os2cx */
 
@@ -23,7 +23,7 @@ void compute_plc_nef_select_volume(
     assert(attr_bit_mask != attr_bit_solid());
     solid_nef->map_everywhere([&](AttrBitset bs, PlcNef3::FeatureType ft) {
         if (ft == PlcNef3::FeatureType::Volume && bs[attr_bit_solid()]) {
-            bs[attr_bit_mask] = true;
+            bs.set(attr_bit_mask);
         }
         return bs;
     });
@@ -196,9 +196,7 @@ MaxElementSize suggest_max_element_size(const Plc3 &plc) {
 
 ElementSet compute_element_set_from_range(ElementId begin, ElementId end) {
     ElementSet set;
-    for (ElementId id = begin; id != end; ++id) {
-        set.elements.insert(id);
-    }
+    set.elements.insert_range(begin, end);
     return set;
 }
 
@@ -212,7 +210,7 @@ ElementSet compute_element_set_from_attr_bit(
     ElementSet set;
     for (ElementId eid = element_begin; eid != element_end; ++eid) {
         const Element3 &element = mesh.elements[eid];
-        if (element.attrs[attr_bit]) {
+        if (mesh.attr_sets[element.attrs][attr_bit]) {
             set.elements.insert(eid);
         }
     }
@@ -238,7 +236,8 @@ FaceSet compute_face_set_from_attr_bit(
         const ElementTypeShape *shape = &element_type_shape(element.type);
         for (fid.face = 0; fid.face < static_cast<int>(shape->faces.size());
                 ++fid.face) {
-            AttrBitset attrs = element.face_attrs[fid.face];
+            const AttrBitset &attrs =
+                mesh.attr_sets[element.face_attrs[fid.face]];
             if (attrs[attr_bit]) {
                 /* This direction_vector check is _almost_ redundant, because
                 compute_plc_nef3_select_surface_*() wouldn't have set the attr
@@ -267,9 +266,7 @@ NodeSet compute_node_set_singleton(NodeId node) {
 
 NodeSet compute_node_set_from_range(NodeId begin, NodeId end) {
     NodeSet set;
-    for (NodeId id = begin; id != end; ++id) {
-        set.nodes.insert(id);
-    }
+    set.nodes.insert_range(begin, end);
     return set;
 }
 
@@ -277,14 +274,16 @@ NodeSet compute_node_set_from_element_set(
     const Mesh3 &mesh,
     const ElementSet &element_set
 ) {
-    NodeSet set;
+    std::vector<NodeId> node_ids;
     for (ElementId element_id : element_set.elements) {
         const Element3 &element = mesh.elements[element_id];
         int num_nodes = element.num_nodes();
         for (int i = 0; i < num_nodes; ++i) {
-            set.nodes.insert(element.nodes[i]);
+            node_ids.push_back(element.nodes[i]);
         }
     }
+    NodeSet set;
+    set.nodes = RangeSet<NodeId>::from_keys(std::move(node_ids));
     return set;
 }
 
@@ -292,15 +291,17 @@ NodeSet compute_node_set_from_face_set(
     const Mesh3 &mesh,
     const FaceSet &face_set
 ) {
-    NodeSet set;
+    std::vector<NodeId> node_ids;
     for (FaceId face_id : face_set.faces) {
         const Element3 &element = mesh.elements[face_id.element_id];
         const ElementTypeShape *shape = &element_type_shape(element.type);
 
         for (int vertex_index : shape->faces[face_id.face].vertices) {
-            set.nodes.insert(element.nodes[vertex_index]);
+            node_ids.push_back(element.nodes[vertex_index]);
         }
     }
+    NodeSet set;
+    set.nodes = RangeSet<NodeId>::from_keys(std::move(node_ids));
     return set;
 }
 
@@ -314,7 +315,7 @@ NodeId compute_node_id_from_attr_bit(
     assert(attr_bit != attr_bit_solid());
     for (NodeId nid = node_begin; nid != node_end; ++nid) {
         const Node3 &node = mesh.nodes[nid];
-        if (node.attrs[attr_bit]) {
+        if (mesh.attr_sets[node.attrs][attr_bit]) {
             assert(node_id == NodeId::invalid());
             node_id = nid;
         }
@@ -322,64 +323,366 @@ NodeId compute_node_id_from_attr_bit(
     return node_id;
 }
 
+SelectionResult compute_selections_from_attr_bits(
+    const Mesh3 &mesh,
+    const SelectionQuery &query
+) {
+    /* A mesh has only a handful of distinct attribute sets, so work out up
+    front which selections each one belongs to. Then the per-element and
+    per-node work is a table lookup instead of a bit test per selection. */
+    int num_attr_sets = mesh.attr_sets.size();
+    std::vector<std::vector<int> > volume_hits(num_attr_sets);
+    std::vector<std::vector<int> > surface_hits(num_attr_sets);
+    std::vector<std::vector<int> > node_hits(num_attr_sets);
+    for (int i = 0; i < num_attr_sets; ++i) {
+        const AttrBitset &attrs = mesh.attr_sets[AttrSetId::from_int(i)];
+        for (int j = 0; j < static_cast<int>(query.volumes.size()); ++j) {
+            assert(query.volumes[j] != attr_bit_solid());
+            if (attrs[query.volumes[j]]) volume_hits[i].push_back(j);
+        }
+        for (int j = 0; j < static_cast<int>(query.surfaces.size()); ++j) {
+            assert(query.surfaces[j].attr_bit != attr_bit_solid());
+            if (attrs[query.surfaces[j].attr_bit]) surface_hits[i].push_back(j);
+        }
+        for (int j = 0; j < static_cast<int>(query.nodes.size()); ++j) {
+            assert(query.nodes[j] != attr_bit_solid());
+            if (attrs[query.nodes[j]]) node_hits[i].push_back(j);
+        }
+    }
+
+    std::vector<double> cos_thresholds;
+    for (const SelectionQuery::Surface &surface : query.surfaces) {
+        cos_thresholds.push_back(
+            cos(surface.direction_angle_tolerance / 180 * M_PI)
+                - direction_angle_epsilon);
+    }
+
+    SelectionResult empty_result;
+    empty_result.volumes.resize(query.volumes.size());
+    empty_result.surfaces.resize(query.surfaces.size());
+    empty_result.nodes.resize(query.nodes.size());
+
+    /* Each chunk collects its own sets; since chunks are in increasing ID
+    order, concatenating them afterwards is cheap. */
+    static const int min_chunk_size = 4096;
+    int element_begin = mesh.elements.key_begin().to_int();
+    int element_end = mesh.elements.key_end().to_int();
+    std::vector<SelectionResult> element_chunks(
+        parallel_num_chunks(element_begin, element_end, min_chunk_size),
+        empty_result);
+    parallel_for_chunks(element_begin, element_end, min_chunk_size,
+        [&](int chunk_begin, int chunk_end, int chunk_index) {
+            SelectionResult *chunk = &element_chunks[chunk_index];
+            for (int i = chunk_begin; i < chunk_end; ++i) {
+                ElementId element_id = ElementId::from_int(i);
+                const Element3 &element = mesh.elements[element_id];
+                for (int j : volume_hits[element.attrs.to_int()]) {
+                    chunk->volumes[j].elements.insert(element_id);
+                }
+                int num_faces = element_type_shape(element.type).faces.size();
+                for (int face = 0; face < num_faces; ++face) {
+                    const std::vector<int> &hits =
+                        surface_hits[element.face_attrs[face].to_int()];
+                    if (hits.empty()) {
+                        continue;
+                    }
+                    /* See compute_face_set_from_attr_bit() for why we check
+                    the face normal against the direction vector here */
+                    Vector face_normal = mesh.oriented_area(element, face);
+                    face_normal /= face_normal.magnitude();
+                    for (int j : hits) {
+                        double dot =
+                            query.surfaces[j].direction_vector.dot(face_normal);
+                        if (dot > cos_thresholds[j]) {
+                            chunk->surfaces[j].faces.insert(
+                                FaceId(element_id, face));
+                        }
+                    }
+                }
+            }
+        });
+
+    int node_begin = mesh.nodes.key_begin().to_int();
+    int node_end = mesh.nodes.key_end().to_int();
+    std::vector<SelectionResult> node_chunks(
+        parallel_num_chunks(node_begin, node_end, min_chunk_size),
+        empty_result);
+    parallel_for_chunks(node_begin, node_end, min_chunk_size,
+        [&](int chunk_begin, int chunk_end, int chunk_index) {
+            SelectionResult *chunk = &node_chunks[chunk_index];
+            for (int i = chunk_begin; i < chunk_end; ++i) {
+                NodeId node_id = NodeId::from_int(i);
+                const Node3 &node = mesh.nodes[node_id];
+                for (int j : node_hits[node.attrs.to_int()]) {
+                    chunk->nodes[j].nodes.insert(node_id);
+                }
+            }
+        });
+
+    SelectionResult result = std::move(empty_result);
+    for (const SelectionResult &chunk : element_chunks) {
+        for (int j = 0; j < static_cast<int>(result.volumes.size()); ++j) {
+            result.volumes[j].elements |= chunk.volumes[j].elements;
+        }
+        for (int j = 0; j < static_cast<int>(result.surfaces.size()); ++j) {
+            result.surfaces[j].faces |= chunk.surfaces[j].faces;
+        }
+    }
+    for (const SelectionResult &chunk : node_chunks) {
+        for (int j = 0; j < static_cast<int>(result.nodes.size()); ++j) {
+            result.nodes[j].nodes |= chunk.nodes[j].nodes;
+        }
+    }
+    return result;
+}
+
+/* Collects the per-node contributions to a load from one chunk of keys in
+compute_load_dense(), sorted into buckets by range of nodes. */
+class LoadContributions {
+public:
+    LoadContributions(int node_begin, int nodes_per_bucket, int num_buckets) :
+        node_begin(node_begin),
+        nodes_per_bucket(nodes_per_bucket),
+        buckets(num_buckets) { }
+
+    void add(NodeId node_id, Vector force) {
+        int index = node_id.to_int() - node_begin;
+        buckets[index / nodes_per_bucket].push_back(
+            std::make_pair(index, force));
+    }
+
+    int node_begin, nodes_per_bucket;
+    /* Pairs of (NodeId::to_int() minus 'node_begin', force) */
+    std::vector<std::vector<std::pair<int, Vector> > > buckets;
+};
+
+/* Computes a ConcentratedLoad by calling 'func(key, contributions)' for every
+key in 'key_set'. 'func' calls 'contributions->add()' with its contribution for
+each node, and returns the volume or area of the element or face. If
+'normalize' is true, the forces are divided by the total volume or area at the
+end.
+
+The keys are processed in batches. Each chunk of a batch collects its
+contributions separately, sorted by range of nodes; then each range of nodes is
+summed into a single dense per-node array on its own thread. So there's no
+locking and no per-contribution tree lookup, and the memory used is the one
+per-node array plus the contributions from one batch. */
+template<class Key, class Func>
+static ConcentratedLoad compute_load_dense(
+    const Mesh3 &mesh,
+    const RangeSet<Key> &key_set,
+    bool normalize,
+    const Func &func
+) {
+    std::vector<Key> keys;
+    keys.reserve(key_set.size());
+    for (Key key : key_set) {
+        keys.push_back(key);
+    }
+
+    static const int min_keys_per_chunk = 1024;
+    static const int keys_per_batch = 1 << 16;
+    static const int min_nodes_per_chunk = 16384;
+    int node_begin = mesh.nodes.key_begin().to_int();
+    int num_nodes = mesh.nodes.key_end().to_int() - node_begin;
+    int num_buckets = parallel_num_chunks(0, num_nodes, min_nodes_per_chunk);
+    int nodes_per_bucket = std::max(1,
+        (num_nodes + num_buckets - 1) / num_buckets);
+
+    std::vector<Vector> forces(num_nodes, Vector::zero());
+    double total = 0;
+    for (int batch_begin = 0; batch_begin < static_cast<int>(keys.size());
+            batch_begin += keys_per_batch) {
+        int batch_end = std::min(
+            batch_begin + keys_per_batch, static_cast<int>(keys.size()));
+        int num_chunks =
+            parallel_num_chunks(batch_begin, batch_end, min_keys_per_chunk);
+        std::vector<LoadContributions> chunk_contributions(num_chunks,
+            LoadContributions(node_begin, nodes_per_bucket, num_buckets));
+        std::vector<double> chunk_totals(num_chunks, 0);
+        parallel_for_chunks(batch_begin, batch_end, min_keys_per_chunk,
+            [&](int chunk_begin, int chunk_end, int chunk_index) {
+                double chunk_total = 0;
+                for (int i = chunk_begin; i < chunk_end; ++i) {
+                    chunk_total += func(
+                        keys[i], &chunk_contributions[chunk_index]);
+                }
+                chunk_totals[chunk_index] = chunk_total;
+            });
+        for (double chunk_total : chunk_totals) {
+            total += chunk_total;
+        }
+
+        parallel_for_chunks(0, num_buckets, 1,
+            [&](int bucket_begin, int bucket_end, int) {
+                for (int bucket = bucket_begin; bucket < bucket_end;
+                        ++bucket) {
+                    for (const LoadContributions &contributions
+                            : chunk_contributions) {
+                        for (const std::pair<int, Vector> &pair
+                                : contributions.buckets[bucket]) {
+                            forces[pair.first] += pair.second;
+                        }
+                    }
+                }
+            });
+    }
+    double scale = (normalize && total != 0) ? 1 / total : 1;
+
+    std::vector<ConcentratedLoad> node_chunks(
+        parallel_num_chunks(0, num_nodes, min_nodes_per_chunk));
+    parallel_for_chunks(0, num_nodes, min_nodes_per_chunk,
+        [&](int chunk_begin, int chunk_end, int chunk_index) {
+            ConcentratedLoad *out = &node_chunks[chunk_index];
+            for (int i = chunk_begin; i < chunk_end; ++i) {
+                if (forces[i] != Vector::zero()) {
+                    ConcentratedLoad::Load load;
+                    load.force = forces[i] * scale;
+                    out->loads.push_back(std::make_pair(
+                        NodeId::from_int(node_begin + i), load));
+                }
+            }
+        });
+
+    ConcentratedLoad load;
+    for (const ConcentratedLoad &node_chunk : node_chunks) {
+        load.loads.insert(load.loads.end(),
+            node_chunk.loads.begin(), node_chunk.loads.end());
+    }
+    return load;
+}
+
 ConcentratedLoad compute_load_from_element_set(const Mesh3 &mesh,
     const ElementSet &element_set,
     Vector force_total_or_per_volume,
     bool force_is_per_volume
 ) {
-    ConcentratedLoad load;
+    return compute_load_dense(mesh, element_set.elements, !force_is_per_volume,
+        [&](ElementId element_id, LoadContributions *contributions) {
+            const Element3 &element = mesh.elements[element_id];
+            int num_nodes = element.num_nodes();
+            Volume volumes_for_nodes[
+                ElementTypeShape::max_vertices_per_element];
+            mesh.volumes_for_nodes(element, volumes_for_nodes);
+            double volume = 0;
+            for (int i = 0; i < num_nodes; ++i) {
+                volume += volumes_for_nodes[i];
+                contributions->add(element.nodes[i],
+                    volumes_for_nodes[i] * force_total_or_per_volume);
+            }
+            return volume;
+        });
+}
+
+ConcentratedLoad compute_load_from_face_set(
+    const Mesh3 &mesh,
+    const FaceSet &face_set,
+    Vector force_total_or_per_area,
+    bool force_is_per_area
+) {
+    return compute_load_dense(mesh, face_set.faces, !force_is_per_area,
+        [&](FaceId face_id, LoadContributions *contributions) {
+            const Element3 &element = mesh.elements[face_id.element_id];
+            int num_nodes = element.num_nodes();
+            /* Note: For second-order rectangular faces, some oriented areas
+            may point in the opposite direction of the overall face! */
+            Vector areas_for_nodes[ElementTypeShape::max_vertices_per_element];
+            mesh.oriented_areas_for_nodes(
+                element, face_id.face, areas_for_nodes);
+            Vector face_oriented_area = Vector::zero();
+            for (int i = 0; i < num_nodes; ++i) {
+                face_oriented_area += areas_for_nodes[i];
+            }
+            double face_area = face_oriented_area.magnitude();
+            if (face_area == 0) {
+                /* A degenerate face takes no share of the load */
+                return 0.0;
+            }
+            for (int i = 0; i < num_nodes; ++i) {
+                contributions->add(element.nodes[i],
+                    areas_for_nodes[i].dot(face_oriented_area) / face_area
+                        * force_total_or_per_area);
+            }
+            return face_area;
+        });
+}
+
+DistributedLoad compute_distributed_load_from_element_set(
+    const Mesh3 &mesh,
+    const ElementSet &element_set,
+    Vector force_total_or_per_volume,
+    bool force_is_per_volume
+) {
+    DistributedLoad load;
+    if (force_is_per_volume) {
+        load.type = DistributedLoad::Type::BodyForce;
+        load.body_force = force_total_or_per_volume;
+        return load;
+    }
     double total_volume = 0;
     for (ElementId element_id : element_set.elements) {
-        const Element3 &element = mesh.elements[element_id];
-        int num_nodes = element.num_nodes();
-        Volume volumes_for_nodes[ElementTypeShape::max_vertices_per_element];
-        mesh.volumes_for_nodes(element, volumes_for_nodes);
-        for (int i = 0; i < num_nodes; ++i) {
-            total_volume += volumes_for_nodes[i];
-            load.loads[element.nodes[i]].force +=
-                volumes_for_nodes[i] * force_total_or_per_volume;
-        }
+        total_volume += mesh.volume(mesh.elements[element_id]);
     }
-    if (!force_is_per_volume && total_volume != 0) {
-        for (auto &pair : load.loads) {
-            pair.second.force /= total_volume;
-        }
+    if (total_volume != 0) {
+        load.type = DistributedLoad::Type::BodyForce;
+        load.body_force = force_total_or_per_volume / total_volume;
     }
     return load;
 }
 
-ConcentratedLoad compute_load_from_face_set(
+DistributedLoad compute_distributed_load_from_face_set(
     const Mesh3 &mesh,
     const FaceSet &face_set,
     Vector force_total_or_per_area,
     bool force_is_per_area
 ) {
-    ConcentratedLoad load;
+    static const double tolerance = 1e-6;
+    DistributedLoad load;
+
+    std::vector<Vector> face_areas;
+    face_areas.reserve(face_set.faces.size());
     double total_area = 0;
     for (FaceId face_id : face_set.faces) {
-        const Element3 &element = mesh.elements[face_id.element_id];
-        int num_nodes = element.num_nodes();
-        /* Note: For second-order rectangular faces, some oriented areas may
-        point in the opposite direction of the overall face! */
-        Vector areas_for_nodes[ElementTypeShape::max_vertices_per_element];
-        mesh.oriented_areas_for_nodes(element, face_id.face, areas_for_nodes);
-        Vector face_oriented_area = Vector::zero();
-        for (int i = 0; i < num_nodes; ++i) {
-            face_oriented_area += areas_for_nodes[i];
+        Vector oriented_area =
+            mesh.oriented_area(mesh.elements[face_id.element_id], face_id.face);
+        face_areas.push_back(oriented_area);
+        total_area += oriented_area.magnitude();
+    }
+    if (total_area == 0) {
+        return load;
+    }
+
+    Vector force_per_area = force_is_per_area
+        ? force_total_or_per_area
+        : force_total_or_per_area / total_area;
+    double magnitude = force_per_area.magnitude();
+
+    /* Every face's outward normal must be (anti)parallel to the force, with
+    the same sign throughout, or else a pressure can't represent it */
+    double pressure = 0;
+    bool first = true;
+    for (const Vector &oriented_area : face_areas) {
+        if (oriented_area == Vector::zero()) {
+            /* A degenerate face has no normal, but it also takes no share of
+            the load, so it doesn't matter */
+            continue;
         }
-        double face_area = face_oriented_area.magnitude();
-        total_area += face_area;
-        for (int i = 0; i < num_nodes; ++i) {
-            load.loads[element.nodes[i]].force +=
-                areas_for_nodes[i].dot(face_oriented_area) / face_area
-                    * force_total_or_per_area;
+        Vector normal = oriented_area / oriented_area.magnitude();
+        double face_pressure = -force_per_area.dot(normal);
+        Vector tangential = force_per_area + face_pressure * normal;
+        if (tangential.magnitude() > tolerance * magnitude) {
+            return load;
         }
-    }
-    if (!force_is_per_area && total_area != 0) {
-        for (auto &pair : load.loads) {
-            pair.second.force /= total_area;
+        if (first) {
+            pressure = face_pressure;
+            first = false;
+        } else if (fabs(face_pressure - pressure) > tolerance * magnitude) {
+            return load;
         }
     }
+
+    load.type = DistributedLoad::Type::Pressure;
+    load.pressure = pressure;
     return load;
 }
 
@@ -409,17 +712,19 @@ Slice compute_slice(
     Mesh3Index mesh_index(*mesh);
 
     /* Identify all nodes that might be participating in the slice */
-    std::set<NodeId> nodes;
+    std::vector<NodeId> nodes;
     for (const FaceId &face : face_set.faces) {
         const Element3 &element = mesh->elements[face.element_id];
         for (int vertex :
                 element_type_shape(element.type).faces[face.face].vertices) {
-            nodes.insert(element.nodes[vertex]);
+            nodes.push_back(element.nodes[vertex]);
         }
     }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
 
-    /* For each eligible node, build a data structure tracking all the elements
-    it participates in and which faces they share with each other. */
+    /* For each eligible node, we'll build a data structure tracking all the
+    elements it participates in and which faces they share with each other. */
     struct NodeElementData {
         NodeElementData() {
             for (int face = 0; face < ElementTypeShape::max_faces_per_element;
@@ -429,6 +734,8 @@ Slice compute_slice(
             partitioned_node_id = NodeId::invalid();
         }
 
+        ElementId element_id;
+
         /* Where the node appears in the element */
         int vertex;
 
@@ -445,46 +752,66 @@ Slice compute_slice(
         to a partition, we'll fill this in with the partitioned node ID. */
         PartitionedNodeId partitioned_node_id;
     };
-    std::map<NodeId, std::map<ElementId, NodeElementData> > node_element_data;
-    for (ElementId element_id = mesh->elements.key_begin();
-            element_id != mesh->elements.key_end(); ++element_id) {
-        const Element3 &element = mesh->elements[element_id];
-        const ElementTypeShape &shape = element_type_shape(element.type);
-        for (int face = 0; face < static_cast<int>(shape.faces.size());
-                ++face) {
-            FaceId face_id_1(element_id, face);
-            FaceId face_id_2 = mesh_index.matching_face(face_id_1);
-            if (face_id_2 == FaceId::invalid()) {
-                continue;
+
+    Slice slice;
+
+    /* Visit each node and consider partitioning it */
+    std::vector<NodeElementData> element_data;
+    for (NodeId node_id : nodes) {
+        /* Fill in element_data from the elements around this node. Only
+        elements that share at least one face around this node with another
+        element take part; element_data stays sorted by element ID. */
+        element_data.clear();
+        for (ElementId element_id : mesh_index.elements_for_node(node_id)) {
+            const Element3 &element = mesh->elements[element_id];
+            const ElementTypeShape &shape = element_type_shape(element.type);
+            NodeElementData data;
+            data.element_id = element_id;
+            data.vertex = -1;
+            for (int vertex = 0; vertex < element.num_nodes(); ++vertex) {
+                if (element.nodes[vertex] == node_id) {
+                    data.vertex = vertex;
+                }
             }
-            for (int vertex : shape.faces[face].vertices) {
-                NodeId node = element.nodes[vertex];
-                if (!nodes.count(node)) {
+            assert(data.vertex != -1);
+            bool any_adjacent = false;
+            for (int face = 0; face < static_cast<int>(shape.faces.size());
+                    ++face) {
+                const std::vector<int> &face_vertices =
+                    shape.faces[face].vertices;
+                if (std::find(face_vertices.begin(), face_vertices.end(),
+                        data.vertex) == face_vertices.end()) {
+                    continue;
+                }
+                FaceId face_id_1(element_id, face);
+                FaceId face_id_2 = mesh_index.matching_face(face_id_1);
+                if (face_id_2 == FaceId::invalid()) {
                     continue;
                 }
-                NodeElementData *data = &node_element_data[node][element_id];
-                data->vertex = vertex;
-                data->adjacent[face] = face_id_2.element_id;
-                data->adjacent_sliced[face] =
+                data.adjacent[face] = face_id_2.element_id;
+                data.adjacent_sliced[face] =
                     face_set.faces.count(face_id_1) ||
                     face_set.faces.count(face_id_2);
+                any_adjacent = true;
+            }
+            if (any_adjacent) {
+                element_data.push_back(data);
             }
         }
-    }
-
-    Slice slice;
-
-    /* Visit each node and consider partitioning it */
-    for (auto &pair : node_element_data) {
-        NodeId node_id = pair.first;
-        std::map<ElementId, NodeElementData> &element_data = pair.second;
+        auto find_data = [&](ElementId element_id) -> NodeElementData & {
+            auto it = std::lower_bound(
+                element_data.begin(), element_data.end(), element_id,
+                [](const NodeElementData &d, ElementId e) {
+                    return d.element_id < e;
+                });
+            assert(it != element_data.end() && it->element_id == element_id);
+            return *it;
+        };
 
         /* Generate the partitions, assigning each element to one of the
         partitions. Also create the partitioned nodes. */
         std::vector<PartitionedNodeId> partitioned_node_ids;
-        for (auto &data_pair : element_data) {
-            ElementId element_id = data_pair.first;
-            NodeElementData &data = data_pair.second;
+        for (NodeElementData &data : element_data) {
             if (data.partitioned_node_id != PartitionedNodeId::invalid()) {
                 /* We've already visited this element */
                 continue;
@@ -505,11 +832,11 @@ Slice compute_slice(
             /* Iteratively find all elements that are reachable from this
             element, and bring them into the partition */
             std::deque<ElementId> queue;
-            queue.push_back(element_id);
+            queue.push_back(data.element_id);
             while (!queue.empty()) {
                 ElementId next_element_id = queue.front();
                 queue.pop_front();
-                NodeElementData &next_data = element_data[next_element_id];
+                NodeElementData &next_data = find_data(next_element_id);
                 if (next_data.partitioned_node_id !=
                         PartitionedNodeId::invalid()) {
                     /* We've already visited this element */
@@ -532,11 +859,10 @@ Slice compute_slice(
 
         /* Update the actual element records to point at the partitioned nodes
         */
-        for (const auto &data_pair : element_data) {
-            Element3 &element = mesh->elements[data_pair.first];
-            assert(element.nodes[data_pair.second.vertex] == node_id);
-            element.nodes[data_pair.second.vertex] =
-                data_pair.second.partitioned_node_id;
+        for (const NodeElementData &data : element_data) {
+            Element3 &element = mesh->elements[data.element_id];
+            assert(element.nodes[data.vertex] == node_id);
+            element.nodes[data.vertex] = data.partitioned_node_id;
         }
 
         /* For each sliced face, figure out which pair of partitions it slices
@@ -546,24 +872,24 @@ Slice compute_slice(
             std::pair<PartitionedNodeId, PartitionedNodeId>,
             std::vector<Vector>
             > partition_pair_areas;
-        for (const auto &data_pair : element_data) {
-            PartitionedNodeId partition1 = data_pair.second.partitioned_node_id;
+        for (const NodeElementData &data : element_data) {
+            PartitionedNodeId partition1 = data.partitioned_node_id;
             for (int face = 0; face < ElementTypeShape::max_faces_per_element;
                     ++face) {
-                ElementId element2 = data_pair.second.adjacent[face];
+                ElementId element2 = data.adjacent[face];
                 if (element2 == ElementId::invalid()) {
                     /* The node we're partitioning isn't part of this face, or
                     this face index is past the max face index of the element */
                     continue;
                 }
                 PartitionedNodeId partition2 =
-                    element_data.at(element2).partitioned_node_id;
+                    find_data(element2).partitioned_node_id;
                 if (partition1 == partition2) {
                     /* These two elements are in the same partition, so the face
                     doesn't slice between two different partitions. */
                     continue;
                 }
-                assert(data_pair.second.adjacent_sliced[face]);
+                assert(data.adjacent_sliced[face]);
                 if (partition2 < partition1) {
                     /* We'll reach each pair of elements twice; to avoid double-
                     counting, skip based on the partitions' order */
@@ -572,7 +898,7 @@ Slice compute_slice(
                 std::pair<PartitionedNodeId, PartitionedNodeId> key(
                     partition1, partition2);
                 Vector oriented_area =
-                    mesh->oriented_area(mesh->elements[data_pair.first], face);
+                    mesh->oriented_area(mesh->elements[data.element_id], face);
                 Vector normal = oriented_area / oriented_area.magnitude();
                 partition_pair_areas[key].push_back(normal);
             }
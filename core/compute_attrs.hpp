@@ -2,6 +2,7 @@
 #define OS2CX_COMPUTE_ATTRS_HPP_
 
 #include <map>
+#include <utility>
 
 #include "mesh.hpp"
 #include "mesh_index.hpp"
@@ -41,7 +42,7 @@ MaxElementSize suggest_max_element_size(const Plc3 &plc);
 
 class ElementSet {
 public:
-    std::set<ElementId> elements;
+    RangeSet<ElementId> elements;
 };
 
 ElementSet compute_element_set_from_range(ElementId begin, ElementId end);
@@ -54,7 +55,7 @@ ElementSet compute_element_set_from_attr_bit(
 
 class FaceSet {
 public:
-    std::set<FaceId> faces;
+    RangeSet<FaceId> faces;
 };
 
 FaceSet compute_face_set_from_attr_bit(
@@ -67,7 +68,7 @@ FaceSet compute_face_set_from_attr_bit(
 
 class NodeSet {
 public:
-    std::set<NodeId> nodes;
+    RangeSet<NodeId> nodes;
 };
 
 NodeSet compute_node_set_singleton(NodeId node);
@@ -88,6 +89,35 @@ NodeId compute_node_id_from_attr_bit(
     NodeId node_end,
     AttrBitIndex attr_bit);
 
+/* SelectionQuery lists every volume, surface, and node selection that should be
+extracted from a mesh. compute_selections_from_attr_bits() finds all of them in
+a single pass over the elements and nodes, which is much faster than calling
+compute_*_from_attr_bit() once per selection when there are many selections. */
+class SelectionQuery {
+public:
+    class Surface {
+    public:
+        AttrBitIndex attr_bit;
+        Vector direction_vector;
+        double direction_angle_tolerance;
+    };
+    std::vector<AttrBitIndex> volumes;
+    std::vector<Surface> surfaces;
+    std::vector<AttrBitIndex> nodes;
+};
+
+/* Each vector is parallel to the corresponding vector of the SelectionQuery */
+class SelectionResult {
+public:
+    std::vector<ElementSet> volumes;
+    std::vector<FaceSet> surfaces;
+    std::vector<NodeSet> nodes;
+};
+
+SelectionResult compute_selections_from_attr_bits(
+    const Mesh3 &mesh,
+    const SelectionQuery &query);
+
 class ConcentratedLoad {
 public:
     class Load {
@@ -95,7 +125,8 @@ public:
         Load() : force(0, 0, 0) { }
         Vector force;
     };
-    std::map<NodeId, Load> loads;
+    /* Sorted by NodeId. Nodes with zero force are omitted. */
+    std::vector<std::pair<NodeId, Load> > loads;
 };
 
 ConcentratedLoad compute_load_from_element_set(
@@ -110,6 +141,36 @@ ConcentratedLoad compute_load_from_face_set(
     Vector force_total_or_per_area,
     bool force_is_per_area);
 
+/* A load that CalculiX can apply by itself using *DLOAD, instead of as forces
+on individual nodes. A volume load becomes a uniform body force on the volume's
+element set; a surface load becomes a uniform pressure on the surface, which
+only works if the force is perpendicular to every face of the surface. */
+class DistributedLoad {
+public:
+    enum class Type {
+        None, /* can't be represented; fall back to ConcentratedLoad */
+        BodyForce,
+        Pressure
+    };
+    DistributedLoad() :
+        type(Type::None), body_force(0, 0, 0), pressure(0) { }
+    Type type;
+    Vector body_force; /* force per unit volume */
+    double pressure; /* positive pressure pushes into the surface */
+};
+
+DistributedLoad compute_distributed_load_from_element_set(
+    const Mesh3 &mesh,
+    const ElementSet &element_set,
+    Vector force_total_or_per_volume,
+    bool force_is_per_volume);
+
+DistributedLoad compute_distributed_load_from_face_set(
+    const Mesh3 &mesh,
+    const FaceSet &face_set,
+    Vector force_total_or_per_area,
+    bool force_is_per_area);
+
 class Slice {
 public:
     class Pair {
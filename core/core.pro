@@ -1,6 +1,6 @@
 TARGET = os2cx
 QT -= gui
-CONFIG += c++14 console
+CONFIG += c++14 console thread
 CONFIG -= app_bundle
 
 LIBS += -lgmp -lmpfr
@@ -49,7 +49,10 @@ SOURCES += \
     project_run.cpp \
     mesher_naive_bricks.cpp \
     compute_attrs.cpp \
-    attrs.cpp
+    attrs.cpp \
+    surface_decimate.cpp \
+    bvh.cpp \
+    mesh_cut.cpp
 
 HEADERS += \
     calc.hpp \
@@ -80,7 +83,10 @@ HEADERS += \
     project_run.hpp \
     mesher_naive_bricks.hpp \
     compute_attrs.hpp \
-    attrs.hpp
+    attrs.hpp \
+    surface_decimate.hpp \
+    bvh.hpp \
+    mesh_cut.hpp
 
 # The "gui" and "test" projects include all the same headers and sources as
 # "core", minus "main.cpp". Prepare variables for them to use from this file.
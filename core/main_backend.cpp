@@ -39,6 +39,16 @@ void print_measurements(const Project &project) {
 
                 if (isnan(max_datum)) {
                     std::cout << "N/A";
+                    auto dataset_it =
+                        step.datasets.find(measure_pair.second.dataset);
+                    if (dataset_it != step.datasets.end()) {
+                        std::string error =
+                            dataset_it->second.values()->load_error;
+                        if (!error.empty()) {
+                            std::cout << " (error reading CalculiX output "
+                                << "file: " << error << ")";
+                        }
+                    }
                 } else {
                     Unit unit = project.unit_system.suggest_unit(
                         guess_unit_type_for_dataset(measure_pair.second.dataset),
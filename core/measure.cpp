@@ -15,16 +15,20 @@ double Measure::measure(
     const Results::Dataset &dataset_obj = dataset_it->second;
 
     SubVariable measure_subvariable;
-    if (dataset_obj.node_scalar) {
+    switch (dataset_obj.type) {
+    case Results::Dataset::Type::Scalar:
         measure_subvariable = SubVariable::ScalarValue;
-    } else if (dataset_obj.node_vector) {
+        break;
+    case Results::Dataset::Type::Vector:
         measure_subvariable = SubVariable::VectorMagnitude;
-    } else if (dataset_obj.node_complex_vector) {
+        break;
+    case Results::Dataset::Type::ComplexVector:
         measure_subvariable = SubVariable::ComplexVectorMagnitude;
-    } else if (dataset_obj.node_matrix) {
+        break;
+    case Results::Dataset::Type::Matrix:
         measure_subvariable = SubVariable::MatrixVonMisesStress;
-    } else {
-        assert(false);
+        break;
+    default: assert(false);
     }
 
     std::shared_ptr<const NodeSet> node_set;
@@ -40,11 +44,12 @@ double Measure::measure(
             compute_node_set_singleton(node->node_id)));
     }
 
+    std::shared_ptr<const Results::Dataset::Values> values =
+        dataset_obj.values();
+    int component = values->subvariable_component(measure_subvariable);
     double max_datum = 0;
     for (NodeId node_id : node_set->nodes) {
-        double datum = dataset_obj.subvariable_value(
-            measure_subvariable,
-            node_id);
+        double datum = values->component(component, node_id);
         if (isnan(datum)) {
             return NAN;
         }
@@ -1,5 +1,7 @@
 #include "mesh.hpp"
 
+#include <stdexcept>
+
 namespace os2cx {
 
 void Mesh3::append_mesh(
@@ -10,9 +12,20 @@ void Mesh3::append_mesh(
         nodes.key_end().to_int()- other.nodes.key_begin().to_int(),
         elements.key_end().to_int() - other.elements.key_begin().to_int());
 
+    /* The two meshes have separate attribute tables, so re-intern each of the
+    other mesh's attribute sets into ours. */
+    std::vector<AttrSetId> attr_mapping;
+    attr_mapping.reserve(other.attr_sets.size());
+    for (int i = 0; i < other.attr_sets.size(); ++i) {
+        attr_mapping.push_back(
+            attr_sets.intern(other.attr_sets[AttrSetId::from_int(i)]));
+    }
+
     nodes.reserve(nodes.size() + other.nodes.size());
     for (const Node3 &node : other.nodes) {
-        nodes.push_back(node);
+        Node3 copy = node;
+        copy.attrs = attr_mapping[copy.attrs.to_int()];
+        nodes.push_back(copy);
     }
 
     elements.reserve(elements.size() + other.elements.size());
@@ -21,15 +34,88 @@ void Mesh3::append_mesh(
         for (int i = 0; i < copy.num_nodes(); ++i) {
             copy.nodes[i] = id_mapping_out->convert_node_id(copy.nodes[i]);
         }
+        copy.attrs = attr_mapping[copy.attrs.to_int()];
+        for (int i = 0; i < ElementTypeShape::max_faces_per_element; ++i) {
+            copy.face_attrs[i] = attr_mapping[copy.face_attrs[i].to_int()];
+        }
         elements.push_back(copy);
     }
 }
 
+/* The functions below integrate over an element using the shape function
+values and derivatives tabulated in each ElementTypeShape::IntegrationPoint,
+rather than calling the virtual shape functions at every integration point.
+ElementPoints copies the element's node positions out of the node map once, and
+the Jacobian kernel is instantiated for each vertex count so the compiler can
+unroll its inner loop for every element type. */
+
+class ElementPoints {
+public:
+    ElementPoints(const Mesh3 &mesh, const Element3 &element) :
+        shape(element_type_shape(element.type)),
+        num_vertices(shape.vertices.size())
+    {
+        for (int i = 0; i < num_vertices; ++i) {
+            points[i] = mesh.nodes[element.nodes[i]].point - Point::origin();
+        }
+    }
+
+    const ElementTypeShape &shape;
+    int num_vertices;
+    Vector points[ElementTypeShape::max_vertices_per_element];
+};
+
+template<int num_vertices>
+static Matrix jacobian_kernel(
+    const Vector *points,
+    const ElementTypeShape::ShapeVector *sf_d_uvw
+) {
+    Matrix jacobian = Matrix::zero();
+    for (int i = 0; i < num_vertices; ++i) {
+        jacobian.cols[0] += points[i] * sf_d_uvw[i].x;
+        jacobian.cols[1] += points[i] * sf_d_uvw[i].y;
+        jacobian.cols[2] += points[i] * sf_d_uvw[i].z;
+    }
+    return jacobian;
+}
+
+static Matrix jacobian(
+    const ElementPoints &ep,
+    const ElementTypeShape::IntegrationPoint &ip
+) {
+    switch (ep.num_vertices) {
+    case 4: return jacobian_kernel<4>(ep.points, ip.sf_d_uvw);
+    case 8: return jacobian_kernel<8>(ep.points, ip.sf_d_uvw);
+    case 10: return jacobian_kernel<10>(ep.points, ip.sf_d_uvw);
+    case 20: return jacobian_kernel<20>(ep.points, ip.sf_d_uvw);
+    default:
+        assert(false);
+        throw std::logic_error("unexpected number of element vertices");
+    }
+}
+
+static double integrate_volume(
+    const ElementPoints &ep,
+    const ElementTypeShape::IntegrationPoint &ip
+) {
+    return ip.weight * jacobian(ep, ip).determinant();
+}
+
+static Vector integrate_area(
+    const ElementPoints &ep,
+    int face_index,
+    const ElementTypeShape::IntegrationPoint &ip
+) {
+    ElementTypeShape::ShapeVector shape_normal =
+        ep.shape.faces[face_index].normal;
+    return ip.weight * jacobian(ep, ip).cofactor_matrix().apply(shape_normal);
+}
+
 Volume Mesh3::volume(const Element3 &element) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
+    ElementPoints ep(*this, element);
     double total_volume = 0;
-    for (const auto &ip : shape.volume_integration_points) {
-        total_volume += integrate_volume(element, ip);
+    for (const auto &ip : ep.shape.volume_integration_points) {
+        total_volume += integrate_volume(ep, ip);
     }
     return Volume(total_volume);
 }
@@ -38,26 +124,24 @@ void Mesh3::volumes_for_nodes(
     const Element3 &element,
     Volume *volumes_out
 ) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+    ElementPoints ep(*this, element);
+    for (int i = 0; i < ep.num_vertices; ++i) {
         volumes_out[i] = 0;
     }
-    for (const auto &ip : shape.volume_integration_points) {
-        double d_volume = integrate_volume(element, ip);
-        double sf[ElementTypeShape::max_vertices_per_element];
-        shape.shape_functions(ip.uvw, sf);
-        for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
-            volumes_out[i] += sf[i] * d_volume;
+    for (const auto &ip : ep.shape.volume_integration_points) {
+        double d_volume = integrate_volume(ep, ip);
+        for (int i = 0; i < ep.num_vertices; ++i) {
+            volumes_out[i] += ip.sf[i] * d_volume;
         }
     }
 }
 
 Vector Mesh3::oriented_area(const Element3 &element, int face_index) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    const ElementTypeShape::Face &face_shape = shape.faces[face_index];
+    ElementPoints ep(*this, element);
+    const ElementTypeShape::Face &face_shape = ep.shape.faces[face_index];
     Vector total_oriented_area = Vector::zero();
     for (const auto &ip : face_shape.integration_points) {
-        total_oriented_area += integrate_area(element, face_index, ip);
+        total_oriented_area += integrate_area(ep, face_index, ip);
     }
     return total_oriented_area;
 }
@@ -67,17 +151,15 @@ void Mesh3::oriented_areas_for_nodes(
     int face_index,
     Vector *areas_out
 ) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    const ElementTypeShape::Face &face_shape = shape.faces[face_index];
-    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+    ElementPoints ep(*this, element);
+    const ElementTypeShape::Face &face_shape = ep.shape.faces[face_index];
+    for (int i = 0; i < ep.num_vertices; ++i) {
         areas_out[i] = Vector::zero();
     }
     for (const auto &ip : face_shape.integration_points) {
-        Vector d_area = integrate_area(element, face_index, ip);
-        double sf[ElementTypeShape::max_vertices_per_element];
-        shape.shape_functions(ip.uvw, sf);
+        Vector d_area = integrate_area(ep, face_index, ip);
         for (int node_ix : face_shape.vertices) {
-            areas_out[node_ix] += sf[node_ix] * d_area;
+            areas_out[node_ix] += ip.sf[node_ix] * d_area;
         }
     }
 }
@@ -88,13 +170,16 @@ void Mesh3::center_of_mass(
     Point *center_of_mass_out,
     Volume *volume_out
 ) const {
+    ElementPoints ep(*this, element);
     Vector center_of_mass = Vector::zero();
     double volume = 0;
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    for (const auto &ip : shape.volume_integration_points) {
-        Point ip_center_of_mass = point_for_shape_point(element, ip.uvw);
-        double ip_volume = integrate_volume(element, ip);
-        center_of_mass += (ip_center_of_mass - Point::origin()) * ip_volume;
+    for (const auto &ip : ep.shape.volume_integration_points) {
+        Vector ip_center_of_mass = Vector::zero();
+        for (int i = 0; i < ep.num_vertices; ++i) {
+            ip_center_of_mass += ip.sf[i] * ep.points[i];
+        }
+        double ip_volume = integrate_volume(ep, ip);
+        center_of_mass += ip_center_of_mass * ip_volume;
         volume += ip_volume;
     }
     *center_of_mass_out = Point::origin() + center_of_mass / volume;
@@ -103,57 +188,5 @@ void Mesh3::center_of_mass(
     }
 }
 
-Point Mesh3::point_for_shape_point(
-    const Element3 &element,
-    ElementTypeShape::ShapePoint uvw
-) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    double sf[ElementTypeShape::max_vertices_per_element];
-    shape.shape_functions(uvw, sf);
-    Vector point = Vector::zero();
-    for (int vertex = 0; vertex < static_cast<int>(shape.vertices.size());
-            ++vertex) {
-        Point vertex_point = nodes[element.nodes[vertex]].point;
-        point += sf[vertex] * (vertex_point - Point::origin());
-    }
-    return Point::origin() + point;
-}
-
-Matrix Mesh3::jacobian(
-    const Element3 &element,
-    ElementTypeShape::ShapePoint uvw
-) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    ElementTypeShape::ShapeVector sf_d_uvw[
-        ElementTypeShape::max_vertices_per_element];
-    shape.shape_function_derivatives(uvw, sf_d_uvw);
-    Matrix jacobian = Matrix::zero();
-    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
-        Vector point = nodes[element.nodes[i]].point - Point::origin();
-        jacobian.cols[0] += point * sf_d_uvw[i].x;
-        jacobian.cols[1] += point * sf_d_uvw[i].y;
-        jacobian.cols[2] += point * sf_d_uvw[i].z;
-    }
-    return jacobian;
-}
-
-double Mesh3::integrate_volume(
-    const Element3 &element,
-    const ElementTypeShape::IntegrationPoint &ip
-) const {
-    return ip.weight * jacobian(element, ip.uvw).determinant();
-}
-
-Vector Mesh3::integrate_area(
-    const Element3 &element,
-    int face_index,
-    const ElementTypeShape::IntegrationPoint &ip
-) const {
-    Matrix j = jacobian(element, ip.uvw);
-    ElementTypeShape::ShapeVector shape_normal =
-        element_type_shape(element.type).faces[face_index].normal;
-    return ip.weight * j.cofactor_matrix().apply(shape_normal);
-}
-
 } /* namespace os2cx */
 
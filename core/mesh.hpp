@@ -17,7 +17,7 @@ namespace os2cx {
 class Node3 {
 public:
     Point point;
-    AttrBitset attrs;
+    AttrSetId attrs;
 };
 
 class NodeId {
@@ -41,8 +41,8 @@ public:
 
     ElementType type;
     NodeId nodes[ElementTypeShape::max_vertices_per_element];
-    AttrBitset attrs;
-    AttrBitset face_attrs[ElementTypeShape::max_faces_per_element];
+    AttrSetId attrs;
+    AttrSetId face_attrs[ElementTypeShape::max_faces_per_element];
 };
 
 class ElementId {
@@ -75,7 +75,7 @@ public:
     }
     FaceId() { }
     FaceId(ElementId ei, int f) : element_id(ei), face(f) { }
-    int to_int() {
+    int to_int() const {
         return element_id.to_int() * ElementTypeShape::max_faces_per_element
             + face;
     }
@@ -167,27 +167,9 @@ public:
     ContiguousMap<NodeId, Node3> nodes;
     ContiguousMap<ElementId, Element3> elements;
 
-private:
-    Point point_for_shape_point(
-        const Element3 &element,
-        ElementTypeShape::ShapePoint uvw
-    ) const;
-
-    Matrix jacobian(
-        const Element3 &element,
-        ElementTypeShape::ShapePoint uvw
-    ) const;
-
-    double integrate_volume(
-        const Element3 &element,
-        const ElementTypeShape::IntegrationPoint &ip
-    ) const;
-
-    Vector integrate_area(
-        const Element3 &element,
-        int face_index,
-        const ElementTypeShape::IntegrationPoint &ip
-    ) const;
+    /* The 'attrs' and 'face_attrs' of every node and element are IDs into this
+    table. */
+    AttrTable attr_sets;
 };
 
 } /* namespace os2cx */
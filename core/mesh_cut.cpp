@@ -0,0 +1,188 @@
+#include "mesh_cut.hpp"
+
+#include <stdexcept>
+
+namespace os2cx {
+
+/* Bricks are split into six tetrahedra around the diagonal from corner 0 to
+corner 6. Two bricks that share a face split it along the same diagonal, as
+long as they're oriented the same way (as the ones from mesher_naive_bricks()
+are); otherwise there may be thin cracks in the surface along the face. */
+static const int brick_tets[6][4] = {
+    {0, 1, 2, 6}, {0, 1, 5, 6}, {0, 3, 2, 6},
+    {0, 3, 7, 6}, {0, 4, 5, 6}, {0, 4, 7, 6}
+};
+static const int tetrahedron_tets[1][4] = {
+    {0, 1, 2, 3}
+};
+
+int element_type_num_corners(ElementType type) {
+    const ElementTypeShape &shape = element_type_shape(type);
+    int num_corners = 0;
+    while (num_corners < static_cast<int>(shape.vertices.size()) &&
+            shape.vertices[num_corners].type
+                == ElementTypeShape::Vertex::Type::Corner) {
+        ++num_corners;
+    }
+    return num_corners;
+}
+
+/* Appends the triangle (a, b, c), turned if necessary to face towards
+'above' */
+static void add_triangle(
+    const Mesh3 &mesh,
+    CutPoint a,
+    CutPoint b,
+    CutPoint c,
+    Point above,
+    std::vector<CutPoint> *triangles_out
+) {
+    Point pa = a.point(mesh);
+    Vector normal = (b.point(mesh) - pa).cross(c.point(mesh) - pa);
+    if (normal.dot(above - pa) < 0) {
+        std::swap(b, c);
+    }
+    triangles_out->push_back(a);
+    triangles_out->push_back(b);
+    triangles_out->push_back(c);
+}
+
+static void cut_tetrahedron(
+    const Mesh3 &mesh,
+    const NodeId *nodes,
+    const double *values,
+    double level,
+    std::vector<CutPoint> *triangles_out
+) {
+    int above[4], below[4];
+    int num_above = 0, num_below = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (values[i] > level) {
+            above[num_above++] = i;
+        } else {
+            below[num_below++] = i;
+        }
+    }
+    if (num_above == 0 || num_below == 0) {
+        return;
+    }
+
+    auto cut = [&](int b, int a) {
+        CutPoint point;
+        point.node_a = nodes[b];
+        point.node_b = nodes[a];
+        point.weight = (level - values[b]) / (values[a] - values[b]);
+        return point;
+    };
+    Point above_point = mesh.nodes[nodes[above[0]]].point;
+
+    if (num_above == 1) {
+        add_triangle(mesh,
+            cut(below[0], above[0]),
+            cut(below[1], above[0]),
+            cut(below[2], above[0]),
+            above_point, triangles_out);
+    } else if (num_above == 3) {
+        add_triangle(mesh,
+            cut(below[0], above[0]),
+            cut(below[0], above[1]),
+            cut(below[0], above[2]),
+            above_point, triangles_out);
+    } else {
+        /* The four edges between the two above and two below corners form a
+        quadrilateral, in this order */
+        CutPoint quad[4] = {
+            cut(below[0], above[0]),
+            cut(below[0], above[1]),
+            cut(below[1], above[1]),
+            cut(below[1], above[0])
+        };
+        add_triangle(mesh, quad[0], quad[1], quad[2],
+            above_point, triangles_out);
+        add_triangle(mesh, quad[0], quad[2], quad[3],
+            above_point, triangles_out);
+    }
+}
+
+void cut_element(
+    const Mesh3 &mesh,
+    const Element3 &element,
+    const double *corner_values,
+    double level,
+    std::vector<CutPoint> *triangles_out
+) {
+    int num_corners = element_type_num_corners(element.type);
+    for (int i = 0; i < num_corners; ++i) {
+        if (isnan(corner_values[i])) {
+            return;
+        }
+    }
+
+    int num_tets;
+    const int (*tets)[4];
+    if (num_corners == 8) {
+        num_tets = 6;
+        tets = brick_tets;
+    } else if (num_corners == 4) {
+        num_tets = 1;
+        tets = tetrahedron_tets;
+    } else {
+        assert(false);
+        throw std::logic_error("unexpected number of element corners");
+    }
+    for (int t = 0; t < num_tets; ++t) {
+        NodeId nodes[4];
+        double values[4];
+        for (int i = 0; i < 4; ++i) {
+            nodes[i] = element.nodes[tets[t][i]];
+            values[i] = corner_values[tets[t][i]];
+        }
+        cut_tetrahedron(mesh, nodes, values, level, triangles_out);
+    }
+}
+
+std::vector<ElementId> ElementRanges::elements_at(double level) const {
+    static const int min_chunk_size = 1 << 16;
+    int num_elements = mins.size();
+    std::vector<std::vector<ElementId> > chunk_element_ids(
+        parallel_num_chunks(0, num_elements, min_chunk_size));
+    parallel_for_chunks(0, num_elements, min_chunk_size,
+        [&](int element_begin, int element_end, int chunk) {
+            for (int i = element_begin; i < element_end; ++i) {
+                /* The same test as cut_tetrahedron(): a corner that's exactly
+                at 'level' counts as below it */
+                if (mins[i] <= level && maxs[i] > level) {
+                    chunk_element_ids[chunk].push_back(
+                        ElementId::from_int(key_begin.to_int() + i));
+                }
+            }
+        });
+
+    std::vector<ElementId> element_ids;
+    for (const std::vector<ElementId> &ids : chunk_element_ids) {
+        element_ids.insert(element_ids.end(), ids.begin(), ids.end());
+    }
+    return element_ids;
+}
+
+Bvh element_bvh(const Mesh3 &mesh) {
+    return Bvh(mesh.elements.size(), [&](int i) {
+        const Element3 &element = mesh.elements[ElementId::from_int(
+            mesh.elements.key_begin().to_int() + i)];
+        Point p = mesh.nodes[element.nodes[0]].point;
+        Box box(p.x, p.y, p.z, p.x, p.y, p.z);
+        int num_corners = element_type_num_corners(element.type);
+        for (int j = 1; j < num_corners; ++j) {
+            p = mesh.nodes[element.nodes[j]].point;
+            box.xl = std::min(box.xl, p.x);
+            box.yl = std::min(box.yl, p.y);
+            box.zl = std::min(box.zl, p.z);
+            box.xh = std::max(box.xh, p.x);
+            box.yh = std::max(box.yh, p.y);
+            box.zh = std::max(box.zh, p.z);
+        }
+        return box;
+    });
+}
+
+} /* namespace os2cx */
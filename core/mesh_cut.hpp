@@ -0,0 +1,169 @@
+#ifndef OS2CX_MESH_CUT_HPP_
+#define OS2CX_MESH_CUT_HPP_
+
+#include <vector>
+
+#include "bvh.hpp"
+#include "mesh.hpp"
+
+namespace os2cx {
+
+/* A point on the edge between two nodes, 'weight' of the way from 'node_a' to
+'node_b'. Anything that's defined at the nodes (position, displacement, stress)
+can be interpolated at the point in the same way. */
+class CutPoint {
+public:
+    template<class T>
+    T interpolate(const T &a, const T &b) const {
+        return a + (b - a) * weight;
+    }
+
+    Point point(const Mesh3 &mesh) const {
+        return interpolate(mesh.nodes[node_a].point, mesh.nodes[node_b].point);
+    }
+
+    NodeId node_a, node_b;
+    double weight;
+};
+
+/* Finds the surface inside 'element' where a field crosses 'level', and
+appends it to '*triangles_out' as three CutPoints per triangle, facing towards
+higher values. 'corner_values[i]' is the field's value at 'element.nodes[i]',
+for each of the element's corners (which always come before its edge nodes).
+
+The element is split into tetrahedra between its corners, and the field is
+taken to be linear on each of them ("marching tetrahedra"). So the surface is
+only approximate for second-order elements, whose edge nodes are ignored. If
+any corner value is NaN, the element is skipped. */
+void cut_element(
+    const Mesh3 &mesh,
+    const Element3 &element,
+    const double *corner_values,
+    double level,
+    std::vector<CutPoint> *triangles_out);
+
+/* Returns the number of corners of an element of type 'type'. They're the
+shape's first vertices, so this counts the vertices up to the first edge
+vertex. */
+int element_type_num_corners(ElementType type);
+
+/* Calls cut_element() on each of 'element_ids', in parallel. 'node_value(id)'
+returns the field's value at node 'id', and is called from several threads at
+once. Each thread collects its own triangles, and they're put together in
+order, so the result is the same as cutting the elements one at a time. If
+'triangle_elements_out' isn't null, it gets the element that each triangle
+came from, one per triangle. */
+template<class NodeValue>
+void cut_elements(
+    const Mesh3 &mesh,
+    const std::vector<ElementId> &element_ids,
+    const NodeValue &node_value,
+    double level,
+    std::vector<CutPoint> *triangles_out,
+    std::vector<ElementId> *triangle_elements_out = nullptr
+) {
+    static const int min_chunk_size = 1 << 12;
+    int num_elements = element_ids.size();
+    int num_chunks = parallel_num_chunks(0, num_elements, min_chunk_size);
+    std::vector<std::vector<CutPoint> > chunk_triangles(num_chunks);
+    std::vector<std::vector<ElementId> > chunk_elements(num_chunks);
+    parallel_for_chunks(0, num_elements, min_chunk_size,
+        [&](int element_begin, int element_end, int chunk) {
+            double corner_values[ElementTypeShape::max_vertices_per_element];
+            for (int i = element_begin; i < element_end; ++i) {
+                const Element3 &element = mesh.elements[element_ids[i]];
+                int num_corners = element_type_num_corners(element.type);
+                for (int j = 0; j < num_corners; ++j) {
+                    corner_values[j] = node_value(element.nodes[j]);
+                }
+                cut_element(mesh, element, corner_values, level,
+                    &chunk_triangles[chunk]);
+                if (triangle_elements_out != nullptr) {
+                    chunk_elements[chunk].resize(
+                        chunk_triangles[chunk].size() / 3, element_ids[i]);
+                }
+            }
+        });
+
+    triangles_out->clear();
+    size_t size = 0;
+    for (const std::vector<CutPoint> &triangles : chunk_triangles) {
+        size += triangles.size();
+    }
+    triangles_out->reserve(size);
+    for (const std::vector<CutPoint> &triangles : chunk_triangles) {
+        triangles_out->insert(
+            triangles_out->end(), triangles.begin(), triangles.end());
+    }
+    if (triangle_elements_out != nullptr) {
+        triangle_elements_out->clear();
+        triangle_elements_out->reserve(size / 3);
+        for (const std::vector<ElementId> &elements : chunk_elements) {
+            triangle_elements_out->insert(
+                triangle_elements_out->end(), elements.begin(), elements.end());
+        }
+    }
+}
+
+/* The range of a field over each element's corners. A level only passes
+through the elements whose range includes it, and those are much faster to find
+from the ranges than by looking at every element's nodes again. So when only
+the level changes (e.g. as the user drags a threshold slider), the ranges can
+be computed once, and then cut_elements() only has to look at the elements
+that elements_at() returns. */
+class ElementRanges {
+public:
+    /* 'node_value' is as for cut_elements() */
+    template<class NodeValue>
+    ElementRanges(const Mesh3 &mesh, const NodeValue &node_value);
+
+    /* Returns the elements whose range includes 'level', in order. Elements
+    with NaN at any corner are never included, since cut_element() would skip
+    them anyway. */
+    std::vector<ElementId> elements_at(double level) const;
+
+private:
+    ElementId key_begin;
+    /* By element, minus 'key_begin'. Both are NaN if any corner is NaN. */
+    std::vector<double> mins, maxs;
+};
+
+template<class NodeValue>
+ElementRanges::ElementRanges(
+    const Mesh3 &mesh,
+    const NodeValue &node_value
+) :
+    key_begin(mesh.elements.key_begin()),
+    mins(mesh.elements.size()),
+    maxs(mesh.elements.size())
+{
+    parallel_for_chunks(0, mesh.elements.size(), 1 << 14,
+        [&](int element_begin, int element_end, int) {
+            for (int i = element_begin; i < element_end; ++i) {
+                const Element3 &element = mesh.elements[
+                    ElementId::from_int(key_begin.to_int() + i)];
+                int num_corners = element_type_num_corners(element.type);
+                double min = node_value(element.nodes[0]), max = min;
+                for (int j = 1; j < num_corners; ++j) {
+                    double value = node_value(element.nodes[j]);
+                    if (isnan(value)) {
+                        min = max = value;
+                        break;
+                    }
+                    min = std::min(min, value);
+                    max = std::max(max, value);
+                }
+                mins[i] = min;
+                maxs[i] = max;
+            }
+        });
+}
+
+/* Builds a BVH over the boxes around the corners of the mesh's elements, for
+finding the elements that a plane cuts through (see Bvh::plane_query()). Item
+'i' of the BVH is the element with ID 'mesh.elements.key_begin() + i'. */
+Bvh element_bvh(const Mesh3 &mesh);
+
+} /* namespace os2cx */
+
+#endif
@@ -1,6 +1,6 @@
 #include "mesh_index.hpp"
 
-#include <boost/container/flat_map.hpp>
+#include <atomic>
 
 namespace os2cx {
 
@@ -44,6 +44,27 @@ public:
         }
     }
 
+    /* Returns whichever of this face and its reverse sorts first. A face and
+    the face it matches against have the same canonical form. */
+    FaceNodes canonical(bool *reversed_out) const {
+        FaceNodes r = *this;
+        r.reverse();
+        *reversed_out = r < *this;
+        return *reversed_out ? r : *this;
+    }
+
+    size_t hash() const {
+        size_t h = num_nodes;
+        for (int i = 0; i < num_nodes; ++i) {
+            h = h * 1000003 + nodes[i].to_int();
+        }
+        return h ^ (h >> 29);
+    }
+
+    bool operator==(const FaceNodes &o) const {
+        return !(*this < o) && !(o < *this);
+    }
+
     /* This is just an arbitrary ordering so we can use FaceNodes as a sorting
     key */
     bool operator<(const FaceNodes &o) const {
@@ -61,34 +82,49 @@ public:
 };
 
 Mesh3Index::Mesh3Index(const Mesh3 &mesh) {
-    /* We want to build a map from FaceNodes to FaceId so that we can match
-    faces. We use 'boost::container::flat_map' instead of 'std::map' in order to
-    reduce memory allocations and improve memory locality. The FaceNodes
-    ordering function should put matching faces close together in the map, which
-    will further improve locality. */
-    typedef boost::container::flat_map<FaceNodes, FaceId> MapType;
-    MapType::sequence_type sequence;
-    for (ElementId element_id = mesh.elements.key_begin();
-            element_id != mesh.elements.key_end();
-            ++element_id) {
-        const Element3 &element = mesh.elements[element_id];
-        const ElementTypeShape &shape = element_type_shape(element.type);
-        for (int face = 0;
-                face < static_cast<int>(shape.faces.size()); ++face) {
-            sequence.push_back(std::make_pair(
-                FaceNodes::make(element, face),
-                FaceId { element_id, face }
-            ));
-        }
-    }
-
-    int num_faces = sequence.size();
-    MapType map;
-    map.adopt_sequence(std::move(sequence));
+    build_matching_faces(mesh);
+    build_node_elements(mesh);
+}
 
-    /* This would fail if some faces were non-unique, i.e. if two elements
-    shared a certain face *from the same side*. */
-    assert(num_faces == static_cast<int>(map.size()));
+void Mesh3Index::build_matching_faces(const Mesh3 &mesh) {
+    /* Two faces match if one's FaceNodes is the reverse of the other's, so
+    they have the same canonical FaceNodes. We hash every face's canonical
+    FaceNodes into one of several buckets, so that matching faces always end up
+    in the same bucket. Then each bucket can be sorted and scanned for matches
+    independently of the others. Both steps are run in parallel. */
+    struct Entry {
+        FaceNodes key;
+        FaceId face_id;
+        bool reversed;
+    };
+
+    int element_begin = mesh.elements.key_begin().to_int();
+    int element_end = mesh.elements.key_end().to_int();
+    static const int min_elements_per_chunk = 4096;
+    int num_chunks = parallel_num_chunks(
+        element_begin, element_end, min_elements_per_chunk);
+    int num_buckets = (num_chunks == 1) ? 1 : 4 * parallel_num_threads();
+
+    /* entries[chunk][bucket] is written only by the thread for 'chunk' */
+    std::vector<std::vector<std::vector<Entry> > > entries(
+        num_chunks, std::vector<std::vector<Entry> >(num_buckets));
+    parallel_for_chunks(element_begin, element_end, min_elements_per_chunk,
+    [&](int chunk_begin, int chunk_end, int chunk) {
+        for (int i = chunk_begin; i < chunk_end; ++i) {
+            ElementId element_id = ElementId::from_int(i);
+            const Element3 &element = mesh.elements[element_id];
+            const ElementTypeShape &shape = element_type_shape(element.type);
+            for (int face = 0;
+                    face < static_cast<int>(shape.faces.size()); ++face) {
+                Entry entry;
+                entry.key = FaceNodes::make(element, face)
+                    .canonical(&entry.reversed);
+                entry.face_id = FaceId(element_id, face);
+                int bucket = entry.key.hash() % num_buckets;
+                entries[chunk][bucket].push_back(entry);
+            }
+        }
+    });
 
     matching_faces = ContiguousMap<FaceId, FaceId>(
         FaceId { mesh.elements.key_begin(), 0 },
@@ -96,19 +132,119 @@ Mesh3Index::Mesh3Index(const Mesh3 &mesh) {
         FaceId::invalid()
     );
 
-    for (auto it = map.begin(); it != map.end(); ++it) {
-        FaceId *result = &matching_faces[it->second];
-        FaceNodes key = it->first;
-        key.reverse();
-        auto jt = map.find(key);
-        if (jt == map.end()) {
-            *result = FaceId::invalid();
-            unmatched_faces.push_back(it->second);
-        } else {
-            *result = jt->second;
+    /* Every face lands in exactly one bucket, so the threads never write to
+    the same entry of 'matching_faces'. */
+    parallel_for_chunks(0, num_buckets, 1,
+    [&](int bucket_begin, int bucket_end, int) {
+        std::vector<Entry> bucket_entries;
+        for (int bucket = bucket_begin; bucket < bucket_end; ++bucket) {
+            bucket_entries.clear();
+            for (int chunk = 0; chunk < num_chunks; ++chunk) {
+                const std::vector<Entry> &part = entries[chunk][bucket];
+                bucket_entries.insert(
+                    bucket_entries.end(), part.begin(), part.end());
+            }
+            std::sort(bucket_entries.begin(), bucket_entries.end(),
+                [](const Entry &a, const Entry &b) {
+                    if (a.key < b.key) return true;
+                    if (b.key < a.key) return false;
+                    return a.face_id < b.face_id;
+                });
+            for (int i = 0; i + 1 < static_cast<int>(bucket_entries.size());
+                    ++i) {
+                const Entry &a = bucket_entries[i];
+                const Entry &b = bucket_entries[i + 1];
+                if (!(a.key == b.key)) continue;
+                /* This would fail if some faces were non-unique, i.e. if two
+                elements shared a certain face *from the same side*, or if more
+                than two elements shared a face. */
+                assert(a.reversed != b.reversed);
+                assert(i + 2 == static_cast<int>(bucket_entries.size()) ||
+                    !(bucket_entries[i + 2].key == a.key));
+                matching_faces[a.face_id] = b.face_id;
+                matching_faces[b.face_id] = a.face_id;
+                ++i;
+            }
+        }
+    });
+
+    std::vector<std::vector<FaceId> > chunk_unmatched_faces(num_chunks);
+    parallel_for_chunks(element_begin, element_end, min_elements_per_chunk,
+    [&](int chunk_begin, int chunk_end, int chunk) {
+        for (int i = chunk_begin; i < chunk_end; ++i) {
+            ElementId element_id = ElementId::from_int(i);
+            const Element3 &element = mesh.elements[element_id];
+            int num_faces = element_type_shape(element.type).faces.size();
+            for (int face = 0; face < num_faces; ++face) {
+                FaceId face_id(element_id, face);
+                if (matching_faces[face_id] == FaceId::invalid()) {
+                    chunk_unmatched_faces[chunk].push_back(face_id);
+                }
+            }
         }
+    });
+    for (const std::vector<FaceId> &part : chunk_unmatched_faces) {
+        unmatched_faces.insert(unmatched_faces.end(), part.begin(), part.end());
     }
 }
 
-} /* namespace os2cx */
+void Mesh3Index::build_node_elements(const Mesh3 &mesh) {
+    node_begin = mesh.nodes.key_begin();
+    int num_nodes = mesh.nodes.size();
+    int element_begin = mesh.elements.key_begin().to_int();
+    int element_end = mesh.elements.key_end().to_int();
+    static const int min_elements_per_chunk = 4096;
+
+    /* First count how many elements each node is part of, then turn the counts
+    into offsets, then fill in the element IDs. */
+    std::vector<std::atomic<int> > cursors(num_nodes);
+    parallel_for_chunks(element_begin, element_end, min_elements_per_chunk,
+    [&](int chunk_begin, int chunk_end, int) {
+        for (int i = chunk_begin; i < chunk_end; ++i) {
+            const Element3 &element = mesh.elements[ElementId::from_int(i)];
+            int num_element_nodes = element.num_nodes();
+            for (int j = 0; j < num_element_nodes; ++j) {
+                int index = element.nodes[j].to_int() - node_begin.to_int();
+                cursors[index].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    node_element_offsets.resize(num_nodes + 1);
+    node_element_offsets[0] = 0;
+    for (int index = 0; index < num_nodes; ++index) {
+        int count = cursors[index].load(std::memory_order_relaxed);
+        node_element_offsets[index + 1] = node_element_offsets[index] + count;
+        cursors[index].store(
+            node_element_offsets[index], std::memory_order_relaxed);
+    }
 
+    node_elements.resize(node_element_offsets[num_nodes]);
+    parallel_for_chunks(element_begin, element_end, min_elements_per_chunk,
+    [&](int chunk_begin, int chunk_end, int) {
+        for (int i = chunk_begin; i < chunk_end; ++i) {
+            ElementId element_id = ElementId::from_int(i);
+            const Element3 &element = mesh.elements[element_id];
+            int num_element_nodes = element.num_nodes();
+            for (int j = 0; j < num_element_nodes; ++j) {
+                int index = element.nodes[j].to_int() - node_begin.to_int();
+                int slot =
+                    cursors[index].fetch_add(1, std::memory_order_relaxed);
+                node_elements[slot] = element_id;
+            }
+        }
+    });
+
+    /* The threads may have filled in each node's elements in any order */
+    static const int min_nodes_per_chunk = 16384;
+    parallel_for_chunks(0, num_nodes, min_nodes_per_chunk,
+    [&](int chunk_begin, int chunk_end, int) {
+        for (int index = chunk_begin; index < chunk_end; ++index) {
+            std::sort(
+                node_elements.begin() + node_element_offsets[index],
+                node_elements.begin() + node_element_offsets[index + 1]);
+        }
+    });
+}
+
+} /* namespace os2cx */
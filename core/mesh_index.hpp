@@ -17,10 +17,43 @@ public:
         return matching_faces[face];
     }
 
+    /* Sorted by FaceId */
     std::vector<FaceId> unmatched_faces;
 
+    class ElementRange {
+    public:
+        ElementRange(const ElementId *b, const ElementId *e) :
+            _begin(b), _end(e) { }
+        const ElementId *begin() const { return _begin; }
+        const ElementId *end() const { return _end; }
+        int size() const { return _end - _begin; }
+    private:
+        const ElementId *_begin, *_end;
+    };
+
+    /* Returns the IDs of all the elements that have 'node' as one of their
+    vertices, in increasing order. The ranges for all the nodes are stored
+    back-to-back in a single array (compressed sparse row format), so this
+    doesn't allocate. */
+    ElementRange elements_for_node(NodeId node) const {
+        int index = node.to_int() - node_begin.to_int();
+        assert(index >= 0);
+        assert(index + 1 < static_cast<int>(node_element_offsets.size()));
+        const ElementId *base = node_elements.data();
+        return ElementRange(
+            base + node_element_offsets[index],
+            base + node_element_offsets[index + 1]);
+    }
+
 private:
+    void build_matching_faces(const Mesh3 &mesh);
+    void build_node_elements(const Mesh3 &mesh);
+
     ContiguousMap<FaceId, FaceId> matching_faces;
+
+    NodeId node_begin;
+    std::vector<int> node_element_offsets;
+    std::vector<ElementId> node_elements;
 };
 
 } /* namespace os2cx */
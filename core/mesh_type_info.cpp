@@ -120,6 +120,21 @@ void ElementTypeShape::precalculate_face_info() {
     }
 }
 
+void ElementTypeShape::tabulate_integration_points() {
+    auto tabulate = [this](IntegrationPoint *ip) {
+        shape_functions(ip->uvw, ip->sf);
+        shape_function_derivatives(ip->uvw, ip->sf_d_uvw);
+    };
+    for (IntegrationPoint &ip : volume_integration_points) {
+        tabulate(&ip);
+    }
+    for (Face &face : faces) {
+        for (IntegrationPoint &ip : face.integration_points) {
+            tabulate(&ip);
+        }
+    }
+}
+
 /* eight_volume_integration_points() defines the integration point scheme that's
 shared between C3D8, C3D20R, and C3D20RI. */
 std::vector<ElementTypeShape::IntegrationPoint>
@@ -164,6 +179,7 @@ public:
         precalculate_face_info();
 
         volume_integration_points = eight_volume_integration_points();
+        tabulate_integration_points();
     }
 
     void shape_functions(ShapePoint uvw, double *sf_out) const {
@@ -327,6 +343,7 @@ public:
                 locs[x], locs[y], locs[z],
                 weights[x] * weights[y] * weights[z]);
         }
+        tabulate_integration_points();
     }
 };
 
@@ -336,6 +353,7 @@ public:
         name = "C3D20R";
 
         volume_integration_points = eight_volume_integration_points();
+        tabulate_integration_points();
     }
 };
 
@@ -345,6 +363,7 @@ public:
         name = "C3D20RI";
 
         volume_integration_points = eight_volume_integration_points();
+        tabulate_integration_points();
     }
 };
 
@@ -371,6 +390,7 @@ public:
 
         volume_integration_points.resize(1);
         volume_integration_points[0] = IntegrationPoint(0.25, 0.25, 0.25, 1/6.0);
+        tabulate_integration_points();
     }
 
     void shape_functions(ShapePoint uvw, double *sf_out) const {
@@ -426,6 +446,7 @@ public:
         volume_integration_points[1] = IntegrationPoint(b, a, a, 1/24.0);
         volume_integration_points[2] = IntegrationPoint(a, b, a, 1/24.0);
         volume_integration_points[3] = IntegrationPoint(a, a, b, 1/24.0);
+        tabulate_integration_points();
     }
 
     void shape_functions(ShapePoint uvw, double *sf_out) const {
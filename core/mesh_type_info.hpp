@@ -48,6 +48,12 @@ public:
             uvw(u, v, w), weight(we) { }
         ShapePoint uvw;
         double weight;
+
+        /* The shape functions and their derivatives, evaluated at 'uvw'. These
+        are filled in by tabulate_integration_points() so that code that
+        integrates over many elements doesn't have to re-evaluate them. */
+        double sf[max_vertices_per_element];
+        ShapeVector sf_d_uvw[max_vertices_per_element];
     };
 
     /* Note, vertices and faces are numbered according to the same convention
@@ -105,6 +111,11 @@ protected:
     /* Computes faces[*].normal and faces[*].integration_points from
     faces[*].vertices and vertices[*].uvw */
     void precalculate_face_info();
+
+    /* Fills in the 'sf' and 'sf_d_uvw' tables of every volume and face
+    integration point. Must be called at the end of the most-derived
+    constructor, once the integration points are final. */
+    void tabulate_integration_points();
 };
 
 const ElementTypeShape &element_type_shape(ElementType);
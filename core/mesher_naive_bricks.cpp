@@ -398,7 +398,7 @@ void create_brick(
     Array2D<NodeId> *z_lower_node_ids,
     Array2D<NodeId> *z_middle_node_ids,
     Array2D<NodeId> *z_upper_node_ids,
-    AttrBitset attrs,
+    AttrSetId attrs,
     Mesh3 *mesh
 ) {
     Element3 element;
@@ -505,7 +505,7 @@ void create_bricks(
                     element_type, order,
                     x_lower, x_upper, y_lower, y_upper, z_lower, z_upper,
                     z_lower_node_ids, &z_middle_node_ids, z_upper_node_ids,
-                    plc.volumes[vid].attrs,
+                    mesh->attr_sets.intern(plc.volumes[vid].attrs),
                     mesh);
             }
 
@@ -639,7 +639,8 @@ void update_face_attrs(
                     << " next_eid=" << next_eid.to_int()
                     << " surface_id=" << surface_id << std::endl);
                 if (surface_id != SURFACE_ID_UNSET) {
-                    AttrBitset attrs = plc.surfaces[surface_id].attrs;
+                    AttrSetId attrs =
+                        mesh->attr_sets.intern(plc.surfaces[surface_id].attrs);
                     if (prev_eid != ElementId::invalid()) {
                         mesh->elements[prev_eid].face_attrs[face_after] =
                             attrs;
@@ -672,7 +673,8 @@ void update_node_attrs(const Plc3 &plc, Mesh3 *mesh) {
     for (Node3 &node : mesh->nodes) {
         auto it = vertices_by_point.find(node.point);
         if (it != vertices_by_point.end()) {
-            node.attrs = plc.vertices[it->second].attrs;
+            node.attrs =
+                mesh->attr_sets.intern(plc.vertices[it->second].attrs);
         }
     }
 }
@@ -155,12 +155,12 @@ void transfer_attrs(const Plc3 &plc, Mesh3 *mesh) {
             Plc3::VertexId vid = nid.to_int();
             const Plc3::Vertex &vertex = plc.vertices[vid];
             assert(vertex.point == node->point);
-            node->attrs = vertex.attrs;
+            node->attrs = mesh->attr_sets.intern(vertex.attrs);
         } else {
             /* This node was created artificially by tetgen. Set the attrs to
             empty. This isn't technically correct, but node attrs only matter
             for purposes of os2cx_select_node(), so this is fine. */
-            node->attrs = AttrBitset();
+            node->attrs = AttrSetId::empty();
         }
     }
 
@@ -176,7 +176,8 @@ void transfer_attrs(const Plc3 &plc, Mesh3 *mesh) {
         Point center = Point::origin() + sum / num_nodes;
 
         Plc3::VolumeId volume_id = plc_index.volume_containing_point(center);
-        element->attrs = plc.volumes[volume_id].attrs;
+        element->attrs =
+            mesh->attr_sets.intern(plc.volumes[volume_id].attrs);
 
         FaceId fid;
         fid.element_id = eid;
@@ -195,10 +196,11 @@ void transfer_attrs(const Plc3 &plc, Mesh3 *mesh) {
                 plc_index.surface_containing_point(center);
             if (surface_id == -1) {
                 /* internal face, not on any surface */
-                element->face_attrs[fid.face] = plc.volumes[volume_id].attrs;
+                element->face_attrs[fid.face] = element->attrs;
             } else {
                 /* copy attrs of the surface */
-                element->face_attrs[fid.face] = plc.surfaces[surface_id].attrs;
+                element->face_attrs[fid.face] =
+                    mesh->attr_sets.intern(plc.surfaces[surface_id].attrs);
             }
         }
     }
@@ -34,6 +34,13 @@ void check_arg_count(
     }
 }
 
+bool check_bool(const OpenscadValue &value) {
+    if (value.type != OpenscadValue::Type::Bool) {
+        throw BadEchoError("expected true or false");
+    }
+    return value.bool_value;
+}
+
 std::string check_string(const OpenscadValue &value) {
     if (value.type != OpenscadValue::Type::String) {
         throw BadEchoError("expected string");
@@ -222,7 +229,11 @@ void do_analysis_directive(
     Project *project,
     const std::vector<OpenscadValue> &args
 ) {
-    check_arg_count(args, 2, "analysis");
+    /* The 'binary_output' and 'single_precision' arguments were added later,
+    so they're optional */
+    if (args.size() != 3 && args.size() != 4) {
+        check_arg_count(args, 2, "analysis");
+    }
 
     if (!project->calculix_deck_raw.empty()) {
         throw UsageError("Can't have multiple os2cx_analysis_...() directives "
@@ -248,6 +259,15 @@ void do_analysis_directive(
         throw UsageError("Invalid unit system in analysis directive: " +
             std::string(e.what()));
     }
+
+    if (args.size() >= 3) {
+        project->calculix_binary_output = check_bool(args[2]);
+    }
+    if (args.size() >= 4) {
+        project->results_precision = check_bool(args[3])
+            ? Results::Precision::Single
+            : Results::Precision::Double;
+    }
 }
 
 void do_mesh_directive(
@@ -307,8 +327,6 @@ void do_slice_directive(
 
     Project::SliceObject object;
 
-    /* If there are too many select_* directives, bit_index will be greater than
-    or equal to num_attr_bits; we'll check this later. */
     object.bit_index = project->next_bit_index++;
 
     object.direction_vector = check_vector_3(args[1]);
@@ -329,8 +347,6 @@ void do_select_volume_directive(
 
     Project::SelectVolumeObject object;
 
-    /* If there are too many select_volume directives, bit_index will be greater
-    than or equal to num_attr_bits; we'll check this later. */
     object.bit_index = project->next_bit_index++;
 
     project->select_volume_objects.insert(std::make_pair(name, object));
@@ -347,8 +363,6 @@ void do_select_surface_directive(
 
     Project::SelectSurfaceObject object;
 
-    /* If there are too many select_* directives, bit_index will be greater than
-    or equal to num_attr_bits; we'll check this later. */
     object.bit_index = project->next_bit_index++;
 
     std::string mode = check_string(args[1]);
@@ -384,8 +398,6 @@ void do_select_node_directive(
 
     Project::SelectNodeObject object;
 
-    /* If there are too many select_* directives, bit_index will be greater than
-    or equal to num_attr_bits; we'll check this later. */
     object.bit_index = project->next_bit_index++;
 
     object.point = Point::origin() + check_vector_3(args[1]);
@@ -413,7 +425,10 @@ void do_load_volume_directive(
     Project *project,
     const std::vector<OpenscadValue> &args
 ) {
-    check_arg_count(args, 4, "load_volume");
+    /* The 'distributed' argument was added later, so it's optional */
+    if (args.size() != 5) {
+        check_arg_count(args, 4, "load_volume");
+    }
 
     Project::LoadObjectName name = check_name_new(args[0], "load", project);
 
@@ -438,13 +453,20 @@ void do_load_volume_directive(
         throw BadEchoError("specify exactly one of force_total and "
             "force_per_volume");
     }
+
+    if (args.size() == 5) {
+        project->load_volume_objects[name].distributed = check_bool(args[4]);
+    }
 }
 
 void do_load_surface_directive(
     Project *project,
     const std::vector<OpenscadValue> &args
 ) {
-    check_arg_count(args, 4, "load_surface");
+    /* The 'distributed' argument was added later, so it's optional */
+    if (args.size() != 5) {
+        check_arg_count(args, 4, "load_surface");
+    }
 
     Project::LoadObjectName name = check_name_new(args[0], "load", project);
 
@@ -469,6 +491,10 @@ void do_load_surface_directive(
         throw BadEchoError("specify exactly one of force_total and "
             "force_per_area");
     }
+
+    if (args.size() == 5) {
+        project->load_surface_objects[name].distributed = check_bool(args[4]);
+    }
 }
 
 void do_material_elastic_simple_directive(
@@ -642,15 +668,6 @@ void openscad_extract_inventory(Project *project) {
         }
     }
 
-    if (project->next_bit_index - 1 > num_attr_bits - 1) {
-        std::stringstream msg;
-        msg << "There are too many os2cx_select_*() and/or "
-            << "os2cx_slice() directives. There are "
-            << (project->next_bit_index - 1)
-            << ", but the limit is " << (num_attr_bits - 1) << ".";
-        throw UsageError(msg.str());
-    }
-
     if (project->calculix_deck_raw.empty()) {
         throw UsageError("Please specify an os2cx_analysis_...() directive.");
     }
@@ -44,17 +44,7 @@ public:
 };
 
 inline std::ostream &operator<<(std::ostream &stream, PlcNef3Mark marks) {
-    stream << '[';
-    bool is_first = true;
-    for (int i = 0; i < num_attr_bits; ++i) {
-        if (marks.attrs[i]) {
-            if (is_first) is_first = false;
-            else stream << ' ';
-            stream << i;
-        }
-    }
-    stream << ']';
-    return stream;
+    return stream << marks.attrs;
 }
 
 typedef CGAL::Exact_predicates_exact_constructions_kernel KE;
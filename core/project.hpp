@@ -34,6 +34,8 @@ public:
         scad_path(scad_path_),
         progress(Progress::NothingDone),
         errored(false),
+        calculix_binary_output(false),
+        results_precision(Results::Precision::Double),
         next_bit_index(attr_bit_solid() + 1),
         approx_scale(Length(0))
         { }
@@ -51,6 +53,9 @@ public:
 
     std::vector<OpenscadValue> calculix_deck_raw;
     std::vector<std::string> calculix_deck;
+    bool calculix_binary_output;
+    /* Datasets that are measured are always kept in double precision */
+    Results::Precision results_precision;
 
     AttrBitIndex next_bit_index;
 
@@ -89,6 +94,13 @@ public:
 
     class LoadObject {
     public:
+        LoadObject() : distributed(false) { }
+
+        /* If 'distributed' is true, the load is written as a *DLOAD whenever
+        CalculiX can represent it that way; then 'distributed_load' is set and
+        'load' is null. Otherwise, 'load' is set. */
+        bool distributed;
+        std::shared_ptr<const DistributedLoad> distributed_load;
         std::shared_ptr<const ConcentratedLoad> load;
     };
 
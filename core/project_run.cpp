@@ -1,7 +1,5 @@
 #include "project_run.hpp"
 
-#include <fstream>
-
 #include "calculix_frd_read.hpp"
 #include "calculix_inp_write.hpp"
 #include "calculix_run.hpp"
@@ -13,6 +11,11 @@
 
 namespace os2cx {
 
+/* Results are loaded from the .frd file as they're viewed; this is roughly how
+much memory the loaded results may take up before the least recently used ones
+are dropped again. */
+static const size_t results_cache_memory_limit = size_t(1) << 30;
+
 void project_run_inner(Project *p, ProjectRunCallbacks *callbacks) {
     /* If scad_path="/foo/bar.scad", then project_name="bar" */
     p->project_name = p->scad_path;
@@ -263,75 +266,61 @@ void project_run_inner(Project *p, ProjectRunCallbacks *callbacks) {
             compute_equations_for_slice(*pair.second.slice)));
     }
 
-    for (auto &pair : p->select_volume_objects) {
-        callbacks->project_run_log("Computing volume '" + pair.first + "'...");
-        ElementSet element_set;
-        for (auto &mesh_pair : p->mesh_objects) {
-            ElementSet partial_element_set = compute_element_set_from_attr_bit(
-                *p->mesh,
-                mesh_pair.second.element_begin,
-                mesh_pair.second.element_end,
-                pair.second.bit_index);
-            element_set.elements.insert(
-                partial_element_set.elements.begin(),
-                partial_element_set.elements.end());
-        }
-
-        NodeSet node_set =
-            compute_node_set_from_element_set(*p->mesh, element_set);
-
-        pair.second.element_set.reset(new ElementSet(std::move(element_set)));
-        pair.second.node_set.reset(new NodeSet(std::move(node_set)));
-
-        callbacks->project_run_checkpoint();
-    }
+    {
+        callbacks->project_run_log("Computing selections...");
 
-    for (auto &pair : p->select_surface_objects) {
-        callbacks->project_run_log("Computing surface '" + pair.first + "'...");
-        FaceSet face_set;
-        for (auto &mesh_pair : p->mesh_objects) {
-            FaceSet partial_face_set = compute_face_set_from_attr_bit(
-                *p->mesh,
-                mesh_pair.second.element_begin,
-                mesh_pair.second.element_end,
-                pair.second.direction_vector,
-                pair.second.direction_angle_tolerance,
-                pair.second.bit_index);
-            face_set.faces.insert(
-                partial_face_set.faces.begin(),
-                partial_face_set.faces.end());
+        SelectionQuery query;
+        for (const auto &pair : p->select_volume_objects) {
+            query.volumes.push_back(pair.second.bit_index);
+        }
+        for (const auto &pair : p->select_surface_objects) {
+            SelectionQuery::Surface surface;
+            surface.attr_bit = pair.second.bit_index;
+            surface.direction_vector = pair.second.direction_vector;
+            surface.direction_angle_tolerance =
+                pair.second.direction_angle_tolerance;
+            query.surfaces.push_back(surface);
+        }
+        for (const auto &pair : p->select_node_objects) {
+            query.nodes.push_back(pair.second.bit_index);
         }
 
-        NodeSet node_set = compute_node_set_from_face_set(*p->mesh, face_set);
-
-        pair.second.face_set.reset(new FaceSet(std::move(face_set)));
-        pair.second.node_set.reset(new NodeSet(std::move(node_set)));
-
-        callbacks->project_run_checkpoint();
-    }
+        SelectionResult result =
+            compute_selections_from_attr_bits(*p->mesh, query);
+
+        int i = 0;
+        for (auto &pair : p->select_volume_objects) {
+            ElementSet &element_set = result.volumes[i++];
+            NodeSet node_set =
+                compute_node_set_from_element_set(*p->mesh, element_set);
+            pair.second.element_set.reset(
+                new ElementSet(std::move(element_set)));
+            pair.second.node_set.reset(new NodeSet(std::move(node_set)));
+        }
 
-    for (auto &pair : p->select_node_objects) {
-        callbacks->project_run_log("Computing node '" + pair.first + "'...");
+        i = 0;
+        for (auto &pair : p->select_surface_objects) {
+            FaceSet &face_set = result.surfaces[i++];
+            NodeSet node_set =
+                compute_node_set_from_face_set(*p->mesh, face_set);
+            pair.second.face_set.reset(new FaceSet(std::move(face_set)));
+            pair.second.node_set.reset(new NodeSet(std::move(node_set)));
+        }
 
-        pair.second.node_id = NodeId::invalid();
-        for (auto &mesh_pair : p->mesh_objects) {
-            NodeId node_id = compute_node_id_from_attr_bit(
-                *p->mesh,
-                mesh_pair.second.node_begin,
-                mesh_pair.second.node_end,
-                pair.second.bit_index);
-            if (node_id != NodeId::invalid()) {
-                if (pair.second.node_id == NodeId::invalid()) {
-                    pair.second.node_id = node_id;
-                } else {
-                    throw UsageError("os2cx_select_node() \"" + pair.first +
-                        "\" hits multiple solid meshes.");
-                }
+        i = 0;
+        for (auto &pair : p->select_node_objects) {
+            /* Each solid mesh has at most one node with the bit set, so if
+            several nodes have it, the point hit several solid meshes */
+            const NodeSet &node_set = result.nodes[i++];
+            if (node_set.nodes.size() > 1) {
+                throw UsageError("os2cx_select_node() \"" + pair.first +
+                    "\" hits multiple solid meshes.");
             }
-        }
-        if (pair.second.node_id == NodeId::invalid()) {
-            throw UsageError("os2cx_select_node() \"" + pair.first +
-                "\" doesn't hit any solid meshes.");
+            if (node_set.nodes.empty()) {
+                throw UsageError("os2cx_select_node() \"" + pair.first +
+                    "\" doesn't hit any solid meshes.");
+            }
+            pair.second.node_id = *node_set.nodes.begin();
         }
 
         callbacks->project_run_checkpoint();
@@ -341,12 +330,29 @@ void project_run_inner(Project *p, ProjectRunCallbacks *callbacks) {
         callbacks->project_run_log("Computing load '" + pair.first + "'...");
         const ElementSet &element_set =
             *p->find_volume_object(pair.second.volume)->element_set;
+        Vector force = p->unit_system.unit_to_system(
+            pair.second.force_total_or_per_volume);
+        if (pair.second.distributed) {
+            DistributedLoad distributed_load =
+                compute_distributed_load_from_element_set(
+                    *p->mesh,
+                    element_set,
+                    force,
+                    pair.second.force_is_per_volume);
+            if (distributed_load.type != DistributedLoad::Type::None) {
+                pair.second.distributed_load.reset(
+                    new DistributedLoad(distributed_load));
+                callbacks->project_run_checkpoint();
+                continue;
+            }
+            callbacks->project_run_log("Load '" + pair.first + "' can't be "
+                "written as a *DLOAD; using per-node *CLOADs instead.");
+        }
         pair.second.load.reset(new ConcentratedLoad(
             compute_load_from_element_set(
                 *p->mesh,
                 element_set,
-                p->unit_system.unit_to_system(
-                    pair.second.force_total_or_per_volume),
+                force,
                 pair.second.force_is_per_volume)
         ));
         callbacks->project_run_checkpoint();
@@ -356,12 +362,30 @@ void project_run_inner(Project *p, ProjectRunCallbacks *callbacks) {
         callbacks->project_run_log("Computing load '" + pair.first + "'...");
         const FaceSet &face_set =
             *p->find_surface_object(pair.second.surface)->face_set;
+        Vector force = p->unit_system.unit_to_system(
+            pair.second.force_total_or_per_area);
+        if (pair.second.distributed) {
+            DistributedLoad distributed_load =
+                compute_distributed_load_from_face_set(
+                    *p->mesh,
+                    face_set,
+                    force,
+                    pair.second.force_is_per_area);
+            if (distributed_load.type != DistributedLoad::Type::None) {
+                pair.second.distributed_load.reset(
+                    new DistributedLoad(distributed_load));
+                callbacks->project_run_checkpoint();
+                continue;
+            }
+            callbacks->project_run_log("Load '" + pair.first + "' isn't "
+                "perpendicular to its surface, so it can't be written as a "
+                "*DLOAD pressure; using per-node *CLOADs instead.");
+        }
         pair.second.load.reset(new ConcentratedLoad(
             compute_load_from_face_set(
                 *p->mesh,
                 face_set,
-                p->unit_system.unit_to_system(
-                    pair.second.force_total_or_per_area),
+                force,
                 pair.second.force_is_per_area)
         ));
         callbacks->project_run_checkpoint();
@@ -378,7 +402,8 @@ void project_run_inner(Project *p, ProjectRunCallbacks *callbacks) {
     callbacks->project_run_checkpoint();
 
     try {
-        run_calculix(p->temp_dir, p->project_name);
+        run_calculix(
+            p->temp_dir, p->project_name, p->calculix_binary_output);
     } catch (const CalculixRunError &error) {
         callbacks->project_run_log("CalculiX failed.");
         p->errored = true;
@@ -386,14 +411,12 @@ void project_run_inner(Project *p, ProjectRunCallbacks *callbacks) {
     }
 
     callbacks->project_run_log("Reading CalculiX output files...");
-    std::ifstream frd_stream(p->temp_dir + "/" + p->project_name + ".frd");
-    std::vector<FrdAnalysis> frd_analyses;
+    std::shared_ptr<const FrdFile> frd_file;
     try {
-        read_calculix_frd(
-            frd_stream,
+        frd_file.reset(new FrdFile(
+            p->temp_dir + "/" + p->project_name + ".frd",
             p->mesh->nodes.key_begin(),
-            p->mesh->nodes.key_end(),
-            &frd_analyses);
+            p->mesh->nodes.key_end()));
     } catch (const CalculixFrdFileReadError &error) {
         callbacks->project_run_log("Error reading CalculiX output file:");
         callbacks->project_run_log(error.what());
@@ -401,8 +424,21 @@ void project_run_inner(Project *p, ProjectRunCallbacks *callbacks) {
         return;
     }
 
+    std::set<std::string> measured_datasets;
+    for (const auto &pair : p->measure_objects) {
+        measured_datasets.insert(pair.second.dataset);
+    }
     Results results;
-    results_from_frd_analyses(frd_analyses, &results);
+    results_from_frd_file(
+        frd_file,
+        results_cache_memory_limit,
+        p->results_precision,
+        measured_datasets,
+        &results);
+
+    /* The results can be shown right away; the GUI needs each dataset's
+    stats to choose its scales, so those are computed in the background */
+    results_start_computing_stats(results);
     p->results.reset(new Results(std::move(results)));
     p->progress = Project::Progress::ResultsDone;
     callbacks->project_run_log("Done.");
@@ -1,140 +1,529 @@
 #include "result.hpp"
 
+#include <limits>
+#include <stdexcept>
+
 namespace os2cx {
 
-double Results::Dataset::subvariable_value(
-    SubVariable subvar,
-    NodeId node_id
-) const {
+/* Appends the derived components described in result.hpp to 'components'.
+Each one is computed in a single pass over the contiguous component arrays,
+split across threads. */
+template<class T>
+static void add_derived_components(
+    Results::Dataset::Type type,
+    std::vector<ContiguousMap<NodeId, T> > *components
+) {
+    int num_derived;
+    switch (type) {
+    case Results::Dataset::Type::Scalar: num_derived = 0; break;
+    case Results::Dataset::Type::Vector: num_derived = 1; break;
+    case Results::Dataset::Type::ComplexVector: num_derived = 1; break;
+    case Results::Dataset::Type::Matrix: num_derived = 4; break;
+    default:
+        assert(false);
+        throw std::logic_error("unknown dataset type");
+    }
+    if (num_derived == 0) {
+        return;
+    }
+
+    NodeId node_begin = (*components)[0].key_begin();
+    NodeId node_end = (*components)[0].key_end();
+    int num_inputs = components->size();
+    for (int i = 0; i < num_derived; ++i) {
+        components->push_back(
+            ContiguousMap<NodeId, T>(node_begin, node_end, NAN));
+    }
+    const T *in[6];
+    for (int i = 0; i < num_inputs; ++i) {
+        in[i] = (*components)[i].data();
+    }
+    T *out[4];
+    for (int i = 0; i < num_derived; ++i) {
+        out[i] = (*components)[num_inputs + i].data();
+    }
+
+    parallel_for_chunks(0, (*components)[0].size(), 1 << 14,
+        [&](int chunk_begin, int chunk_end, int) {
+            switch (type) {
+            case Results::Dataset::Type::Vector:
+                for (int n = chunk_begin; n < chunk_end; ++n) {
+                    double x = in[0][n], y = in[1][n], z = in[2][n];
+                    out[0][n] = sqrt(x * x + y * y + z * z);
+                }
+                break;
+            case Results::Dataset::Type::ComplexVector:
+                for (int n = chunk_begin; n < chunk_end; ++n) {
+                    double sum = 0;
+                    for (int i = 0; i < 6; ++i) {
+                        sum += double(in[i][n]) * double(in[i][n]);
+                    }
+                    out[0][n] = sqrt(sum);
+                }
+                break;
+            case Results::Dataset::Type::Matrix:
+                for (int n = chunk_begin; n < chunk_end; ++n) {
+                    Matrix m;
+                    m.cols[0].x = in[0][n];
+                    m.cols[1].y = in[1][n];
+                    m.cols[2].z = in[2][n];
+                    m.cols[0].y = m.cols[1].x = in[3][n];
+                    m.cols[1].z = m.cols[2].y = in[4][n];
+                    m.cols[2].x = m.cols[0].z = in[5][n];
+                    out[0][n] = von_mises_stress(m);
+                    double s1, s2, s3;
+                    principal_stresses(m, &s1, &s2, &s3);
+                    out[1][n] = s1;
+                    out[2][n] = s2;
+                    out[3][n] = s3;
+                }
+                break;
+            default: assert(false);
+            }
+        });
+}
+
+Results::Dataset::Values::Values(
+    Type type,
+    std::vector<ContiguousMap<NodeId, double> > &&components
+) : double_components(std::move(components)) {
+    assert(!double_components.empty());
+    add_derived_components(type, &double_components);
+}
+
+void Results::Dataset::Values::convert_to_single() {
+    for (ContiguousMap<NodeId, double> &component : double_components) {
+        ContiguousMap<NodeId, float> float_component(
+            component.key_begin(), component.key_end(), NAN);
+        std::copy(component.begin(), component.end(), float_component.begin());
+        float_components.push_back(std::move(float_component));
+        component = ContiguousMap<NodeId, double>(component.key_begin());
+    }
+    double_components.clear();
+}
+
+Matrix Results::Dataset::Values::matrix(NodeId node_id) const {
+    Matrix m;
+    m.cols[0].x = component(0, node_id);
+    m.cols[1].y = component(1, node_id);
+    m.cols[2].z = component(2, node_id);
+    m.cols[0].y = m.cols[1].x = component(3, node_id);
+    m.cols[1].z = m.cols[2].y = component(4, node_id);
+    m.cols[2].x = m.cols[0].z = component(5, node_id);
+    return m;
+}
+
+int subvariable_component(SubVariable subvar) {
+    int i;
     switch (subvar) {
-    case SubVariable::ScalarValue:
-        return (*node_scalar)[node_id];
-    case SubVariable::VectorMagnitude:
-        return (*node_vector)[node_id].magnitude();
-    case SubVariable::VectorX:
-        return (*node_vector)[node_id].x;
-    case SubVariable::VectorY:
-        return (*node_vector)[node_id].y;
-    case SubVariable::VectorZ:
-        return (*node_vector)[node_id].z;
-    case SubVariable::ComplexVectorMagnitude:
-        return (*node_complex_vector)[node_id].magnitude();
-    case SubVariable::MatrixVonMisesStress:
-        return von_mises_stress((*node_matrix)[node_id]);
-    case SubVariable::MatrixXX:
-        return (*node_matrix)[node_id].cols[0].x;
-    case SubVariable::MatrixYY:
-        return (*node_matrix)[node_id].cols[1].y;
-    case SubVariable::MatrixZZ:
-        return (*node_matrix)[node_id].cols[2].z;
-    case SubVariable::MatrixXY:
-        return (*node_matrix)[node_id].cols[0].y;
-    case SubVariable::MatrixYZ:
-        return (*node_matrix)[node_id].cols[1].z;
-    case SubVariable::MatrixZX:
-        return (*node_matrix)[node_id].cols[2].x;
-    default: assert(false);
-    }
-}
-
-void result_var_from_frd_analysis(
+    case SubVariable::ScalarValue: i = 0; break;
+    case SubVariable::VectorMagnitude: i = 3; break;
+    case SubVariable::VectorX: i = 0; break;
+    case SubVariable::VectorY: i = 1; break;
+    case SubVariable::VectorZ: i = 2; break;
+    case SubVariable::ComplexVectorMagnitude: i = 6; break;
+    case SubVariable::MatrixVonMisesStress: i = 6; break;
+    case SubVariable::MatrixMaxPrincipal: i = 7; break;
+    case SubVariable::MatrixMidPrincipal: i = 8; break;
+    case SubVariable::MatrixMinPrincipal: i = 9; break;
+    case SubVariable::MatrixXX: i = 0; break;
+    case SubVariable::MatrixYY: i = 1; break;
+    case SubVariable::MatrixZZ: i = 2; break;
+    case SubVariable::MatrixXY: i = 3; break;
+    case SubVariable::MatrixYZ: i = 4; break;
+    case SubVariable::MatrixZX: i = 5; break;
+    default:
+        assert(false);
+        throw std::logic_error("unknown subvariable");
+    }
+    return i;
+}
+
+int Results::Dataset::Values::subvariable_component(
+    SubVariable subvar
+) const {
+    int i = os2cx::subvariable_component(subvar);
+    assert(i < num_components());
+    return i;
+}
+
+size_t Results::Dataset::Values::memory_size() const {
+    size_t size = 0;
+    for (const ContiguousMap<NodeId, double> &component : double_components) {
+        size += component.size() * sizeof(double);
+    }
+    for (const ContiguousMap<NodeId, float> &component : float_components) {
+        size += component.size() * sizeof(float);
+    }
+    return size;
+}
+
+template<class T>
+static Results::Dataset::Stats stats_for_components(
+    const std::vector<ContiguousMap<NodeId, T> > &components
+) {
+    Results::Dataset::Stats stats;
+    for (const ContiguousMap<NodeId, T> &component : components) {
+        /* Each chunk gets its own sketch; merging them in chunk order keeps
+        the result independent of how the threads are scheduled */
+        const T *data = component.data();
+        int num_chunks = parallel_num_chunks(0, component.size(), 1 << 16);
+        std::vector<QuantileSketch<double> > sketches(num_chunks);
+        std::vector<double> mins(num_chunks), maxs(num_chunks);
+        parallel_for_chunks(0, component.size(), 1 << 16,
+            [&](int chunk_begin, int chunk_end, int chunk) {
+                double min = std::numeric_limits<double>::infinity();
+                double max = -std::numeric_limits<double>::infinity();
+                for (int i = chunk_begin; i < chunk_end; ++i) {
+                    T value = data[i];
+                    if (isnan(value)) continue;
+                    if (value < min) min = value;
+                    if (value > max) max = value;
+                    sketches[chunk].insert(value);
+                }
+                mins[chunk] = min;
+                maxs[chunk] = max;
+            });
+
+        double min = *std::min_element(mins.begin(), mins.end());
+        double max = *std::max_element(maxs.begin(), maxs.end());
+        if (min > max) {
+            min = max = NAN;
+        }
+        stats.component_min.push_back(min);
+        stats.component_max.push_back(max);
+
+        for (int chunk = 1; chunk < num_chunks; ++chunk) {
+            sketches[0].merge(sketches[chunk]);
+        }
+        stats.component_sketches.push_back(std::move(sketches[0]));
+    }
+    return stats;
+}
+
+Results::Dataset::Stats Results::Dataset::Values::compute_stats() const {
+    if (double_components.empty()) {
+        return stats_for_components(float_components);
+    }
+    return stats_for_components(double_components);
+}
+
+std::shared_ptr<const Results::Dataset::Values>
+        Results::Dataset::values() const {
+    if (cache) {
+        return cache->get(frd_analysis_index, frd_entity_index, precision);
+    }
+    assert(loaded);
+    return loaded;
+}
+
+std::shared_ptr<const Results::Dataset::Stats>
+        Results::Dataset::stats() const {
+    if (cache) {
+        return cache->stats(frd_analysis_index, frd_entity_index, precision);
+    }
+    assert(loaded);
+    return loaded->stats;
+}
+
+static bool frd_analysis_is_vector(const FrdAnalysis &fa) {
+    return fa.entities.size() == 4 &&
+        fa.entities[0].ind1 == 1 &&
+        fa.entities[1].ind1 == 2 &&
+        fa.entities[2].ind1 == 3 &&
+        fa.entities[3].exist == FrdEntity::Exist::ShouldCalculate;
+}
+
+static bool frd_analysis_is_complex_vector(const FrdAnalysis &fa) {
+    return fa.entities.size() == 6 &&
+        fa.entities[0].ind1 == 1 && fa.entities[0].name == "MAG1" &&
+        fa.entities[1].ind1 == 2 && fa.entities[1].name == "MAG2" &&
+        fa.entities[2].ind1 == 3 && fa.entities[2].name == "MAG3" &&
+        fa.entities[3].ind1 == 4 && fa.entities[3].name == "PHA1" &&
+        fa.entities[4].ind1 == 5 && fa.entities[4].name == "PHA2" &&
+        fa.entities[5].ind1 == 6 && fa.entities[5].name == "PHA3";
+}
+
+static bool frd_analysis_is_matrix(const FrdAnalysis &fa) {
+    return fa.entities.size() == 6 &&
+        fa.entities[0].ind1 == 1 && fa.entities[0].ind2 == 1 &&
+        fa.entities[1].ind1 == 2 && fa.entities[1].ind2 == 2 &&
+        fa.entities[2].ind1 == 3 && fa.entities[2].ind2 == 3 &&
+        fa.entities[3].ind1 == 1 && fa.entities[3].ind2 == 2 &&
+        fa.entities[4].ind1 == 2 && fa.entities[4].ind2 == 3 &&
+        fa.entities[5].ind1 == 3 && fa.entities[5].ind2 == 1;
+}
+
+/* Decides which datasets 'fa' holds, based on its header alone, and calls
+'func(name, type, entity_index)' for each one. 'entity_index' is the entity
+that the dataset comes from, or -1 if the dataset combines all of them. */
+template<class Func>
+static void datasets_for_frd_analysis(
     const FrdAnalysis &fa,
-    std::map<std::string, Results::Dataset> *datasets
+    const Func &func
 ) {
     if (fa.name == "CONTACT") {
         /* CONTACT dataset is formatted like a matrix, but actually it's many
         separate scalars. Handle it as a special case. */
-        for (const auto &entity : fa.entities) {
-            Results::Dataset *dataset = &(*datasets)[entity.name];
-            dataset->node_scalar.reset(
-                new ContiguousMap<NodeId, double>(entity.data));
+        for (int i = 0; i < static_cast<int>(fa.entities.size()); ++i) {
+            func(fa.entities[i].name, Results::Dataset::Type::Scalar, i);
         }
-
     } else if (fa.entities.size() == 1) {
-        (*datasets)[fa.name].node_scalar.reset(
-            new ContiguousMap<NodeId, double>(fa.entities[0].data));
-
-    } else if (fa.entities.size() == 4 &&
-            fa.entities[0].ind1 == 1 &&
-            fa.entities[1].ind1 == 2 &&
-            fa.entities[2].ind1 == 3 &&
-            fa.entities[3].exist == FrdEntity::Exist::ShouldCalculate) {
-        const ContiguousMap<NodeId, double> &dx = fa.entities[0].data;
-        const ContiguousMap<NodeId, double> &dy = fa.entities[1].data;
-        const ContiguousMap<NodeId, double> &dz = fa.entities[2].data;
-        ContiguousMap<NodeId, Vector> dxyz(
-            dx.key_begin(), dx.key_end(), Vector(NAN, NAN, NAN));
-        for (NodeId node = dx.key_begin(); node != dx.key_end(); ++node) {
-            dxyz[node] = Vector(dx[node], dy[node], dz[node]);
+        func(fa.name, Results::Dataset::Type::Scalar, 0);
+    } else if (frd_analysis_is_vector(fa)) {
+        func(fa.name, Results::Dataset::Type::Vector, -1);
+    } else if (frd_analysis_is_complex_vector(fa)) {
+        func(fa.name, Results::Dataset::Type::ComplexVector, -1);
+    } else if (frd_analysis_is_matrix(fa)) {
+        func(fa.name, Results::Dataset::Type::Matrix, -1);
+    } else {
+        assert(false);
+    }
+}
+
+/* Builds the values of one of the datasets that datasets_for_frd_analysis()
+found in 'fa', once 'fa' has its entities' data filled in. The entities' data
+is moved out of 'fa' (or converted in place) rather than copied. The values'
+stats are only computed if 'compute_stats' is true. */
+static std::unique_ptr<Results::Dataset::Values> values_from_frd_analysis(
+    FrdAnalysis *fa,
+    Results::Dataset::Type type,
+    int entity_index,
+    Results::Precision precision,
+    bool compute_stats
+) {
+    std::vector<ContiguousMap<NodeId, double> > components;
+    if (type == Results::Dataset::Type::Scalar) {
+        components.push_back(std::move(fa->entities[entity_index].data));
+
+    } else if (type == Results::Dataset::Type::Vector) {
+        for (int i = 0; i < 3; ++i) {
+            components.push_back(std::move(fa->entities[i].data));
         }
-        Results::Dataset *dataset = &(*datasets)[fa.name];
-        dataset->node_vector.reset(
-            new ContiguousMap<NodeId, Vector>(std::move(dxyz)));
-
-    } else if (fa.entities.size() == 6 &&
-            fa.entities[0].ind1 == 1 && fa.entities[0].name == "MAG1" &&
-            fa.entities[1].ind1 == 2 && fa.entities[1].name == "MAG2" &&
-            fa.entities[2].ind1 == 3 && fa.entities[2].name == "MAG3" &&
-            fa.entities[3].ind1 == 4 && fa.entities[3].name == "PHA1" &&
-            fa.entities[4].ind1 == 5 && fa.entities[4].name == "PHA2" &&
-            fa.entities[5].ind1 == 6 && fa.entities[5].name == "PHA3") {
-        const ContiguousMap<NodeId, double> dxm = fa.entities[0].data;
-        const ContiguousMap<NodeId, double> dym = fa.entities[1].data;
-        const ContiguousMap<NodeId, double> dzm = fa.entities[2].data;
-        const ContiguousMap<NodeId, double> dxp = fa.entities[3].data;
-        const ContiguousMap<NodeId, double> dyp = fa.entities[4].data;
-        const ContiguousMap<NodeId, double> dzp = fa.entities[5].data;
-        ComplexVector nan_vector(
-            std::complex<double>(NAN, NAN),
-            std::complex<double>(NAN, NAN),
-            std::complex<double>(NAN, NAN));
-        ContiguousMap<NodeId, ComplexVector> dxyz(
-            dxm.key_begin(), dxm.key_end(), nan_vector);
-        for (NodeId node = dxm.key_begin(); node != dxm.key_end(); ++node) {
-            dxyz[node] = ComplexVector(
-                std::polar(dxm[node], dxp[node] / 360.0 * (2*M_PI)),
-                std::polar(dym[node], dyp[node] / 360.0 * (2*M_PI)),
-                std::polar(dzm[node], dzp[node] / 360.0 * (2*M_PI)));
+
+    } else if (type == Results::Dataset::Type::ComplexVector) {
+        /* The FRD file has magnitudes and phases (in degrees); turn them into
+        real and imaginary parts in place */
+        for (int i = 0; i < 3; ++i) {
+            ContiguousMap<NodeId, double> &mag = fa->entities[i].data;
+            ContiguousMap<NodeId, double> &pha = fa->entities[i + 3].data;
+            for (NodeId node = mag.key_begin(); node != mag.key_end(); ++node) {
+                std::complex<double> c =
+                    std::polar(mag[node], pha[node] / 360.0 * (2*M_PI));
+                mag[node] = c.real();
+                pha[node] = c.imag();
+            }
+        }
+        for (int i = 0; i < 6; ++i) {
+            components.push_back(std::move(fa->entities[i].data));
         }
-        Results::Dataset *dataset = &(*datasets)[fa.name];
-        dataset->node_complex_vector.reset(
-            new ContiguousMap<NodeId, ComplexVector>(std::move(dxyz)));
-
-    } else if (fa.entities.size() == 6 &&
-            fa.entities[0].ind1 == 1 && fa.entities[0].ind2 == 1 &&
-            fa.entities[1].ind1 == 2 && fa.entities[1].ind2 == 2 &&
-            fa.entities[2].ind1 == 3 && fa.entities[2].ind2 == 3 &&
-            fa.entities[3].ind1 == 1 && fa.entities[3].ind2 == 2 &&
-            fa.entities[4].ind1 == 2 && fa.entities[4].ind2 == 3 &&
-            fa.entities[5].ind1 == 3 && fa.entities[5].ind2 == 1) {
-        const ContiguousMap<NodeId, double> sxx = fa.entities[0].data;
-        const ContiguousMap<NodeId, double> syy = fa.entities[1].data;
-        const ContiguousMap<NodeId, double> szz = fa.entities[2].data;
-        const ContiguousMap<NodeId, double> sxy = fa.entities[3].data;
-        const ContiguousMap<NodeId, double> syz = fa.entities[4].data;
-        const ContiguousMap<NodeId, double> szx = fa.entities[5].data;
-        Matrix nan_matrix;
-        nan_matrix.cols[0] = nan_matrix.cols[1] = nan_matrix.cols[2] =
-            Vector(NAN, NAN, NAN);
-        ContiguousMap<NodeId, Matrix> sxyz(
-            sxx.key_begin(), sxx.key_end(), nan_matrix);
-        for (NodeId node = sxx.key_begin(); node != sxx.key_end(); ++node) {
-            Matrix m;
-            m.cols[0].x = sxx[node];
-            m.cols[1].y = syy[node];
-            m.cols[2].z = szz[node];
-            m.cols[0].y = m.cols[1].x = sxy[node];
-            m.cols[1].z = m.cols[2].y = syz[node];
-            m.cols[2].x = m.cols[0].z = szx[node];
-            sxyz[node] = m;
+
+    } else if (type == Results::Dataset::Type::Matrix) {
+        for (int i = 0; i < 6; ++i) {
+            components.push_back(std::move(fa->entities[i].data));
         }
-        Results::Dataset *dataset = &(*datasets)[fa.name];
-        dataset->node_matrix.reset(
-            new ContiguousMap<NodeId, Matrix>(std::move(sxyz)));
 
     } else {
         assert(false);
     }
+
+    /* The derived components and the statistics are computed from the
+    doubles, so single precision only rounds what's stored */
+    std::unique_ptr<Results::Dataset::Values> values(
+        new Results::Dataset::Values(type, std::move(components)));
+    if (compute_stats) {
+        values->stats = std::make_shared<Results::Dataset::Stats>(
+            values->compute_stats());
+    }
+    if (precision == Results::Precision::Single) {
+        values->convert_to_single();
+    }
+    return values;
+}
+
+/* Used in place of a dataset's values if they couldn't be loaded; 'error' says
+why */
+static std::unique_ptr<Results::Dataset::Values> nan_values(
+    Results::Dataset::Type type,
+    NodeId node_begin,
+    NodeId node_end,
+    Results::Precision precision,
+    bool compute_stats,
+    const std::string &error
+) {
+    FrdAnalysis fa;
+    int num_entities;
+    switch (type) {
+    case Results::Dataset::Type::Scalar: num_entities = 1; break;
+    case Results::Dataset::Type::Vector: num_entities = 3; break;
+    case Results::Dataset::Type::ComplexVector: num_entities = 6; break;
+    case Results::Dataset::Type::Matrix: num_entities = 6; break;
+    default:
+        assert(false);
+        throw std::logic_error("unknown dataset type");
+    }
+    fa.entities.resize(num_entities);
+    for (FrdEntity &entity : fa.entities) {
+        entity.data = ContiguousMap<NodeId, double>(node_begin, node_end, NAN);
+    }
+    std::unique_ptr<Results::Dataset::Values> values =
+        values_from_frd_analysis(&fa, type, 0, precision, compute_stats);
+    values->load_error = error;
+    return values;
+}
+
+ResultsCache::ResultsCache(
+    std::shared_ptr<const FrdFile> frd_file,
+    size_t memory_limit
+) :
+    frd_file(frd_file),
+    memory_limit(memory_limit),
+    entries_memory(0),
+    stopping(false)
+{ }
+
+ResultsCache::~ResultsCache() {
+    stopping = true;
+    if (stats_thread.joinable()) {
+        stats_thread.join();
+    }
+}
+
+std::unique_ptr<Results::Dataset::Values> ResultsCache::load(
+    Key key,
+    Results::Precision precision,
+    bool compute_stats
+) const {
+    const FrdAnalysis &header = frd_file->analyses()[key.first];
+    Results::Dataset::Type type = Results::Dataset::Type::Scalar;
+    datasets_for_frd_analysis(header,
+        [&](const std::string &, Results::Dataset::Type t, int entity_index) {
+            if (entity_index == key.second) {
+                type = t;
+            }
+        });
+    try {
+        FrdAnalysis fa = frd_file->load_analysis(key.first);
+        return values_from_frd_analysis(
+            &fa, type, key.second, precision, compute_stats);
+    } catch (const CalculixFrdFileReadError &error) {
+        /* By now the results are already being displayed, so rather than
+        failing, the values show up as missing, and carry the error for the
+        caller to report */
+        return nan_values(
+            type, frd_file->node_begin(), frd_file->node_end(), precision,
+            compute_stats, error.what());
+    }
+}
+
+std::shared_ptr<const Results::Dataset::Values> ResultsCache::get(
+    int frd_analysis_index,
+    int frd_entity_index,
+    Results::Precision precision
+) {
+    Key key(frd_analysis_index, frd_entity_index);
+    bool have_stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries_by_key.find(key);
+        if (it != entries_by_key.end()) {
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->values;
+        }
+        have_stats = stats_by_key.count(key) != 0;
+    }
+
+    /* Load the values without holding the lock, so other threads can use the
+    cache in the meantime. If two threads load the same values at once, the
+    second one to finish just uses the first one's copy. */
+    std::shared_ptr<const Results::Dataset::Values> values =
+        load(key, precision, !have_stats);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (values->stats) {
+        stats_by_key.insert(std::make_pair(key, values->stats));
+    }
+    auto it = entries_by_key.find(key);
+    if (it != entries_by_key.end()) {
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->values;
+    }
+    Entry entry;
+    entry.key = key;
+    entry.values = values;
+    entries.push_front(std::move(entry));
+    entries_by_key[key] = entries.begin();
+    entries_memory += values->memory_size();
+
+    /* Evict the least recently used values, but never the ones we're about to
+    return */
+    while (entries_memory > memory_limit && entries.size() > 1) {
+        const Entry &victim = entries.back();
+        entries_memory -= victim.values->memory_size();
+        entries_by_key.erase(victim.key);
+        entries.pop_back();
+    }
+    return values;
+}
+
+std::shared_ptr<const Results::Dataset::Stats> ResultsCache::stats(
+    int frd_analysis_index,
+    int frd_entity_index,
+    Results::Precision precision
+) {
+    Key key(frd_analysis_index, frd_entity_index);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = stats_by_key.find(key);
+        if (it != stats_by_key.end()) {
+            return it->second;
+        }
+    }
+    /* Loading the values always records their stats */
+    get(frd_analysis_index, frd_entity_index, precision);
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats_by_key.at(key);
+}
+
+void ResultsCache::start_computing_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!stats_thread.joinable()) {
+        stats_thread = std::thread(&ResultsCache::compute_stats_thread, this);
+    }
+}
+
+void ResultsCache::compute_stats_thread() {
+    const std::vector<FrdAnalysis> &headers = frd_file->analyses();
+    for (int i = 0; i < static_cast<int>(headers.size()); ++i) {
+        std::vector<int> entity_indices;
+        datasets_for_frd_analysis(headers[i],
+            [&](const std::string &, Results::Dataset::Type, int entity_index) {
+                entity_indices.push_back(entity_index);
+            });
+        for (int entity_index : entity_indices) {
+            if (stopping) {
+                return;
+            }
+            Key key(i, entity_index);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stats_by_key.count(key) != 0) {
+                    continue;
+                }
+            }
+            /* The stats don't depend on the precision, and the values are
+            thrown away right after, so there's no point converting them */
+            std::shared_ptr<const Results::Dataset::Stats> stats =
+                load(key, Results::Precision::Double, true)->stats;
+            std::lock_guard<std::mutex> lock(mutex);
+            stats_by_key.insert(std::make_pair(key, stats));
+        }
+    }
+}
+
+size_t ResultsCache::memory_used() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries_memory;
 }
 
 bool same_datasets(
@@ -153,13 +542,19 @@ bool same_datasets(
     return true;
 }
 
-void results_from_frd_analyses(
+/* Groups the FrdAnalysis records into steps and results. Each dataset is passed
+to 'make_dataset(name, analysis_index, type, entity_index, dataset)' to fill in
+its values, or how to load them. */
+template<class MakeDataset>
+static void results_from_frd_headers(
     const std::vector<FrdAnalysis> &frd_analyses,
+    const MakeDataset &make_dataset,
     Results *results_out
 ) {
     /* Collect related FrdAnalysis records into a single Result::Step */
     std::vector<std::pair<const FrdAnalysis *, Results::Result::Step> > steps;
-    for (const FrdAnalysis &fa : frd_analyses) {
+    for (int i = 0; i < static_cast<int>(frd_analyses.size()); ++i) {
+        const FrdAnalysis &fa = frd_analyses[i];
         bool combine;
         if (steps.empty()) {
             combine = false;
@@ -178,7 +573,16 @@ void results_from_frd_analyses(
             steps.push_back(std::make_pair(&fa, std::move(step)));
         }
         Results::Result::Step *step = &steps.back().second;
-        result_var_from_frd_analysis(fa, &step->datasets);
+        datasets_for_frd_analysis(fa,
+            [&](const std::string &name,
+                    Results::Dataset::Type type,
+                    int entity_index) {
+                Results::Dataset *dataset = &step->datasets[name];
+                dataset->type = type;
+                dataset->frd_analysis_index = i;
+                dataset->frd_entity_index = entity_index;
+                make_dataset(name, i, type, entity_index, dataset);
+            });
     }
 
     /* Collect related Result::Step records into a single Result */
@@ -222,6 +626,62 @@ void results_from_frd_analyses(
     }
 }
 
+void results_from_frd_analyses(
+    std::vector<FrdAnalysis> frd_analyses,
+    Results::Precision precision,
+    Results *results_out
+) {
+    /* Grouping only looks at the headers, so it's fine for 'make_dataset' to
+    move the entities' data out from under it */
+    results_from_frd_headers(frd_analyses,
+        [&](const std::string &,
+                int analysis_index,
+                Results::Dataset::Type type,
+                int entity_index,
+                Results::Dataset *dataset) {
+            dataset->precision = precision;
+            dataset->loaded = values_from_frd_analysis(
+                &frd_analyses[analysis_index], type, entity_index, precision,
+                true);
+        },
+        results_out);
+}
+
+void results_from_frd_file(
+    std::shared_ptr<const FrdFile> frd_file,
+    size_t memory_limit,
+    Results::Precision precision,
+    const std::set<std::string> &double_datasets,
+    Results *results_out
+) {
+    std::shared_ptr<ResultsCache> cache(
+        new ResultsCache(frd_file, memory_limit));
+    results_from_frd_headers(frd_file->analyses(),
+        [&](const std::string &name,
+                int,
+                Results::Dataset::Type,
+                int,
+                Results::Dataset *dataset) {
+            dataset->precision = double_datasets.count(name)
+                ? Results::Precision::Double
+                : precision;
+            dataset->cache = cache;
+        },
+        results_out);
+}
+
+void results_start_computing_stats(const Results &results) {
+    for (const Results::Result &result : results.results) {
+        for (const Results::Result::Step &step : result.steps) {
+            for (const auto &pair : step.datasets) {
+                if (pair.second.cache) {
+                    pair.second.cache->start_computing_stats();
+                }
+            }
+        }
+    }
+}
+
 const std::map<std::string, UnitType> dataset_name_to_unit_type = {
     {"DISP", UnitType::Length},
     {"DISPI", UnitType::Length},
@@ -1,9 +1,14 @@
 #ifndef OS2CX_RESULT_HPP_
 #define OS2CX_RESULT_HPP_
 
+#include <atomic>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 
 #include "calculix_frd_read.hpp"
 #include "mesh.hpp"
@@ -16,39 +21,167 @@ enum class SubVariable {
     VectorMagnitude, VectorX, VectorY, VectorZ,
     ComplexVectorMagnitude,
     MatrixVonMisesStress,
+    MatrixMaxPrincipal, MatrixMidPrincipal, MatrixMinPrincipal,
     MatrixXX, MatrixYY, MatrixZZ, MatrixXY, MatrixYZ, MatrixZX
 };
 
+/* Returns which component of a dataset's values (see Results::Dataset::Values)
+holds 'subvar'. Loops over many nodes should look this up once, and then call
+Values::component() for each node. */
+int subvariable_component(SubVariable subvar);
+
+class ResultsCache;
+
 class Results {
 public:
+    enum class Precision { Double, Single };
+
     class Dataset {
     public:
-        NodeId node_begin() const {
-            if (node_scalar) return node_scalar->key_begin();
-            if (node_vector) return node_vector->key_begin();
-            if (node_complex_vector) return node_complex_vector->key_begin();
-            if (node_matrix) return node_matrix->key_begin();
-            assert(false);
-        }
-        NodeId node_end() const {
-            if (node_scalar) return node_scalar->key_end();
-            if (node_vector) return node_vector->key_end();
-            if (node_complex_vector) return node_complex_vector->key_end();
-            if (node_matrix) return node_matrix->key_end();
-            assert(false);
-        }
-
-        /* Exactly one of these will be non-null */
-        std::unique_ptr<ContiguousMap<NodeId, double> > node_scalar;
-        std::unique_ptr<ContiguousMap<NodeId, Vector> > node_vector;
-        std::unique_ptr<ContiguousMap<NodeId, ComplexVector> >
-            node_complex_vector;
-        std::unique_ptr<ContiguousMap<NodeId, Matrix> > node_matrix;
-
-        double subvariable_value(
-            SubVariable subvar,
-            NodeId node_id
-        ) const;
+        enum class Type { Scalar, Vector, ComplexVector, Matrix };
+
+        /* Summary statistics of each of a dataset's components (including the
+        derived ones), so that the GUI can choose scales without going over
+        every node of every step. They're computed as each dataset is loaded,
+        so they never need a pass of their own over the values. */
+        class Stats {
+        public:
+            /* The smallest and largest non-NaN value of each component; both
+            are NaN if every value is NaN */
+            std::vector<double> component_min, component_max;
+
+            /* The distribution of each component's non-NaN values. Sketches
+            from several steps can be merged, to get percentiles over all of
+            them. */
+            std::vector<QuantileSketch<double> > component_sketches;
+        };
+
+        /* The components are stored as separate arrays, in the same order as
+        the FRD entities they come from, so that loading a dataset can take
+        over the entities' arrays instead of copying them:
+          Scalar: the value
+          Vector: x, y, z
+          ComplexVector: real parts of x, y, z, then imaginary parts
+          Matrix: xx, yy, zz, xy, yz, zx
+        The constructor then appends the derived components, computed once
+        for every node, so that coloring and measuring don't redo the math for
+        every access:
+          Vector: magnitude
+          ComplexVector: magnitude
+          Matrix: von Mises stress, then the principal stresses in decreasing
+            order
+        With Precision::Single the components are stored as floats, which
+        halves the memory used. */
+        class Values {
+        public:
+            Values(
+                Type type,
+                std::vector<ContiguousMap<NodeId, double> > &&components);
+
+            /* Switches to Precision::Single, freeing each double array as
+            soon as it's converted */
+            void convert_to_single();
+
+            NodeId node_begin() const {
+                return double_components.empty()
+                    ? float_components[0].key_begin()
+                    : double_components[0].key_begin();
+            }
+            NodeId node_end() const {
+                return double_components.empty()
+                    ? float_components[0].key_end()
+                    : double_components[0].key_end();
+            }
+
+            double scalar(NodeId node_id) const {
+                return component(0, node_id);
+            }
+            Vector vector(NodeId node_id) const {
+                return Vector(
+                    component(0, node_id),
+                    component(1, node_id),
+                    component(2, node_id));
+            }
+            ComplexVector complex_vector(NodeId node_id) const {
+                return ComplexVector(
+                    std::complex<double>(
+                        component(0, node_id), component(3, node_id)),
+                    std::complex<double>(
+                        component(1, node_id), component(4, node_id)),
+                    std::complex<double>(
+                        component(2, node_id), component(5, node_id)));
+            }
+            Matrix matrix(NodeId node_id) const;
+
+            /* Like os2cx::subvariable_component(), but also checks that the
+            values actually have that component */
+            int subvariable_component(SubVariable subvar) const;
+
+            double component(int i, NodeId node_id) const {
+                if (double_components.empty()) {
+                    return float_components[i][node_id];
+                }
+                return double_components[i][node_id];
+            }
+
+            double subvariable_value(
+                SubVariable subvar,
+                NodeId node_id
+            ) const {
+                return component(subvariable_component(subvar), node_id);
+            }
+
+            /* Approximate number of bytes used by the values */
+            size_t memory_size() const;
+
+            Stats compute_stats() const;
+
+            /* If the values couldn't be read from the FRD file, they're all
+            NaN, and this says why; otherwise it's empty */
+            std::string load_error;
+
+            /* The statistics of the values as they were read, before any
+            conversion to single precision; null if they weren't computed
+            (because the cache already had them) */
+            std::shared_ptr<const Stats> stats;
+
+        private:
+            int num_components() const {
+                return double_components.empty()
+                    ? float_components.size()
+                    : double_components.size();
+            }
+
+            /* Exactly one of these is non-empty */
+            std::vector<ContiguousMap<NodeId, double> > double_components;
+            std::vector<ContiguousMap<NodeId, float> > float_components;
+        };
+
+        Type type;
+
+        /* How the values are stored once loaded */
+        Precision precision;
+
+        /* Returns the dataset's values, loading them from the FRD file first
+        if they aren't already in memory. The returned values stay valid for as
+        long as the caller holds on to them, even if the cache evicts them in
+        the meantime; so callers should fetch them once, outside of any
+        per-node loop, and drop them when they're done. */
+        std::shared_ptr<const Values> values() const;
+
+        /* Returns the statistics of the dataset's values. These are kept
+        after the values themselves are evicted, so only the first call may
+        have to load the values. */
+        std::shared_ptr<const Stats> stats() const;
+
+        /* Datasets either have their values already 'loaded', or are loaded
+        on demand from 'cache'. In the latter case, 'frd_entity_index' is the
+        single entity of the FRD analysis that the dataset holds, or -1 if the
+        dataset combines all of its entities. */
+        std::shared_ptr<const Values> loaded;
+        std::shared_ptr<ResultsCache> cache;
+        int frd_analysis_index;
+        int frd_entity_index;
     };
 
     class Result {
@@ -79,10 +212,98 @@ public:
     std::vector<Result> results;
 };
 
+/* ResultsCache loads datasets from an FRD file the first time they're needed,
+and keeps the most recently used ones in memory, up to about 'memory_limit'
+bytes. Values that callers are still holding on to stay alive even if they're
+evicted, so the limit can be exceeded temporarily. It's safe to use from
+several threads at once. */
+class ResultsCache {
+public:
+    ResultsCache(
+        std::shared_ptr<const FrdFile> frd_file,
+        size_t memory_limit);
+    ~ResultsCache();
+
+    /* Every dataset should always ask for the same 'precision', since the
+    cache only keeps one copy of each */
+    std::shared_ptr<const Results::Dataset::Values> get(
+        int frd_analysis_index,
+        int frd_entity_index,
+        Results::Precision precision);
+
+    /* See Results::Dataset::stats() */
+    std::shared_ptr<const Results::Dataset::Stats> stats(
+        int frd_analysis_index,
+        int frd_entity_index,
+        Results::Precision precision);
+
+    /* Starts a single background thread that goes through the datasets in
+    the FRD file one at a time, and computes the stats of each one that
+    doesn't have them yet, so that they're usually ready by the time they're
+    asked for. The values it loads aren't put in the cache, so it doesn't
+    push out anything that's in use. The thread stops early if the cache is
+    destroyed. Calling this again does nothing. */
+    void start_computing_stats();
+
+    size_t memory_used() const;
+
+private:
+    typedef std::pair<int, int> Key;
+
+    /* Loads the values for 'key' from the FRD file; their stats are only
+    computed if 'compute_stats' is true */
+    std::unique_ptr<Results::Dataset::Values> load(
+        Key key,
+        Results::Precision precision,
+        bool compute_stats) const;
+
+    void compute_stats_thread();
+    class Entry {
+    public:
+        Key key;
+        std::shared_ptr<const Results::Dataset::Values> values;
+    };
+
+    std::shared_ptr<const FrdFile> frd_file;
+    size_t memory_limit;
+
+    mutable std::mutex mutex;
+    /* Most recently used first */
+    std::list<Entry> entries;
+    std::map<Key, std::list<Entry>::iterator> entries_by_key;
+    size_t entries_memory;
+    /* Never evicted; they're much smaller than the values */
+    std::map<Key, std::shared_ptr<const Results::Dataset::Stats> > stats_by_key;
+
+    std::thread stats_thread;
+    std::atomic<bool> stopping;
+};
+
+/* Builds results whose values are all loaded up front from 'frd_analyses'. The
+entities' data is moved into the results rather than copied, so pass the
+analyses with std::move() if they aren't needed afterwards. */
 void results_from_frd_analyses(
-    const std::vector<FrdAnalysis> &frd_analyses,
+    std::vector<FrdAnalysis> frd_analyses,
+    Results::Precision precision,
     Results *results_out);
 
+/* Builds results from the headers of 'frd_file' alone; each dataset's values
+are only loaded from the file when they're first used. Single precision is
+enough for display, but the datasets named in 'double_datasets' are always
+stored as doubles, since numbers computed from them (such as measurements) are
+shown to the user in full. */
+void results_from_frd_file(
+    std::shared_ptr<const FrdFile> frd_file,
+    size_t memory_limit,
+    Results::Precision precision,
+    const std::set<std::string> &double_datasets,
+    Results *results_out);
+
+/* Calls ResultsCache::start_computing_stats() for the datasets in 'results'
+that are loaded on demand. Datasets whose values were loaded up front already
+have their stats. */
+void results_start_computing_stats(const Results &results);
+
 UnitType guess_unit_type_for_dataset(const std::string &name);
 
 } /* namespace os2cx */
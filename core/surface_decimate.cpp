@@ -0,0 +1,166 @@
+#include "surface_decimate.hpp"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <unordered_map>
+
+namespace os2cx {
+
+/* The sum of the squared distances from a point to some weighted planes, as a
+symmetric 4x4 matrix. Only the upper triangle is stored. */
+class Quadric {
+public:
+    Quadric() {
+        std::fill(coeffs, coeffs + 10, 0.0);
+    }
+
+    /* 'normal' must be a unit vector */
+    void add_plane(Vector normal, Vector point, double weight) {
+        double v[4] = {normal.x, normal.y, normal.z, -normal.dot(point)};
+        int k = 0;
+        for (int i = 0; i < 4; ++i) {
+            for (int j = i; j < 4; ++j) {
+                coeffs[k++] += weight * v[i] * v[j];
+            }
+        }
+    }
+
+    double error(Vector point) const {
+        double v[4] = {point.x, point.y, point.z, 1};
+        double sum = 0;
+        int k = 0;
+        for (int i = 0; i < 4; ++i) {
+            for (int j = i; j < 4; ++j) {
+                sum += (i == j ? 1 : 2) * coeffs[k++] * v[i] * v[j];
+            }
+        }
+        return sum;
+    }
+
+private:
+    double coeffs[10];
+};
+
+void decimate_surface(
+    const std::vector<Point> &points,
+    const std::vector<int> &triangles,
+    int target_triangles,
+    std::vector<int> *triangles_out
+) {
+    int num_triangles = triangles.size() / 3;
+    if (num_triangles <= target_triangles) {
+        *triangles_out = triangles;
+        return;
+    }
+
+    /* Work relative to the corner of the bounding box, both to find the cells
+    and to keep the quadrics from losing precision far from the origin */
+    double inf = std::numeric_limits<double>::infinity();
+    Point lo(inf, inf, inf), hi(-inf, -inf, -inf);
+    for (int index : triangles) {
+        const Point &p = points[index];
+        lo = Point(std::min(lo.x, p.x), std::min(lo.y, p.y),
+            std::min(lo.z, p.z));
+        hi = Point(std::max(hi.x, p.x), std::max(hi.y, p.y),
+            std::max(hi.z, p.z));
+    }
+
+    /* A cell that the surface passes through holds about cell_size^2 of its
+    area, and there are about twice as many triangles as points */
+    double area = 0;
+    for (int t = 0; t < num_triangles; ++t) {
+        Vector a = points[triangles[3 * t + 1]] - points[triangles[3 * t]];
+        Vector b = points[triangles[3 * t + 2]] - points[triangles[3 * t]];
+        area += a.cross(b).magnitude() / 2;
+    }
+    double cell_size = sqrt(2 * area / std::max(target_triangles, 1));
+    /* Keys pack three 21-bit cell coordinates into one integer */
+    static const int max_cells_per_axis = 1 << 21;
+    double extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+    cell_size = std::max(cell_size, extent / (max_cells_per_axis - 1));
+    if (!(cell_size > 0)) {
+        *triangles_out = triangles;
+        return;
+    }
+
+    /* Assign the points to cells */
+    std::unordered_map<uint64_t, int> cells_by_key;
+    std::vector<int> point_cells(points.size(), -1);
+    for (int index : triangles) {
+        if (point_cells[index] != -1) {
+            continue;
+        }
+        Vector rel = points[index] - lo;
+        uint64_t key =
+            (uint64_t(rel.x / cell_size) << 42) |
+            (uint64_t(rel.y / cell_size) << 21) |
+            uint64_t(rel.z / cell_size);
+        auto it = cells_by_key.insert(
+            std::make_pair(key, static_cast<int>(cells_by_key.size()))).first;
+        point_cells[index] = it->second;
+    }
+
+    /* Each triangle's plane counts against the cells of all three corners,
+    weighted by its area */
+    std::vector<Quadric> quadrics(cells_by_key.size());
+    for (int t = 0; t < num_triangles; ++t) {
+        Vector p0 = points[triangles[3 * t]] - lo;
+        Vector p1 = points[triangles[3 * t + 1]] - lo;
+        Vector p2 = points[triangles[3 * t + 2]] - lo;
+        Vector cross = (p1 - p0).cross(p2 - p0);
+        double mag = cross.magnitude();
+        if (mag == 0) {
+            continue;
+        }
+        for (int i = 0; i < 3; ++i) {
+            quadrics[point_cells[triangles[3 * t + i]]].add_plane(
+                cross / mag, p0, mag / 2);
+        }
+    }
+
+    /* Each cell keeps its point with the least error */
+    std::vector<int> cell_points(quadrics.size(), -1);
+    std::vector<double> cell_errors(quadrics.size(), inf);
+    for (int index = 0; index < static_cast<int>(points.size()); ++index) {
+        int cell = point_cells[index];
+        if (cell == -1) {
+            continue;
+        }
+        double error = quadrics[cell].error(points[index] - lo);
+        if (error < cell_errors[cell] || cell_points[cell] == -1) {
+            cell_errors[cell] = error;
+            cell_points[cell] = index;
+        }
+    }
+
+    /* Several triangles often collapse onto the same three cells. Rotate each
+    one to start from its smallest index, without changing its orientation, so
+    that duplicates can be found by sorting. */
+    std::vector<std::array<int, 3> > kept;
+    for (int t = 0; t < num_triangles; ++t) {
+        std::array<int, 3> tri;
+        for (int i = 0; i < 3; ++i) {
+            tri[i] = cell_points[point_cells[triangles[3 * t + i]]];
+        }
+        if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) {
+            continue;
+        }
+        while (tri[0] > tri[1] || tri[0] > tri[2]) {
+            std::rotate(tri.begin(), tri.begin() + 1, tri.end());
+        }
+        kept.push_back(tri);
+    }
+    std::sort(kept.begin(), kept.end());
+    kept.erase(std::unique(kept.begin(), kept.end()), kept.end());
+
+    triangles_out->clear();
+    triangles_out->reserve(3 * kept.size());
+    for (const std::array<int, 3> &tri : kept) {
+        triangles_out->insert(triangles_out->end(), tri.begin(), tri.end());
+    }
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,33 @@
+#ifndef OS2CX_SURFACE_DECIMATE_HPP_
+#define OS2CX_SURFACE_DECIMATE_HPP_
+
+#include <vector>
+
+#include "calc.hpp"
+
+namespace os2cx {
+
+/* Builds a simplified version of a triangle surface, e.g. to draw in place of
+the real surface while the camera is moving. 'triangles' has three indices into
+'points' per triangle, and so does '*triangles_out'.
+
+Space is divided into a grid of cubic cells, and all the points in each cell
+are merged into one. Triangles that end up with fewer than three distinct
+corners are dropped. The point that each cell keeps is the one with the least
+quadric error (Garland and Heckbert) with respect to the planes of the cell's
+triangles, so corners and sharp edges tend to survive. Only original points are
+kept, so anything that's attached to the points, like colors or displacements,
+carries over to the simplified surface unchanged.
+
+The cell size is chosen from the surface area so that the result has roughly
+'target_triangles' triangles; it can be off by a factor of two either way. If
+'triangles' is already no bigger than that, it's returned as-is. */
+void decimate_surface(
+    const std::vector<Point> &points,
+    const std::vector<int> &triangles,
+    int target_triangles,
+    std::vector<int> *triangles_out);
+
+} /* namespace os2cx */
+
+#endif
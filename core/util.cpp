@@ -2,10 +2,16 @@
 
 #include <assert.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -50,6 +56,233 @@ void maybe_create_directory(const std::string &directory) {
     }
 }
 
+static const uint64_t fnv1a_hash_begin = 0xcbf29ce484222325ull;
+
+static uint64_t fnv1a_hash(uint64_t hash, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static std::string format_file_hash(uint64_t hash, size_t size) {
+    char hash_chars[17];
+    snprintf(hash_chars, sizeof(hash_chars), "%016llx",
+        static_cast<unsigned long long>(hash));
+    return std::string(hash_chars) + " " + std::to_string(size);
+}
+
+/* Reads the record that was kept for the file at 'path' by the last call to
+write_file_if_changed() or write_file_if_inputs_changed(): the hash of its
+contents, and the key of the inputs it was generated from, if any. Returns false
+if there's no record, or if the file's size doesn't match it any more. */
+static bool read_file_hash(
+    const FilePath &path,
+    std::string *hash_out,
+    std::string *inputs_key_out
+) {
+    std::ifstream hash_stream(path + ".hash");
+    std::string hash, inputs_key;
+    if (!std::getline(hash_stream, hash)) {
+        return false;
+    }
+    std::getline(hash_stream, inputs_key);
+    size_t space = hash.find(' ');
+    struct stat st;
+    if (space == std::string::npos || stat(path.c_str(), &st) != 0 ||
+            hash.compare(space + 1, std::string::npos,
+                std::to_string(st.st_size)) != 0) {
+        return false;
+    }
+    *hash_out = hash;
+    *inputs_key_out = inputs_key;
+    return true;
+}
+
+/* Returns true if the file at 'path' was last written with contents whose
+hash is 'hash' */
+static bool file_has_hash(const FilePath &path, const std::string &hash) {
+    std::string old_hash, old_inputs_key;
+    return read_file_hash(path, &old_hash, &old_inputs_key) &&
+        old_hash == hash;
+}
+
+static void write_hash_file(
+    const FilePath &path,
+    const std::string &hash,
+    const std::string &inputs_key
+) {
+    std::ofstream hash_stream(path + ".hash");
+    hash_stream << hash << '\n';
+    if (!inputs_key.empty()) {
+        hash_stream << inputs_key << '\n';
+    }
+}
+
+/* Moves the file at 'temp_path' to 'path', and records its hash */
+static void replace_file(
+    const FilePath &temp_path,
+    const FilePath &path,
+    const std::string &hash,
+    const std::string &inputs_key
+) {
+    /* Remove the old hash first, so that if we're interrupted, the next call
+    won't trust whatever is at 'path' */
+    FilePath hash_path = path + ".hash";
+    unlink(hash_path.c_str());
+    if (rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::string error = strerror(errno);
+        unlink(temp_path.c_str());
+        throw std::runtime_error("could not write file: " + path + ": " +
+            error);
+    }
+    write_hash_file(path, hash, inputs_key);
+}
+
+bool write_file_if_changed(const FilePath &path, const std::string &contents) {
+    std::string hash = format_file_hash(
+        fnv1a_hash(fnv1a_hash_begin, contents.data(), contents.size()),
+        contents.size());
+    if (file_has_hash(path, hash)) {
+        return false;
+    }
+
+    FilePath temp_path = path + ".tmp";
+    {
+        std::ofstream stream(temp_path, std::ios::binary);
+        stream.write(contents.data(), contents.size());
+        if (!stream) {
+            unlink(temp_path.c_str());
+            throw std::runtime_error("could not write file: " + temp_path);
+        }
+    }
+    replace_file(temp_path, path, hash, "");
+    return true;
+}
+
+/* A stream buffer that writes to a file, and hashes everything that goes
+through it on the way */
+class HashingFileBuf : public std::streambuf {
+public:
+    explicit HashingFileBuf(const FilePath &path) :
+        hash(fnv1a_hash_begin), size(0), ok(true)
+    {
+        if (!file.open(path, std::ios::out | std::ios::binary)) {
+            throw std::runtime_error("could not write file: " + path);
+        }
+        setp(buffer, buffer + sizeof(buffer));
+    }
+
+    /* Writes out anything that's buffered and closes the file. Returns false
+    if any write failed. */
+    bool close() {
+        flush_buffer();
+        return file.close() != nullptr && ok;
+    }
+
+    uint64_t hash;
+    size_t size;
+
+protected:
+    int overflow(int c) override {
+        flush_buffer();
+        if (c != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return ok ? traits_type::not_eof(c) : traits_type::eof();
+    }
+
+    int sync() override {
+        flush_buffer();
+        return ok ? 0 : -1;
+    }
+
+private:
+    void flush_buffer() {
+        std::streamsize count = pptr() - pbase();
+        hash = fnv1a_hash(hash, pbase(), count);
+        size += count;
+        if (file.sputn(pbase(), count) != count) {
+            ok = false;
+        }
+        setp(buffer, buffer + sizeof(buffer));
+    }
+
+    std::filebuf file;
+    char buffer[1 << 16];
+    bool ok;
+};
+
+/* Shared by both of the streaming variants below; 'inputs_key' is recorded
+alongside the hash of the contents, if it isn't empty. */
+static bool write_file_streaming(
+    const FilePath &path,
+    const std::string &inputs_key,
+    const std::function<void(std::ostream &)> &write
+) {
+    FilePath temp_path = path + ".tmp";
+    std::string hash;
+    {
+        HashingFileBuf buf(temp_path);
+        std::ostream stream(&buf);
+        try {
+            write(stream);
+        } catch (...) {
+            buf.close();
+            unlink(temp_path.c_str());
+            throw;
+        }
+        if (!stream || !buf.close()) {
+            unlink(temp_path.c_str());
+            throw std::runtime_error("could not write file: " + temp_path);
+        }
+        hash = format_file_hash(buf.hash, buf.size);
+    }
+
+    if (file_has_hash(path, hash)) {
+        unlink(temp_path.c_str());
+        if (!inputs_key.empty()) {
+            /* The inputs changed in a way that doesn't show in the file, so
+            just remember the new key */
+            write_hash_file(path, hash, inputs_key);
+        }
+        return false;
+    }
+    replace_file(temp_path, path, hash, inputs_key);
+    return true;
+}
+
+bool write_file_if_changed(
+    const FilePath &path,
+    const std::function<void(std::ostream &)> &write
+) {
+    return write_file_streaming(path, "", write);
+}
+
+bool write_file_if_inputs_changed(
+    const FilePath &path,
+    const std::string &inputs_key,
+    const std::function<void(std::ostream &)> &write
+) {
+    assert(!inputs_key.empty() &&
+        inputs_key.find('\n') == std::string::npos);
+    std::string old_hash, old_inputs_key;
+    if (read_file_hash(path, &old_hash, &old_inputs_key) &&
+            old_inputs_key == inputs_key) {
+        return false;
+    }
+    return write_file_streaming(path, inputs_key, write);
+}
+
+std::string InputsHash::key() const {
+    char key_chars[17];
+    snprintf(key_chars, sizeof(key_chars), "%016llx",
+        static_cast<unsigned long long>(value));
+    return key_chars;
+}
+
 TempDir::TempDir(const std::string &tmplate, AutoCleanup ac) :
         auto_cleanup(AutoCleanup::No) {
     std::vector<char> scratch(tmplate.begin(), tmplate.end());
@@ -75,6 +308,101 @@ TempDir::~TempDir() {
     }
 }
 
+MappedFile::MappedFile(const FilePath &path) : _data(nullptr), _size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(
+            "open(" + path + ") failed: " + std::string(strerror(errno)));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(
+            "fstat(" + path + ") failed: " + std::string(strerror(error)));
+    }
+    _size = st.st_size;
+    /* mmap() refuses zero-length mappings, so empty files just have a null
+    data pointer */
+    if (_size != 0) {
+        void *ptr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error(
+                "mmap(" + path + ") failed: " + std::string(strerror(error)));
+        }
+        _data = static_cast<const char *>(ptr);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (_data != nullptr) {
+        munmap(const_cast<char *>(_data), _size);
+    }
+}
+
+static int compute_parallel_num_threads() {
+    /* OS2CX_NUM_THREADS overrides the hardware thread count, e.g. to leave
+    some cores free, or to test the multi-threaded code paths. */
+    const char *env = getenv("OS2CX_NUM_THREADS");
+    if (env != nullptr && atoi(env) > 0) {
+        return atoi(env);
+    }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+int parallel_num_threads() {
+    static const int num_threads = compute_parallel_num_threads();
+    return num_threads;
+}
+
+int parallel_num_chunks(int begin, int end, int min_chunk_size) {
+    assert(min_chunk_size > 0);
+    int by_size = (end - begin) / min_chunk_size;
+    return std::max(1, std::min(parallel_num_threads(), by_size));
+}
+
+BackgroundWorker::BackgroundWorker() :
+    stopping(false),
+    thread(&BackgroundWorker::run, this)
+{ }
+
+BackgroundWorker::~BackgroundWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void BackgroundWorker::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+void BackgroundWorker::run() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
 class DirWalker {
 public:
     DirWalker(const char *path) {
@@ -2,9 +2,18 @@
 #define OS2CX_UTIL_HPP_
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace os2cx {
@@ -17,6 +26,67 @@ std::string build_command_line(
 
 void maybe_create_directory(const std::string &directory);
 
+/* Writes 'contents' to the file at 'path', unless the file already holds
+exactly those contents from a previous call. A hash of the contents is kept in
+'path' + ".hash" so that checking doesn't require reading the old file back.
+Returns true if the file was (re)written. The new file is written next to
+'path' and then renamed over it, so 'path' never holds a partial file. */
+bool write_file_if_changed(const FilePath &path, const std::string &contents);
+
+/* Like the above, but the contents are whatever 'write(stream)' writes. They
+go straight to disk and are hashed along the way, so they never have to be in
+memory all at once; if they turn out to be unchanged, the new file is deleted
+instead of replacing the old one. */
+bool write_file_if_changed(
+    const FilePath &path,
+    const std::function<void(std::ostream &)> &write);
+
+/* Like the above, but keyed on the inputs the file is generated from instead of
+on its contents. 'inputs_key' should change whenever anything that 'write'
+reads does (see InputsHash). If the file is still as it was left by a previous
+call with the same key, 'write' isn't called at all, so callers skip the cost of
+formatting the contents as well as writing them. */
+bool write_file_if_inputs_changed(
+    const FilePath &path,
+    const std::string &inputs_key,
+    const std::function<void(std::ostream &)> &write);
+
+/* Accumulates a hash of the inputs to write_file_if_inputs_changed(). Values
+are mixed in a word at a time, since the inputs can be whole meshes. */
+class InputsHash {
+public:
+    InputsHash() : value(0xcbf29ce484222325ull) { }
+
+    void add_int(int64_t v) {
+        add_word(static_cast<uint64_t>(v));
+    }
+    void add_double(double v) {
+        uint64_t word;
+        static_assert(sizeof(word) == sizeof(v), "double isn't 64 bits");
+        memcpy(&word, &v, sizeof(word));
+        add_word(word);
+    }
+    void add_string(const std::string &s) {
+        add_int(s.size());
+        for (char c : s) {
+            add_word(static_cast<unsigned char>(c));
+        }
+    }
+    void add_hash(const InputsHash &other) {
+        add_word(other.value);
+    }
+
+    std::string key() const;
+
+private:
+    void add_word(uint64_t word) {
+        value = (value ^ word) * 0x100000001b3ull;
+        value ^= value >> 29;
+    }
+
+    uint64_t value;
+};
+
 class TempDir {
 public:
     enum class ExpandTemplate { Yes, No };
@@ -32,6 +102,101 @@ private:
     FilePath _path;
 };
 
+/* MappedFile maps an entire file into memory read-only, so that large output
+files can be parsed in place without copying them through a stream. */
+class MappedFile {
+public:
+    explicit MappedFile(const FilePath &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+private:
+    const char *_data;
+    size_t _size;
+};
+
+/* Returns the number of threads that parallel_for_chunks() will use at most.
+This is the hardware thread count, unless overridden by the OS2CX_NUM_THREADS
+environment variable. */
+int parallel_num_threads();
+
+/* Returns the number of chunks that parallel_for_chunks() will split the range
+[begin, end) into, given 'min_chunk_size'. Callers use this to preallocate
+per-chunk output buffers. */
+int parallel_num_chunks(int begin, int end, int min_chunk_size);
+
+/* Splits [begin, end) into parallel_num_chunks() contiguous chunks and calls
+'func(chunk_begin, chunk_end, chunk_index)' for each one, running the chunks on
+separate threads. Chunks are numbered in order of increasing 'chunk_begin', so
+callers can concatenate per-chunk results to get a deterministic order. If any
+call throws, the exception is rethrown once all the threads have finished. */
+template<class Func>
+void parallel_for_chunks(
+    int begin,
+    int end,
+    int min_chunk_size,
+    const Func &func
+) {
+    int num_chunks = parallel_num_chunks(begin, end, min_chunk_size);
+    if (num_chunks <= 1) {
+        func(begin, end, 0);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(num_chunks);
+    auto run_chunk = [&](int chunk) {
+        long long size = end - begin;
+        int chunk_begin = begin + size * chunk / num_chunks;
+        int chunk_end = begin + size * (chunk + 1) / num_chunks;
+        try {
+            func(chunk_begin, chunk_end, chunk);
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(num_chunks - 1);
+    for (int chunk = 1; chunk < num_chunks; ++chunk) {
+        threads.emplace_back(run_chunk, chunk);
+    }
+    run_chunk(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/* A single thread that runs jobs one at a time, in the order they were posted,
+for work that shouldn't hold up the caller. Jobs can't be taken back once
+they're posted; a job whose result is no longer wanted should notice that
+itself when it starts (e.g. by holding a std::weak_ptr to whatever it's for)
+and return right away. The destructor drops the jobs that haven't started, and
+waits for the one that's running, if any. */
+class BackgroundWorker {
+public:
+    BackgroundWorker();
+    ~BackgroundWorker();
+
+    BackgroundWorker(const BackgroundWorker &) = delete;
+    BackgroundWorker &operator=(const BackgroundWorker &) = delete;
+
+    void post(std::function<void()> job);
+
+private:
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()> > jobs;
+    bool stopping;
+    std::thread thread;
+};
+
 template<class Key, class Value>
 class ContiguousMap {
 public:
@@ -72,6 +237,9 @@ public:
     typename std::vector<Value>::const_iterator end() const {
         return values.end();
     }
+    /* Raw access to the values, for loops that the compiler can vectorize */
+    Value *data() { return values.data(); }
+    const Value *data() const { return values.data(); }
     void reserve(int capacity) { values.reserve(capacity); }
     Key push_back(const Value &value) {
         values.push_back(value);
@@ -82,6 +250,191 @@ private:
     std::vector<Value> values;
 };
 
+/* RangeSet is a set of IDs (NodeId, ElementId, FaceId, etc.), stored as a
+sorted list of disjoint half-open runs of consecutive IDs. Sets that cover a
+contiguous range of IDs take constant space no matter how many IDs they
+contain, and scattered IDs take a few bytes each rather than a whole tree node.
+Membership tests are O(log runs); iteration is in increasing order. Inserting
+IDs in increasing order is amortized O(1). */
+template<class Key>
+class RangeSet {
+public:
+    class Run {
+    public:
+        Run() { }
+        Run(int b, int e) : begin(b), end(e) { }
+        int size() const { return end - begin; }
+        int begin, end;
+    };
+
+    class const_iterator {
+    public:
+        const_iterator() : run(nullptr), value(0) { }
+        const_iterator(const Run *r, int v) : run(r), value(v) { }
+        Key operator*() const { return Key::from_int(value); }
+        const_iterator &operator++() {
+            if (++value == run->end) {
+                ++run;
+                value = run->begin;
+            }
+            return *this;
+        }
+        bool operator==(const const_iterator &o) const {
+            return run == o.run && value == o.value;
+        }
+        bool operator!=(const const_iterator &o) const {
+            return !(*this == o);
+        }
+    private:
+        /* 'value' is only meaningful if 'run' isn't the past-the-end run. A
+        sentinel run is kept past the last real run so that operator++ can
+        always read 'run->begin'. */
+        const Run *run;
+        int value;
+    };
+
+    RangeSet() : num_keys(0) { runs_and_sentinel.push_back(Run(0, 0)); }
+    RangeSet(Key begin, Key end) : RangeSet() { insert_range(begin, end); }
+
+    /* Builds a set from 'keys', which may be unsorted and contain duplicates */
+    static RangeSet from_keys(std::vector<Key> keys) {
+        std::sort(keys.begin(), keys.end());
+        RangeSet set;
+        for (Key key : keys) {
+            set.insert(key);
+        }
+        return set;
+    }
+
+    int size() const { return num_keys; }
+    bool empty() const { return num_keys == 0; }
+    int num_runs() const { return runs_and_sentinel.size() - 1; }
+    const Run *runs_begin() const { return runs_and_sentinel.data(); }
+    const Run *runs_end() const { return runs_begin() + num_runs(); }
+
+    const_iterator begin() const {
+        return const_iterator(runs_begin(), runs_begin()->begin);
+    }
+    const_iterator end() const {
+        return const_iterator(runs_end(), runs_end()->begin);
+    }
+
+    int count(Key key) const {
+        int k = key.to_int();
+        const Run *it = std::upper_bound(runs_begin(), runs_end(), k,
+            [](int v, const Run &r) { return v < r.begin; });
+        return (it != runs_begin() && k < (it - 1)->end) ? 1 : 0;
+    }
+
+    void insert(Key key) {
+        int k = key.to_int();
+        insert_range_int(k, k + 1);
+    }
+
+    void insert_range(Key begin, Key end) {
+        insert_range_int(begin.to_int(), end.to_int());
+    }
+
+    void clear() {
+        *this = RangeSet();
+    }
+
+    RangeSet operator|(const RangeSet &other) const {
+        RangeSet result;
+        const Run *a = runs_begin(), *b = other.runs_begin();
+        while (a != runs_end() || b != other.runs_end()) {
+            if (b == other.runs_end() ||
+                    (a != runs_end() && a->begin < b->begin)) {
+                result.append_run(a->begin, a->end);
+                ++a;
+            } else {
+                result.append_run(b->begin, b->end);
+                ++b;
+            }
+        }
+        return result;
+    }
+
+    RangeSet operator&(const RangeSet &other) const {
+        RangeSet result;
+        const Run *a = runs_begin(), *b = other.runs_begin();
+        while (a != runs_end() && b != other.runs_end()) {
+            int begin = std::max(a->begin, b->begin);
+            int end = std::min(a->end, b->end);
+            if (begin < end) {
+                result.append_run(begin, end);
+            }
+            if (a->end < b->end) {
+                ++a;
+            } else {
+                ++b;
+            }
+        }
+        return result;
+    }
+
+    RangeSet &operator|=(const RangeSet &other) {
+        if (empty() || other.empty() ||
+                other.runs_begin()->begin >= runs_end()[-1].end) {
+            /* Fast path for concatenating sets in increasing order */
+            for (const Run *r = other.runs_begin(); r != other.runs_end();
+                    ++r) {
+                append_run(r->begin, r->end);
+            }
+        } else {
+            *this = *this | other;
+        }
+        return *this;
+    }
+
+    bool operator==(const RangeSet &other) const {
+        if (num_runs() != other.num_runs()) return false;
+        for (int i = 0; i < num_runs(); ++i) {
+            if (runs_begin()[i].begin != other.runs_begin()[i].begin ||
+                    runs_begin()[i].end != other.runs_begin()[i].end) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool operator!=(const RangeSet &other) const { return !(*this == other); }
+
+private:
+    /* Appends [begin, end) to the set; requires 'begin' to be no less than the
+    start of the last run. Merges with the last run if they overlap or touch. */
+    void append_run(int begin, int end) {
+        if (begin >= end) return;
+        runs_and_sentinel.pop_back();
+        if (!runs_and_sentinel.empty() &&
+                begin <= runs_and_sentinel.back().end) {
+            Run &last = runs_and_sentinel.back();
+            assert(begin >= last.begin);
+            if (end > last.end) {
+                num_keys += end - last.end;
+                last.end = end;
+            }
+        } else {
+            runs_and_sentinel.push_back(Run(begin, end));
+            num_keys += end - begin;
+        }
+        runs_and_sentinel.push_back(Run(0, 0));
+    }
+
+    void insert_range_int(int begin, int end) {
+        if (begin >= end) return;
+        if (empty() || begin >= runs_end()[-1].begin) {
+            append_run(begin, end);
+        } else {
+            RangeSet single;
+            single.append_run(begin, end);
+            *this = *this | single;
+        }
+    }
+
+    std::vector<Run> runs_and_sentinel;
+    int num_keys;
+};
+
 template<class Value>
 class Array2D {
 public:
@@ -109,49 +462,129 @@ private:
     std::vector<Value> vector;
 };
 
+/* QuantileSketch estimates percentiles of a stream of values in a small, fixed
+amount of memory, without keeping or sorting the whole stream. It's a
+deterministic variant of the KLL sketch: the values it keeps are split into
+levels, and each value in level 'h' stands for 2^h of the values inserted. When
+a level fills up, it's sorted, and every other value moves up to the next
+level. Sketches of different parts of a stream can be merged, so the parts can
+be processed on different threads. With the default capacity, percentiles are
+typically within about 1% of the right rank, and the sketch keeps at most about
+three times 'capacity' values. */
 template<class Value>
-class ReservoirSampler {
+class QuantileSketch {
 public:
-    explicit ReservoirSampler(int num_samples) :
-        samples(num_samples), total(0), next_to_keep(-1), sorted(true) { }
+    explicit QuantileSketch(int capacity = 512) :
+        capacity(capacity), total(0) { }
+
     void insert(Value value) {
-        if (total < static_cast<int>(samples.size())) {
-            samples[total] = value;
-        } else if (total < static_cast<int>(samples.size()) * 10) {
-            int i = rand() % total;
-            if (i < static_cast<int>(samples.size())) {
-                samples[i] = value;
+        if (levels.empty()) {
+            add_level();
+        }
+        levels[0].push_back(value);
+        if (total == 0 || value < min) min = value;
+        if (total == 0 || value > max) max = value;
+        ++total;
+        if (static_cast<int>(levels[0].size()) >= level_capacity(0)) {
+            compress();
+        }
+    }
+
+    void merge(const QuantileSketch &other) {
+        while (levels.size() < other.levels.size()) {
+            add_level();
+        }
+        for (int h = 0; h < static_cast<int>(other.levels.size()); ++h) {
+            levels[h].insert(
+                levels[h].end(),
+                other.levels[h].begin(),
+                other.levels[h].end());
+        }
+        if (other.total != 0) {
+            if (total == 0 || other.min < min) min = other.min;
+            if (total == 0 || other.max > max) max = other.max;
+        }
+        total += other.total;
+        compress();
+    }
+
+    /* Number of values inserted, including the ones merged in */
+    int64_t count() const { return total; }
+
+    /* Returns the value that 'p' percent of the inserted values are less than
+    or equal to. 'p' must be in [0, 100], and the sketch must not be empty. The
+    0th and 100th percentiles are exact. */
+    Value percentile(double p) const {
+        assert(p >= 0 && p <= 100);
+        assert(total > 0);
+        if (p == 0) return min;
+        if (p == 100) return max;
+        std::vector<std::pair<Value, int64_t> > weighted;
+        for (int h = 0; h < static_cast<int>(levels.size()); ++h) {
+            for (Value value : levels[h]) {
+                weighted.push_back(std::make_pair(value, int64_t(1) << h));
             }
-        } else {
-            /* When total is very large, use an approximation to avoid having to
-            call rand() every time. Instead of each sample having an independent
-            1/N chance of being kept, we randomly preselect one of the next N
-            samples for keeping. */
-            if (next_to_keep == -1) {
-                next_to_keep = total + rand() % (total / samples.size());
+        }
+        std::sort(weighted.begin(), weighted.end());
+        double target = p / 100 * total;
+        int64_t cumulative = 0;
+        for (const std::pair<Value, int64_t> &pair : weighted) {
+            cumulative += pair.second;
+            if (cumulative >= target) {
+                return pair.first;
             }
-            if (total == next_to_keep) {
-                samples[rand() % samples.size()] = value;
-                next_to_keep = -1;
+        }
+        return weighted.back().first;
+    }
+
+private:
+    /* Values in the top level stand for the most inserted values, so they get
+    the most room; each level below gets 2/3 as much room as the one above. */
+    int level_capacity(int h) const {
+        int depth = levels.size() - 1 - h;
+        double room = capacity;
+        for (int i = 0; i < depth && room > 2; ++i) {
+            room *= 2.0 / 3.0;
+        }
+        return std::max(2, static_cast<int>(room));
+    }
+
+    void add_level() {
+        levels.emplace_back();
+        offsets.push_back(0);
+    }
+
+    void compress() {
+        for (int h = 0; h < static_cast<int>(levels.size()); ++h) {
+            if (static_cast<int>(levels[h].size()) >= level_capacity(h)) {
+                if (h + 1 == static_cast<int>(levels.size())) {
+                    add_level();
+                }
+                compact(h);
             }
         }
-        ++total;
-        sorted = false;
     }
-    Value percentile(int p) {
-        assert(p > 0 && p < 100);
-        int n = std::min(static_cast<int>(samples.size()), total);
-        if (!sorted) {
-            std::sort(samples.begin(), samples.begin() + n);
-            sorted = true;
+
+    /* Moves every other value of level 'h' up to level 'h + 1'. If the level
+    has an odd number of values, the largest one stays behind. Compactions
+    alternate between keeping the even-indexed and the odd-indexed values, so
+    that their errors tend to cancel out instead of adding up. */
+    void compact(int h) {
+        std::vector<Value> &level = levels[h];
+        std::sort(level.begin(), level.end());
+        int n = level.size() & ~1;
+        for (int i = offsets[h]; i < n; i += 2) {
+            levels[h + 1].push_back(level[i]);
         }
-        return samples[n * p / 100];
+        offsets[h] ^= 1;
+        level.erase(level.begin(), level.begin() + n);
     }
-private:
-    std::vector<Value> samples;
-    int total;
-    int next_to_keep;
-    bool sorted;
+
+    int capacity;
+    int64_t total;
+    Value min, max;
+    std::vector<std::vector<Value> > levels;
+    std::vector<int> offsets;
 };
 
 } /* namespace os2cx */
@@ -18,7 +18,8 @@ HEADERS = $$CORE_HEADERS \
     gui_combo_box_modes.hpp \
     gui_opengl_mesh.hpp \
     gui_opengl_poly3.hpp \
-    gui_mode_inspect.hpp
+    gui_mode_inspect.hpp \
+    gui_opengl_pick.hpp
 
 SOURCES = $$CORE_SOURCES \
     gui_project_runner.cpp \
@@ -32,7 +33,8 @@ SOURCES = $$CORE_SOURCES \
     gui_combo_box_modes.cpp \
     gui_opengl_mesh.cpp \
     gui_opengl_poly3.cpp \
-    gui_mode_inspect.cpp
+    gui_mode_inspect.cpp \
+    gui_opengl_pick.cpp
 
 DISTFILES += \
     OpenSCAD2CalculiX.desktop \
@@ -10,19 +10,28 @@ GuiColorScale::GuiColorScale(QWidget *parent) :
     QWidget(parent)
 {
     static const UnitSystem si_system("m", "kg", "s"); /* placeholder */
-    set_range(0.0, 1.0, &si_system, UnitType::Dimensionless);
+    set_range(0.0, 1.0, Mapping::Linear, false, &si_system,
+        UnitType::Dimensionless);
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
 }
 
 void GuiColorScale::set_range(
     double val_min,
     double val_max,
+    Mapping mapping,
+    bool clamped,
     const UnitSystem *new_unit_system,
     UnitType new_unit_type
 ) {
     assert(val_min <= val_max);
+    lut.logarithmic = (mapping == Mapping::Logarithmic && val_max > 0);
+    if (lut.logarithmic && val_min <= 0) {
+        val_min = val_max * 1e-3;
+        clamped = true;
+    }
     range_min = val_min;
     range_max = val_max;
+    range_clamped = clamped;
     double scale = std::max(std::abs(val_min), std::abs(val_max));
     colors.clear();
     colors[-scale]     = QColor::fromHsl(240, 0xFF, 0x66);
@@ -31,13 +40,28 @@ void GuiColorScale::set_range(
     colors[ scale / 3] = QColor::fromHsl( 60, 0xEE, 0x99);
     colors[0]          = QColor::fromHsl(120, 0x00, 0xEE);
 
+    /* Table entry 'i' is the color at 'offset + i / scale' in the (possibly
+    logarithmic) coordinates that Lookup::rgb() works in */
+    double low = lut.logarithmic ? std::log(val_min) : val_min;
+    double high = lut.logarithmic ? std::log(val_max) : val_max;
+    lut.val_min = val_min;
+    lut.offset = low;
+    lut.scale = (high > low) ? (Lookup::size - 1) / (high - low) : 0;
+    for (int i = 0; i < Lookup::size; ++i) {
+        double x = low + (high - low) * i / (Lookup::size - 1);
+        QColor c = interpolate_color(lut.logarithmic ? std::exp(x) : x);
+        lut.table[3 * i + 0] = c.red();
+        lut.table[3 * i + 1] = c.green();
+        lut.table[3 * i + 2] = c.blue();
+    }
+
     unit_system = new_unit_system;
     unit_type = new_unit_type;
 
     update();
 }
 
-QColor GuiColorScale::color(double val) const {
+QColor GuiColorScale::interpolate_color(double val) const {
     std::map<double, QColor>::const_iterator it = colors.lower_bound(val);
     if (it == colors.begin()) {
         /* 'val' is below 'range_min' */
@@ -72,24 +96,29 @@ void GuiColorScale::paintEvent(QPaintEvent *) {
     WithUnit<double> range_min2 = unit_system->system_to_unit(unit, range_min);
     WithUnit<double> range_max2 = unit_system->system_to_unit(unit, range_max);
 
+    /* If the range is clamped, the end colors also stand for everything past
+    the ends of the range */
     QRect label_rect(0, 0, width(), fontMetrics().height());
     painter.drawText(label_rect, Qt::AlignLeft|Qt::AlignBottom,
-        QString("%1%2").arg(range_min2.value_in_unit).arg(unit.name.c_str()));
+        QString("%1%2%3")
+            .arg(range_clamped ? u8"\u2264" : "")
+            .arg(range_min2.value_in_unit)
+            .arg(unit.name.c_str()));
     painter.drawText(label_rect, Qt::AlignRight|Qt::AlignBottom,
-        QString("%1%2").arg(range_max2.value_in_unit).arg(unit.name.c_str()));
+        QString("%1%2%3")
+            .arg(range_clamped ? u8"\u2265" : "")
+            .arg(range_max2.value_in_unit)
+            .arg(unit.name.c_str()));
 
     /* Draw the main color gradient */
     QRect bar_rect(0, label_rect.bottom(), width(), bar_size_px);
     painter.setPen(Qt::NoPen);
     QLinearGradient gradient(bar_rect.left(), 0, bar_rect.right(), 0);
-    gradient.setColorAt(0.0, color(range_min));
-    for (const auto &pair : colors) {
-        if (range_max == range_min) continue;
-        double normalized = (pair.first - range_min) / (range_max - range_min);
-        if (normalized <= 0.0 || normalized >= 1.0) continue;
-        gradient.setColorAt(normalized, pair.second);
+    for (int i = 0; i < Lookup::size; ++i) {
+        const uint8_t *rgb = &lut.table[3 * i];
+        gradient.setColorAt(
+            i / (Lookup::size - 1.0), QColor(rgb[0], rgb[1], rgb[2]));
     }
-    gradient.setColorAt(1.0, color(range_max));
     painter.setBrush(gradient);
     painter.drawRoundedRect(bar_rect, bar_size_px / 10, bar_size_px / 10);
 
@@ -1,6 +1,11 @@
 #ifndef GUI_COLOR_SCALE_HPP
 #define GUI_COLOR_SCALE_HPP
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+
 #include <QWidget>
 
 #include "units.hpp"
@@ -13,13 +18,52 @@ class GuiColorScale : public QWidget
 public:
     explicit GuiColorScale(QWidget *parent = nullptr);
 
+    enum class Mapping {
+        Linear,
+        Logarithmic
+    };
+
+    /* Maps values to colors with a precomputed table, so coloring a scene
+    costs a few arithmetic operations and one table load per point instead of a
+    search through the color stops. Values outside the range get the color at
+    the nearest end of the range. */
+    class Lookup {
+    public:
+        static const int size = 256;
+
+        /* Returns three bytes: red, green, and blue. 'val' must not be NaN. */
+        const uint8_t *rgb(double val) const {
+            double x = logarithmic ? std::log(std::max(val, val_min)) : val;
+            double t = (x - offset) * scale;
+            t = std::min(std::max(t, 0.0), size - 1.0);
+            return &table[3 * static_cast<int>(t + 0.5)];
+        }
+
+    private:
+        friend class GuiColorScale;
+        bool logarithmic;
+        double val_min, offset, scale;
+        uint8_t table[3 * size];
+    };
+
+    /* If 'clamped' is true, the data extends past [val_min, val_max], and the
+    labels say so. A logarithmic scale can't reach zero, so if 'val_min' isn't
+    positive, the scale starts at 1/1000 of 'val_max' instead; and if 'val_max'
+    isn't positive either, the scale is linear. */
     void set_range(
         double val_min,
         double val_max,
+        Mapping mapping,
+        bool clamped,
         const UnitSystem *unit_system,
         UnitType unit_type);
 
-    QColor color(double val) const;
+    const Lookup &lookup() const { return lut; }
+
+    QColor color(double val) const {
+        const uint8_t *rgb = lut.rgb(val);
+        return QColor(rgb[0], rgb[1], rgb[2]);
+    }
 
 signals:
 
@@ -31,11 +75,17 @@ private:
     QSize sizeHint() const;
     void paintEvent(QPaintEvent *event);
 
+    /* Interpolates between the color stops in 'colors'. This is what 'lut' is
+    computed from. */
+    QColor interpolate_color(double val) const;
+
     double range_min, range_max;
+    bool range_clamped;
     const UnitSystem *unit_system;
     UnitType unit_type;
 
     std::map<double, QColor> colors;
+    Lookup lut;
 };
 
 } /* namespace os2cx */
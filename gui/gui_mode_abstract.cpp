@@ -17,6 +17,18 @@ GuiModeAbstract::GuiModeAbstract(
     layout->setContentsMargins(0, 0, 0, 0);
 }
 
+std::shared_ptr<const GuiOpenglSection> GuiModeAbstract::make_section() {
+    return nullptr;
+}
+
+std::shared_ptr<const GuiOpenglTriangles> GuiModeAbstract::make_isosurface() {
+    return nullptr;
+}
+
+void GuiModeAbstract::show_pick(const GuiOpenglPick *pick) {
+    (void)pick;
+}
+
 QLabel *GuiModeAbstract::create_widget_label(const QString &text) {
     layout->addSpacing(10);
     QLabel *label = new QLabel(text, this);
@@ -10,7 +10,10 @@
 
 namespace os2cx {
 
+class GuiOpenglPick;
 class GuiOpenglScene;
+class GuiOpenglSection;
+class GuiOpenglTriangles;
 
 class GuiModeAbstract : public QWidget
 {
@@ -20,6 +23,18 @@ public:
 
     virtual std::shared_ptr<const GuiOpenglScene> make_scene() = 0;
 
+    /* Called along with make_scene(). Returns the section to cut the scene
+    with, or null to show the whole scene, which is the default. */
+    virtual std::shared_ptr<const GuiOpenglSection> make_section();
+
+    /* Called along with make_scene(). Returns an isosurface to draw inside the
+    scene, or null for none, which is the default. */
+    virtual std::shared_ptr<const GuiOpenglTriangles> make_isosurface();
+
+    /* Called when the user clicks on the scene. 'pick' is null if the click
+    missed. By default, nothing happens. */
+    virtual void show_pick(const GuiOpenglPick *pick);
+
     const std::shared_ptr<const Project> project;
 
 signals:
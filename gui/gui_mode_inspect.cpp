@@ -1,6 +1,7 @@
 #include "gui_mode_inspect.hpp"
 
 #include "gui_opengl_mesh.hpp"
+#include "gui_opengl_pick.hpp"
 #include "gui_opengl_poly3.hpp"
 
 namespace os2cx {
@@ -64,6 +65,12 @@ GuiModeInspect::GuiModeInspect(
                 this, &GuiModeInspect::current_item_changed);
     current_item_changed(nullptr, nullptr);
 
+    create_widget_label(tr("Picked node"));
+    pick_label = new QLabel(this);
+    pick_label->setWordWrap(true);
+    layout->addWidget(pick_label);
+    show_pick(nullptr);
+
     /* Update to reflect project's initial state */
     project_updated();
 }
@@ -231,12 +238,12 @@ std::shared_ptr<const GuiOpenglScene> GuiModeInspect::make_scene_poly3() {
         callback.focus_mesh = focus_name;
         break;
     case Focus::SelectVolume:
-        callback.focus_attrs[
-            project->select_volume_objects.at(focus_name).bit_index] = true;
+        callback.focus_attrs.set(
+            project->select_volume_objects.at(focus_name).bit_index);
         break;
     case Focus::SelectSurface:
-        callback.focus_attrs[
-            project->select_surface_objects.at(focus_name).bit_index] = true;
+        callback.focus_attrs.set(
+            project->select_surface_objects.at(focus_name).bit_index);
         break;
     case Focus::SelectOrCreateNode:
         callback.focus_node_object = focus_name;
@@ -247,16 +254,16 @@ std::shared_ptr<const GuiOpenglScene> GuiModeInspect::make_scene_poly3() {
         if (project->mesh_objects.count(volume)) {
             callback.focus_mesh = volume;
         } else {
-            callback.focus_attrs[
-                project->select_volume_objects.at(volume).bit_index] = true;
+            callback.focus_attrs.set(
+                project->select_volume_objects.at(volume).bit_index);
         }
         break;
     }
     case Focus::LoadSurface: {
         Project::SurfaceObjectName surface =
             project->load_surface_objects.at(focus_name).surface;
-        callback.focus_attrs[
-            project->select_surface_objects.at(surface).bit_index] = true;
+        callback.focus_attrs.set(
+            project->select_surface_objects.at(surface).bit_index);
         break;
     }
     default: assert(false);
@@ -419,6 +426,40 @@ std::shared_ptr<const GuiOpenglScene> GuiModeInspect::make_scene_mesh() {
     return gui_opengl_scene_mesh(*project, &callback);
 }
 
+void GuiModeInspect::show_pick(const GuiOpenglPick *pick) {
+    if (pick == nullptr) {
+        pick_label->setText(tr("Click on the mesh to pick a node."));
+        return;
+    }
+    if (pick->node_id == NodeId::invalid()) {
+        /* The OpenSCAD geometry doesn't have nodes */
+        pick_label->setText(tr("Switch to the mesh to pick a node."));
+        return;
+    }
+
+    Unit length_unit = project->unit_system.suggest_unit(
+        UnitType::Length, project->approx_scale);
+    WithUnit<Vector> position = project->unit_system.system_to_unit(
+        length_unit,
+        project->mesh->nodes[pick->node_id].point - Point::origin());
+    QString text = tr("Node %1 at (%2, %3, %4)%5")
+        .arg(pick->node_id.to_int())
+        .arg(position.value_in_unit.x)
+        .arg(position.value_in_unit.y)
+        .arg(position.value_in_unit.z)
+        .arg(length_unit.name.c_str());
+
+    text += "\n";
+    text += tr("Element %1").arg(pick->element_id.to_int());
+    for (const auto &pair : project->mesh_objects) {
+        if (!(pick->element_id < pair.second.element_begin) &&
+                pick->element_id < pair.second.element_end) {
+            text += tr(" of mesh '%1'").arg(pair.first.c_str());
+        }
+    }
+    pick_label->setText(text);
+}
+
 std::shared_ptr<const GuiOpenglScene> GuiModeInspect::make_scene() {
     if (radiobutton_poly3->isChecked()) {
         return make_scene_poly3();
@@ -15,6 +15,8 @@ public:
         QWidget *parent,
         std::shared_ptr<const Project> project);
 
+    void show_pick(const GuiOpenglPick *pick);
+
 public slots:
     void project_updated();
 
@@ -53,6 +55,8 @@ private:
     QRadioButton *radiobutton_poly3, *radiobutton_mesh;
 
     QListWidget *list;
+
+    QLabel *pick_label;
 };
 
 } /* namespace os2cx */
@@ -2,8 +2,30 @@
 
 #include <QHeaderView>
 
+#include "gui_opengl_pick.hpp"
+
 namespace os2cx {
 
+/* Returns the largest value of 'subvar' in 'dataset', or 0 if there are no
+non-NaN values */
+static double dataset_max(
+    const Results::Dataset &dataset,
+    SubVariable subvar
+) {
+    double max = dataset.stats()->component_max[subvariable_component(subvar)];
+    return isnan(max) ? 0 : max;
+}
+
+/* Eigenfrequencies are often far too fast to watch, or too slow to be worth
+waiting for. Returns 'true_hz' slowed down or sped up by a power of ten into the
+range 0.2 to 5 Hz. */
+static double watchable_animate_hz(double true_hz) {
+    double hz = true_hz;
+    while (hz > 5) hz /= 10;
+    while (hz < 0.2) hz *= 10;
+    return hz;
+}
+
 GuiModeResult::GuiModeResult(
     QWidget *parent,
     std::shared_ptr<const Project> project,
@@ -12,8 +34,21 @@ GuiModeResult::GuiModeResult(
     GuiModeAbstract(parent, project),
     result(result),
     checkbox_animate(nullptr),
-    animate_active(false)
+    animate_active(false),
+    pick_node_id(NodeId::invalid()),
+    pick_element_id(ElementId::invalid()),
+    combo_box_section_axis(nullptr),
+    slider_section(nullptr),
+    section_index_timer(-1),
+    checkbox_isosurface(nullptr),
+    slider_isosurface(nullptr),
+    isosurface_label(nullptr)
 {
+    load_error_label = new QLabel(this);
+    load_error_label->setWordWrap(true);
+    load_error_label->hide();
+    layout->addWidget(load_error_label);
+
     maybe_setup_frequency();
 
     maybe_setup_disp();
@@ -42,12 +77,32 @@ GuiModeResult::GuiModeResult(
     });
 
     create_widget_label(tr("Color scale"));
+    combo_box_color_range = new QComboBox(this);
+    layout->addWidget(combo_box_color_range);
+    combo_box_color_range->addItem(tr("Full range"));
+    combo_box_color_range->addItem(tr("1st to 99th percentile"));
+    connect(combo_box_color_range, QOverload<int>::of(&QComboBox::activated),
+    [this](int) {
+        refresh_color_scale();
+    });
+    checkbox_color_log = new QCheckBox(tr("Logarithmic"), this);
+    layout->addWidget(checkbox_color_log);
+    connect(checkbox_color_log, &QCheckBox::stateChanged,
+    [this](int) {
+        refresh_color_scale();
+    });
     color_scale = new GuiColorScale(this);
     layout->addWidget(color_scale);
 
     set_color_variable(first_step()->datasets.begin()->first);
 
     maybe_setup_measurements();
+
+    setup_section();
+
+    setup_isosurface();
+
+    setup_pick();
 }
 
 void GuiModeResult::maybe_setup_frequency() {
@@ -75,8 +130,13 @@ void GuiModeResult::maybe_setup_frequency() {
     connect(combo_box_frequency, QOverload<int>::of(&QComboBox::activated),
     [this](int new_index) {
         step_index = new_index;
-        refresh_animate_hz();
+        refresh_load_error();
+        refresh_animate_label();
         refresh_measurements();
+        refresh_pick();
+        section = nullptr;
+        isosurface_ranges = nullptr;
+        isosurface = nullptr;
         emit refresh_scene();
     });
 
@@ -93,6 +153,7 @@ void GuiModeResult::maybe_setup_disp() {
         }
     } else {
         disp_key = dispi_key = "";
+        disp_scale = 1.0;
         return;
     }
 
@@ -110,24 +171,15 @@ void GuiModeResult::maybe_setup_disp() {
     double min_disp = std::numeric_limits<double>::max();
     double max_disp = 0;
     for (const Results::Result::Step &step : result->steps) {
-        double step_disp = 0;
-        const ContiguousMap<NodeId, Vector> *disp =
-            step.datasets.at(disp_key).node_vector.get();
-        const ContiguousMap<NodeId, Vector> *dispi =
-            dispi_key.empty()
-            ? nullptr
-            : step.datasets.at(dispi_key).node_vector.get();
-        for (NodeId ni = disp->key_begin(); ni != disp->key_end(); ++ni) {
-            double mag;
-            if (dispi == nullptr) {
-                mag = (*disp)[ni].magnitude();
-            } else {
-                mag = ComplexVector((*disp)[ni], (*dispi)[ni]).magnitude();
-            }
-            if (isnan(mag)) {
-                continue;
-            }
-            step_disp = std::max(step_disp, mag);
+        double step_disp = dataset_max(
+            step.datasets.at(disp_key), SubVariable::VectorMagnitude);
+        if (!dispi_key.empty()) {
+            /* The real and imaginary parts might peak at different nodes, so
+            this overestimates the peak magnitude; but it's close enough for
+            suggesting exaggeration factors. */
+            double step_dispi = dataset_max(
+                step.datasets.at(dispi_key), SubVariable::VectorMagnitude);
+            step_disp = sqrt(step_disp * step_disp + step_dispi * step_dispi);
         }
         if (step_disp != 0) {
             min_disp = std::min(min_disp, step_disp);
@@ -220,7 +272,7 @@ void GuiModeResult::maybe_setup_disp() {
     [this](int new_index) {
         disp_scale =
             combo_box_disp_scale->itemData(new_index).value<double>();
-        emit refresh_scene();
+        invalidate_scenes();
     });
 
     checkbox_animate = new QCheckBox(this);
@@ -228,82 +280,87 @@ void GuiModeResult::maybe_setup_disp() {
     connect(checkbox_animate, &QCheckBox::stateChanged,
     [this](int new_state) {
         animate_active = (new_state == Qt::Checked);
-        emit refresh_scene();
+        invalidate_scenes();
     });
     if (combo_box_frequency == nullptr) {
         checkbox_animate->setText("Animate");
         animate_mode_if_active = GuiOpenglScene::AnimateMode::Sawtooth;
-        animate_hz = 1.0;
     } else {
-        refresh_animate_hz();
+        refresh_animate_label();
         animate_mode_if_active = GuiOpenglScene::AnimateMode::Sine;
     }
 }
 
-void GuiModeResult::refresh_animate_hz() {
+void GuiModeResult::refresh_animate_label() {
     if (checkbox_animate == nullptr) {
         return;
     }
 
     double true_hz = result->steps[step_index].frequency;
-    if (true_hz > 5) {
-        double divider = 1;
-        while (true_hz / divider > 5) divider *= 10;
-        animate_hz = true_hz / divider;
+    double animate_hz = watchable_animate_hz(true_hz);
+    if (animate_hz < true_hz) {
         checkbox_animate->setText(
-            tr(u8"Animate (%1\u00D7 slowed)").arg(divider));
-    } else if (true_hz < 0.2) {
-        double multiplier = 1;
-        while (true_hz * multiplier < 0.2) multiplier *= 10;
-        animate_hz = true_hz * multiplier;
+            tr(u8"Animate (%1\u00D7 slowed)").arg(true_hz / animate_hz));
+    } else if (animate_hz > true_hz) {
         checkbox_animate->setText(
-            tr(u8"Animate (%1\u00D7 sped up)").arg(multiplier));
+            tr(u8"Animate (%1\u00D7 sped up)").arg(animate_hz / true_hz));
     } else {
-        animate_hz = true_hz;
         checkbox_animate->setText(tr(u8"Animate (real-time)"));
     }
 }
 
+std::vector<std::pair<SubVariable, QString> >
+        GuiModeResult::dataset_subvariables(const std::string &variable) {
+    const Results::Dataset &dataset = first_step()->datasets.at(variable);
+    std::vector<std::pair<SubVariable, QString> > subvars;
+    auto add = [&](SubVariable subvar, const QString &name) {
+        subvars.push_back(std::make_pair(subvar, name));
+    };
+    if (dataset.type == Results::Dataset::Type::Scalar) {
+        add(SubVariable::ScalarValue, tr("Value"));
+    } else if (dataset.type == Results::Dataset::Type::Vector) {
+        add(SubVariable::VectorMagnitude, tr("Magnitude"));
+        add(SubVariable::VectorX, tr("X Component"));
+        add(SubVariable::VectorY, tr("Y Component"));
+        add(SubVariable::VectorZ, tr("Z Component"));
+    } else if (dataset.type == Results::Dataset::Type::ComplexVector) {
+        add(SubVariable::ComplexVectorMagnitude, tr("Magnitude"));
+    } else if (dataset.type == Results::Dataset::Type::Matrix) {
+        if (variable == "STRESS" || variable == "ISTRESS") {
+            add(SubVariable::MatrixVonMisesStress, tr("Von Mises Stress"));
+            add(SubVariable::MatrixMaxPrincipal, tr("Max Principal Stress"));
+            add(SubVariable::MatrixMidPrincipal, tr("Mid Principal Stress"));
+            add(SubVariable::MatrixMinPrincipal, tr("Min Principal Stress"));
+        }
+        add(SubVariable::MatrixXX, tr("XX Component"));
+        add(SubVariable::MatrixYY, tr("YY Component"));
+        add(SubVariable::MatrixZZ, tr("ZZ Component"));
+        add(SubVariable::MatrixXY, tr("XY Component"));
+        add(SubVariable::MatrixYZ, tr("YZ Component"));
+        add(SubVariable::MatrixZX, tr("ZX Component"));
+    } else {
+        assert(false);
+    }
+    return subvars;
+}
+
+QString GuiModeResult::format_value(const std::string &variable, double value) {
+    if (isnan(value)) {
+        return tr("N/A");
+    }
+    Unit unit = project->unit_system.suggest_unit(
+        guess_unit_type_for_dataset(variable), value);
+    WithUnit<double> value_2 = project->unit_system.system_to_unit(unit, value);
+    return QString("%1%2").arg(value_2.value_in_unit).arg(unit.name.c_str());
+}
+
 void GuiModeResult::set_color_variable(const std::string &new_var) {
     color_variable = new_var;
 
-    const Results::Dataset &dataset = first_step()->datasets.at(color_variable);
-
     combo_box_color_subvariable->clear();
-    if (dataset.node_scalar) {
-        combo_box_color_subvariable->addItem(tr("Value"),
-            QVariant(static_cast<int>(SubVariable::ScalarValue)));
-    } else if (dataset.node_vector) {
-        combo_box_color_subvariable->addItem(tr("Magnitude"),
-            QVariant(static_cast<int>(SubVariable::VectorMagnitude)));
-        combo_box_color_subvariable->addItem(tr("X Component"),
-            QVariant(static_cast<int>(SubVariable::VectorX)));
-        combo_box_color_subvariable->addItem(tr("Y Component"),
-            QVariant(static_cast<int>(SubVariable::VectorY)));
-        combo_box_color_subvariable->addItem(tr("Z Component"),
-            QVariant(static_cast<int>(SubVariable::VectorZ)));
-    } else if (dataset.node_complex_vector) {
-        combo_box_color_subvariable->addItem(tr("Magnitude"),
-            QVariant(static_cast<int>(SubVariable::ComplexVectorMagnitude)));
-    } else if (dataset.node_matrix) {
-        if (color_variable == "STRESS" || color_variable == "ISTRESS") {
-            combo_box_color_subvariable->addItem(tr("Von Mises Stress"),
-                QVariant(static_cast<int>(SubVariable::MatrixVonMisesStress)));
-        }
-        combo_box_color_subvariable->addItem(tr("XX Component"),
-            QVariant(static_cast<int>(SubVariable::MatrixXX)));
-        combo_box_color_subvariable->addItem(tr("YY Component"),
-            QVariant(static_cast<int>(SubVariable::MatrixYY)));
-        combo_box_color_subvariable->addItem(tr("ZZ Component"),
-            QVariant(static_cast<int>(SubVariable::MatrixZZ)));
-        combo_box_color_subvariable->addItem(tr("XY Component"),
-            QVariant(static_cast<int>(SubVariable::MatrixXY)));
-        combo_box_color_subvariable->addItem(tr("YZ Component"),
-            QVariant(static_cast<int>(SubVariable::MatrixYZ)));
-        combo_box_color_subvariable->addItem(tr("ZX Component"),
-            QVariant(static_cast<int>(SubVariable::MatrixZX)));
-    } else {
-        assert(false);
+    for (const auto &pair : dataset_subvariables(color_variable)) {
+        combo_box_color_subvariable->addItem(pair.second,
+            QVariant(static_cast<int>(pair.first)));
     }
 
     combo_box_color_subvariable->setCurrentIndex(0);
@@ -317,44 +374,89 @@ void GuiModeResult::set_color_variable(const std::string &new_var) {
     }
     set_color_subvariable(static_cast<SubVariable>(
         combo_box_color_subvariable->currentData().value<int>()));
+    refresh_load_error();
+}
+
+void GuiModeResult::refresh_load_error() {
+    const Results::Result::Step &step = result->steps[step_index];
+    QString text;
+    for (const std::string &key : {color_variable, disp_key, dispi_key}) {
+        if (key.empty()) {
+            continue;
+        }
+        std::shared_ptr<const Results::Dataset::Values> values =
+            step.datasets.at(key).values();
+        if (!values->load_error.empty()) {
+            text += tr("Couldn't read %1 from the CalculiX output file: %2\n")
+                .arg(key.c_str())
+                .arg(values->load_error.c_str());
+        }
+    }
+    load_error_label->setText(text.trimmed());
+    load_error_label->setVisible(!text.isEmpty());
 }
 
 void GuiModeResult::set_color_subvariable(SubVariable new_subvar) {
     color_subvariable = new_subvar;
+    /* set_color_variable() always comes through here too */
+    isosurface_ranges = nullptr;
 
+    int component = subvariable_component(color_subvariable);
     double min_datum = std::numeric_limits<double>::max();
     double max_datum = std::numeric_limits<double>::lowest();
+    QuantileSketch<double> sketch;
     for (const Results::Result::Step &step : result->steps) {
-        const Results::Dataset &dataset = step.datasets.at(color_variable);
-        for (NodeId ni = dataset.node_begin(); ni != dataset.node_end(); ++ni) {
-            double datum = dataset.subvariable_value(color_subvariable, ni);
-            if (!isnan(datum)) {
-                min_datum = std::min(min_datum, datum);
-                max_datum = std::max(max_datum, datum);
-            }
+        std::shared_ptr<const Results::Dataset::Stats> stats =
+            step.datasets.at(color_variable).stats();
+        if (!isnan(stats->component_min[component])) {
+            min_datum = std::min(min_datum, stats->component_min[component]);
+            max_datum = std::max(max_datum, stats->component_max[component]);
         }
+        sketch.merge(stats->component_sketches[component]);
     }
 
     if (min_datum == std::numeric_limits<double>::max() &&
             max_datum == std::numeric_limits<double>::lowest()) {
         /* All values in dataset are NaN; just make up some dummy values */
-        min_datum = -1;
-        max_datum = 1;
+        color_full_range[0] = color_percentile_range[0] = -1;
+        color_full_range[1] = color_percentile_range[1] = 1;
+    } else {
+        color_full_range[0] = min_datum;
+        color_full_range[1] = max_datum;
+        color_percentile_range[0] = sketch.percentile(1);
+        color_percentile_range[1] = sketch.percentile(99);
     }
 
     if (color_subvariable == SubVariable::VectorMagnitude ||
             color_subvariable == SubVariable::ComplexVectorMagnitude ||
             color_subvariable == SubVariable::MatrixVonMisesStress) {
-        min_datum = 0;
+        color_full_range[0] = color_percentile_range[0] = 0;
     }
 
+    refresh_color_scale();
+}
+
+const double *GuiModeResult::color_range() {
+    bool percentile = (combo_box_color_range->currentIndex() == 1);
+    return percentile ? color_percentile_range : color_full_range;
+}
+
+void GuiModeResult::refresh_color_scale() {
+    bool percentile = (combo_box_color_range->currentIndex() == 1);
+    const double *range = color_range();
     color_scale->set_range(
-        min_datum,
-        max_datum,
+        range[0],
+        range[1],
+        checkbox_color_log->isChecked()
+            ? GuiColorScale::Mapping::Logarithmic
+            : GuiColorScale::Mapping::Linear,
+        percentile &&
+            (range[0] > color_full_range[0] || range[1] < color_full_range[1]),
         &project->unit_system,
         guess_unit_type_for_dataset(color_variable));
 
-    emit refresh_scene();
+    refresh_isosurface_label();
+    invalidate_scenes();
 }
 
 void GuiModeResult::maybe_setup_measurements() {
@@ -392,94 +494,524 @@ void GuiModeResult::refresh_measurements() {
             QString(measure_pair.first.c_str())));
 
         double max_datum = measure_pair.second.measure(*project, step);
+        measurement_table->setItem(row, 1, new QTableWidgetItem(
+            format_value(measure_pair.second.dataset, max_datum)));
+        ++row;
+    }
+}
+
+void GuiModeResult::setup_pick() {
+    create_widget_label(tr("Picked node"));
+    pick_label = new QLabel(tr("Click on the model to pick a node."), this);
+    pick_label->setWordWrap(true);
+    layout->addWidget(pick_label);
+
+    pick_table = new QTableWidget(0, 2, this);
+    pick_table->verticalHeader()->hide();
+    pick_table->horizontalHeader()->hide();
+    pick_table->setSelectionMode(QAbstractItemView::NoSelection);
+    pick_table->horizontalHeader()
+        ->setSectionResizeMode(0, QHeaderView::Stretch);
+    pick_table->horizontalHeader()
+        ->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    pick_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    pick_table->setDragEnabled(false);
+    pick_table->hide();
+    layout->addWidget(pick_table);
+}
+
+void GuiModeResult::show_pick(const GuiOpenglPick *pick) {
+    if (pick != nullptr) {
+        pick_node_id = pick->node_id;
+        pick_element_id = pick->element_id;
+    } else {
+        pick_node_id = NodeId::invalid();
+        pick_element_id = ElementId::invalid();
+    }
+    refresh_pick();
+}
+
+void GuiModeResult::refresh_pick() {
+    if (pick_node_id == NodeId::invalid()) {
+        pick_label->show();
+        pick_table->hide();
+        return;
+    }
+    pick_label->hide();
+    pick_table->show();
+
+    const Results::Result::Step &step = result->steps[step_index];
+    pick_table->setRowCount(0);
+    auto add_row = [&](const QString &name, const QString &value) {
+        int row = pick_table->rowCount();
+        pick_table->insertRow(row);
+        pick_table->setItem(row, 0, new QTableWidgetItem(name));
+        pick_table->setItem(row, 1, new QTableWidgetItem(value));
+    };
+
+    add_row(tr("Node"), QString::number(pick_node_id.to_int()));
+    add_row(tr("Element"), QString::number(pick_element_id.to_int()));
+    Unit length_unit = project->unit_system.suggest_unit(
+        UnitType::Length, project->approx_scale);
+    WithUnit<Vector> position = project->unit_system.system_to_unit(
+        length_unit,
+        project->mesh->nodes[pick_node_id].point - Point::origin());
+    add_row(tr("Position"), QString("(%1, %2, %3)%4")
+        .arg(position.value_in_unit.x)
+        .arg(position.value_in_unit.y)
+        .arg(position.value_in_unit.z)
+        .arg(length_unit.name.c_str()));
+
+    for (const auto &pair : step.datasets) {
+        std::shared_ptr<const Results::Dataset::Values> values =
+            pair.second.values();
+        for (const auto &subvar : dataset_subvariables(pair.first)) {
+            QString name = (pair.second.type == Results::Dataset::Type::Scalar)
+                ? QString(pair.first.c_str())
+                : tr("%1 %2").arg(pair.first.c_str()).arg(subvar.second);
+            add_row(name, format_value(pair.first,
+                values->subvariable_value(subvar.first, pick_node_id)));
+        }
+    }
+}
+
+static const int section_slider_steps = 1000;
+
+void GuiModeResult::setup_section() {
+    create_widget_label(tr("Section"));
+    combo_box_section_axis = new QComboBox(this);
+    layout->addWidget(combo_box_section_axis);
+    combo_box_section_axis->addItem(tr("None"));
+    combo_box_section_axis->addItem(tr("Cut across X axis"));
+    combo_box_section_axis->addItem(tr("Cut across Y axis"));
+    combo_box_section_axis->addItem(tr("Cut across Z axis"));
+
+    slider_section = new QSlider(Qt::Horizontal, this);
+    slider_section->setRange(0, section_slider_steps);
+    slider_section->setValue(section_slider_steps / 2);
+    slider_section->setEnabled(false);
+    layout->addWidget(slider_section);
+
+    connect(combo_box_section_axis, QOverload<int>::of(&QComboBox::activated),
+    [this](int new_index) {
+        slider_section->setEnabled(new_index != 0);
+        if (new_index != 0) {
+            start_section_index();
+        }
+        section = nullptr;
+        emit refresh_scene();
+    });
+    connect(slider_section, &QSlider::valueChanged,
+    [this](int) {
+        section = nullptr;
+        emit refresh_scene();
+    });
+}
+
+std::shared_ptr<const GuiOpenglSection> GuiModeResult::make_section() {
+    int axis = combo_box_section_axis->currentIndex() - 1;
+    if (axis == -1) {
+        return nullptr;
+    }
+    if (!section) {
+        std::shared_future<std::shared_ptr<const SectionIndex> > index =
+            start_section_index();
+        if (index.wait_for(std::chrono::seconds(0))
+                != std::future_status::ready) {
+            return nullptr;
+        }
+        section = build_section(axis, *index.get());
+    }
+    return section;
+}
 
-        if (isnan(max_datum)) {
-            measurement_table->setItem(row, 1, new QTableWidgetItem(tr("N/A")));
+void GuiModeResult::timerEvent(QTimerEvent *event) {
+    if (event->timerId() != section_index_timer) {
+        GuiModeAbstract::timerEvent(event);
+        return;
+    }
+    if (section_index.wait_for(std::chrono::seconds(0))
+            == std::future_status::ready) {
+        killTimer(section_index_timer);
+        section_index_timer = -1;
+        section = nullptr;
+        emit refresh_scene();
+    }
+}
+
+std::shared_future<std::shared_ptr<const GuiModeResult::SectionIndex> >
+        GuiModeResult::start_section_index() {
+    if (section_index.valid()) {
+        return section_index;
+    }
+    std::shared_ptr<const Project> project_copy = project;
+    section_index = std::async(std::launch::async, [project_copy]() {
+        const Mesh3 &mesh = *project_copy->mesh;
+        std::shared_ptr<SectionIndex> index(new SectionIndex);
+        index->element_bvh = element_bvh(mesh);
+        Point p = mesh.nodes.begin()->point;
+        index->box = Box(p.x, p.y, p.z, p.x, p.y, p.z);
+        for (const Node3 &node : mesh.nodes) {
+            index->box.xl = std::min(index->box.xl, node.point.x);
+            index->box.yl = std::min(index->box.yl, node.point.y);
+            index->box.zl = std::min(index->box.zl, node.point.z);
+            index->box.xh = std::max(index->box.xh, node.point.x);
+            index->box.yh = std::max(index->box.yh, node.point.y);
+            index->box.zh = std::max(index->box.zh, node.point.z);
+        }
+        return std::shared_ptr<const SectionIndex>(index);
+    }).share();
+    section_index_timer = startTimer(50);
+    return section_index;
+}
+
+std::shared_ptr<const GuiOpenglSection> GuiModeResult::build_section(
+    int axis,
+    const SectionIndex &index
+) {
+    const Mesh3 &mesh = *project->mesh;
+
+    double lo[3] = {index.box.xl, index.box.yl, index.box.zl};
+    double hi[3] = {index.box.xh, index.box.yh, index.box.zh};
+    double offset = lo[axis] + (hi[axis] - lo[axis])
+        * slider_section->value() / section_slider_steps;
+    Vector normal(axis == 0, axis == 1, axis == 2);
+
+    /* Only the elements whose boxes straddle the plane are cut */
+    std::vector<ElementId> element_ids;
+    int key_begin = mesh.elements.key_begin().to_int();
+    index.element_bvh.plane_query(normal, offset, [&](int i) {
+        element_ids.push_back(ElementId::from_int(key_begin + i));
+    });
+    std::vector<CutPoint> cut_points;
+    std::vector<ElementId> triangle_elements;
+    cut_elements(mesh, element_ids,
+        [&](NodeId node_id) {
+            return normal.dot(mesh.nodes[node_id].point - Point::origin());
+        },
+        offset, &cut_points, &triangle_elements);
+
+    /* The cut points are between nodes, so their deltas and values are
+    interpolated between the nodes'. The value is interpolated rather than the
+    color, so the section's colors match the color scale. */
+    SceneSettings settings = scene_settings();
+    NodeAppearance appearance(settings, step_index);
+    std::shared_ptr<GuiOpenglSection> new_section(
+        new GuiOpenglSection(normal, offset, cut_points.size()));
+    new_section->triangle_elements = std::move(triangle_elements);
+    parallel_for_chunks(0, cut_points.size(), 1 << 14,
+        [&](int point_begin, int point_end, int) {
+            for (int point = point_begin; point < point_end; ++point) {
+                const CutPoint &cut = cut_points[point];
+                new_section->point_nodes[point] =
+                    (cut.weight < 0.5) ? cut.node_a : cut.node_b;
+                new_section->triangles.set_point(
+                    point,
+                    cut.point(mesh),
+                    cut.interpolate(
+                        appearance.delta(cut.node_a),
+                        appearance.delta(cut.node_b)),
+                    appearance.rgb(cut.interpolate(
+                        appearance.color_value(cut.node_a),
+                        appearance.color_value(cut.node_b))));
+            }
+        });
+    return new_section;
+}
+
+static const int isosurface_slider_steps = 1000;
+
+void GuiModeResult::setup_isosurface() {
+    create_widget_label(tr("Isosurface"));
+    checkbox_isosurface = new QCheckBox(tr("Show isosurface"), this);
+    layout->addWidget(checkbox_isosurface);
+
+    slider_isosurface = new QSlider(Qt::Horizontal, this);
+    slider_isosurface->setRange(0, isosurface_slider_steps);
+    slider_isosurface->setValue(isosurface_slider_steps / 2);
+    slider_isosurface->setEnabled(false);
+    layout->addWidget(slider_isosurface);
+
+    isosurface_label = new QLabel(this);
+    layout->addWidget(isosurface_label);
+    refresh_isosurface_label();
+
+    /* The surface of the mesh switches to x-ray while the isosurface is shown,
+    so that the isosurface can be seen through it; that's a different scene */
+    connect(checkbox_isosurface, &QCheckBox::stateChanged,
+    [this](int new_state) {
+        slider_isosurface->setEnabled(new_state == Qt::Checked);
+        invalidate_scenes();
+    });
+    connect(slider_isosurface, &QSlider::valueChanged,
+    [this](int) {
+        refresh_isosurface_label();
+        isosurface = nullptr;
+        emit refresh_scene();
+    });
+}
+
+double GuiModeResult::isosurface_level() {
+    const double *range = color_range();
+    return range[0] + (range[1] - range[0])
+        * slider_isosurface->value() / isosurface_slider_steps;
+}
+
+void GuiModeResult::refresh_isosurface_label() {
+    if (isosurface_label == nullptr) {
+        return;
+    }
+    isosurface_label->setText(tr("At %1").arg(
+        format_value(color_variable, isosurface_level())));
+}
+
+std::shared_ptr<const GuiOpenglTriangles> GuiModeResult::make_isosurface() {
+    if (!checkbox_isosurface->isChecked()) {
+        return nullptr;
+    }
+    if (isosurface) {
+        return isosurface;
+    }
+
+    const Mesh3 &mesh = *project->mesh;
+    SceneSettings settings = scene_settings();
+    NodeAppearance appearance(settings, step_index);
+    auto node_value = [&](NodeId node_id) {
+        return appearance.color_value(node_id);
+    };
+    if (!isosurface_ranges) {
+        isosurface_ranges = std::make_shared<const ElementRanges>(
+            mesh, node_value);
+    }
+
+    double level = isosurface_level();
+    std::vector<CutPoint> cut_points;
+    cut_elements(mesh, isosurface_ranges->elements_at(level), node_value,
+        level, &cut_points);
+
+    /* The whole isosurface has the same value, so it's all the same color */
+    const uint8_t *rgb = appearance.rgb(level);
+    std::shared_ptr<GuiOpenglTriangles> new_isosurface(
+        new GuiOpenglTriangles(cut_points.size()));
+    parallel_for_chunks(0, cut_points.size(), 1 << 14,
+        [&](int point_begin, int point_end, int) {
+            for (int point = point_begin; point < point_end; ++point) {
+                const CutPoint &cut = cut_points[point];
+                new_isosurface->set_point(
+                    point,
+                    cut.point(mesh),
+                    cut.interpolate(
+                        appearance.delta(cut.node_a),
+                        appearance.delta(cut.node_b)),
+                    rgb);
+            }
+        });
+    isosurface = new_isosurface;
+    return isosurface;
+}
+
+void GuiModeResult::invalidate_scenes() {
+    scenes.clear();
+    section = nullptr;
+    isosurface = nullptr;
+    emit refresh_scene();
+}
+
+std::shared_ptr<const GuiOpenglScene> GuiModeResult::make_scene() {
+    /* If the worker hasn't started on this step's scene yet, build it here
+    rather than waiting in line; if it's already building it, wait for it */
+    std::shared_ptr<SceneJob> job = scene_job(step_index, false);
+    job->run();
+    std::shared_ptr<const GuiOpenglScene> scene = job->scene.get();
+
+    /* Keep only the scenes for this step and the ones on either side of it,
+    and start building the latter in the background, so that stepping through
+    the frequencies one at a time doesn't have to wait */
+    int num_steps = result->steps.size();
+    for (auto it = scenes.begin(); it != scenes.end();) {
+        if (abs(it->first - step_index) > 1) {
+            it = scenes.erase(it);
         } else {
-            Unit unit = project->unit_system.suggest_unit(
-                guess_unit_type_for_dataset(measure_pair.second.dataset),
-                max_datum);
-            WithUnit<double> max_datum_2 =
-                project->unit_system.system_to_unit(unit, max_datum);
-            measurement_table->setItem(row, 1, new QTableWidgetItem(
-                QString("%1%2")
-                    .arg(max_datum_2.value_in_unit)
-                    .arg(unit.name.c_str())));
+            ++it;
         }
-        ++row;
     }
+    for (int neighbor : {step_index - 1, step_index + 1}) {
+        if (neighbor >= 0 && neighbor < num_steps) {
+            scene_job(neighbor, true);
+        }
+    }
+
+    return scene;
 }
 
-void GuiModeResult::calculate_xrays(
-    FaceSet *xray_faces_out,
-    std::set<std::string> *xray_node_object_names_out
-) const {
-    (void)xray_faces_out;
-    (void)xray_node_object_names_out;
+GuiModeResult::SceneJob::SceneJob(const SceneSettings &settings, int step) :
+    settings(settings),
+    step(step),
+    claimed(false),
+    scene(promise.get_future().share())
+{ }
+
+void GuiModeResult::SceneJob::run() {
+    if (claimed.exchange(true)) {
+        return;
+    }
+    try {
+        promise.set_value(build_scene(settings, step));
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
 }
 
-void GuiModeResult::calculate_face_attributes(
-    FaceId face_id,
-    NodeId node_id,
-    ComplexVector *displacement_out,
-    QColor *color_out
-) const {
-    (void)face_id;
+std::shared_ptr<GuiModeResult::SceneJob> GuiModeResult::scene_job(
+    int step,
+    bool background
+) {
+    std::shared_ptr<SceneJob> &job = scenes[step];
+    if (job) {
+        return job;
+    }
+    job = std::make_shared<SceneJob>(scene_settings(), step);
+    if (background) {
+        std::weak_ptr<SceneJob> weak_job = job;
+        scene_worker.post([weak_job]() {
+            if (std::shared_ptr<SceneJob> job = weak_job.lock()) {
+                job->run();
+            }
+        });
+    }
+    return job;
+}
 
-    const Results::Result::Step &step = result->steps[step_index];
+GuiModeResult::SceneSettings GuiModeResult::scene_settings() {
+    if (!scene_geometry) {
+        std::shared_ptr<std::vector<NodeId> > point_nodes(
+            new std::vector<NodeId>);
+        scene_geometry = gui_opengl_geometry_mesh(*project, point_nodes.get());
+        scene_point_nodes = point_nodes;
+    }
+    bool xray = checkbox_isosurface != nullptr
+        && checkbox_isosurface->isChecked();
+    if (xray && !scene_xray_geometry) {
+        std::vector<NodeId> point_nodes;
+        scene_xray_geometry =
+            gui_opengl_geometry_mesh(*project, &point_nodes, true);
+        assert(point_nodes == *scene_point_nodes);
+    }
 
-    if (!dispi_key.empty()) {
-        Vector disp = (*step.datasets.at(disp_key).node_vector)[node_id];
-        Vector dispi = (*step.datasets.at(dispi_key).node_vector)[node_id];
+    SceneSettings settings;
+    settings.project = project;
+    settings.result = result;
+    settings.geometry = xray ? scene_xray_geometry : scene_geometry;
+    settings.point_nodes = scene_point_nodes;
+    settings.disp_key = disp_key;
+    settings.dispi_key = dispi_key;
+    settings.disp_scale = disp_scale;
+    settings.color_variable = color_variable;
+    settings.color_subvariable = color_subvariable;
+    settings.color_lookup = color_scale->lookup();
+    settings.animate_mode = animate_active
+        ? animate_mode_if_active
+        : GuiOpenglScene::AnimateMode::None;
+    return settings;
+}
+
+/* Results are loaded lazily, so the values for the step are fetched once up
+front rather than for every node */
+GuiModeResult::NodeAppearance::NodeAppearance(
+    const SceneSettings &settings_,
+    int step_index
+) :
+    settings(settings_)
+{
+    const Results::Result::Step &step = settings.result->steps[step_index];
+    if (!settings.disp_key.empty()) {
+        disp_values = step.datasets.at(settings.disp_key).values();
+    }
+    if (!settings.dispi_key.empty()) {
+        dispi_values = step.datasets.at(settings.dispi_key).values();
+    }
+    color_values = step.datasets.at(settings.color_variable).values();
+    color_component =
+        color_values->subvariable_component(settings.color_subvariable);
+}
+
+ComplexVector GuiModeResult::NodeAppearance::delta(NodeId node_id) const {
+    double disp_scale = settings.disp_scale;
+    if (dispi_values) {
+        Vector disp = disp_values->vector(node_id);
+        Vector dispi = dispi_values->vector(node_id);
         if (isnan(disp.x) || isnan(disp.y) || isnan(disp.z)
             || isnan(dispi.x) || isnan(dispi.y) || isnan(dispi.z)) {
-            *displacement_out = ComplexVector::zero();
-        } else {
-            *displacement_out = ComplexVector(disp, dispi) * disp_scale;
+            return ComplexVector::zero();
         }
-    } else if (!disp_key.empty()) {
-        Vector disp = (*step.datasets.at(disp_key).node_vector)[node_id];
+        return ComplexVector(disp, dispi) * disp_scale;
+    } else if (disp_values) {
+        Vector disp = disp_values->vector(node_id);
         if (isnan(disp.x) || isnan(disp.y) || isnan(disp.z)) {
-            *displacement_out = ComplexVector::zero();
-        } else {
-            *displacement_out =
-                ComplexVector(disp * disp_scale, Vector::zero());
+            return ComplexVector::zero();
         }
+        return ComplexVector(disp * disp_scale, Vector::zero());
     } else {
-        *displacement_out = ComplexVector::zero();
+        return ComplexVector::zero();
     }
+}
 
-    double color_datum = step.datasets.at(color_variable)
-        .subvariable_value(color_subvariable, node_id);
-    if (isnan(color_datum)) {
-        *color_out = QColor(30, 30, 30);
-    } else {
-        *color_out = color_scale->color(color_datum);
-    }
+double GuiModeResult::NodeAppearance::color_value(NodeId node_id) const {
+    return color_values->component(color_component, node_id);
 }
 
-void GuiModeResult::calculate_vertex_attributes(
-    const std::string &node_object_name,
-    ComplexVector *displacement_out,
-    QColor *color_out
-) const {
-    NodeId node_id = project->find_node_object(node_object_name)->node_id;
-    calculate_face_attributes(
-        FaceId::invalid(),
-        node_id,
-        displacement_out,
-        color_out);
+const uint8_t *GuiModeResult::NodeAppearance::rgb(double color_value) const {
+    static const uint8_t nan_rgb[3] = {30, 30, 30};
+    if (isnan(color_value)) {
+        return nan_rgb;
+    }
+    return settings.color_lookup.rgb(color_value);
 }
 
-std::shared_ptr<const GuiOpenglScene> GuiModeResult::make_scene() {
-    return gui_opengl_scene_mesh(
-        *project,
-        this,
-        animate_active
-            ? animate_mode_if_active
-            : GuiOpenglScene::AnimateMode::None,
-        animate_hz
-    );
+std::shared_ptr<const GuiOpenglScene> GuiModeResult::build_scene(
+    const SceneSettings &settings,
+    int step_index
+) {
+    const Project &project = *settings.project;
+    const std::vector<NodeId> &point_nodes = *settings.point_nodes;
+    const Results::Result::Step &step = settings.result->steps[step_index];
+
+    NodeAppearance appearance(settings, step_index);
+
+    std::shared_ptr<GuiOpenglScene> scene(
+        new GuiOpenglScene(settings.geometry));
+    parallel_for_chunks(0, point_nodes.size(), 1 << 14,
+        [&](int point_begin, int point_end, int) {
+            for (int point = point_begin; point < point_end; ++point) {
+                NodeId node_id = point_nodes[point];
+                scene->set_point_delta(point, appearance.delta(node_id));
+                scene->set_point_rgb(point,
+                    appearance.rgb(appearance.color_value(node_id)));
+            }
+        });
+
+    auto add_node_object = [&](const Project::NodeObject &node_object) {
+        NodeId node_id = node_object.node_id;
+        const uint8_t *rgb = appearance.rgb(appearance.color_value(node_id));
+        scene->add_vertex(
+            project.mesh->nodes[node_id].point,
+            appearance.delta(node_id),
+            QColor(rgb[0], rgb[1], rgb[2]),
+            false);
+    };
+    for (const auto &pair : project.select_node_objects) {
+        add_node_object(pair.second);
+    }
+    for (const auto &pair : project.create_node_objects) {
+        add_node_object(pair.second);
+    }
+
+    scene->animate_mode = settings.animate_mode;
+    scene->animate_hz =
+        (settings.animate_mode == GuiOpenglScene::AnimateMode::Sine)
+        ? watchable_animate_hz(step.frequency)
+        : 1.0;
+    return scene;
 }
 
 } /* namespace os2cx */
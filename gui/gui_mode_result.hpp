@@ -3,17 +3,21 @@
 
 #include <QCheckBox>
 #include <QComboBox>
+#include <QSlider>
 #include <QTableWidget>
 
+#include <atomic>
+#include <future>
+
+#include "bvh.hpp"
+#include "mesh_cut.hpp"
 #include "gui_color_scale.hpp"
 #include "gui_mode_abstract.hpp"
 #include "gui_opengl_mesh.hpp"
 
 namespace os2cx {
 
-class GuiModeResult :
-    public GuiModeAbstract,
-    private GuiOpenglMeshCallback
+class GuiModeResult : public GuiModeAbstract
 {
 public:
     GuiModeResult(
@@ -21,45 +25,148 @@ public:
         std::shared_ptr<const Project> project,
         const Results::Result *result);
 
-private:
+    void show_pick(const GuiOpenglPick *pick);
 
+    std::shared_ptr<const GuiOpenglSection> make_section();
 
+private:
     /* All the steps have the same datasets, so we often use the first step as
     a "prototypical step" to see which datasets exist. */
     const Results::Result::Step *first_step() {
         return &result->steps.front();
     }
 
+    /* Shows which of the datasets being displayed couldn't be read, if any;
+    their values show up as missing */
+    void refresh_load_error();
+
     void maybe_setup_frequency();
 
     void maybe_setup_disp();
-    void refresh_animate_hz();
+    void refresh_animate_label();
+
+    /* The subvariables that can be shown for dataset 'variable', and their
+    names */
+    std::vector<std::pair<SubVariable, QString> > dataset_subvariables(
+        const std::string &variable);
+
+    /* Formats a value of dataset 'variable' in a suitable unit */
+    QString format_value(const std::string &variable, double value);
 
     void set_color_variable(const std::string &new_var);
     void set_color_subvariable(SubVariable new_subvar);
+    void refresh_color_scale();
+    /* The range of the color scale, as picked by 'combo_box_color_range' */
+    const double *color_range();
 
     void maybe_setup_measurements();
     void refresh_measurements();
 
-    void calculate_xrays(
-        FaceSet *xray_faces_out,
-        std::set<std::string> *xray_node_object_names_out) const;
-
-    void calculate_face_attributes(
-        FaceId face_id,
-        NodeId node_id,
-        ComplexVector *displacement_out,
-        QColor *color_out) const;
-
-    void calculate_vertex_attributes(
-        const std::string &node_object_name,
-        ComplexVector *displacement_out,
-        QColor *color_out) const;
+    void setup_pick();
+    void refresh_pick();
+
+    void setup_section();
+
+    void setup_isosurface();
+    /* The level of the isosurface, per the slider and the color scale */
+    double isosurface_level();
+    void refresh_isosurface_label();
+
+    /* Everything that a scene depends on, other than which step it's for.
+    Scenes are built from a copy of these, so that they can be built on
+    background threads while the user changes the originals. */
+    class SceneSettings {
+    public:
+        std::shared_ptr<const Project> project;
+        const Results::Result *result;
+        std::shared_ptr<const GuiOpenglScene::Geometry> geometry;
+        std::shared_ptr<const std::vector<NodeId> > point_nodes;
+        std::string disp_key, dispi_key;
+        double disp_scale;
+        std::string color_variable;
+        SubVariable color_subvariable;
+        GuiColorScale::Lookup color_lookup;
+        GuiOpenglScene::AnimateMode animate_mode;
+    };
+
+    /* Looks up each node's delta and color in one step's datasets, the way
+    'settings' says to */
+    class NodeAppearance {
+    public:
+        NodeAppearance(const SceneSettings &settings, int step);
+        ComplexVector delta(NodeId node_id) const;
+        /* The value of the color subvariable */
+        double color_value(NodeId node_id) const;
+        const uint8_t *rgb(double color_value) const;
+    private:
+        const SceneSettings &settings;
+        std::shared_ptr<const Results::Dataset::Values> disp_values;
+        std::shared_ptr<const Results::Dataset::Values> dispi_values;
+        std::shared_ptr<const Results::Dataset::Values> color_values;
+        int color_component;
+    };
+
+    /* Returns the current settings. The first call builds the geometry. */
+    SceneSettings scene_settings();
 
     std::shared_ptr<const GuiOpenglScene> make_scene();
 
+    static std::shared_ptr<const GuiOpenglScene> build_scene(
+        const SceneSettings &settings,
+        int step);
+
+    /* A scene that's built either by 'scene_worker', or by make_scene() if it
+    needs the scene before the worker has started on it */
+    class SceneJob {
+    public:
+        SceneJob(const SceneSettings &settings, int step);
+
+        /* Builds the scene, unless someone else already has or is */
+        void run();
+
+        const SceneSettings settings;
+        const int step;
+        std::atomic<bool> claimed;
+        std::promise<std::shared_ptr<const GuiOpenglScene> > promise;
+        std::shared_future<std::shared_ptr<const GuiOpenglScene> > scene;
+    };
+
+    /* Returns the job for 'step' with the current settings, adding it to
+    'scenes' if it isn't there yet. If 'background' is true, a new job is
+    posted to 'scene_worker'. */
+    std::shared_ptr<SceneJob> scene_job(int step, bool background);
+
+    /* Drops the scenes built with the old settings, and shows a new one */
+    void invalidate_scenes();
+
+    /* Everything needed to find which elements a section plane cuts through,
+    without looking at all of them: a BVH over the elements, and the box
+    around the whole mesh, which the slider moves the plane across */
+    class SectionIndex {
+    public:
+        Bvh element_bvh;
+        Box box;
+    };
+
+    /* Starts building the section index in the background, unless it's
+    already built or being built. 'section_index_timer' polls it until it's
+    done, and then refreshes the scene. */
+    std::shared_future<std::shared_ptr<const SectionIndex> >
+        start_section_index();
+
+    /* Cuts the current step along the plane perpendicular to 'axis' that the
+    slider is set to */
+    std::shared_ptr<const GuiOpenglSection> build_section(
+        int axis, const SectionIndex &index);
+
+    void timerEvent(QTimerEvent *event);
+
+    std::shared_ptr<const GuiOpenglTriangles> make_isosurface();
+
     const Results::Result *result;
 
+    QLabel *load_error_label;
+
     QComboBox *combo_box_frequency;
     int step_index;
 
@@ -69,7 +176,6 @@ private:
     QCheckBox *checkbox_animate;
     bool animate_active;
     GuiOpenglScene::AnimateMode animate_mode_if_active;
-    double animate_hz;
 
     QComboBox *combo_box_color_variable;
     std::string color_variable;
@@ -77,9 +183,63 @@ private:
     QComboBox *combo_box_color_subvariable;
     SubVariable color_subvariable;
 
+    /* [min, max] of the color subvariable over all the steps, and the range
+    from its 1st to 99th percentile, which isn't thrown off by a few extreme
+    nodes (e.g. stress singularities at sharp corners). Both come from the
+    datasets' precomputed stats, so neither has to look at the values. */
+    double color_full_range[2], color_percentile_range[2];
+
+    QComboBox *combo_box_color_range;
+    QCheckBox *checkbox_color_log;
     GuiColorScale *color_scale;
 
+    /* The geometry doesn't depend on anything the user picks, so it's built
+    once, the first time make_scene() is called. Then each scene only has to
+    compute the deltas and colors of 'scene_point_nodes'. The x-ray geometry,
+    with the same points, is used instead while the isosurface is shown; it's
+    built the first time that happens. */
+    std::shared_ptr<const GuiOpenglScene::Geometry> scene_geometry;
+    std::shared_ptr<const GuiOpenglScene::Geometry> scene_xray_geometry;
+    std::shared_ptr<const std::vector<NodeId> > scene_point_nodes;
+
+    /* Scenes for the current settings, by step: the current step's, and the
+    ones on either side of it, which may still be being built in the
+    background. The worker only holds weak pointers to the jobs, so dropping
+    one never waits for it: if it hasn't started, it's skipped, and if it's
+    running, its scene is thrown away when it's done. */
+    std::map<int, std::shared_ptr<SceneJob> > scenes;
+    BackgroundWorker scene_worker;
+
     QTableWidget *measurement_table;
+
+    /* The node and element that the user last clicked on, if any */
+    NodeId pick_node_id;
+    ElementId pick_element_id;
+    QLabel *pick_label;
+    QTableWidget *pick_table;
+
+    /* The section index covers every element, so it isn't built until the
+    user first turns on a section. After that, each section only costs as much
+    as the elements that the plane cuts through, so it's rebuilt on every step
+    of a drag. 'section' is null if it has to be rebuilt. Until the index is
+    ready, no section is shown, rather than waiting for it. */
+    QComboBox *combo_box_section_axis;
+    QSlider *slider_section;
+    std::shared_future<std::shared_ptr<const SectionIndex> > section_index;
+    int section_index_timer;
+    std::shared_ptr<const GuiOpenglSection> section;
+
+    /* The isosurface is of the color subvariable, at a level that the slider
+    picks from the color scale's range. The element ranges only depend on the
+    step and the subvariable, so they're kept when the color scale or the
+    displacement changes; and as the slider moves, only the elements that the
+    new level passes through have to be cut. Both are null if they have to be
+    rebuilt. */
+    QCheckBox *checkbox_isosurface;
+    QSlider *slider_isosurface;
+    QLabel *isosurface_label;
+    std::shared_ptr<const ElementRanges> isosurface_ranges;
+    std::shared_ptr<const GuiOpenglTriangles> isosurface;
 };
 
 } /* namespace os2cx */
@@ -2,12 +2,19 @@
 
 namespace os2cx {
 
-void gui_opengl_scene_mesh_face(
+/* Roughly how many triangles a software renderer can draw at an interactive
+frame rate */
+static const int interactive_triangles = 200000;
+
+/* Adds the triangles and lines for face 'face_id' to 'geometry'. The point for
+each of the face's nodes comes from 'point_for_node(node_id)'. */
+template<class PointForNode>
+static void gui_opengl_geometry_mesh_face(
     const Project &project,
-    const GuiOpenglMeshCallback *callback,
     FaceId face_id,
     bool xray,
-    GuiOpenglScene *scene
+    const PointForNode &point_for_node,
+    GuiOpenglScene::Geometry *geometry
 ) {
     const Element3 &element = project.mesh->elements[face_id.element_id];
     const ElementTypeShape &shape = element_type_shape(element.type);
@@ -17,13 +24,9 @@ void gui_opengl_scene_mesh_face(
         node_ids[i] = element.nodes[face.vertices[i]];
     }
 
-    Point ps[ElementTypeShape::max_vertices_per_face];
-    ComplexVector ds[ElementTypeShape::max_vertices_per_face];
-    QColor cs[ElementTypeShape::max_vertices_per_face];
+    int ps[ElementTypeShape::max_vertices_per_face];
     for (int i = 0; i < static_cast<int>(face.vertices.size()); ++i) {
-        ps[i] = project.mesh->nodes[node_ids[i]].point;
-        callback->calculate_face_attributes(
-            face_id, node_ids[i], &ds[i], &cs[i]);
+        ps[i] = point_for_node(node_ids[i]);
     }
 
     int n;
@@ -52,13 +55,8 @@ void gui_opengl_scene_mesh_face(
         assert(false);
     }
     for (int i = 0; i < n; ++i) {
-        Point subps[3] =
-            {ps[ixs[i][0]], ps[ixs[i][1]], ps[ixs[i][2]]};
-        ComplexVector subds[3] =
-            {ds[ixs[i][0]], ds[ixs[i][1]], ds[ixs[i][2]]};
-        QColor subcs[3] =
-            {cs[ixs[i][0]], cs[ixs[i][1]], cs[ixs[i][2]]};
-        scene->add_triangle(subps, subds, subcs, xray);
+        int subps[3] = {ps[ixs[i][0]], ps[ixs[i][1]], ps[ixs[i][2]]};
+        geometry->add_triangle(subps, xray, face_id.element_id);
     }
 
     for (int i = 0; i < static_cast<int>(face.vertices.size()); ++i) {
@@ -67,13 +65,62 @@ void gui_opengl_scene_mesh_face(
         traverse it in opposite directions. Only draw one of the two
         directions so that we don't draw each line twice. */
         if (node_ids[i].to_int() > node_ids[j].to_int()) {
-            Point line_ps[2] = {ps[i], ps[j]};
-            ComplexVector line_ds[2] = {ds[i], ds[j]};
-            scene->add_line(line_ps, line_ds, xray);
+            int line_ps[2] = {ps[i], ps[j]};
+            geometry->add_line(line_ps, xray);
         }
     }
 }
 
+/* Assigns points to mesh nodes, for gui_opengl_scene_mesh(). Faces usually
+share their nodes' points with their neighbors; but a node gets a separate
+point for each distinct color or displacement that the callback gives it on
+different faces, e.g. on the border between differently-colored surfaces. */
+class GuiOpenglMeshPoints {
+public:
+    GuiOpenglMeshPoints(const Mesh3 &mesh) :
+        node_points(mesh.nodes.key_begin(), mesh.nodes.key_end(), -1) { }
+
+    int point(
+        const Mesh3 &mesh,
+        NodeId node_id,
+        const ComplexVector &delta,
+        const QColor &color,
+        GuiOpenglScene::Geometry *geometry
+    ) {
+        for (int i = node_points[node_id]; i != -1; i = points[i].next) {
+            if (points[i].delta == delta && points[i].color == color) {
+                return i;
+            }
+        }
+        int index = geometry->add_point(mesh.nodes[node_id].point, node_id);
+        assert(index == static_cast<int>(points.size()));
+        PointInfo info;
+        info.delta = delta;
+        info.color = color;
+        info.next = node_points[node_id];
+        points.push_back(info);
+        node_points[node_id] = index;
+        return index;
+    }
+
+    void set_point_attributes(GuiOpenglScene *scene) const {
+        for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+            scene->set_point_delta(i, points[i].delta);
+            scene->set_point_color(i, points[i].color);
+        }
+    }
+
+private:
+    struct PointInfo {
+        ComplexVector delta;
+        QColor color;
+        /* The next point for the same node, or -1 */
+        int next;
+    };
+    ContiguousMap<NodeId, int> node_points;
+    std::vector<PointInfo> points;
+};
+
 void gui_opengl_scene_mesh_vertex(
     const Project &project,
     const GuiOpenglMeshCallback *callback,
@@ -99,38 +146,82 @@ std::shared_ptr<const GuiOpenglScene> gui_opengl_scene_mesh(
     const GuiOpenglScene::AnimateMode animate_mode,
     double animate_hz
 ) {
-    GuiOpenglScene scene;
+    std::shared_ptr<GuiOpenglScene::Geometry> geometry(
+        new GuiOpenglScene::Geometry);
+    GuiOpenglMeshPoints points(*project.mesh);
 
     FaceSet xray_faces;
     std::set<std::string> xray_node_object_names;
     callback->calculate_xrays(&xray_faces, &xray_node_object_names);
 
+    auto add_face = [&](FaceId face_id, bool xray) {
+        gui_opengl_geometry_mesh_face(project, face_id, xray,
+            [&](NodeId node_id) {
+                ComplexVector delta;
+                QColor color;
+                callback->calculate_face_attributes(
+                    face_id, node_id, &delta, &color);
+                return points.point(
+                    *project.mesh, node_id, delta, color, geometry.get());
+            },
+            geometry.get());
+    };
     for (FaceId face_id : project.mesh_index->unmatched_faces) {
         if (!xray_faces.faces.count(face_id)) {
-            gui_opengl_scene_mesh_face(
-                project, callback, face_id, false, &scene);
+            add_face(face_id, false);
         }
     }
     for (FaceId face_id : xray_faces.faces) {
-        gui_opengl_scene_mesh_face(
-            project, callback, face_id, true, &scene);
+        add_face(face_id, true);
     }
 
+    std::shared_ptr<GuiOpenglScene> scene(new GuiOpenglScene(geometry));
+    points.set_point_attributes(scene.get());
+
     for (const auto &pair : project.select_node_objects) {
         bool xray = xray_node_object_names.count(pair.first);
         gui_opengl_scene_mesh_vertex(
-            project, callback, pair.first, pair.second, xray, &scene);
+            project, callback, pair.first, pair.second, xray, scene.get());
     }
     for (const auto &pair : project.create_node_objects) {
         bool xray = xray_node_object_names.count(pair.first);
         gui_opengl_scene_mesh_vertex(
-            project, callback, pair.first, pair.second, xray, &scene);
+            project, callback, pair.first, pair.second, xray, scene.get());
     }
 
-    scene.animate_mode = animate_mode;
-    scene.animate_hz = animate_hz;
+    scene->animate_mode = animate_mode;
+    scene->animate_hz = animate_hz;
+
+    return scene;
+}
+
+std::shared_ptr<const GuiOpenglScene::Geometry> gui_opengl_geometry_mesh(
+    const Project &project,
+    std::vector<NodeId> *point_nodes_out,
+    bool xray
+) {
+    std::shared_ptr<GuiOpenglScene::Geometry> geometry(
+        new GuiOpenglScene::Geometry);
+    ContiguousMap<NodeId, int> node_points(
+        project.mesh->nodes.key_begin(), project.mesh->nodes.key_end(), -1);
+    point_nodes_out->clear();
+
+    for (FaceId face_id : project.mesh_index->unmatched_faces) {
+        gui_opengl_geometry_mesh_face(project, face_id, xray,
+            [&](NodeId node_id) {
+                int &point = node_points[node_id];
+                if (point == -1) {
+                    point = geometry->add_point(
+                        project.mesh->nodes[node_id].point, node_id);
+                    point_nodes_out->push_back(node_id);
+                }
+                return point;
+            },
+            geometry.get());
+    }
 
-    return std::make_shared<const GuiOpenglScene>(std::move(scene));
+    geometry->build_proxy(interactive_triangles);
+    return geometry;
 }
 
 } /* namespace os2cx */
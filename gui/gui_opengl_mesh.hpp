@@ -32,6 +32,16 @@ std::shared_ptr<const GuiOpenglScene> gui_opengl_scene_mesh(
     double animate_hz = 0.0
 );
 
+/* Builds just the geometry of a mesh scene, for modes that compute the points'
+deltas and colors themselves: one point per node on the surface of the mesh.
+'point_nodes_out' gets the node of each point. If 'xray' is true, all the faces
+are x-ray, so that something drawn inside the mesh can be seen through them;
+the points come out in the same order either way. */
+std::shared_ptr<const GuiOpenglScene::Geometry> gui_opengl_geometry_mesh(
+    const Project &project,
+    std::vector<NodeId> *point_nodes_out,
+    bool xray = false);
+
 } /* namespace os2cx */
 
 #endif // GUI_OPENGL_MESH_HPP
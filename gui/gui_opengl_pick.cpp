@@ -0,0 +1,249 @@
+#include "gui_opengl_pick.hpp"
+
+#include <string.h>
+
+namespace os2cx {
+
+GuiOpenglPicker::GuiOpenglPicker(
+    std::shared_ptr<const GuiOpenglScene> scene_
+) :
+    scene(scene_),
+    num_opaque_triangles(
+        scene->geometry->indices.triangle_indices.size() / 3)
+{
+    int num_triangles = num_opaque_triangles
+        + scene->geometry->xray_indices.triangle_indices.size() / 3;
+    bvh = Bvh(num_triangles, [this](int triangle) {
+        const GLuint *ps = triangle_points(triangle);
+        Box box = point_motion_box(ps[0]);
+        for (int i = 1; i < 3; ++i) {
+            Box other = point_motion_box(ps[i]);
+            box.xl = std::min(box.xl, other.xl);
+            box.yl = std::min(box.yl, other.yl);
+            box.zl = std::min(box.zl, other.zl);
+            box.xh = std::max(box.xh, other.xh);
+            box.yh = std::max(box.yh, other.yh);
+            box.zh = std::max(box.zh, other.zh);
+        }
+        return box;
+    });
+}
+
+bool GuiOpenglPicker::can_reuse(
+    const GuiOpenglScene &built_for,
+    const GuiOpenglScene &scene
+) {
+    /* The deltas are compared bitwise, so NaNs match too */
+    return built_for.geometry == scene.geometry
+        && built_for.animate_mode == scene.animate_mode
+        && built_for.point_deltas.size() == scene.point_deltas.size()
+        && memcmp(
+            built_for.point_deltas.data(),
+            scene.point_deltas.data(),
+            scene.point_deltas.size() * sizeof(GLfloat)) == 0;
+}
+
+/* This has to match the vertex shader in gui_opengl_widget.cpp. 'p' is the
+point's three floats, and 'd' its six delta floats. */
+static Point moved(
+    const GLfloat *p,
+    const GLfloat *d,
+    std::complex<double> multiplier
+) {
+    return Point(p[0], p[1], p[2])
+        + multiplier.real() * Vector(d[0], d[1], d[2])
+        - multiplier.imag() * Vector(d[3], d[4], d[5]);
+}
+
+/* Returns the index (0, 1, or 2) of whichever of 'corners' is nearest to 'p' */
+static int nearest_corner(const Point *corners, Point p) {
+    int nearest = 0;
+    for (int i = 1; i < 3; ++i) {
+        if ((corners[i] - p).magnitude() < (corners[nearest] - p).magnitude()) {
+            nearest = i;
+        }
+    }
+    return nearest;
+}
+
+/* 'p' is a point in the triangle with corners 'deformed'. Returns the point at
+the same place in the triangle with corners 'undeformed'. */
+static Point undeformed_point(
+    const Point *undeformed,
+    const Point *deformed,
+    Point p
+) {
+    Vector n = (deformed[1] - deformed[0]).cross(deformed[2] - deformed[0]);
+    double nn = n.dot(n);
+    if (nn == 0) {
+        return undeformed[0];
+    }
+    double w0 = (deformed[2] - deformed[1]).cross(p - deformed[1]).dot(n) / nn;
+    double w1 = (deformed[0] - deformed[2]).cross(p - deformed[2]).dot(n) / nn;
+    double w2 = 1 - w0 - w1;
+    return undeformed[0]
+        + w1 * (undeformed[1] - undeformed[0])
+        + w2 * (undeformed[2] - undeformed[0]);
+}
+
+bool GuiOpenglPicker::pick(
+    Point origin,
+    Vector direction,
+    double t_max,
+    std::complex<double> multiplier,
+    const GuiOpenglSection *section,
+    GuiOpenglPick *pick_out
+) const {
+    /* The scene's triangles, skipping hits on the side of the section that's
+    clipped away. Like the fragment shader, this tests the undeformed point. */
+    double t;
+    int triangle = bvh.ray_cast(origin, direction, t_max,
+        [&](int triangle) {
+            const GLuint *ps = triangle_points(triangle);
+            Point corners[3];
+            for (int i = 0; i < 3; ++i) {
+                corners[i] = moved_point(ps[i], multiplier);
+            }
+            double t = ray_triangle_intersection(origin, direction,
+                corners[0], corners[1], corners[2]);
+            if (t < 0 || isinf(t)) {
+                return std::numeric_limits<double>::infinity();
+            }
+            if (section != nullptr) {
+                Point undeformed[3];
+                for (int i = 0; i < 3; ++i) {
+                    undeformed[i] = point(ps[i]);
+                }
+                Point p = undeformed_point(
+                    undeformed, corners, origin + t * direction);
+                if (section->normal.dot(p - Point::origin())
+                        - section->offset > 0) {
+                    return std::numeric_limits<double>::infinity();
+                }
+            }
+            return t;
+        },
+        &t);
+    if (triangle != -1) {
+        t_max = t;
+    }
+
+    /* The section's triangles aren't clipped. There are few enough of them
+    (it's a single slice through the mesh) that they're just tested one by
+    one, and only ones nearer than the scene's hit count. */
+    int section_triangle = -1;
+    if (section != nullptr) {
+        const GuiOpenglTriangles &triangles = section->triangles;
+        int num_triangles = triangles.num_points() / 3;
+        for (int i = 0; i < num_triangles; ++i) {
+            Point corners[3];
+            for (int j = 0; j < 3; ++j) {
+                int point = 3 * i + j;
+                corners[j] = moved(&triangles.points[3 * point],
+                    &triangles.point_deltas[6 * point], multiplier);
+            }
+            double section_t = ray_triangle_intersection(origin, direction,
+                corners[0], corners[1], corners[2]);
+            if (section_t >= 0 && section_t <= t_max) {
+                t_max = t = section_t;
+                section_triangle = i;
+            }
+        }
+    }
+
+    if (section_triangle != -1) {
+        pick_out->point = origin + t * direction;
+        const GuiOpenglTriangles &triangles = section->triangles;
+        Point corners[3];
+        for (int j = 0; j < 3; ++j) {
+            int point = 3 * section_triangle + j;
+            corners[j] = moved(&triangles.points[3 * point],
+                &triangles.point_deltas[6 * point], multiplier);
+        }
+        int nearest = nearest_corner(corners, pick_out->point);
+        pick_out->node_id =
+            section->point_nodes[3 * section_triangle + nearest];
+        pick_out->element_id = section->triangle_elements[section_triangle];
+        return true;
+    }
+    if (triangle == -1) {
+        return false;
+    }
+
+    pick_out->point = origin + t * direction;
+    const GLuint *ps = triangle_points(triangle);
+    Point corners[3];
+    for (int i = 0; i < 3; ++i) {
+        corners[i] = moved_point(ps[i], multiplier);
+    }
+    int nearest = nearest_corner(corners, pick_out->point);
+    pick_out->node_id = scene->geometry->point_nodes[ps[nearest]];
+    pick_out->element_id = triangle_element(triangle);
+    return true;
+}
+
+Point GuiOpenglPicker::point(int index) const {
+    const GLfloat *p = &scene->geometry->points[3 * index];
+    return Point(p[0], p[1], p[2]);
+}
+
+Point GuiOpenglPicker::moved_point(
+    int index,
+    std::complex<double> multiplier
+) const {
+    return moved(
+        &scene->geometry->points[3 * index],
+        &scene->point_deltas[6 * index],
+        multiplier);
+}
+
+Box GuiOpenglPicker::point_motion_box(int index) const {
+    Point p = point(index);
+    const GLfloat *d = &scene->point_deltas[6 * index];
+    double lo[3], hi[3];
+    for (int i = 0; i < 3; ++i) {
+        double base = (i == 0) ? p.x : ((i == 1) ? p.y : p.z);
+        double real = d[i], imag = d[i + 3];
+        switch (scene->animate_mode) {
+        case GuiOpenglScene::AnimateMode::None:
+            /* The multiplier is always 1 */
+            lo[i] = hi[i] = base + real;
+            break;
+        case GuiOpenglScene::AnimateMode::Sawtooth:
+            /* The multiplier ramps from 0 to 1 */
+            lo[i] = base + std::min(0.0, real);
+            hi[i] = base + std::max(0.0, real);
+            break;
+        case GuiOpenglScene::AnimateMode::Sine: {
+            /* The multiplier goes around the unit circle, so each coordinate
+            swings by the magnitude of its complex delta */
+            double swing = std::abs(std::complex<double>(real, imag));
+            lo[i] = base - swing;
+            hi[i] = base + swing;
+            break;
+        }
+        default: assert(false);
+        }
+    }
+    return Box(lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+}
+
+const GLuint *GuiOpenglPicker::triangle_points(int triangle) const {
+    const GuiOpenglScene::Geometry &geometry = *scene->geometry;
+    if (triangle < num_opaque_triangles) {
+        return &geometry.indices.triangle_indices[3 * triangle];
+    }
+    return &geometry.xray_indices.triangle_indices[
+        3 * (triangle - num_opaque_triangles)];
+}
+
+ElementId GuiOpenglPicker::triangle_element(int triangle) const {
+    const GuiOpenglScene::Geometry &geometry = *scene->geometry;
+    if (triangle < num_opaque_triangles) {
+        return geometry.indices.triangle_elements[triangle];
+    }
+    return geometry.xray_indices.triangle_elements[
+        triangle - num_opaque_triangles];
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,74 @@
+#ifndef OS2CX_GUI_OPENGL_PICK_HPP_
+#define OS2CX_GUI_OPENGL_PICK_HPP_
+
+#include "bvh.hpp"
+#include "gui_opengl_widget.hpp"
+
+namespace os2cx {
+
+/* What the user clicked on */
+class GuiOpenglPick {
+public:
+    /* Where the click hit the surface, as drawn (i.e. including the delta) */
+    Point point;
+
+    /* The node at whichever corner of the triangle under the click is closest
+    to 'point', and the element that the triangle is part of. These are
+    invalid if the scene's geometry isn't a mesh. */
+    NodeId node_id;
+    ElementId element_id;
+};
+
+/* Finds which of a scene's triangles is under the mouse. Building a picker
+takes about as long as building the scene, so GuiOpenglWidget builds it in the
+background and keeps it for as long as the scene is shown.
+
+The triangles move while the scene is animated, so each triangle's box in the
+BVH covers everywhere that the triangle goes during the animation. That way the
+same picker works for every frame, and only the exact test against the
+triangles needs to know where they are right now. */
+class GuiOpenglPicker {
+public:
+    explicit GuiOpenglPicker(std::shared_ptr<const GuiOpenglScene> scene);
+
+    /* Returns true if a picker built for 'built_for' works for 'scene' too.
+    Only the triangles' positions and motion matter, so scenes that share a
+    geometry, deltas and animation mode can share a picker, e.g. when only the
+    colors change. */
+    static bool can_reuse(
+        const GuiOpenglScene &built_for,
+        const GuiOpenglScene &scene);
+
+    /* Casts the ray 'origin + t * direction', for 0 <= t <= 't_max', against
+    the scene's triangles as they're drawn when the animation multiplier is
+    'multiplier'. If 'section' isn't null, the scene is clipped by it the same
+    way as it's drawn, so hits on the hidden side are skipped; and the
+    section's own triangles can be hit too. Returns false if it misses. */
+    bool pick(
+        Point origin,
+        Vector direction,
+        double t_max,
+        std::complex<double> multiplier,
+        const GuiOpenglSection *section,
+        GuiOpenglPick *pick_out) const;
+
+private:
+    Point point(int index) const;
+    Point moved_point(int index, std::complex<double> multiplier) const;
+
+    /* The box that point 'index' stays inside during the animation */
+    Box point_motion_box(int index) const;
+
+    /* Triangles are numbered through the non-x-ray triangles first, then the
+    x-ray ones */
+    const GLuint *triangle_points(int triangle) const;
+    ElementId triangle_element(int triangle) const;
+
+    std::shared_ptr<const GuiOpenglScene> scene;
+    int num_opaque_triangles;
+    Bvh bvh;
+};
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_GUI_OPENGL_PICK_HPP_ */
@@ -21,7 +21,9 @@ std::shared_ptr<const GuiOpenglScene> gui_opengl_scene_poly3(
     const Project &project,
     const GuiOpenglPoly3Callback *callback
 ) {
-    GuiOpenglScene scene;
+    std::shared_ptr<GuiOpenglScene::Geometry> geometry(
+        new GuiOpenglScene::Geometry);
+    std::vector<QColor> point_colors;
 
     std::set<std::pair<std::string, Plc3::SurfaceId> > xray_surfaces;
     std::set<std::string> xray_node_object_names;
@@ -53,43 +55,56 @@ std::shared_ptr<const GuiOpenglScene> gui_opengl_scene_poly3(
             QColor color;
             callback->calculate_surface_attributes(
                 pair.first, sid, &color);
-            QColor colors[3] = {color, color, color};
 
+            /* The triangles of a surface share their points, since they all
+            have the same color */
+            std::map<Plc3::VertexId, int> points;
             for (const Plc3::Surface::Triangle &tri : surface.triangles) {
-                Point ps[3];
-                ComplexVector ds[3];
+                int ps[3];
                 for (int i = 0; i < 3; ++i) {
-                    ps[i] = plc->vertices[tri.vertices[i]].point;
-                    ds[i] = ComplexVector::zero();
+                    auto it = points.find(tri.vertices[i]);
+                    if (it == points.end()) {
+                        int point = geometry->add_point(
+                            plc->vertices[tri.vertices[i]].point);
+                        point_colors.push_back(color);
+                        it = points.insert(
+                            std::make_pair(tri.vertices[i], point)).first;
+                    }
+                    ps[i] = it->second;
                 }
                 if (xray) {
-                    scene.add_triangle(ps, ds, colors, true);
+                    geometry->add_triangle(ps, true);
                 } else {
                     if (outside_volume_index == 1) {
                         /* In non-xray mode, the orientation is used for
-                        lighting and/or backface culling, so we need to ensure
-                        the triangle is facing the right way */
+                        backface culling, so we need to ensure the triangle is
+                        facing the right way */
                         std::swap(ps[2], ps[1]);
                     }
-                    scene.add_triangle(ps, ds, colors, false);
+                    geometry->add_triangle(ps, false);
                 }
 
             }
         }
     }
 
+    std::shared_ptr<GuiOpenglScene> scene(new GuiOpenglScene(geometry));
+    for (int i = 0; i < static_cast<int>(point_colors.size()); ++i) {
+        scene->set_point_color(i, point_colors[i]);
+    }
+
     for (const auto &pair : project.select_node_objects) {
         bool xray = xray_node_object_names.count(pair.first);
         gui_opengl_scene_poly3_vertex(
-            callback, pair.first, pair.second, xray, &scene);
+            callback, pair.first, pair.second, xray, scene.get());
     }
     for (const auto &pair : project.create_node_objects) {
         bool xray = xray_node_object_names.count(pair.first);
         gui_opengl_scene_poly3_vertex(
-            callback, pair.first, pair.second, xray, &scene);
+            callback, pair.first, pair.second, xray, scene.get());
     }
 
-    return std::make_shared<const GuiOpenglScene>(std::move(scene));
+    return scene;
 }
 
 } /* namespace os2cx */
@@ -2,75 +2,192 @@
 
 #include <QMouseEvent>
 #include <QTime>
+#include <QVector3D>
+#include <QVector4D>
+
+#include "gui_opengl_pick.hpp"
+#include "surface_decimate.hpp"
 
 namespace os2cx {
 
-GuiOpenglScene::GuiOpenglScene() :
-    animate_mode(AnimateMode::None) { }
+static void push_point(std::vector<GLfloat> *out, Point point) {
+    out->push_back(point.x);
+    out->push_back(point.y);
+    out->push_back(point.z);
+}
+
+static void push_delta(std::vector<GLfloat> *out, const ComplexVector &delta) {
+    Vector real = delta.real(), imag = delta.imag();
+    out->push_back(real.x);
+    out->push_back(real.y);
+    out->push_back(real.z);
+    out->push_back(imag.x);
+    out->push_back(imag.y);
+    out->push_back(imag.z);
+}
+
+static void push_color(std::vector<GLubyte> *out, const QColor &color) {
+    out->push_back(color.red());
+    out->push_back(color.green());
+    out->push_back(color.blue());
+}
 
-void GuiOpenglScene::add_triangle(
-    const Point *points,
-    const ComplexVector *deltas,
-    const QColor *colors,
-    bool xray
+int GuiOpenglScene::Geometry::add_point(Point point, NodeId node_id) {
+    int index = num_points();
+    push_point(&points, point);
+    point_nodes.push_back(node_id);
+    return index;
+}
+
+void GuiOpenglScene::Geometry::add_triangle(
+    const int *points,
+    bool xray,
+    ElementId element_id
 ) {
-    Primitives *p = xray ? &xray_primitives : &primitives;
-    ++p->num_triangles;
+    Indices *ix = xray ? &xray_indices : &indices;
     for (int i = 0; i < 3; ++i) {
-        p->triangle_points.push_back(points[i]);
-        p->triangle_deltas.push_back(deltas[i]);
-        p->triangle_colors.push_back(colors[i].red());
-        p->triangle_colors.push_back(colors[i].green());
-        p->triangle_colors.push_back(colors[i].blue());
+        assert(points[i] >= 0 && points[i] < num_points());
+        ix->triangle_indices.push_back(points[i]);
     }
+    ix->triangle_elements.push_back(element_id);
 }
 
-void GuiOpenglScene::add_line(
-    const Point *points, const ComplexVector *deltas, bool xray
-) {
-    Primitives *p = xray ? &xray_primitives : &primitives;
-    ++p->num_lines;
+void GuiOpenglScene::Geometry::add_line(const int *points, bool xray) {
+    Indices *ix = xray ? &xray_indices : &indices;
     for (int i = 0; i < 2; ++i) {
-        p->line_points.push_back(points[i]);
-        p->line_deltas.push_back(deltas[i]);
+        assert(points[i] >= 0 && points[i] < num_points());
+        ix->line_indices.push_back(points[i]);
+    }
+}
+
+void GuiOpenglScene::Geometry::build_proxy(int target_triangles) {
+    proxy_triangle_indices.clear();
+    if (static_cast<int>(indices.triangle_indices.size()) / 3
+            < 2 * target_triangles) {
+        return;
+    }
+
+    std::vector<Point> point_vector;
+    point_vector.reserve(num_points());
+    for (int i = 0; i < num_points(); ++i) {
+        point_vector.push_back(
+            Point(points[3 * i], points[3 * i + 1], points[3 * i + 2]));
     }
+    std::vector<int> triangles(
+        indices.triangle_indices.begin(), indices.triangle_indices.end());
+    std::vector<int> proxy_triangles;
+    decimate_surface(
+        point_vector, triangles, target_triangles, &proxy_triangles);
+    proxy_triangle_indices.assign(
+        proxy_triangles.begin(), proxy_triangles.end());
 }
 
+GuiOpenglScene::GuiOpenglScene() :
+    GuiOpenglScene(std::make_shared<const Geometry>()) { }
+
+GuiOpenglScene::GuiOpenglScene(std::shared_ptr<const Geometry> geometry) :
+    animate_mode(AnimateMode::None),
+    animate_hz(0),
+    geometry(geometry),
+    point_deltas(6 * geometry->num_points(), 0),
+    point_colors(3 * geometry->num_points(), 0) { }
+
 void GuiOpenglScene::add_vertex(
     Point point, ComplexVector delta, const QColor &color, bool xray
 ) {
-    Primitives *p = xray ? &xray_primitives : &primitives;
-    ++p->num_vertices;
-    p->vertex_points.push_back(point);
-    p->vertex_deltas.push_back(delta);
-    p->vertex_colors.push_back(color.red());
-    p->vertex_colors.push_back(color.green());
-    p->vertex_colors.push_back(color.blue());
+    Vertices *v = xray ? &xray_vertices : &vertices;
+    ++v->num_vertices;
+    push_point(&v->vertex_points, point);
+    push_delta(&v->vertex_deltas, delta);
+    push_color(&v->vertex_colors, color);
+}
+
+GuiOpenglScene::Vertices::Vertices() :
+    num_vertices(0) { }
+
+GuiOpenglTriangles::GuiOpenglTriangles(int num_points) :
+    points(3 * num_points, 0),
+    point_deltas(6 * num_points, 0),
+    point_colors(3 * num_points, 0) { }
+
+void GuiOpenglTriangles::set_point(
+    int point,
+    Point position,
+    const ComplexVector &delta,
+    const uint8_t *rgb
+) {
+    GLfloat *p = &points[3 * point];
+    p[0] = position.x;
+    p[1] = position.y;
+    p[2] = position.z;
+    GLfloat *d = &point_deltas[6 * point];
+    d[0] = delta.x.real();
+    d[1] = delta.y.real();
+    d[2] = delta.z.real();
+    d[3] = delta.x.imag();
+    d[4] = delta.y.imag();
+    d[5] = delta.z.imag();
+    GLubyte *c = &point_colors[3 * point];
+    c[0] = rgb[0];
+    c[1] = rgb[1];
+    c[2] = rgb[2];
 }
 
-GuiOpenglScene::Primitives::Primitives() :
-    num_triangles(0), num_lines(0), num_vertices(0) { }
+GuiOpenglSection::GuiOpenglSection(
+    Vector normal_,
+    double offset_,
+    int num_points
+) :
+    normal(normal_),
+    offset(offset_),
+    triangles(num_points),
+    point_nodes(num_points, NodeId::invalid()),
+    triangle_elements(num_points / 3, ElementId::invalid()) { }
+
+GuiOpenglWidget::IndexBuffers::IndexBuffers() :
+    triangle_indices(QOpenGLBuffer::IndexBuffer),
+    line_indices(QOpenGLBuffer::IndexBuffer) { }
 
 GuiOpenglWidget::GuiOpenglWidget(QWidget *parent) :
     QOpenGLWidget(parent),
     mode(nullptr),
     animate_timer(-1),
+    mouse_dragged(false),
+    pick_pending(false),
+    pick_timer(-1),
+    interacting(false),
+    interaction_timer(-1),
     look_at(Point::origin()),
     yaw(30),
     pitch(30),
-    zoom(1)
+    zoom(1),
+    proxy_triangle_indices_buffer(QOpenGLBuffer::IndexBuffer)
 { }
 
+GuiOpenglWidget::~GuiOpenglWidget() {
+    /* The GL objects have to be freed while the context is current */
+    makeCurrent();
+    destroy_buffers();
+    program.reset();
+    doneCurrent();
+}
+
 void GuiOpenglWidget::set_mode(GuiModeAbstract *new_mode) {
     mode = new_mode;
+    /* A pick that was meant for the old mode shouldn't go to the new one */
+    pick_pending = false;
     refresh_scene();
 }
 
 void GuiOpenglWidget::refresh_scene() {
     if (mode != nullptr) {
         scene = mode->make_scene();
+        section = mode->make_section();
+        isosurface = mode->make_isosurface();
     } else {
         scene = nullptr;
+        section = nullptr;
+        isosurface = nullptr;
     }
 
     if (scene && scene->animate_mode != GuiOpenglScene::AnimateMode::None) {
@@ -105,6 +222,15 @@ void GuiOpenglWidget::compute_fov() {
     }
 }
 
+QMatrix4x4 GuiOpenglWidget::compute_modelview() {
+    QMatrix4x4 modelview;
+    modelview.translate(0, 0, -camera_dist);
+    modelview.rotate(-90 + pitch, 1.0f, 0.0f, 0.0f);
+    modelview.rotate(-yaw, 0.0f, 0.0f, 1.0f);
+    modelview.translate(look_at.x, look_at.y, look_at.z);
+    return modelview;
+}
+
 std::complex<double> GuiOpenglWidget::compute_animate_multiplier() {
     /* phase ramps from 0 to 1, then repeats. The fact that we're using
     currentMSecsSinceStartOfDay() means we'll will briefly glitch at midnight,
@@ -131,58 +257,89 @@ std::complex<double> GuiOpenglWidget::compute_animate_multiplier() {
     }
 }
 
-void GuiOpenglWidget::compute_points_and_normals(
-    std::complex<double> multiplier,
-    const GuiOpenglScene::Primitives &primitives,
-    ComputedPrimitives *computed_primitives_out
-) {
-    const GuiOpenglScene::Primitives &p = primitives;
-    ComputedPrimitives *cp = computed_primitives_out;
-
-    cp->triangle_points.resize(9 * p.num_triangles);
-    cp->triangle_normals.resize(9 * p.num_triangles);
-    for (int i = 0; i < p.num_triangles; ++i) {
-        Point points[3];
-        for (int j = 0; j < 3; ++j) {
-            points[j] = p.triangle_points[3 * i + j]
-                + (multiplier * p.triangle_deltas[3 * i + j]).real();
-        }
-        Vector normal = triangle_normal(points[0], points[1], points[2]);
-        for (int j = 0; j < 3; ++j) {
-            cp->triangle_points[3 * (3 * i + j) + 0] = points[j].x;
-            cp->triangle_points[3 * (3 * i + j) + 1] = points[j].y;
-            cp->triangle_points[3 * (3 * i + j) + 2] = points[j].z;
-            cp->triangle_normals[3 * (3 * i + j) + 0] = normal.x;
-            cp->triangle_normals[3 * (3 * i + j) + 1] = normal.y;
-            cp->triangle_normals[3 * (3 * i + j) + 2] = normal.z;
-        }
+/* The vertex shader applies the animation to the points, so the point and
+delta buffers never need to be re-uploaded while animating. The deformed point
+is 'point + Re(multiplier * delta)'. Fragments on the positive side of
+'clip_plane' (a normal and an offset) are discarded; the distance is measured
+at the undeformed point, to match where the section was cut. */
+static const char *vertex_shader_source = R"(
+#version 120
+attribute vec3 point;
+attribute vec3 delta_real;
+attribute vec3 delta_imag;
+attribute vec4 color;
+uniform vec2 multiplier;
+uniform vec4 clip_plane;
+varying vec3 eye_position;
+varying vec4 vertex_color;
+varying float clip_distance;
+void main() {
+    vec3 deformed = point
+        + multiplier.x * delta_real
+        - multiplier.y * delta_imag;
+    vec4 eye = gl_ModelViewMatrix * vec4(deformed, 1.0);
+    eye_position = eye.xyz;
+    vertex_color = color;
+    clip_distance = dot(clip_plane.xyz, point) - clip_plane.w;
+    gl_Position = gl_ProjectionMatrix * eye;
+}
+)";
+
+/* Triangles are flat-shaded. Rather than computing normals on the CPU every
+time the points move, the fragment shader gets the normal from the screen-space
+derivatives of the deformed position. The normal is flipped to face the camera,
+which gives us two-sided lighting for x-ray triangles for free. The lighting
+and fog match what the old fixed-function pipeline did: 60% ambient plus a
+single directional light, and linear fog towards black. */
+static const char *fragment_shader_source = R"(
+#version 120
+uniform bool lighting;
+uniform vec3 light_direction;
+uniform float fog_start;
+uniform float fog_end;
+varying vec3 eye_position;
+varying vec4 vertex_color;
+varying float clip_distance;
+void main() {
+    if (clip_distance > 0.0) {
+        discard;
     }
-
-    cp->line_points.resize(6 * p.num_lines);
-    for (int i = 0; i < p.num_lines; ++i) {
-        for (int j = 0; j < 2; ++j) {
-            Point point = p.line_points[2 * i + j]
-                + (multiplier * p.line_deltas[2 * i + j]).real();
-            cp->line_points[3 * (2 * i + j) + 0] = point.x;
-            cp->line_points[3 * (2 * i + j) + 1] = point.y;
-            cp->line_points[3 * (2 * i + j) + 2] = point.z;
+    vec4 color = vertex_color;
+    if (lighting) {
+        vec3 normal = normalize(
+            cross(dFdx(eye_position), dFdy(eye_position)));
+        if (dot(normal, eye_position) > 0.0) {
+            normal = -normal;
         }
+        float diffuse = max(dot(normal, light_direction), 0.0);
+        color.rgb = min(color.rgb * (0.6 + diffuse), 1.0);
     }
-
-    cp->vertex_points.resize(3 * p.num_vertices);
-    for (int i = 0; i < p.num_vertices; ++i) {
-        Point point = p.vertex_points[i]
-            + (multiplier * p.vertex_deltas[i]).real();
-        cp->vertex_points[3 * i + 0] = point.x;
-        cp->vertex_points[3 * i + 1] = point.y;
-        cp->vertex_points[3 * i + 2] = point.z;
-    }
+    float fog = clamp(
+        (fog_end + eye_position.z) / (fog_end - fog_start), 0.0, 1.0);
+    color.rgb *= fog;
+    gl_FragColor = color;
 }
+)";
 
 void GuiOpenglWidget::initializeGL() {
     bool res = initializeOpenGLFunctions();
     assert(res);
 
+    /* GLSL 1.20 and buffer objects only need OpenGL 2.1, which every driver
+    we care about has, including Mesa's llvmpipe software renderer */
+    program.reset(new QOpenGLShaderProgram);
+    res = program->addShaderFromSourceCode(
+        QOpenGLShader::Vertex, vertex_shader_source);
+    assert(res);
+    res = program->addShaderFromSourceCode(
+        QOpenGLShader::Fragment, fragment_shader_source);
+    assert(res);
+    /* In a compatibility context, something has to be bound to attribute 0 */
+    program->bindAttributeLocation("point", 0);
+    res = program->link();
+    assert(res);
+    (void)res;
+
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClearDepth(1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -192,28 +349,6 @@ void GuiOpenglWidget::initializeGL() {
 
     glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
 
-    glEnable(GL_COLOR_MATERIAL);
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-
-    GLfloat light_ambient[4] = {0, 0, 0, 1};
-    glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
-    GLfloat light_diffuse[4] = {1.0, 1.0, 1.0, 1};
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse);
-    GLfloat light_specular[4] = {0, 0, 0, 1};
-    glLightfv(GL_LIGHT0, GL_SPECULAR, light_specular);
-    GLfloat light_model_ambient[4] = {0.6, 0.6, 0.6, 1.0};
-    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, light_model_ambient);
-    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
-    GLfloat material_specular[4] = {0, 0, 0, 1};
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material_specular);
-
-    /* Make faraway objects ever-so-slightly darker */
-    glEnable(GL_FOG);
-    glFogi(GL_FOG_MODE, GL_LINEAR);
-    GLfloat fog_color[4] = {0, 0, 0, 1};
-    glFogfv(GL_FOG_COLOR, fog_color);
-
     /* Back-face culling for performance */
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
@@ -231,59 +366,201 @@ void GuiOpenglWidget::resizeGL(int viewport_width, int viewport_height) {
     (void)viewport_height;
 }
 
+template<class T>
+static void upload_buffer(QOpenGLBuffer *buffer, const std::vector<T> &data) {
+    if (!buffer->isCreated()) {
+        buffer->create();
+    }
+    buffer->bind();
+    buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+    buffer->allocate(data.data(), data.size() * sizeof(T));
+    buffer->release();
+}
+
+void GuiOpenglWidget::upload_geometry(
+    const GuiOpenglScene::Geometry &geometry
+) {
+    upload_buffer(&points_buffer, geometry.points);
+    upload_buffer(&index_buffers.triangle_indices,
+        geometry.indices.triangle_indices);
+    upload_buffer(&index_buffers.line_indices,
+        geometry.indices.line_indices);
+    upload_buffer(&xray_index_buffers.triangle_indices,
+        geometry.xray_indices.triangle_indices);
+    upload_buffer(&xray_index_buffers.line_indices,
+        geometry.xray_indices.line_indices);
+    upload_buffer(&proxy_triangle_indices_buffer,
+        geometry.proxy_triangle_indices);
+}
+
+void GuiOpenglWidget::upload_scene(const GuiOpenglScene &scene) {
+    upload_buffer(&point_deltas_buffer, scene.point_deltas);
+    upload_buffer(&point_colors_buffer, scene.point_colors);
+    for (int xray = 0; xray < 2; ++xray) {
+        const GuiOpenglScene::Vertices &v =
+            xray ? scene.xray_vertices : scene.vertices;
+        VertexBuffers *b = xray ? &xray_vertex_buffers : &vertex_buffers;
+        upload_buffer(&b->vertex_points, v.vertex_points);
+        upload_buffer(&b->vertex_deltas, v.vertex_deltas);
+        upload_buffer(&b->vertex_colors, v.vertex_colors);
+    }
+}
+
+void GuiOpenglWidget::upload_triangles(
+    const GuiOpenglTriangles &triangles,
+    VertexBuffers *buffers
+) {
+    upload_buffer(&buffers->vertex_points, triangles.points);
+    upload_buffer(&buffers->vertex_deltas, triangles.point_deltas);
+    upload_buffer(&buffers->vertex_colors, triangles.point_colors);
+}
+
+void GuiOpenglWidget::destroy_buffers() {
+    for (QOpenGLBuffer *buffer : {
+            &points_buffer,
+            &index_buffers.triangle_indices,
+            &index_buffers.line_indices,
+            &xray_index_buffers.triangle_indices,
+            &xray_index_buffers.line_indices,
+            &proxy_triangle_indices_buffer,
+            &point_deltas_buffer,
+            &point_colors_buffer,
+            &vertex_buffers.vertex_points,
+            &vertex_buffers.vertex_deltas,
+            &vertex_buffers.vertex_colors,
+            &xray_vertex_buffers.vertex_points,
+            &xray_vertex_buffers.vertex_deltas,
+            &xray_vertex_buffers.vertex_colors,
+            &section_buffers.vertex_points,
+            &section_buffers.vertex_deltas,
+            &section_buffers.vertex_colors,
+            &isosurface_buffers.vertex_points,
+            &isosurface_buffers.vertex_deltas,
+            &isosurface_buffers.vertex_colors}) {
+        buffer->destroy();
+    }
+}
+
+void GuiOpenglWidget::set_attribute_buffer(
+    const char *name,
+    QOpenGLBuffer *buffer,
+    GLenum type,
+    int offset,
+    int tuple_size,
+    int stride
+) {
+    buffer->bind();
+    program->enableAttributeArray(name);
+    program->setAttributeBuffer(name, type, offset, tuple_size, stride);
+    buffer->release();
+}
+
+static const int delta_stride = 6 * sizeof(GLfloat);
+static const int delta_imag_offset = 3 * sizeof(GLfloat);
+
+void GuiOpenglWidget::set_point_attribute_buffers() {
+    set_attribute_buffer("point", &points_buffer, GL_FLOAT, 0, 3, 0);
+    set_attribute_buffer("delta_real", &point_deltas_buffer,
+        GL_FLOAT, 0, 3, delta_stride);
+    set_attribute_buffer("delta_imag", &point_deltas_buffer,
+        GL_FLOAT, delta_imag_offset, 3, delta_stride);
+}
+
 void GuiOpenglWidget::paint_primitives(
-    const GuiOpenglScene::Primitives &primitives,
-    const ComputedPrimitives &computed_primitives
+    const GuiOpenglScene::Geometry::Indices &indices,
+    IndexBuffers *index_buffers,
+    const GuiOpenglScene::Vertices &vertices,
+    VertexBuffers *vertex_buffers,
+    bool use_proxy
 ) {
-    const GuiOpenglScene::Primitives &p = primitives;
-    const ComputedPrimitives &cp = computed_primitives;
-
-    if (p.num_triangles != 0) {
-        glEnable(GL_VERTEX_ARRAY);
-        glEnable(GL_COLOR_ARRAY);
-        glEnable(GL_NORMAL_ARRAY);
-        glVertexPointer(3, GL_FLOAT, 0, cp.triangle_points.data());
-        glColorPointer(3, GL_UNSIGNED_BYTE, 0, p.triangle_colors.data());
-        glNormalPointer(GL_FLOAT, 0, cp.triangle_normals.data());
-        glDrawArrays(GL_TRIANGLES, 0, 3 * p.num_triangles);
-        glDisable(GL_NORMAL_ARRAY);
-        glDisable(GL_COLOR_ARRAY);
-        glDisable(GL_VERTEX_ARRAY);
-    }
-
-    if (p.num_lines != 0) {
+    const GuiOpenglScene::Geometry::Indices &ix = indices;
+    IndexBuffers *ib = index_buffers;
+    const GuiOpenglScene::Vertices &v = vertices;
+    VertexBuffers *vb = vertex_buffers;
+
+    QOpenGLBuffer *triangle_buffer = use_proxy
+        ? &proxy_triangle_indices_buffer
+        : &ib->triangle_indices;
+    int num_triangle_indices = use_proxy
+        ? uploaded_geometry->proxy_triangle_indices.size()
+        : ix.triangle_indices.size();
+    if (num_triangle_indices != 0) {
+        set_point_attribute_buffers();
+        set_attribute_buffer("color", &point_colors_buffer,
+            GL_UNSIGNED_BYTE, 0, 3, 0);
+        program->setUniformValue("lighting", 1);
+        triangle_buffer->bind();
+        glDrawElements(GL_TRIANGLES, num_triangle_indices,
+            GL_UNSIGNED_INT, nullptr);
+        triangle_buffer->release();
+        program->disableAttributeArray("color");
+    }
+
+    program->setUniformValue("lighting", 0);
+
+    /* The lines are the full mesh's edges, which don't line up with the
+    proxy's triangles; and there are about as many of them as triangles, so
+    they'd cost as much to draw */
+    if (!ix.line_indices.empty() && !use_proxy) {
         /* Draw lines in translucent black */
         glEnable(GL_BLEND);
-        glColor4f(0, 0, 0, 0.2);
+        program->setAttributeValue("color", 0.0f, 0.0f, 0.0f, 0.2f);
 
-        glEnable(GL_VERTEX_ARRAY);
-        glVertexPointer(3, GL_FLOAT, 0, cp.line_points.data());
-        glDrawArrays(GL_LINES, 0, 2 * p.num_lines);
-        glDisable(GL_VERTEX_ARRAY);
+        set_point_attribute_buffers();
+        ib->line_indices.bind();
+        glDrawElements(GL_LINES, ix.line_indices.size(),
+            GL_UNSIGNED_INT, nullptr);
+        ib->line_indices.release();
 
         glDisable(GL_BLEND);
     }
 
-    if (p.num_vertices != 0) {
-        glDisable(GL_LIGHTING);
-        glEnable(GL_VERTEX_ARRAY);
-        glVertexPointer(3, GL_FLOAT, 0, cp.vertex_points.data());
+    if (v.num_vertices != 0) {
+        set_attribute_buffer("point", &vb->vertex_points, GL_FLOAT, 0, 3, 0);
+        set_attribute_buffer("delta_real", &vb->vertex_deltas,
+            GL_FLOAT, 0, 3, delta_stride);
+        set_attribute_buffer("delta_imag", &vb->vertex_deltas,
+            GL_FLOAT, delta_imag_offset, 3, delta_stride);
 
         /* Draw a 10-pixel point in black, which will form a black border */
-        glColor3f(0, 0, 0);
+        program->setAttributeValue("color", 0.0f, 0.0f, 0.0f, 1.0f);
         glPointSize(10);
-        glDrawArrays(GL_POINTS, 0, p.num_vertices);
+        glDrawArrays(GL_POINTS, 0, v.num_vertices);
 
         /* Draw an 8-pixel point in the intended color */
-        glEnable(GL_COLOR_ARRAY);
-        glColorPointer(3, GL_UNSIGNED_BYTE, 0, p.vertex_colors.data());
+        set_attribute_buffer("color", &vb->vertex_colors,
+            GL_UNSIGNED_BYTE, 0, 3, 0);
         glPointSize(8);
-        glDrawArrays(GL_POINTS, 0, p.num_vertices);
+        glDrawArrays(GL_POINTS, 0, v.num_vertices);
+        program->disableAttributeArray("color");
+    }
+
+    program->disableAttributeArray("point");
+    program->disableAttributeArray("delta_real");
+    program->disableAttributeArray("delta_imag");
+}
 
-        glDisable(GL_COLOR_ARRAY);
-        glDisable(GL_VERTEX_ARRAY);
-        glEnable(GL_LIGHTING);
+void GuiOpenglWidget::paint_triangles(
+    const GuiOpenglTriangles &triangles,
+    VertexBuffers *buffers
+) {
+    if (triangles.num_points() == 0) {
+        return;
     }
+    VertexBuffers *b = buffers;
+    set_attribute_buffer("point", &b->vertex_points, GL_FLOAT, 0, 3, 0);
+    set_attribute_buffer("delta_real", &b->vertex_deltas,
+        GL_FLOAT, 0, 3, delta_stride);
+    set_attribute_buffer("delta_imag", &b->vertex_deltas,
+        GL_FLOAT, delta_imag_offset, 3, delta_stride);
+    set_attribute_buffer("color", &b->vertex_colors,
+        GL_UNSIGNED_BYTE, 0, 3, 0);
+    program->setUniformValue("lighting", 1);
+    glDrawArrays(GL_TRIANGLES, 0, triangles.num_points());
+    program->disableAttributeArray("color");
+    program->disableAttributeArray("point");
+    program->disableAttributeArray("delta_real");
+    program->disableAttributeArray("delta_imag");
 }
 
 static const uint8_t depth_buffer_stipple_pattern[4 * 32] = {
@@ -377,58 +654,219 @@ void GuiOpenglWidget::paintGL() {
         z_near, z_far);
 
     glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
-    GLfloat light_dir[4] = {0.0, 0.6, 1.0, 0.0};
-    glLightfv(GL_LIGHT0, GL_POSITION, light_dir);
-
-    glFogf(GL_FOG_START, camera_dist - approx_scale);
-    glFogf(GL_FOG_END, camera_dist + approx_scale * 5);
-
-    glTranslatef(0, 0, -camera_dist);
-    glRotatef(-90 + pitch, 1.0f, 0.0f, 0.0f);
-    glRotatef(-yaw, 0.0f, 0.0f, 1.0f);
-    glTranslatef(look_at.x, look_at.y, look_at.z);
+    glLoadMatrixf(compute_modelview().constData());
 
     if (scene != nullptr) {
-        compute_points_and_normals(
-            compute_animate_multiplier(),
-            scene->primitives,
-            &computed_primitives);
-        compute_points_and_normals(
-            compute_animate_multiplier(),
-            scene->xray_primitives,
-            &computed_xray_primitives);
+        if (uploaded_geometry != scene->geometry) {
+            upload_geometry(*scene->geometry);
+            uploaded_geometry = scene->geometry;
+        }
+        if (uploaded_scene != scene) {
+            upload_scene(*scene);
+            uploaded_scene = scene;
+        }
+        if (section != nullptr && uploaded_section != section) {
+            upload_triangles(section->triangles, &section_buffers);
+            uploaded_section = section;
+        }
+        if (isosurface != nullptr && uploaded_isosurface != isosurface) {
+            upload_triangles(*isosurface, &isosurface_buffers);
+            uploaded_isosurface = isosurface;
+        }
+
+        std::complex<double> multiplier = compute_animate_multiplier();
+        program->bind();
+        program->setUniformValue("multiplier",
+            GLfloat(multiplier.real()), GLfloat(multiplier.imag()));
+        /* The light direction is in eye coordinates */
+        program->setUniformValue("light_direction",
+            QVector3D(0.0, 0.6, 1.0).normalized());
+        program->setUniformValue("fog_start",
+            GLfloat(camera_dist - approx_scale));
+        program->setUniformValue("fog_end",
+            GLfloat(camera_dist + approx_scale * 5));
+        /* With no section, the plane is one that every point is behind */
+        QVector4D clip_plane(0, 0, 0, 1);
+        if (section != nullptr) {
+            clip_plane = QVector4D(section->normal.x, section->normal.y,
+                section->normal.z, section->offset);
+        }
+        program->setUniformValue("clip_plane", clip_plane);
 
         /* First, draw non-xray primitives normally. */
         glCullFace(GL_BACK);
-        paint_primitives(scene->primitives, computed_primitives);
+        paint_primitives(
+            scene->geometry->indices, &index_buffers,
+            scene->vertices, &vertex_buffers,
+            interacting && !scene->geometry->proxy_triangle_indices.empty());
+
+        /* Both sides of the cut triangles can be seen, so they're drawn
+        without culling. The isosurface is clipped by the section like
+        everything else, but the section's triangles lie right on the clip
+        plane, so they're drawn without it. */
+        glDisable(GL_CULL_FACE);
+        if (isosurface != nullptr) {
+            paint_triangles(*isosurface, &isosurface_buffers);
+        }
+        if (section != nullptr) {
+            program->setUniformValue("clip_plane", QVector4D(0, 0, 0, 1));
+            paint_triangles(section->triangles, &section_buffers);
+            program->setUniformValue("clip_plane", clip_plane);
+        }
+        glEnable(GL_CULL_FACE);
 
         /* On alternate pixels, reset the depth buffer to max depth; this
         ensures that xray primitives will be drawn over non-xray primitives on
         those pixels. */
+        program->release();
         paint_stipple_to_depth_buffer();
+        program->bind();
 
         /* Now draw x-ray primitives. x-ray primitives can be seen from any
         direction, so disable face culling. */
         glDisable(GL_CULL_FACE);
-        glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, 1);
-        paint_primitives(scene->xray_primitives, computed_xray_primitives);
+        paint_primitives(
+            scene->geometry->xray_indices, &xray_index_buffers,
+            scene->xray_vertices, &xray_vertex_buffers,
+            false);
         glEnable(GL_CULL_FACE);
-        glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, 0);
+        program->release();
     }
 
     glFlush();
 }
 
-void GuiOpenglWidget::timerEvent(QTimerEvent *) {
+void GuiOpenglWidget::timerEvent(QTimerEvent *event) {
+    if (event->timerId() == pick_timer) {
+        if (finish_pick()) {
+            killTimer(pick_timer);
+            pick_timer = -1;
+        }
+        return;
+    }
+    if (event->timerId() == interaction_timer) {
+        killTimer(interaction_timer);
+        interaction_timer = -1;
+        interacting = false;
+    }
     update();
 }
 
+void GuiOpenglWidget::start_picker() {
+    if (scene == nullptr || picker_scene == scene) {
+        return;
+    }
+    if (picker_scene != nullptr
+            && GuiOpenglPicker::can_reuse(*picker_scene, *scene)) {
+        return;
+    }
+    picker_scene = scene;
+
+    /* The worker only holds a weak pointer to the promise, so if another
+    picker is started before it gets to this one, it skips this one */
+    std::shared_ptr<PickerPromise> promise(new PickerPromise);
+    picker = promise->get_future().share();
+    picker_promise = promise;
+    std::weak_ptr<PickerPromise> weak_promise = promise;
+    std::shared_ptr<const GuiOpenglScene> picker_scene_copy = picker_scene;
+    picker_worker.post([weak_promise, picker_scene_copy]() {
+        std::shared_ptr<PickerPromise> promise = weak_promise.lock();
+        if (promise == nullptr) {
+            return;
+        }
+        try {
+            promise->set_value(
+                std::make_shared<const GuiOpenglPicker>(picker_scene_copy));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+}
+
+void GuiOpenglWidget::pick(int x, int y) {
+    if (mode == nullptr) {
+        return;
+    }
+    if (scene == nullptr) {
+        pick_pending = false;
+        mode->show_pick(nullptr);
+        return;
+    }
+    start_picker();
+
+    /* The ray from the eye through the middle of the pixel, per the frustum
+    in paintGL(). Its 't' is the distance from the eye along the view axis. */
+    compute_fov();
+    QMatrix4x4 inverse = compute_modelview().inverted();
+    QVector3D origin = inverse.map(QVector3D(0, 0, 0));
+    QVector3D direction = inverse.mapVector(QVector3D(
+        (2 * (x + 0.5) / width() - 1) * fov_slope_x,
+        (1 - 2 * (y + 0.5) / height()) * fov_slope_y,
+        -1));
+
+    pick_pending = true;
+    pick_origin = Point(origin.x(), origin.y(), origin.z());
+    pick_direction = Vector(direction.x(), direction.y(), direction.z());
+    pick_max_t = camera_dist + 2 * approx_scale;
+    if (!finish_pick() && pick_timer == -1) {
+        pick_timer = startTimer(50);
+    }
+}
+
+bool GuiOpenglWidget::finish_pick() {
+    if (!pick_pending) {
+        return true;
+    }
+    if (mode == nullptr) {
+        pick_pending = false;
+        return true;
+    }
+    if (scene == nullptr) {
+        pick_pending = false;
+        mode->show_pick(nullptr);
+        return true;
+    }
+
+    /* The scene may have changed since the click; this is a no-op unless the
+    picker doesn't work for the new one */
+    start_picker();
+    if (picker.wait_for(std::chrono::seconds(0))
+            != std::future_status::ready) {
+        return false;
+    }
+
+    pick_pending = false;
+    GuiOpenglPick result;
+    bool hit = picker.get()->pick(
+        pick_origin,
+        pick_direction,
+        pick_max_t,
+        compute_animate_multiplier(),
+        section.get(),
+        &result);
+    mode->show_pick(hit ? &result : nullptr);
+    return true;
+}
+
 void GuiOpenglWidget::mousePressEvent(QMouseEvent *event) {
     if (event->buttons() != 0) {
-        mouse_last_x = event->x();
-        mouse_last_y = event->y();
+        mouse_last_x = mouse_press_x = event->x();
+        mouse_last_y = mouse_press_y = event->y();
+        mouse_dragged = false;
+        interacting = true;
+        /* If this turns out to be a click, the picker will have had a head
+        start */
+        start_picker();
+    }
+}
+
+void GuiOpenglWidget::mouseReleaseEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton && !mouse_dragged) {
+        pick(event->x(), event->y());
+    }
+    if (event->buttons() == 0 && interacting) {
+        interacting = false;
+        update();
     }
 }
 
@@ -477,6 +915,11 @@ void GuiOpenglWidget::mouseMoveEvent(QMouseEvent *event) {
     if (event->buttons() != 0) {
         mouse_last_x = event->x();
         mouse_last_y = event->y();
+        static const int click_slop_px = 3;
+        if (abs(event->x() - mouse_press_x) > click_slop_px ||
+                abs(event->y() - mouse_press_y) > click_slop_px) {
+            mouse_dragged = true;
+        }
     }
 }
 
@@ -484,6 +927,12 @@ void GuiOpenglWidget::wheelEvent(QWheelEvent *event) {
     zoom *= pow(2, -event->angleDelta().y() / (360.0 * 8.0));
     if (zoom < 1) zoom = 1;
     if (zoom > 100) zoom = 100;
+
+    interacting = true;
+    if (interaction_timer != -1) {
+        killTimer(interaction_timer);
+    }
+    interaction_timer = startTimer(300);
     update();
 }
 
@@ -1,24 +1,104 @@
 #ifndef OS2CX_GUI_OPENGL_WIDGET_HPP_
 #define OS2CX_GUI_OPENGL_WIDGET_HPP_
 
+#include <QMatrix4x4>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions_1_1>
 
+#include <future>
+#include <memory>
+
 #include "gui_mode_abstract.hpp"
 
 namespace os2cx {
 
+/* A GuiOpenglScene is an indexed mesh: triangles and lines don't store their
+own points, but refer to points by index. That way a mesh node that's shared by
+several faces is only stored, uploaded, and animated once.
+
+The scene is split into two layers. The Geometry holds the points' positions
+and the triangles and lines between them, and doesn't change when the user
+picks a different variable, step, or displacement scale; so it can be built
+once and shared by many scenes, and GuiOpenglWidget only uploads it once. The
+scene itself holds each point's delta and color.
+
+Node objects are drawn separately, as dots, with add_vertex(). */
 class GuiOpenglScene {
 public:
+    class Geometry {
+    public:
+        /* 'node_id' and 'element_id' say which node a point is at and which
+        element a triangle is part of, for picking; they're left invalid if the
+        geometry isn't a mesh. Returns the new point's index. */
+        int add_point(Point point, NodeId node_id = NodeId::invalid());
+        void add_triangle(
+            const int *points,
+            bool xray,
+            ElementId element_id = ElementId::invalid());
+        void add_line(const int *points, bool xray);
+
+        int num_points() const { return points.size() / 3; }
+
+        /* Builds a simplified copy of the non-x-ray triangles, with about
+        'target_triangles' triangles, for GuiOpenglWidget to draw instead while
+        the camera is moving. It uses a subset of the same points, so it shares
+        their deltas and colors with the full triangles. If there aren't at
+        least twice 'target_triangles' triangles, it wouldn't save enough to be
+        worth it, so nothing is built. */
+        void build_proxy(int target_triangles);
+
+    private:
+        friend class GuiOpenglWidget;
+        friend class GuiOpenglPicker;
+
+        /* Three floats per point */
+        std::vector<GLfloat> points;
+        std::vector<NodeId> point_nodes;
+
+        struct Indices {
+            /* Three point indices per triangle, and two per line */
+            std::vector<GLuint> triangle_indices;
+            std::vector<GLuint> line_indices;
+            /* One per triangle */
+            std::vector<ElementId> triangle_elements;
+        };
+        Indices indices, xray_indices;
+
+        /* Empty if there's no proxy */
+        std::vector<GLuint> proxy_triangle_indices;
+    };
+
+    /* Makes a scene with no points */
     GuiOpenglScene();
+    /* Makes a scene whose points all have zero delta and are black */
+    explicit GuiOpenglScene(std::shared_ptr<const Geometry> geometry);
+
+    const Geometry &get_geometry() const { return *geometry; }
+
+    void set_point_delta(int point, const ComplexVector &delta) {
+        GLfloat *out = &point_deltas[6 * point];
+        out[0] = delta.x.real();
+        out[1] = delta.y.real();
+        out[2] = delta.z.real();
+        out[3] = delta.x.imag();
+        out[4] = delta.y.imag();
+        out[5] = delta.z.imag();
+    }
+    void set_point_color(int point, const QColor &color) {
+        GLubyte *out = &point_colors[3 * point];
+        out[0] = color.red();
+        out[1] = color.green();
+        out[2] = color.blue();
+    }
+    void set_point_rgb(int point, const uint8_t *rgb) {
+        GLubyte *out = &point_colors[3 * point];
+        out[0] = rgb[0];
+        out[1] = rgb[1];
+        out[2] = rgb[2];
+    }
 
-    void add_triangle(
-        const Point *points,
-        const ComplexVector *deltas,
-        const QColor *colors,
-        bool xray);
-    void add_line(
-        const Point *points, const ComplexVector *deltas, bool xray);
     void add_vertex(
         Point point, ComplexVector delta, const QColor &color, bool xray);
 
@@ -32,33 +112,87 @@ public:
 
 private:
     friend class GuiOpenglWidget;
+    friend class GuiOpenglPicker;
 
-    struct Primitives {
-        Primitives();
+    std::shared_ptr<const Geometry> geometry;
 
-        int num_triangles;
-        std::vector<Point> triangle_points;
-        std::vector<ComplexVector> triangle_deltas;
-        std::vector<GLubyte> triangle_colors;
+    /* Everything is stored in the layout that GuiOpenglWidget uploads to the
+    GPU: six floats per delta (the real parts, then the imaginary parts), and
+    three bytes per color. */
+    std::vector<GLfloat> point_deltas;
+    std::vector<GLubyte> point_colors;
 
-        int num_lines;
-        std::vector<Point> line_points;
-        std::vector<ComplexVector> line_deltas;
+    struct Vertices {
+        Vertices();
 
         int num_vertices;
-        std::vector<Point> vertex_points;
-        std::vector<ComplexVector> vertex_deltas;
+        std::vector<GLfloat> vertex_points;
+        std::vector<GLfloat> vertex_deltas;
         std::vector<GLubyte> vertex_colors;
     };
-    Primitives primitives, xray_primitives;
+    Vertices vertices, xray_vertices;
+};
+
+/* Triangles cut through the inside of the mesh, such as a section's
+cross-section or an isosurface, drawn along with a GuiOpenglScene. Each point
+has its own position, delta, and color, and every three points make a triangle.
+Unlike the scene there are no indices, because the points of one cut are never
+reused for another; instead, a new one is built whenever the cut moves, which
+only costs as much as the elements that it passes through. */
+class GuiOpenglTriangles {
+public:
+    /* Makes 'num_points' points, all with zero delta and black */
+    explicit GuiOpenglTriangles(int num_points);
+
+    int num_points() const { return points.size() / 3; }
+
+    void set_point(
+        int point,
+        Point position,
+        const ComplexVector &delta,
+        const uint8_t *rgb);
+
+private:
+    friend class GuiOpenglWidget;
+    friend class GuiOpenglPicker;
+
+    /* In the same layout as GuiOpenglScene's */
+    std::vector<GLfloat> points;
+    std::vector<GLfloat> point_deltas;
+    std::vector<GLubyte> point_colors;
+};
+
+/* A plane cut through the model. Everything in the scene on the positive side
+of the plane is hidden, and 'triangles' fill in the cross-section where the
+plane passes through the volume. The plane is tested against the points'
+undeformed positions, so the cross-section and the cut surface stay together
+as the deltas move them. */
+class GuiOpenglSection {
+public:
+    /* Makes a section through the plane 'normal.dot(p - origin) == offset',
+    with 'num_points' points in its triangles */
+    GuiOpenglSection(Vector normal, double offset, int num_points);
+
+    Vector normal;
+    double offset;
+    GuiOpenglTriangles triangles;
+
+    /* For picking, like the geometry's: the node at each of the triangles'
+    points (or the nearest one), and the element that each triangle is part
+    of. They start out invalid. */
+    std::vector<NodeId> point_nodes;
+    std::vector<ElementId> triangle_elements;
 };
 
+class GuiOpenglPicker;
+
 class GuiOpenglWidget :
     public QOpenGLWidget, public QOpenGLFunctions_1_1
 {
     Q_OBJECT
 public:
     GuiOpenglWidget(QWidget *parent);
+    ~GuiOpenglWidget();
 
     void set_mode(GuiModeAbstract *mode);
 
@@ -66,37 +200,111 @@ public slots:
     void refresh_scene();
 
 private:
-    struct ComputedPrimitives {
-        std::vector<GLfloat> triangle_points, triangle_normals;
-        std::vector<GLfloat> line_points;
-        std::vector<GLfloat> vertex_points;
+    /* GPU-side copies of the scene. The geometry's buffers are only uploaded
+    when the geometry changes, and the others whenever the scene changes; after
+    that, drawing a frame (even an animated one) doesn't touch the scene on the
+    CPU at all. The section and isosurface are uploaded separately, so moving
+    them doesn't re-upload the scene. */
+    struct IndexBuffers {
+        IndexBuffers();
+        QOpenGLBuffer triangle_indices, line_indices;
+    };
+    struct VertexBuffers {
+        QOpenGLBuffer vertex_points, vertex_deltas, vertex_colors;
     };
 
     void compute_fov();
+    /* Maps the model to eye coordinates. compute_fov() must be called first. */
+    QMatrix4x4 compute_modelview();
     std::complex<double> compute_animate_multiplier();
-    void compute_points_and_normals(
-        std::complex<double> multiplier,
-        const GuiOpenglScene::Primitives &primitives,
-        ComputedPrimitives *computed_primitives_out);
+
+    /* Starts building a picker for the current scene in the background, if
+    there isn't one already */
+    void start_picker();
+    /* Tells the mode what's under pixel (x, y). If the picker isn't ready
+    yet, the pick is left pending until it is. */
+    void pick(int x, int y);
+    /* Finishes the pending pick, if the picker is ready; returns false if it
+    still isn't */
+    bool finish_pick();
 
     void initializeGL();
     void resizeGL(int viewport_width, int viewport_height);
+    void upload_geometry(const GuiOpenglScene::Geometry &geometry);
+    void upload_scene(const GuiOpenglScene &scene);
+    void upload_triangles(
+        const GuiOpenglTriangles &triangles,
+        VertexBuffers *buffers);
+    void destroy_buffers();
+    void set_attribute_buffer(
+        const char *name,
+        QOpenGLBuffer *buffer,
+        GLenum type,
+        int offset,
+        int tuple_size,
+        int stride);
+    void set_point_attribute_buffers();
+    /* If 'use_proxy' is true, the geometry's proxy triangles are drawn
+    instead of the triangles in 'indices', and no lines are drawn */
     void paint_primitives(
-        const GuiOpenglScene::Primitives &primitives,
-        const ComputedPrimitives &computed_primitives);
+        const GuiOpenglScene::Geometry::Indices &indices,
+        IndexBuffers *index_buffers,
+        const GuiOpenglScene::Vertices &vertices,
+        VertexBuffers *vertex_buffers,
+        bool use_proxy);
+    void paint_triangles(
+        const GuiOpenglTriangles &triangles,
+        VertexBuffers *buffers);
     void paint_stipple_to_depth_buffer();
     void paintGL();
 
-    void timerEvent(QTimerEvent *);
+    void timerEvent(QTimerEvent *event);
     void mousePressEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
     void wheelEvent(QWheelEvent *event);
 
     GuiModeAbstract *mode;
     std::shared_ptr<const GuiOpenglScene> scene;
+    std::shared_ptr<const GuiOpenglSection> section;
+    std::shared_ptr<const GuiOpenglTriangles> isosurface;
     int mouse_last_x, mouse_last_y;
     int animate_timer;
 
+    /* A press and release without much movement in between is a click, which
+    picks; anything else is a drag, which moves the camera */
+    int mouse_press_x, mouse_press_y;
+    bool mouse_dragged;
+
+    /* The picker for 'picker_scene', which may still be being built by
+    'picker_worker'. It's only started once the user presses a mouse button on
+    the scene, so that flipping through scenes doesn't build pickers that are
+    never used; and it's kept for later scenes that it also works for (see
+    GuiOpenglPicker::can_reuse()). The worker is joined when the widget is
+    destroyed. */
+    typedef std::promise<std::shared_ptr<const GuiOpenglPicker> >
+        PickerPromise;
+    std::shared_ptr<const GuiOpenglScene> picker_scene;
+    std::shared_future<std::shared_ptr<const GuiOpenglPicker> > picker;
+    std::shared_ptr<PickerPromise> picker_promise;
+    BackgroundWorker picker_worker;
+
+    /* A click that came in while the picker was still being built. Rather
+    than holding up the GUI, we keep the ray under the click, and
+    'pick_timer' polls the picker until it can be finished. */
+    bool pick_pending;
+    Point pick_origin;
+    Vector pick_direction;
+    Length pick_max_t;
+    int pick_timer;
+
+    /* While the user is dragging or zooming, we draw the geometry's proxy
+    instead of the full triangles, if it has one. Wheel events don't have a
+    matching release, so zooming counts as finished once 'interaction_timer'
+    goes off without another wheel event. */
+    bool interacting;
+    int interaction_timer;
+
     /* These variables are all computed by setup_camera() */
     double approx_scale;
     float fov_slope_x, fov_slope_y;
@@ -106,7 +314,18 @@ private:
     float yaw, pitch; /* in degrees */
     float zoom;
 
-    ComputedPrimitives computed_primitives, computed_xray_primitives;
+    std::unique_ptr<QOpenGLShaderProgram> program;
+    /* The geometry and scene that are currently in the buffers */
+    std::shared_ptr<const GuiOpenglScene::Geometry> uploaded_geometry;
+    std::shared_ptr<const GuiOpenglScene> uploaded_scene;
+    std::shared_ptr<const GuiOpenglSection> uploaded_section;
+    std::shared_ptr<const GuiOpenglTriangles> uploaded_isosurface;
+    QOpenGLBuffer points_buffer;
+    IndexBuffers index_buffers, xray_index_buffers;
+    QOpenGLBuffer proxy_triangle_indices_buffer;
+    QOpenGLBuffer point_deltas_buffer, point_colors_buffer;
+    VertexBuffers vertex_buffers, xray_vertex_buffers;
+    VertexBuffers section_buffers, isosurface_buffers;
 };
 
 } /* namespace os2cx */
@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <map>
+
+#include "brick_grid.hpp"
 #include "compute_attrs.hpp"
 #include "mesher_naive_bricks.hpp"
 #include "mesher_tetgen.hpp"
@@ -232,4 +235,240 @@ TEST(AttrsTest, ComputeSlice) {
     }
 }
 
+TEST(AttrsTest, AttrBitsetWide) {
+    AttrBitset attrs;
+    attrs.set(3);
+    attrs.set(200);
+    EXPECT_TRUE(attrs[3]);
+    EXPECT_TRUE(attrs[200]);
+    EXPECT_FALSE(attrs[199]);
+    EXPECT_FALSE(attrs[1000]);
+
+    /* Clearing the high bit should give back a bitset equal to one that never
+    had it set */
+    AttrBitset low_only;
+    low_only.set(3);
+    EXPECT_NE(low_only, attrs);
+    attrs.reset(200);
+    EXPECT_EQ(low_only, attrs);
+
+    AttrBitset all;
+    all.set();
+    EXPECT_TRUE(all[5000]);
+    AttrBitset all_but_one = all;
+    all_but_one.reset(130);
+    EXPECT_FALSE(all_but_one[130]);
+    EXPECT_TRUE(all_but_one[131]);
+    EXPECT_EQ(AttrBitset().set(130), ~all_but_one);
+    EXPECT_EQ(AttrBitset(), all_but_one & AttrBitset().set(130));
+    EXPECT_EQ(all, all_but_one | AttrBitset().set(130));
+}
+
+TEST(AttrsTest, AttrTableInterning) {
+    AttrTable table;
+    EXPECT_EQ(AttrSetId::empty(), table.intern(AttrBitset()));
+
+    AttrBitset a, b;
+    a.set(attr_bit_solid());
+    b.set(attr_bit_solid());
+    b.set(100);
+    AttrSetId a_id = table.intern(a);
+    AttrSetId b_id = table.intern(b);
+    EXPECT_NE(a_id, b_id);
+    EXPECT_EQ(a_id, table.intern(a));
+    EXPECT_EQ(b_id, table.intern(AttrBitset(b)));
+    EXPECT_EQ(3, table.size());
+    EXPECT_EQ(b, table[b_id]);
+
+    AttrOverrides<int> overrides;
+    overrides.add(100, 7);
+    std::vector<int> values = overrides.lookup_table(table, 1);
+    ASSERT_EQ(3, static_cast<int>(values.size()));
+    EXPECT_EQ(1, values[a_id.to_int()]);
+    EXPECT_EQ(7, values[b_id.to_int()]);
+}
+
+/* Builds a row of unit bricks along the X axis, long enough that the
+computations get split across several threads. Element 'i' gets attribute bit 1
+if 'i' is divisible by 3 and bit 2 if it's in the upper half of the row; every
+face gets bit 3. */
+static const int row_num_bricks = 10000;
+static BrickGrid make_row_of_bricks() {
+    BrickGrid grid(row_num_bricks, 1, 1);
+    Mesh3 &mesh = grid.mesh;
+    AttrSetId face_attrs = mesh.attr_sets.intern(AttrBitset().set(3));
+    for (int i = 0; i < row_num_bricks; ++i) {
+        Element3 &element = mesh.elements[grid.element_id(i, 0, 0)];
+        AttrBitset attrs;
+        attrs.set(attr_bit_solid());
+        attrs.set(1, i % 3 == 0);
+        attrs.set(2, i >= row_num_bricks / 2);
+        element.attrs = mesh.attr_sets.intern(attrs);
+        for (int f = 0; f < 6; ++f) {
+            element.face_attrs[f] = face_attrs;
+        }
+    }
+    return grid;
+}
+
+TEST(AttrsTest, ComputeSelections) {
+    static const int num_bricks = row_num_bricks;
+    AttrBitIndex bit_every_third = 1, bit_upper_half = 2, bit_faces = 3,
+        bit_node = 4;
+    BrickGrid grid = make_row_of_bricks();
+    Mesh3 &mesh = grid.mesh;
+    NodeId selected_node = grid.node_id(1234, 1, 0);
+    mesh.nodes[selected_node].attrs =
+        mesh.attr_sets.intern(AttrBitset().set(bit_node));
+
+    SelectionQuery query;
+    query.volumes = {bit_every_third, bit_upper_half};
+    query.surfaces.push_back({bit_faces, Vector(0, 0, 1), 10});
+    query.surfaces.push_back({bit_faces, Vector(1, 0, 0), 180});
+    query.nodes = {bit_node, bit_every_third};
+    SelectionResult result = compute_selections_from_attr_bits(mesh, query);
+
+    for (int i = 0; i < static_cast<int>(query.volumes.size()); ++i) {
+        ElementSet expected = compute_element_set_from_attr_bit(
+            mesh, mesh.elements.key_begin(), mesh.elements.key_end(),
+            query.volumes[i]);
+        EXPECT_TRUE(expected.elements == result.volumes[i].elements);
+    }
+    EXPECT_EQ((num_bricks + 2) / 3, result.volumes[0].elements.size());
+    EXPECT_EQ(num_bricks / 2, result.volumes[1].elements.size());
+    EXPECT_EQ(1, result.volumes[1].elements.num_runs());
+
+    for (int i = 0; i < static_cast<int>(query.surfaces.size()); ++i) {
+        FaceSet expected = compute_face_set_from_attr_bit(
+            mesh, mesh.elements.key_begin(), mesh.elements.key_end(),
+            query.surfaces[i].direction_vector,
+            query.surfaces[i].direction_angle_tolerance,
+            query.surfaces[i].attr_bit);
+        EXPECT_TRUE(expected.faces == result.surfaces[i].faces);
+    }
+    EXPECT_EQ(num_bricks, result.surfaces[0].faces.size());
+    EXPECT_EQ(6 * num_bricks, result.surfaces[1].faces.size());
+
+    ASSERT_EQ(1, result.nodes[0].nodes.size());
+    EXPECT_EQ(selected_node, *result.nodes[0].nodes.begin());
+    EXPECT_TRUE(result.nodes[1].nodes.empty());
+}
+
+TEST(AttrsTest, LoadRowOfBricks) {
+    BrickGrid grid = make_row_of_bricks();
+    Mesh3 &mesh = grid.mesh;
+
+    ElementSet element_set = compute_element_set_from_range(
+        mesh.elements.key_begin(), mesh.elements.key_end());
+    ConcentratedLoad volume_load = compute_load_from_element_set(
+        mesh, element_set, Vector(0, 0, -2), false);
+    EXPECT_EQ(4 * (row_num_bricks + 1),
+        static_cast<int>(volume_load.loads.size()));
+    Vector total_force = Vector::zero();
+    for (int i = 0; i < static_cast<int>(volume_load.loads.size()); ++i) {
+        if (i > 0) {
+            EXPECT_LT(volume_load.loads[i - 1].first,
+                volume_load.loads[i].first);
+        }
+        total_force += volume_load.loads[i].second.force;
+    }
+    EXPECT_NEAR(-2, total_force.z, 1e-6);
+    NodeId middle = grid.node_id(row_num_bricks / 2, 0, 0);
+    auto it = std::lower_bound(
+        volume_load.loads.begin(), volume_load.loads.end(),
+        std::make_pair(middle, ConcentratedLoad::Load()),
+        [](const std::pair<NodeId, ConcentratedLoad::Load> &a,
+                const std::pair<NodeId, ConcentratedLoad::Load> &b) {
+            return a.first < b.first;
+        });
+    ASSERT_TRUE(it != volume_load.loads.end() && it->first == middle);
+    EXPECT_NEAR(-2.0 / row_num_bricks / 4, it->second.force.z, 1e-9);
+
+    SelectionQuery query;
+    query.surfaces.push_back({3, Vector(0, 0, 1), 10});
+    SelectionResult result = compute_selections_from_attr_bits(mesh, query);
+    ConcentratedLoad surface_load = compute_load_from_face_set(
+        mesh, result.surfaces[0], Vector(0, 0, -3), true);
+    EXPECT_EQ(2 * (row_num_bricks + 1),
+        static_cast<int>(surface_load.loads.size()));
+    total_force = Vector::zero();
+    for (const auto &pair : surface_load.loads) {
+        total_force += pair.second.force;
+    }
+    EXPECT_NEAR(-3.0 * row_num_bricks, total_force.z, 1e-6);
+}
+
+TEST(AttrsTest, DistributedLoadRowOfBricks) {
+    BrickGrid grid = make_row_of_bricks();
+    Mesh3 &mesh = grid.mesh;
+
+    ElementSet element_set = compute_element_set_from_range(
+        mesh.elements.key_begin(), mesh.elements.key_end());
+    DistributedLoad body = compute_distributed_load_from_element_set(
+        mesh, element_set, Vector(0, 0, -2), false);
+    EXPECT_EQ(DistributedLoad::Type::BodyForce, body.type);
+    EXPECT_NEAR(-2.0 / row_num_bricks, body.body_force.z, 1e-12);
+
+    SelectionQuery query;
+    query.surfaces.push_back({3, Vector(0, 0, 1), 10});
+    query.surfaces.push_back({3, Vector(0, 0, 1), 180});
+    SelectionResult result = compute_selections_from_attr_bits(mesh, query);
+
+    /* A downward force on the top faces is a pressure */
+    DistributedLoad top = compute_distributed_load_from_face_set(
+        mesh, result.surfaces[0], Vector(0, 0, -3), true);
+    EXPECT_EQ(DistributedLoad::Type::Pressure, top.type);
+    EXPECT_NEAR(3, top.pressure, 1e-9);
+    top = compute_distributed_load_from_face_set(
+        mesh, result.surfaces[0], Vector(0, 0, row_num_bricks), false);
+    EXPECT_EQ(DistributedLoad::Type::Pressure, top.type);
+    EXPECT_NEAR(-1, top.pressure, 1e-9);
+
+    /* A sideways force on the top faces, or any force on all the faces,
+    isn't */
+    EXPECT_EQ(DistributedLoad::Type::None,
+        compute_distributed_load_from_face_set(
+            mesh, result.surfaces[0], Vector(1, 0, -3), true).type);
+    EXPECT_EQ(DistributedLoad::Type::None,
+        compute_distributed_load_from_face_set(
+            mesh, result.surfaces[1], Vector(0, 0, -3), true).type);
+}
+
+TEST(AttrsTest, LoadWithDegenerateFace) {
+    /* One unit brick, plus a brick whose corners are all at the same point,
+    so all its faces have zero area */
+    BrickGrid grid(1, 1, 1);
+    Mesh3 &mesh = grid.mesh;
+    Element3 degenerate = mesh.elements[grid.element_id(0, 0, 0)];
+    for (int i = 0; i < 8; ++i) {
+        degenerate.nodes[i] = grid.node_id(0, 0, 1);
+    }
+    ElementId degenerate_id = mesh.elements.push_back(degenerate);
+
+    FaceSet face_set;
+    for (int face = 0; face < 6; ++face) {
+        Vector area = mesh.oriented_area(
+            mesh.elements[grid.element_id(0, 0, 0)], face);
+        if (area.z > 0.5) {
+            face_set.faces.insert(FaceId(grid.element_id(0, 0, 0), face));
+        }
+    }
+    ASSERT_EQ(1, face_set.faces.size());
+    face_set.faces.insert(FaceId(degenerate_id, 0));
+
+    DistributedLoad dload = compute_distributed_load_from_face_set(
+        mesh, face_set, Vector(0, 0, -3), true);
+    EXPECT_EQ(DistributedLoad::Type::Pressure, dload.type);
+    EXPECT_NEAR(3, dload.pressure, 1e-9);
+
+    ConcentratedLoad cload = compute_load_from_face_set(
+        mesh, face_set, Vector(0, 0, -3), false);
+    Vector total_force = Vector::zero();
+    for (const auto &pair : cload.loads) {
+        EXPECT_FALSE(isnan(pair.second.force.z));
+        total_force += pair.second.force;
+    }
+    EXPECT_NEAR(-3, total_force.z, 1e-9);
+}
+
 } /* namespace os2cx */
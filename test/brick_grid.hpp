@@ -0,0 +1,68 @@
+#ifndef OS2CX_TEST_BRICK_GRID_HPP_
+#define OS2CX_TEST_BRICK_GRID_HPP_
+
+#include "mesh.hpp"
+
+namespace os2cx {
+
+/* An 'nx' by 'ny' by 'nz' grid of unit C3D8 bricks, with one corner at the
+origin, for tests that need a mesh of some size. Node (i, j, k) is at the point
+(i, j, k), and brick (i, j, k) is the one whose lowest corner is node (i, j, k).
+Bricks are numbered in order with 'k' varying fastest, so a 'ny = nz = 1' grid
+is a row of bricks along the X axis numbered from one end to the other. Every
+brick is solid, and has no other attributes. */
+class BrickGrid {
+public:
+    BrickGrid(int nx, int ny, int nz) : nx(nx), ny(ny), nz(nz) {
+        for (int i = 0; i <= nx; ++i) {
+            for (int j = 0; j <= ny; ++j) {
+                for (int k = 0; k <= nz; ++k) {
+                    Node3 node;
+                    node.point = Point(i, j, k);
+                    node.attrs = mesh.attr_sets.intern(AttrBitset());
+                    mesh.nodes.push_back(node);
+                }
+            }
+        }
+
+        const ElementTypeShape &shape = element_type_shape(ElementType::C3D8);
+        AttrSetId solid = mesh.attr_sets.intern(
+            AttrBitset().set(attr_bit_solid()));
+        AttrSetId none = mesh.attr_sets.intern(AttrBitset());
+        for (int i = 0; i < nx; ++i) {
+            for (int j = 0; j < ny; ++j) {
+                for (int k = 0; k < nz; ++k) {
+                    Element3 element;
+                    element.type = ElementType::C3D8;
+                    for (int v = 0; v < 8; ++v) {
+                        Point uvw = shape.vertices[v].uvw;
+                        element.nodes[v] = node_id(
+                            i + (uvw.x > 0), j + (uvw.y > 0), k + (uvw.z > 0));
+                    }
+                    element.attrs = solid;
+                    for (int f = 0; f < 6; ++f) {
+                        element.face_attrs[f] = none;
+                    }
+                    mesh.elements.push_back(element);
+                }
+            }
+        }
+    }
+
+    NodeId node_id(int i, int j, int k) const {
+        return NodeId::from_int(mesh.nodes.key_begin().to_int()
+            + (i * (ny + 1) + j) * (nz + 1) + k);
+    }
+
+    ElementId element_id(int i, int j, int k) const {
+        return ElementId::from_int(mesh.elements.key_begin().to_int()
+            + (i * ny + j) * nz + k);
+    }
+
+    int nx, ny, nz;
+    Mesh3 mesh;
+};
+
+} /* namespace os2cx */
+
+#endif
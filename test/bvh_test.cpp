@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "bvh.hpp"
+
+namespace os2cx {
+
+TEST(BvhTest, Empty) {
+    Bvh bvh;
+    EXPECT_EQ(-1, bvh.ray_cast(Point(0, 0, 0), Vector(1, 0, 0), 1e9,
+        [](int) { return 0.0; }));
+}
+
+TEST(BvhTest, RayCastMatchesBruteForce) {
+    /* Small random triangles scattered through a unit cube */
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::uniform_real_distribution<double> offset(-0.05, 0.05);
+    auto random_point = [&]() {
+        return Point(unit(rng), unit(rng), unit(rng));
+    };
+    std::vector<Point> corners;
+    for (int i = 0; i < 5000; ++i) {
+        Point center = random_point();
+        for (int j = 0; j < 3; ++j) {
+            corners.push_back(center + Vector(
+                offset(rng), offset(rng), offset(rng)));
+        }
+    }
+    int num_triangles = corners.size() / 3;
+
+    Bvh bvh(num_triangles, [&](int i) {
+        const Point *p = &corners[3 * i];
+        return Box(
+            std::min({p[0].x, p[1].x, p[2].x}),
+            std::min({p[0].y, p[1].y, p[2].y}),
+            std::min({p[0].z, p[1].z, p[2].z}),
+            std::max({p[0].x, p[1].x, p[2].x}),
+            std::max({p[0].y, p[1].y, p[2].y}),
+            std::max({p[0].z, p[1].z, p[2].z}));
+    });
+    EXPECT_EQ(num_triangles, bvh.num_items());
+
+    int num_hits = 0;
+    for (int i = 0; i < 500; ++i) {
+        Point origin(unit(rng) * 3 - 1, unit(rng) * 3 - 1, -1);
+        Vector direction = random_point() - origin;
+        auto hit = [&](int t) {
+            double d = ray_triangle_intersection(origin, direction,
+                corners[3 * t], corners[3 * t + 1], corners[3 * t + 2]);
+            return d >= 0 ? d : std::numeric_limits<double>::infinity();
+        };
+
+        int expected = -1;
+        double expected_t = 10;
+        for (int t = 0; t < num_triangles; ++t) {
+            if (hit(t) < expected_t) {
+                expected = t;
+                expected_t = hit(t);
+            }
+        }
+
+        int tests = 0;
+        double actual_t;
+        int actual = bvh.ray_cast(origin, direction, 10, [&](int t) {
+            ++tests;
+            return hit(t);
+        }, &actual_t);
+        EXPECT_EQ(expected, actual);
+        if (expected != -1) {
+            EXPECT_EQ(expected_t, actual_t);
+            ++num_hits;
+        }
+        /* The whole point is to not test every triangle */
+        EXPECT_LT(tests, num_triangles / 10);
+    }
+    EXPECT_GT(num_hits, 100);
+}
+
+TEST(BvhTest, RayTriangleIntersection) {
+    Point p1(0, 0, 0), p2(1, 0, 0), p3(0, 1, 0);
+    EXPECT_DOUBLE_EQ(2, ray_triangle_intersection(
+        Point(0.25, 0.25, 2), Vector(0, 0, -1), p1, p2, p3));
+    /* From the other side too */
+    EXPECT_DOUBLE_EQ(1, ray_triangle_intersection(
+        Point(0.25, 0.25, -2), Vector(0, 0, 2), p1, p2, p3));
+    EXPECT_TRUE(std::isinf(ray_triangle_intersection(
+        Point(0.75, 0.75, 2), Vector(0, 0, -1), p1, p2, p3)));
+    EXPECT_TRUE(std::isinf(ray_triangle_intersection(
+        Point(0.25, 0.25, 2), Vector(1, 0, 0), p1, p2, p3)));
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,211 @@
+#include <sys/stat.h>
+
+#include <fstream>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "brick_grid.hpp"
+#include "calculix_inp_write.hpp"
+
+namespace os2cx {
+
+TEST(CalculixInpWriteTest, WriteNodesAndElements) {
+    Mesh3 mesh;
+    NodeId n[5];
+    Point points[5] = {
+        Point(0, 0, 0),
+        Point(1.5, 0, 0),
+        Point(0, -2.25, 0),
+        Point(0, 0, 1e-7),
+        Point(123456789, 0.1, 1)
+    };
+    for (int i = 0; i < 5; ++i) {
+        Node3 node;
+        node.point = points[i];
+        n[i] = mesh.nodes.push_back(node);
+    }
+    AttrSetId attrs = mesh.attr_sets.intern(AttrBitset().set(attr_bit_solid()));
+    mesh.elements.push_back(Element3 {
+        ElementType::C3D4, {n[0], n[1], n[2], n[3]}, attrs,
+        {attrs, attrs, attrs, attrs}
+    });
+    mesh.elements.push_back(Element3 {
+        ElementType::C3D4, {n[0], n[2], n[1], n[4]}, attrs,
+        {attrs, attrs, attrs, attrs}
+    });
+
+    std::ostringstream stream;
+    write_calculix_nodes_and_elements(
+        stream, "foo", mesh,
+        mesh.nodes.key_begin(), mesh.nodes.key_end(),
+        mesh.elements.key_begin(), mesh.elements.key_end());
+    EXPECT_EQ(
+        "*NODE, NSET=Nfoo\n"
+        "1, 0, 0, 0\n"
+        "2, 1.5, 0, 0\n"
+        "3, 0, -2.25, 0\n"
+        "4, 0, 0, 1e-07\n"
+        "5, 1.23457e+08, 0.1, 1\n"
+        "*ELEMENT, TYPE=C3D4, ELSET=Efoo\n"
+        "1, 1, 2, 3, 4\n"
+        "2, 1, 3, 2, 5\n",
+        stream.str());
+}
+
+TEST(CalculixInpWriteTest, WriteManyNodes) {
+    /* Enough nodes that the formatting is split into several chunks */
+    Mesh3 mesh;
+    std::ostringstream expected;
+    expected << "*NODE, NSET=Nbar\n";
+    for (int i = 0; i < 100000; ++i) {
+        Node3 node;
+        node.point = Point(i * 0.001, -i / 7.0, i * 1e10);
+        NodeId node_id = mesh.nodes.push_back(node);
+        expected << node_id.to_int()
+            << ", " << node.point.x
+            << ", " << node.point.y
+            << ", " << node.point.z
+            << '\n';
+    }
+
+    std::ostringstream stream;
+    write_calculix_nodes_and_elements(
+        stream, "bar", mesh,
+        mesh.nodes.key_begin(), mesh.nodes.key_end(),
+        mesh.elements.key_begin(), mesh.elements.key_end());
+    EXPECT_EQ(expected.str(), stream.str());
+}
+
+TEST(CalculixInpWriteTest, WriteCload) {
+    ConcentratedLoad cload;
+    ConcentratedLoad::Load load;
+    load.force = Vector(0, -0.5, 2);
+    cload.loads.push_back(std::make_pair(NodeId::from_int(7), load));
+    load.force = Vector(-3, 0, 0);
+    cload.loads.push_back(std::make_pair(NodeId::from_int(12), load));
+
+    std::ostringstream stream;
+    write_calculix_cload(stream, cload);
+    EXPECT_EQ("*CLOAD\n7,2,-0.5\n7,3,2\n12,1,-3\n", stream.str());
+}
+
+TEST(CalculixInpWriteTest, WriteSets) {
+    NodeSet node_set;
+    node_set.nodes.insert(NodeId::from_int(2));
+    node_set.nodes.insert_range(NodeId::from_int(5), NodeId::from_int(1000));
+    node_set.nodes.insert(NodeId::from_int(1002));
+    node_set.nodes.insert(NodeId::from_int(1003));
+    std::ostringstream node_stream;
+    write_calculix_nset(node_stream, "foo", node_set);
+    EXPECT_EQ(
+        "*NSET, NSET=Nfoo\n"
+        "2\n"
+        "1002\n"
+        "1003\n"
+        "*NSET, NSET=Nfoo, GENERATE\n"
+        "5, 999, 1\n",
+        node_stream.str());
+
+    ElementSet element_set = compute_element_set_from_range(
+        ElementId::from_int(1), ElementId::from_int(101));
+    std::ostringstream element_stream;
+    write_calculix_elset(element_stream, "bar", element_set);
+    EXPECT_EQ(
+        "*ELSET, ELSET=Ebar, GENERATE\n"
+        "1, 100, 1\n",
+        element_stream.str());
+
+    std::ostringstream empty_stream;
+    write_calculix_elset(empty_stream, "baz", ElementSet());
+    EXPECT_EQ("*ELSET, ELSET=Ebaz\n", empty_stream.str());
+}
+
+TEST(CalculixInpWriteTest, WriteDload) {
+    DistributedLoad body;
+    body.type = DistributedLoad::Type::BodyForce;
+    body.body_force = Vector(0, 0, -9.8);
+    std::ostringstream body_stream;
+    write_calculix_dload(body_stream, "Efoo", body);
+    EXPECT_EQ("*DLOAD\nEfoo,BZ,-9.8\n", body_stream.str());
+
+    DistributedLoad pressure;
+    pressure.type = DistributedLoad::Type::Pressure;
+    pressure.pressure = 2.5;
+    std::ostringstream pressure_stream;
+    write_calculix_dload(pressure_stream, "Sbar", pressure);
+    EXPECT_EQ("*DLOAD\nSbar,P,2.5\n", pressure_stream.str());
+}
+
+/* Returns the inode number of the file at 'path'. A file that gets replaced
+gets a new inode, while one that's left alone keeps its old one. */
+static ino_t file_inode(const FilePath &path) {
+    struct stat st;
+    EXPECT_EQ(0, stat(path.c_str(), &st)) << path;
+    return st.st_ino;
+}
+
+TEST(CalculixInpWriteTest, WriteJobOnlyReplacesChangedFiles) {
+    TempDir temp_dir("./test_write_jobXXXXXX", TempDir::AutoCleanup::Yes);
+    FilePath dir = temp_dir.path();
+
+    BrickGrid grid(4, 4, 4);
+    Project project("test.scad");
+    project.mesh.reset(new Mesh3(grid.mesh));
+    Project::MeshObject &mesh_object = project.mesh_objects["mesh"];
+    mesh_object.node_begin = project.mesh->nodes.key_begin();
+    mesh_object.node_end = project.mesh->nodes.key_end();
+    mesh_object.element_begin = project.mesh->elements.key_begin();
+    mesh_object.element_end = project.mesh->elements.key_end();
+
+    Project::LoadVolumeObject &load_object =
+        project.load_volume_objects["load"];
+    load_object.volume = "mesh";
+    std::shared_ptr<ConcentratedLoad> load(new ConcentratedLoad);
+    ConcentratedLoad::Load node_load;
+    node_load.force = Vector(0, 0, -1);
+    load->loads.push_back(std::make_pair(grid.node_id(4, 4, 4), node_load));
+    load_object.load = load;
+
+    project.calculix_deck = {"*INCLUDE, INPUT=objects.inp", "*STEP"};
+
+    const char *file_names[] = {
+        "main.inp", "objects.inp", "objects_mesh.inp", "objects_equations.inp",
+        "objects_sets.inp", "objects_materials.inp", "load.clo"
+    };
+    write_calculix_job(dir, "main", project);
+    std::map<std::string, ino_t> inodes;
+    for (const char *file_name : file_names) {
+        inodes[file_name] = file_inode(dir + "/" + file_name);
+    }
+    std::ifstream mesh_stream(dir + "/objects_mesh.inp");
+    std::string first_line;
+    std::getline(mesh_stream, first_line);
+    EXPECT_EQ("*NODE, NSET=Nmesh", first_line);
+
+    /* Writing the same job again leaves every file alone */
+    write_calculix_job(dir, "main", project);
+    for (const char *file_name : file_names) {
+        EXPECT_EQ(inodes[file_name], file_inode(dir + "/" + file_name))
+            << file_name;
+    }
+
+    /* Changing the load only replaces the load's file */
+    node_load.force = Vector(0, 0, -2);
+    load->loads[0].second = node_load;
+    write_calculix_job(dir, "main", project);
+    for (const char *file_name : file_names) {
+        if (std::string(file_name) == "load.clo") {
+            EXPECT_NE(inodes[file_name], file_inode(dir + "/" + file_name));
+        } else {
+            EXPECT_EQ(inodes[file_name], file_inode(dir + "/" + file_name))
+                << file_name;
+        }
+    }
+
+    /* No temporary files are left behind */
+    struct stat st;
+    EXPECT_NE(0, stat((dir + "/objects_mesh.inp.tmp").c_str(), &st));
+}
+
+} /* namespace os2cx */
@@ -1,10 +1,14 @@
 #include <math.h>
+#include <stdio.h>
 
+#include <fstream>
 #include <sstream>
 
 #include <gtest/gtest.h>
 
+#include "calculix_frd_read.hpp"
 #include "calculix_inp_read.hpp"
+#include "result.hpp"
 
 namespace os2cx {
 
@@ -50,4 +54,598 @@ TEST(CalculixReadTest, ReadCalculixNodesAndElements) {
     EXPECT_EQ(4, e.nodes[3].to_int());
 }
 
+template<class Value>
+static void write_frd_binary(std::ostream &stream, Value value) {
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/* Writes one node record of a block, in the same layout that CalculiX uses:
+text records hold at most six values per line, and binary records are the node
+number followed by the values. */
+template<class BinaryValue>
+static void write_frd_node_record(
+    std::ostream &stream,
+    bool binary,
+    int node,
+    const std::vector<double> &values
+) {
+    if (binary) {
+        write_frd_binary<int>(stream, node);
+        for (double value : values) {
+            write_frd_binary<BinaryValue>(stream, value);
+        }
+        return;
+    }
+    char field[32];
+    snprintf(field, sizeof(field), " -1%10d", node);
+    stream << field;
+    for (int i = 0; i < static_cast<int>(values.size()); ++i) {
+        if (i != 0 && i % 6 == 0) {
+            stream << "\n -2";
+        }
+        snprintf(field, sizeof(field), "%12.5E", values[i]);
+        stream << field;
+    }
+    stream << "\n";
+}
+
+/* Writes an FRD file with 'num_nodes' nodes and two nodal results blocks,
+"DISP" and "STRESS". The results are simple functions of the node number. If
+'binary' is true, the blocks are written the way CalculiX writes them when
+asked for binary output: doubles for the coordinates and floats for the
+results. */
+static std::string make_frd(int num_nodes, bool binary) {
+    std::ostringstream ss;
+    char line[256];
+    ss << "    1C                                                    \n";
+    ss << "    1UUSER                                                \n";
+    snprintf(line, sizeof(line),
+        "    2C%18s%12d%37s%1d\n", "", num_nodes, "", binary ? 3 : 1);
+    ss << line;
+    for (int i = 1; i <= num_nodes; ++i) {
+        write_frd_node_record<double>(ss, binary, i, {i * 1.0, 0.0, -0.5});
+    }
+    if (!binary) {
+        ss << " -3\n";
+    }
+    snprintf(line, sizeof(line),
+        "    3C%18s%12d%37s%1d\n", "", 1, "", binary ? 2 : 1);
+    ss << line;
+    if (binary) {
+        for (int value : {1, 3, 0, 1, 1, 2, 3, 4}) {
+            write_frd_binary<int>(ss, value);
+        }
+    } else {
+        ss << " -1         1    3    0    1\n";
+        ss << " -2         1         2         3         4\n";
+        ss << " -3\n";
+    }
+    ss << "    1PSTEP                         1           1           1\n";
+
+    snprintf(line, sizeof(line), "  100CL  101%12.5E%12d%20s%2d%5d%10s%2d\n",
+        0.0, num_nodes, "", 0, 1, "", binary ? 2 : 1);
+    ss << line;
+    ss << " -4  DISP        4    1\n";
+    ss << " -5  D1          1    2    1    0\n";
+    ss << " -5  D2          1    2    2    0\n";
+    ss << " -5  D3          1    2    3    0\n";
+    ss << " -5  ALL         1    2    0    0    1ALL\n";
+    for (int i = 1; i <= num_nodes; ++i) {
+        write_frd_node_record<float>(
+            ss, binary, i, {i * 0.25, -i / 1000.0, 1.5e10});
+    }
+    if (!binary) {
+        ss << " -3\n";
+    }
+
+    snprintf(line, sizeof(line), "  100CL  102%12.5E%12d%20s%2d%5d%10s%2d\n",
+        0.0, num_nodes, "", 0, 1, "", binary ? 2 : 1);
+    ss << line;
+    ss << " -4  STRESS      6    1\n";
+    ss << " -5  SXX         1    4    1    1\n";
+    ss << " -5  SYY         1    4    2    2\n";
+    ss << " -5  SZZ         1    4    3    3\n";
+    ss << " -5  SXY         1    4    1    2\n";
+    ss << " -5  SYZ         1    4    2    3\n";
+    ss << " -5  SZX         1    4    3    1\n";
+    for (int i = 1; i <= num_nodes; ++i) {
+        write_frd_node_record<float>(
+            ss, binary, i, {1.0, 2.0, 3.0, 4.0, 5.0, i * -0.125});
+    }
+    if (!binary) {
+        ss << " -3\n";
+    }
+    ss << " 9999\n";
+    return ss.str();
+}
+
+static void check_frd_text_analyses(
+    int num_nodes,
+    const std::vector<FrdAnalysis> &analyses
+) {
+    ASSERT_EQ(2, analyses.size());
+
+    const FrdAnalysis &disp = analyses[0];
+    EXPECT_EQ("DISP", disp.name);
+    EXPECT_EQ(FrdAnalysis::CType::Static, disp.ctype);
+    ASSERT_EQ(4, disp.entities.size());
+    EXPECT_EQ("D1", disp.entities[0].name);
+    EXPECT_EQ(FrdEntity::Exist::Provided, disp.entities[0].exist);
+    EXPECT_EQ(FrdEntity::Exist::ShouldCalculate, disp.entities[3].exist);
+    EXPECT_EQ("ALL", disp.entities[3].calculation_name);
+
+    const FrdAnalysis &stress = analyses[1];
+    EXPECT_EQ("STRESS", stress.name);
+    ASSERT_EQ(6, stress.entities.size());
+    EXPECT_EQ(3, stress.entities[4].ind2);
+
+    EXPECT_TRUE(isnan(disp.entities[0].data[NodeId::from_int(0)]));
+    for (int i = 1; i <= num_nodes; ++i) {
+        NodeId node_id = NodeId::from_int(i);
+        EXPECT_EQ(i * 0.25, disp.entities[0].data[node_id]);
+        EXPECT_EQ(-i / 1000.0, disp.entities[1].data[node_id]);
+        EXPECT_EQ(1.5e10, disp.entities[2].data[node_id]);
+        EXPECT_EQ(4.0, stress.entities[3].data[node_id]);
+        EXPECT_EQ(i * -0.125, stress.entities[5].data[node_id]);
+    }
+}
+
+TEST(CalculixReadTest, ReadCalculixFrd) {
+    int num_nodes = 1000;
+    std::string text = make_frd(num_nodes, false);
+    std::vector<FrdAnalysis> analyses;
+    read_calculix_frd(
+        text.data(), text.data() + text.size(),
+        NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &analyses);
+    check_frd_text_analyses(num_nodes, analyses);
+
+    /* Reading from a stream should give the same results */
+    std::istringstream stream(text);
+    std::vector<FrdAnalysis> stream_analyses;
+    read_calculix_frd(
+        stream,
+        NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &stream_analyses);
+    check_frd_text_analyses(num_nodes, stream_analyses);
+
+    /* As should memory-mapping the file */
+    TempDir temp_dir("./test_read_frdXXXXXX", TempDir::AutoCleanup::Yes);
+    FilePath path = temp_dir.path() + "/test.frd";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+    std::vector<FrdAnalysis> file_analyses;
+    read_calculix_frd_file(
+        path,
+        NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &file_analyses);
+    check_frd_text_analyses(num_nodes, file_analyses);
+}
+
+TEST(CalculixReadTest, ReadCalculixFrdErrors) {
+    std::string text = make_frd(3, false);
+    std::vector<FrdAnalysis> analyses;
+
+    /* Node 3 is out of range */
+    try {
+        read_calculix_frd(
+            text.data(), text.data() + text.size(),
+            NodeId::from_int(0), NodeId::from_int(3),
+            &analyses);
+        FAIL() << "expected an error";
+    } catch (const CalculixFrdFileReadError &error) {
+        EXPECT_EQ(
+            std::string("node id out of range (at line 22)"), error.what());
+    }
+
+    /* Corrupt the second component of the first STRESS record */
+    std::string bad_text = text;
+    size_t pos = bad_text.find(" 2.00000E+00", bad_text.find("STRESS"));
+    ASSERT_NE(std::string::npos, pos);
+    bad_text.replace(pos, 12, " 2.0000xE+00");
+    try {
+        read_calculix_frd(
+            bad_text.data(), bad_text.data() + bad_text.size(),
+            NodeId::from_int(0), NodeId::from_int(4),
+            &analyses);
+        FAIL() << "expected an error";
+    } catch (const CalculixFrdFileReadError &error) {
+        EXPECT_EQ(
+            std::string("invalid double: '2.0000xE+00' (at line 31)"),
+            error.what());
+    }
+
+    /* Truncated file */
+    std::string truncated_text = text.substr(0, text.size() / 2);
+    EXPECT_THROW(
+        read_calculix_frd(
+            truncated_text.data(),
+            truncated_text.data() + truncated_text.size(),
+            NodeId::from_int(0), NodeId::from_int(4),
+            &analyses),
+        CalculixFrdFileReadError);
+}
+
+TEST(CalculixReadTest, ReadCalculixFrdBinary) {
+    /* With 1000 nodes, some of the binary records contain newline bytes, which
+    mustn't be mistaken for the ends of lines */
+    int num_nodes = 1000;
+    std::string text = make_frd(num_nodes, false);
+    std::string binary = make_frd(num_nodes, true);
+    EXPECT_LT(binary.size(), text.size());
+
+    std::vector<FrdAnalysis> text_analyses, binary_analyses;
+    read_calculix_frd(
+        text.data(), text.data() + text.size(),
+        NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &text_analyses);
+    read_calculix_frd(
+        binary.data(), binary.data() + binary.size(),
+        NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &binary_analyses);
+
+    /* The binary file should give the same results as the text file, up to the
+    precision of a float */
+    ASSERT_EQ(text_analyses.size(), binary_analyses.size());
+    for (int i = 0; i < static_cast<int>(text_analyses.size()); ++i) {
+        const FrdAnalysis &ta = text_analyses[i], &ba = binary_analyses[i];
+        EXPECT_EQ(ta.name, ba.name);
+        ASSERT_EQ(ta.entities.size(), ba.entities.size());
+        for (int j = 0; j < static_cast<int>(ta.entities.size()); ++j) {
+            const FrdEntity &te = ta.entities[j], &be = ba.entities[j];
+            EXPECT_EQ(te.name, be.name);
+            ASSERT_EQ(te.data.size(), be.data.size());
+            if (te.exist != FrdEntity::Exist::Provided) {
+                continue;
+            }
+            for (int n = 1; n <= num_nodes; ++n) {
+                NodeId node_id = NodeId::from_int(n);
+                EXPECT_EQ(static_cast<float>(te.data[node_id]),
+                    be.data[node_id]);
+            }
+        }
+    }
+
+    /* A truncated binary block is an error, rather than a crash */
+    std::string truncated = binary.substr(0, binary.size() - 100);
+    EXPECT_THROW(
+        read_calculix_frd(
+            truncated.data(), truncated.data() + truncated.size(),
+            NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+            &binary_analyses),
+        CalculixFrdFileReadError);
+}
+
+TEST(CalculixReadTest, ReadCalculixFrdLazily) {
+    int num_nodes = 1000;
+    std::string text = make_frd(num_nodes, true);
+    TempDir temp_dir("./test_read_frdXXXXXX", TempDir::AutoCleanup::Yes);
+    FilePath path = temp_dir.path() + "/test.frd";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+
+    std::vector<FrdAnalysis> analyses;
+    read_calculix_frd_file(
+        path, NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &analyses);
+    Results eager;
+    results_from_frd_analyses(
+        std::move(analyses), Results::Precision::Double, &eager);
+
+    /* The cache only has room for one of the datasets at a time */
+    std::shared_ptr<const FrdFile> frd_file(new FrdFile(
+        path, NodeId::from_int(0), NodeId::from_int(num_nodes + 1)));
+    ASSERT_EQ(2, frd_file->analyses().size());
+    EXPECT_EQ(0, frd_file->analyses()[0].entities[0].data.size());
+    size_t memory_limit = (num_nodes + 1) * 10 * sizeof(double);
+    Results lazy;
+    results_from_frd_file(
+        frd_file, memory_limit, Results::Precision::Double, {}, &lazy);
+
+    ASSERT_EQ(1, lazy.results.size());
+    ASSERT_EQ(1, lazy.results[0].steps.size());
+    const Results::Result::Step &eager_step = eager.results[0].steps[0];
+    const Results::Result::Step &lazy_step = lazy.results[0].steps[0];
+    ASSERT_EQ(2, lazy_step.datasets.size());
+    const Results::Dataset &disp = lazy_step.datasets.at("DISP");
+    const Results::Dataset &stress = lazy_step.datasets.at("STRESS");
+    EXPECT_EQ(Results::Dataset::Type::Vector, disp.type);
+    EXPECT_EQ(Results::Dataset::Type::Matrix, stress.type);
+    EXPECT_EQ(0, disp.cache->memory_used());
+
+    std::shared_ptr<const Results::Dataset::Values> disp_values =
+        disp.values();
+    EXPECT_EQ(disp_values, disp.values());
+    EXPECT_EQ(disp_values->memory_size(), disp.cache->memory_used());
+
+    /* Loading STRESS evicts DISP from the cache, but the values we're holding
+    on to stay valid */
+    std::shared_ptr<const Results::Dataset::Values> stress_values =
+        stress.values();
+    EXPECT_EQ(stress_values->memory_size(), stress.cache->memory_used());
+    EXPECT_NE(disp_values, disp.values());
+
+    std::shared_ptr<const Results::Dataset::Values> eager_disp_values =
+        eager_step.datasets.at("DISP").values();
+    std::shared_ptr<const Results::Dataset::Values> eager_stress_values =
+        eager_step.datasets.at("STRESS").values();
+    for (int i = 1; i <= num_nodes; ++i) {
+        NodeId node_id = NodeId::from_int(i);
+        EXPECT_EQ(
+            eager_disp_values->subvariable_value(SubVariable::VectorY, node_id),
+            disp_values->subvariable_value(SubVariable::VectorY, node_id));
+        EXPECT_EQ(
+            eager_stress_values->subvariable_value(
+                SubVariable::MatrixZX, node_id),
+            stress_values->subvariable_value(SubVariable::MatrixZX, node_id));
+    }
+}
+
+TEST(CalculixReadTest, ReadCalculixFrdStatsLazily) {
+    int num_nodes = 1000;
+    std::string text = make_frd(num_nodes, false);
+    TempDir temp_dir("./test_read_frdXXXXXX", TempDir::AutoCleanup::Yes);
+    FilePath path = temp_dir.path() + "/test.frd";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+
+    std::vector<FrdAnalysis> analyses;
+    read_calculix_frd_file(
+        path, NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &analyses);
+    Results eager;
+    results_from_frd_analyses(
+        std::move(analyses), Results::Precision::Double, &eager);
+
+    /* The cache only has room for one of the datasets at a time */
+    std::shared_ptr<const FrdFile> frd_file(new FrdFile(
+        path, NodeId::from_int(0), NodeId::from_int(num_nodes + 1)));
+    size_t memory_limit = (num_nodes + 1) * 10 * sizeof(double);
+    Results lazy;
+    results_from_frd_file(
+        frd_file, memory_limit, Results::Precision::Double, {}, &lazy);
+    const Results::Dataset &disp = lazy.results[0].steps[0].datasets.at("DISP");
+    const Results::Dataset &stress =
+        lazy.results[0].steps[0].datasets.at("STRESS");
+
+    /* The stats of STRESS outlive its values */
+    std::shared_ptr<const Results::Dataset::Stats> stress_stats =
+        stress.stats();
+    std::shared_ptr<const Results::Dataset::Values> disp_values =
+        disp.values();
+    EXPECT_EQ(disp_values->memory_size(), disp.cache->memory_used());
+    EXPECT_EQ(stress_stats, stress.stats());
+    EXPECT_EQ(disp_values, disp.values());
+
+    /* Stats computed in the background are the same as ones computed from
+    values loaded up front */
+    Results background;
+    results_from_frd_file(
+        frd_file, memory_limit, Results::Precision::Single, {}, &background);
+    results_start_computing_stats(background);
+    for (const auto &pair : background.results[0].steps[0].datasets) {
+        std::shared_ptr<const Results::Dataset::Stats> expected =
+            eager.results[0].steps[0].datasets.at(pair.first).stats();
+        std::shared_ptr<const Results::Dataset::Stats> actual =
+            pair.second.stats();
+        EXPECT_EQ(expected->component_min, actual->component_min);
+        EXPECT_EQ(expected->component_max, actual->component_max);
+    }
+}
+
+TEST(CalculixReadTest, ReadCalculixFrdLazilyWithError) {
+    /* Corrupt the second component of the first STRESS record. Only the
+    headers are read up front, so the error only shows up once STRESS is
+    loaded. */
+    std::string text = make_frd(3, false);
+    size_t pos = text.find(" 2.00000E+00", text.find("STRESS"));
+    ASSERT_NE(std::string::npos, pos);
+    text.replace(pos, 12, " 2.0000xE+00");
+    TempDir temp_dir("./test_read_frdXXXXXX", TempDir::AutoCleanup::Yes);
+    FilePath path = temp_dir.path() + "/test.frd";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+
+    std::shared_ptr<const FrdFile> frd_file(new FrdFile(
+        path, NodeId::from_int(0), NodeId::from_int(4)));
+    Results results;
+    results_from_frd_file(
+        frd_file, 1 << 20, Results::Precision::Double, {}, &results);
+    const Results::Result::Step &step = results.results[0].steps[0];
+
+    std::shared_ptr<const Results::Dataset::Values> disp_values =
+        step.datasets.at("DISP").values();
+    EXPECT_EQ("", disp_values->load_error);
+
+    /* The values are there, but missing, and say why */
+    std::shared_ptr<const Results::Dataset::Values> stress_values =
+        step.datasets.at("STRESS").values();
+    EXPECT_EQ("invalid double: '2.0000xE+00' (at line 31)",
+        stress_values->load_error);
+    EXPECT_TRUE(isnan(stress_values->subvariable_value(
+        SubVariable::MatrixXX, NodeId::from_int(1))));
+}
+
+TEST(CalculixReadTest, ReadCalculixFrdSinglePrecision) {
+    int num_nodes = 100;
+    std::string text = make_frd(num_nodes, false);
+    std::vector<FrdAnalysis> analyses;
+    read_calculix_frd(
+        text.data(), text.data() + text.size(),
+        NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &analyses);
+
+    Results double_results, single_results;
+    results_from_frd_analyses(
+        analyses, Results::Precision::Double, &double_results);
+    results_from_frd_analyses(
+        std::move(analyses), Results::Precision::Single, &single_results);
+
+    std::shared_ptr<const Results::Dataset::Values> double_values =
+        double_results.results[0].steps[0].datasets.at("STRESS").values();
+    std::shared_ptr<const Results::Dataset::Values> single_values =
+        single_results.results[0].steps[0].datasets.at("STRESS").values();
+    EXPECT_EQ(double_values->memory_size(), 2 * single_values->memory_size());
+    for (int i = 1; i <= num_nodes; ++i) {
+        NodeId node_id = NodeId::from_int(i);
+        EXPECT_EQ(
+            static_cast<float>(double_values->matrix(node_id).cols[2].x),
+            single_values->matrix(node_id).cols[2].x);
+        EXPECT_FLOAT_EQ(
+            double_values->subvariable_value(
+                SubVariable::MatrixVonMisesStress, node_id),
+            single_values->subvariable_value(
+                SubVariable::MatrixVonMisesStress, node_id));
+    }
+    EXPECT_TRUE(isnan(single_values->scalar(NodeId::from_int(0))));
+}
+
+TEST(CalculixReadTest, ReadCalculixFrdKeepsMeasuredDatasetsDouble) {
+    int num_nodes = 100;
+    std::string text = make_frd(num_nodes, false);
+    TempDir temp_dir("./test_read_frdXXXXXX", TempDir::AutoCleanup::Yes);
+    FilePath path = temp_dir.path() + "/test.frd";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+
+    std::shared_ptr<const FrdFile> frd_file(new FrdFile(
+        path, NodeId::from_int(0), NodeId::from_int(num_nodes + 1)));
+    Results results;
+    results_from_frd_file(
+        frd_file, 1 << 20, Results::Precision::Single, {"STRESS"}, &results);
+    const Results::Result::Step &step = results.results[0].steps[0];
+    EXPECT_EQ(Results::Precision::Single, step.datasets.at("DISP").precision);
+    EXPECT_EQ(Results::Precision::Double,
+        step.datasets.at("STRESS").precision);
+
+    std::shared_ptr<const Results::Dataset::Values> disp_values =
+        step.datasets.at("DISP").values();
+    std::shared_ptr<const Results::Dataset::Values> stress_values =
+        step.datasets.at("STRESS").values();
+    EXPECT_EQ((num_nodes + 1) * 4 * sizeof(float), disp_values->memory_size());
+    EXPECT_EQ((num_nodes + 1) * 10 * sizeof(double),
+        stress_values->memory_size());
+}
+
+TEST(CalculixReadTest, DerivedComponents) {
+    double s1, s2, s3;
+    principal_stresses(Matrix::scale(2, -1, 5), &s1, &s2, &s3);
+    EXPECT_EQ(5, s1);
+    EXPECT_EQ(2, s2);
+    EXPECT_EQ(-1, s3);
+    Matrix m = Matrix::zero();
+    m.cols[0] = Vector(2, 1, 0);
+    m.cols[1] = Vector(1, 2, 0);
+    principal_stresses(m, &s1, &s2, &s3);
+    EXPECT_DOUBLE_EQ(3, s1);
+    EXPECT_DOUBLE_EQ(1, s2);
+    EXPECT_NEAR(0, s3, 1e-12);
+
+    int num_nodes = 100;
+    std::string text = make_frd(num_nodes, false);
+    std::vector<FrdAnalysis> analyses;
+    read_calculix_frd(
+        text.data(), text.data() + text.size(),
+        NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &analyses);
+    Results results;
+    results_from_frd_analyses(
+        std::move(analyses), Results::Precision::Double, &results);
+    const Results::Result::Step &step = results.results[0].steps[0];
+    std::shared_ptr<const Results::Dataset::Values> disp_values =
+        step.datasets.at("DISP").values();
+    std::shared_ptr<const Results::Dataset::Values> stress_values =
+        step.datasets.at("STRESS").values();
+
+    for (int i = 1; i <= num_nodes; ++i) {
+        NodeId node_id = NodeId::from_int(i);
+        EXPECT_EQ(
+            disp_values->vector(node_id).magnitude(),
+            disp_values->subvariable_value(
+                SubVariable::VectorMagnitude, node_id));
+        Matrix stress = stress_values->matrix(node_id);
+        EXPECT_EQ(
+            von_mises_stress(stress),
+            stress_values->subvariable_value(
+                SubVariable::MatrixVonMisesStress, node_id));
+        s1 = stress_values->subvariable_value(
+            SubVariable::MatrixMaxPrincipal, node_id);
+        s2 = stress_values->subvariable_value(
+            SubVariable::MatrixMidPrincipal, node_id);
+        s3 = stress_values->subvariable_value(
+            SubVariable::MatrixMinPrincipal, node_id);
+        EXPECT_GE(s1, s2);
+        EXPECT_GE(s2, s3);
+        /* The trace and determinant are invariant under rotation */
+        EXPECT_NEAR(1.0 + 2.0 + 3.0, s1 + s2 + s3, 1e-9);
+        EXPECT_NEAR(stress.determinant(), s1 * s2 * s3, 1e-9);
+    }
+    EXPECT_TRUE(isnan(stress_values->subvariable_value(
+        SubVariable::MatrixMaxPrincipal, NodeId::from_int(0))));
+}
+
+TEST(CalculixReadTest, ComputeStats) {
+    int num_nodes = 100;
+    std::string text = make_frd(num_nodes, false);
+    std::vector<FrdAnalysis> analyses;
+    read_calculix_frd(
+        text.data(), text.data() + text.size(),
+        NodeId::from_int(0), NodeId::from_int(num_nodes + 1),
+        &analyses);
+    /* The stats of single-precision results come from the values before
+    they're rounded, so they match the double-precision values exactly */
+    Results double_results, results;
+    results_from_frd_analyses(
+        analyses, Results::Precision::Double, &double_results);
+    results_from_frd_analyses(
+        std::move(analyses), Results::Precision::Single, &results);
+    const Results::Result::Step &step = results.results[0].steps[0];
+
+    for (const auto &pair : step.datasets) {
+        std::shared_ptr<const Results::Dataset::Values> values =
+            double_results.results[0].steps[0].datasets.at(pair.first)
+                .values();
+        std::shared_ptr<const Results::Dataset::Stats> stats_ptr =
+            pair.second.stats();
+        const Results::Dataset::Stats &stats = *stats_ptr;
+        /* Every component has stats, including the derived ones */
+        int num_components =
+            (pair.second.type == Results::Dataset::Type::Vector) ? 4 : 10;
+        ASSERT_EQ(num_components, stats.component_min.size());
+        ASSERT_EQ(num_components, stats.component_max.size());
+        ASSERT_EQ(num_components, stats.component_sketches.size());
+        for (int c = 0; c < num_components; ++c) {
+            double min = INFINITY, max = -INFINITY;
+            /* Node 0 is NaN, and must not affect the stats */
+            for (int i = 0; i <= num_nodes; ++i) {
+                double value = values->component(c, NodeId::from_int(i));
+                if (!isnan(value)) {
+                    min = std::min(min, value);
+                    max = std::max(max, value);
+                }
+            }
+            EXPECT_FALSE(isnan(stats.component_min[c]));
+            EXPECT_EQ(min, stats.component_min[c]);
+            EXPECT_EQ(max, stats.component_max[c]);
+            const QuantileSketch<double> &sketch =
+                stats.component_sketches[c];
+            EXPECT_EQ(num_nodes, sketch.count());
+            EXPECT_EQ(min, sketch.percentile(0));
+            EXPECT_EQ(max, sketch.percentile(100));
+            EXPECT_LE(min, sketch.percentile(50));
+            EXPECT_GE(max, sketch.percentile(50));
+        }
+    }
+}
+
 } /* namespace os2cx */
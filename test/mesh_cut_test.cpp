@@ -0,0 +1,214 @@
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "brick_grid.hpp"
+#include "mesh_cut.hpp"
+
+namespace os2cx {
+
+/* An 'n' by 'n' by 'n' grid of unit bricks */
+static Mesh3 make_brick_grid(int n) {
+    return BrickGrid(n, n, n).mesh;
+}
+
+/* A single element with its nodes at the shape's (u, v, w) coordinates */
+static Mesh3 make_single_element(ElementType type) {
+    Mesh3 mesh;
+    const ElementTypeShape &shape = element_type_shape(type);
+    Element3 element;
+    element.type = type;
+    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+        Node3 node;
+        node.point = shape.vertices[i].uvw;
+        element.nodes[i] = mesh.nodes.key_end();
+        mesh.nodes.push_back(node);
+    }
+    mesh.elements.push_back(element);
+    return mesh;
+}
+
+static std::vector<ElementId> all_elements(const Mesh3 &mesh) {
+    std::vector<ElementId> element_ids;
+    for (ElementId id = mesh.elements.key_begin();
+            id != mesh.elements.key_end(); ++id) {
+        element_ids.push_back(id);
+    }
+    return element_ids;
+}
+
+/* Returns the sum of the triangles' oriented areas */
+static Vector total_area(
+    const Mesh3 &mesh,
+    const std::vector<CutPoint> &triangles
+) {
+    Vector area = Vector::zero();
+    for (int i = 0; i < static_cast<int>(triangles.size()); i += 3) {
+        Point a = triangles[i].point(mesh);
+        Point b = triangles[i + 1].point(mesh);
+        Point c = triangles[i + 2].point(mesh);
+        area += (b - a).cross(c - a) / 2;
+    }
+    return area;
+}
+
+TEST(MeshCutTest, CutBrickGrid) {
+    Mesh3 mesh = make_brick_grid(4);
+    std::vector<CutPoint> triangles;
+    cut_elements(mesh, all_elements(mesh),
+        [&](NodeId id) { return mesh.nodes[id].point.z; },
+        1.3, &triangles);
+
+    ASSERT_FALSE(triangles.empty());
+    for (const CutPoint &point : triangles) {
+        EXPECT_NEAR(1.3, point.point(mesh).z, 1e-9);
+    }
+    Vector area = total_area(mesh, triangles);
+    EXPECT_NEAR(0, area.x, 1e-9);
+    EXPECT_NEAR(0, area.y, 1e-9);
+    EXPECT_NEAR(16, area.z, 1e-9);
+}
+
+TEST(MeshCutTest, CutElementsReportsTriangleElements) {
+    BrickGrid grid(3, 3, 3);
+    const Mesh3 &mesh = grid.mesh;
+    std::vector<CutPoint> triangles;
+    std::vector<ElementId> triangle_elements;
+    cut_elements(mesh, all_elements(mesh),
+        [&](NodeId id) {
+            Point p = mesh.nodes[id].point;
+            return p.x + 0.3 * p.y + 0.2 * p.z;
+        },
+        1.7, &triangles, &triangle_elements);
+
+    /* Each triangle lies inside the brick it came from */
+    ASSERT_EQ(triangles.size() / 3, triangle_elements.size());
+    for (int i = 0; i < static_cast<int>(triangles.size()); ++i) {
+        ElementId element_id = triangle_elements[i / 3];
+        int e = element_id.to_int() - mesh.elements.key_begin().to_int();
+        Point corner(e / 9, e / 3 % 3, e % 3);
+        Point p = triangles[i].point(mesh);
+        EXPECT_GE(p.x, corner.x - 1e-9);
+        EXPECT_LE(p.x, corner.x + 1 + 1e-9);
+        EXPECT_GE(p.y, corner.y - 1e-9);
+        EXPECT_LE(p.y, corner.y + 1 + 1e-9);
+        EXPECT_GE(p.z, corner.z - 1e-9);
+        EXPECT_LE(p.z, corner.z + 1 + 1e-9);
+    }
+}
+
+TEST(MeshCutTest, CutFacesTowardsHigherValues) {
+    Mesh3 mesh = make_brick_grid(2);
+    std::vector<CutPoint> triangles;
+    cut_elements(mesh, all_elements(mesh),
+        [&](NodeId id) { return -mesh.nodes[id].point.x; },
+        -0.5, &triangles);
+    Vector area = total_area(mesh, triangles);
+    EXPECT_NEAR(-4, area.x, 1e-9);
+    EXPECT_NEAR(0, area.y, 1e-9);
+    EXPECT_NEAR(0, area.z, 1e-9);
+}
+
+TEST(MeshCutTest, CutTetrahedron) {
+    Mesh3 mesh = make_single_element(ElementType::C3D4);
+    const Element3 &element = *mesh.elements.begin();
+    double values[4];
+    for (int i = 0; i < 4; ++i) {
+        Vector p = mesh.nodes[element.nodes[i]].point - Point::origin();
+        values[i] = p.x + p.y + p.z;
+    }
+    std::vector<CutPoint> triangles;
+    cut_element(mesh, element, values, 0.5, &triangles);
+    ASSERT_EQ(3u, triangles.size());
+    Vector area = total_area(mesh, triangles);
+    EXPECT_NEAR(0.125, area.x, 1e-9);
+    EXPECT_NEAR(0.125, area.y, 1e-9);
+    EXPECT_NEAR(0.125, area.z, 1e-9);
+
+    values[2] = NAN;
+    triangles.clear();
+    cut_element(mesh, element, values, 0.5, &triangles);
+    EXPECT_TRUE(triangles.empty());
+}
+
+TEST(MeshCutTest, CutSecondOrderBrick) {
+    /* Only the corners matter */
+    Mesh3 mesh = make_single_element(ElementType::C3D20);
+    const Element3 &element = *mesh.elements.begin();
+    double values[8];
+    for (int i = 0; i < 8; ++i) {
+        values[i] = mesh.nodes[element.nodes[i]].point.y;
+    }
+    std::vector<CutPoint> triangles;
+    cut_element(mesh, element, values, 0.25, &triangles);
+    Vector area = total_area(mesh, triangles);
+    EXPECT_NEAR(0, area.x, 1e-9);
+    EXPECT_NEAR(4, area.y, 1e-9);
+    EXPECT_NEAR(0, area.z, 1e-9);
+}
+
+TEST(MeshCutTest, ElementRanges) {
+    Mesh3 mesh = make_brick_grid(4);
+    auto node_value = [&](NodeId id) {
+        Point p = mesh.nodes[id].point;
+        return p.x * p.x + p.y + p.z;
+    };
+    ElementRanges ranges(mesh, node_value);
+
+    for (double level : {-1.0, 0.0, 2.5, 7.0, 24.0, 30.0}) {
+        std::vector<CutPoint> expected, actual;
+        cut_elements(mesh, all_elements(mesh), node_value, level, &expected);
+        std::vector<ElementId> element_ids = ranges.elements_at(level);
+        cut_elements(mesh, element_ids, node_value, level, &actual);
+        ASSERT_EQ(expected.size(), actual.size());
+        for (int i = 0; i < static_cast<int>(expected.size()); ++i) {
+            EXPECT_EQ(expected[i].node_a, actual[i].node_a);
+            EXPECT_EQ(expected[i].node_b, actual[i].node_b);
+            EXPECT_EQ(expected[i].weight, actual[i].weight);
+        }
+        /* Every element that was picked is actually cut */
+        for (ElementId id : element_ids) {
+            std::vector<CutPoint> triangles;
+            cut_elements(mesh, {id}, node_value, level, &triangles);
+            EXPECT_FALSE(triangles.empty());
+        }
+    }
+}
+
+TEST(MeshCutTest, PlaneQueryMatchesBruteForce) {
+    Mesh3 mesh = make_brick_grid(10);
+    Bvh bvh = element_bvh(mesh);
+    EXPECT_EQ(1000, bvh.num_items());
+
+    Vector normal = Vector(1, 2, -3) / Vector(1, 2, -3).magnitude();
+    double offset = 0.7;
+    std::set<ElementId> found;
+    bvh.plane_query(normal, offset, [&](int i) {
+        ElementId id = ElementId::from_int(
+            mesh.elements.key_begin().to_int() + i);
+        EXPECT_TRUE(found.insert(id).second);
+    });
+
+    /* Every element that the plane touches must be found, but a few others
+    near the plane may be too */
+    std::set<ElementId> expected;
+    for (ElementId id : all_elements(mesh)) {
+        const Element3 &element = mesh.elements[id];
+        bool below = false, above = false;
+        for (int i = 0; i < 8; ++i) {
+            double d = normal.dot(
+                mesh.nodes[element.nodes[i]].point - Point::origin());
+            below = below || d <= offset;
+            above = above || d >= offset;
+        }
+        if (below && above) {
+            expected.insert(id);
+        }
+    }
+    for (ElementId id : expected) {
+        EXPECT_EQ(1u, found.count(id));
+    }
+    EXPECT_LT(found.size(), 3 * expected.size());
+}
+
+} /* namespace os2cx */
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include "brick_grid.hpp"
 #include "mesh_index.hpp"
 
 namespace os2cx {
@@ -11,8 +12,9 @@ TEST(MeshIndexTest, Mesh3Index) {
         n[i] = mesh.nodes.key_end();
         mesh.nodes.push_back(Node3());
     }
-    AttrBitset attrs;
-    attrs.set(attr_bit_solid());
+    AttrBitset solid;
+    solid.set(attr_bit_solid());
+    AttrSetId attrs = mesh.attr_sets.intern(solid);
 
     mesh.elements.push_back(Element3 {
         ElementType::C3D4,
@@ -44,4 +46,38 @@ TEST(MeshIndexTest, Mesh3Index) {
     }
 }
 
+TEST(MeshIndexTest, RowOfBricks) {
+    /* Enough elements that the index gets built on several threads */
+    static const int num_bricks = 20000;
+    BrickGrid grid(num_bricks, 1, 1);
+    const Mesh3 &mesh = grid.mesh;
+
+    Mesh3Index index(mesh);
+
+    /* Four side faces per brick, plus the two end caps */
+    EXPECT_EQ(4 * num_bricks + 2,
+        static_cast<int>(index.unmatched_faces.size()));
+    EXPECT_TRUE(std::is_sorted(
+        index.unmatched_faces.begin(), index.unmatched_faces.end()));
+    for (ElementId eid = mesh.elements.key_begin();
+            eid != mesh.elements.key_end(); ++eid) {
+        for (int face = 0; face < 6; ++face) {
+            FaceId match = index.matching_face(FaceId(eid, face));
+            if (match != FaceId::invalid()) {
+                EXPECT_EQ(1, abs(match.element_id.to_int() - eid.to_int()));
+                EXPECT_EQ(FaceId(eid, face), index.matching_face(match));
+            }
+        }
+    }
+
+    /* Node (i, 0, 0) is shared by bricks i-1 and i */
+    NodeId middle = grid.node_id(100, 0, 0);
+    Mesh3Index::ElementRange elements = index.elements_for_node(middle);
+    ASSERT_EQ(2, elements.size());
+    EXPECT_EQ(ElementId::from_int(100), elements.begin()[0]);
+    EXPECT_EQ(ElementId::from_int(101), elements.begin()[1]);
+    NodeId end = grid.node_id(0, 1, 1);
+    ASSERT_EQ(1, index.elements_for_node(end).size());
+}
+
 } /* namespace os2cx */
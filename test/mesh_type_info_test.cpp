@@ -126,6 +126,21 @@ void check_element_type_shape_integration(
     EXPECT_NEAR(symbolic_result, numeric_result, 1e-10);
 }
 
+void check_element_type_shape_tables(
+    const ElementTypeShape &shape,
+    const ElementTypeShape::IntegrationPoint &ip
+) {
+    double sf[ElementTypeShape::max_vertices_per_element];
+    shape.shape_functions(ip.uvw, sf);
+    ElementTypeShape::ShapeVector sf_d_uvw[
+        ElementTypeShape::max_vertices_per_element];
+    shape.shape_function_derivatives(ip.uvw, sf_d_uvw);
+    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+        EXPECT_EQ(sf[i], ip.sf[i]);
+        EXPECT_EQ(sf_d_uvw[i], ip.sf_d_uvw[i]);
+    }
+}
+
 void check_element_type_shape(const ElementTypeShape &shape) {
     for (int i = 0; i < 5; ++i) {
         double u, v, w;
@@ -144,6 +159,15 @@ void check_element_type_shape(const ElementTypeShape &shape) {
             shape, ElementTypeShape::ShapePoint(u, v, w));
     }
 
+    for (const auto &ip : shape.volume_integration_points) {
+        check_element_type_shape_tables(shape, ip);
+    }
+    for (const auto &face : shape.faces) {
+        for (const auto &ip : face.integration_points) {
+            check_element_type_shape_tables(shape, ip);
+        }
+    }
+
     check_element_type_shape_integration(
         shape, QuadraticUVWPolynomial::random(0));
     check_element_type_shape_integration(
@@ -443,32 +443,32 @@ void try_mnb_attr(int transform) {
         Box box = element_to_box(mesh, element);
         if (box == transform_box(Box(0, 0, 0, 1, 1, 1), transform)) {
             ASSERT_EQ(attr_solid|attr_volume,
-                element.attrs);
+                mesh.attr_sets[element.attrs]);
             ASSERT_EQ(attr_solid|attr_surface_external,
-                element.face_attrs[face1]);
+                mesh.attr_sets[element.face_attrs[face1]]);
             ASSERT_EQ(attr_solid|attr_volume,
-                element.face_attrs[face2]);
+                mesh.attr_sets[element.face_attrs[face2]]);
         } else if (box == transform_box(Box(0, 1, 0, 1, 2, 1), transform)) {
             ASSERT_EQ(attr_solid|attr_volume,
-                element.attrs);
+                mesh.attr_sets[element.attrs]);
             ASSERT_EQ(attr_solid|attr_surface_external,
-                element.face_attrs[face1]);
+                mesh.attr_sets[element.face_attrs[face1]]);
             ASSERT_EQ(attr_solid,
-                element.face_attrs[face2]);
+                mesh.attr_sets[element.face_attrs[face2]]);
         } else if (box == transform_box(Box(1, 0, 0, 2, 1, 1), transform)) {
             ASSERT_EQ(attr_solid|attr_volume,
-                element.attrs);
+                mesh.attr_sets[element.attrs]);
             ASSERT_EQ(attr_solid|attr_volume,
-                element.face_attrs[face1]);
+                mesh.attr_sets[element.face_attrs[face1]]);
             ASSERT_EQ(attr_solid|attr_surface_internal,
-                element.face_attrs[face2]);
+                mesh.attr_sets[element.face_attrs[face2]]);
         } else if (box == transform_box(Box(2, 0, 0, 3, 1, 1), transform)) {
             ASSERT_EQ(attr_solid,
-                element.attrs);
+                mesh.attr_sets[element.attrs]);
             ASSERT_EQ(attr_solid|attr_surface_internal,
-                element.face_attrs[face1]);
+                mesh.attr_sets[element.face_attrs[face1]]);
             ASSERT_EQ(attr_solid,
-                element.face_attrs[face2]);
+                mesh.attr_sets[element.face_attrs[face2]]);
         } else {
             FAIL() << "unexpected box: " << box;
         }
@@ -537,20 +537,24 @@ TEST(MesherNaiveBricksTest, AttrSinglePoints) {
     for (const Node3 &node : mesh.nodes) {
         if (node.point == Point(0.5, 0.5, 0.5)) {
             found_point_in_volume = true;
-            ASSERT_EQ(attr_solid|attr_point_in_volume, node.attrs);
+            ASSERT_EQ(attr_solid|attr_point_in_volume,
+                mesh.attr_sets[node.attrs]);
         } else if (node.point == Point(0.5, 0.5, 0)) {
             found_point_on_surface = true;
-            ASSERT_EQ(attr_solid|attr_point_on_surface, node.attrs);
+            ASSERT_EQ(attr_solid|attr_point_on_surface,
+                mesh.attr_sets[node.attrs]);
         } else if (node.point == Point(0.5, 0, 0)) {
             found_point_on_edge = true;
-            ASSERT_EQ(attr_solid|attr_point_on_edge, node.attrs);
+            ASSERT_EQ(attr_solid|attr_point_on_edge,
+                mesh.attr_sets[node.attrs]);
         } else if (node.point == Point(0, 0, 0)) {
             found_point_on_vertex = true;
-            ASSERT_EQ(attr_solid|attr_point_on_vertex, node.attrs);
+            ASSERT_EQ(attr_solid|attr_point_on_vertex,
+                mesh.attr_sets[node.attrs]);
         } else {
             /* Of the nodes that were not explicitly selected, some will have
             attr_solid and some will not; this is normal. */
-            ASSERT_EQ(attr_solid, node.attrs | attr_solid);
+            ASSERT_EQ(attr_solid, mesh.attr_sets[node.attrs] | attr_solid);
         }
     }
     ASSERT_TRUE(found_point_in_volume);
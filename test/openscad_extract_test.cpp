@@ -29,6 +29,8 @@ TEST(OpenscadExtractTest, OpenscadExtractInventory) {
     ASSERT_EQ(2, project.calculix_deck_raw.size());
     ASSERT_EQ("a", project.calculix_deck_raw[0].string_value);
     ASSERT_EQ("b", project.calculix_deck_raw[1].string_value);
+    EXPECT_FALSE(project.calculix_binary_output);
+    EXPECT_EQ(Results::Precision::Double, project.results_precision);
 }
 
 } /* namespace os2cx */
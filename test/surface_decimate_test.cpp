@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <set>
+#include <tuple>
+
+#include "surface_decimate.hpp"
+
+namespace os2cx {
+
+/* Makes the surface of the cube from (0, 0, 0) to (n, n, n), with two
+outward-facing triangles per unit square */
+static void make_cube_surface(
+    int n,
+    std::vector<Point> *points,
+    std::vector<int> *triangles
+) {
+    std::map<std::tuple<int, int, int>, int> indices;
+    auto point = [&](int x, int y, int z) {
+        auto it = indices.find(std::make_tuple(x, y, z));
+        if (it != indices.end()) {
+            return it->second;
+        }
+        int index = points->size();
+        points->push_back(Point(x, y, z));
+        indices[std::make_tuple(x, y, z)] = index;
+        return index;
+    };
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int side = 0; side < 2; ++side) {
+            for (int u = 0; u < n; ++u) {
+                for (int v = 0; v < n; ++v) {
+                    int corners[4];
+                    for (int c = 0; c < 4; ++c) {
+                        int coords[3];
+                        coords[axis] = side * n;
+                        coords[(axis + 1) % 3] = u + (c == 1 || c == 2);
+                        coords[(axis + 2) % 3] = v + (c == 2 || c == 3);
+                        corners[c] = point(coords[0], coords[1], coords[2]);
+                    }
+                    /* The far side faces forwards and the near side faces
+                    backwards */
+                    int order[2][6] = {{0, 3, 2, 0, 2, 1}, {0, 1, 2, 0, 2, 3}};
+                    for (int i = 0; i < 6; ++i) {
+                        triangles->push_back(corners[order[side][i]]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(SurfaceDecimateTest, DecimateCube) {
+    std::vector<Point> points;
+    std::vector<int> triangles;
+    make_cube_surface(100, &points, &triangles);
+    ASSERT_EQ(6 * 100 * 100 * 2 * 3, triangles.size());
+
+    std::vector<int> decimated;
+    decimate_surface(points, triangles, 2000, &decimated);
+    ASSERT_EQ(0, decimated.size() % 3);
+    int num_decimated = decimated.size() / 3;
+    EXPECT_GT(num_decimated, 1000);
+    EXPECT_LT(num_decimated, 4000);
+
+    std::set<std::tuple<int, int, int> > seen;
+    std::set<int> used;
+    for (int t = 0; t < num_decimated; ++t) {
+        int a = decimated[3 * t], b = decimated[3 * t + 1],
+            c = decimated[3 * t + 2];
+        EXPECT_TRUE(a != b && b != c && c != a);
+        EXPECT_TRUE(seen.insert(std::make_tuple(a, b, c)).second);
+        for (int i : {a, b, c}) {
+            ASSERT_TRUE(i >= 0 && i < static_cast<int>(points.size()));
+            used.insert(i);
+        }
+
+        /* The triangles still face outwards */
+        Vector normal =
+            (points[b] - points[a]).cross(points[c] - points[a]);
+        Vector out = points[a] - Point(50, 50, 50);
+        EXPECT_GT(normal.dot(out), 0);
+    }
+
+    /* The corners are where the planes meet, so they have no error at all,
+    and every one of them survives */
+    for (int x : {0, 100}) {
+        for (int y : {0, 100}) {
+            for (int z : {0, 100}) {
+                bool found = false;
+                for (int i : used) {
+                    if (points[i] == Point(x, y, z)) found = true;
+                }
+                EXPECT_TRUE(found) << x << " " << y << " " << z;
+            }
+        }
+    }
+
+    /* Nothing to do if the surface is already small enough */
+    std::vector<int> unchanged;
+    decimate_surface(points, triangles, triangles.size(), &unchanged);
+    EXPECT_EQ(triangles, unchanged);
+}
+
+} /* namespace os2cx */
@@ -6,10 +6,12 @@ CONFIG -= app_bundle
 CONFIG += console
 LIBS += -lgtest -lgtest_main
 
-HEADERS = $$CORE_HEADERS
+HEADERS = $$CORE_HEADERS \
+    brick_grid.hpp
 
 SOURCES = $$CORE_SOURCES \
     attrs_test.cpp \
+    calculix_inp_write_test.cpp \
     calculix_read_test.cpp \
     mesh_index_test.cpp \
     openscad_extract_test.cpp \
@@ -22,7 +24,11 @@ SOURCES = $$CORE_SOURCES \
     units_test.cpp \
     mesh_test.cpp \
     mesher_naive_bricks_test.cpp \
-    mesh_type_info_test.cpp
+    mesh_type_info_test.cpp \
+    util_test.cpp \
+    surface_decimate_test.cpp \
+    bvh_test.cpp \
+    mesh_cut_test.cpp
 
 DISTFILES += \
     max_element_size_test.scad \
@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <sstream>
+
+#include "mesh.hpp"
+#include "util.hpp"
+
+namespace os2cx {
+
+static std::vector<int> range_set_to_ints(const RangeSet<NodeId> &set) {
+    std::vector<int> ints;
+    for (NodeId id : set) {
+        ints.push_back(id.to_int());
+    }
+    return ints;
+}
+
+TEST(UtilTest, RangeSetInsert) {
+    RangeSet<NodeId> set;
+    EXPECT_TRUE(set.empty());
+    EXPECT_TRUE(set.begin() == set.end());
+
+    set.insert(NodeId::from_int(5));
+    set.insert(NodeId::from_int(6));
+    set.insert(NodeId::from_int(7));
+    set.insert(NodeId::from_int(10));
+    EXPECT_EQ(4, set.size());
+    EXPECT_EQ(2, set.num_runs());
+
+    /* Out-of-order inserts, including one that bridges two runs */
+    set.insert(NodeId::from_int(2));
+    set.insert(NodeId::from_int(9));
+    set.insert(NodeId::from_int(8));
+    set.insert(NodeId::from_int(6));
+    EXPECT_EQ(7, set.size());
+    EXPECT_EQ(2, set.num_runs());
+    EXPECT_EQ(std::vector<int>({2, 5, 6, 7, 8, 9, 10}), range_set_to_ints(set));
+
+    EXPECT_EQ(0, set.count(NodeId::from_int(1)));
+    EXPECT_EQ(1, set.count(NodeId::from_int(2)));
+    EXPECT_EQ(0, set.count(NodeId::from_int(3)));
+    EXPECT_EQ(1, set.count(NodeId::from_int(5)));
+    EXPECT_EQ(1, set.count(NodeId::from_int(10)));
+    EXPECT_EQ(0, set.count(NodeId::from_int(11)));
+}
+
+TEST(UtilTest, RangeSetRange) {
+    RangeSet<NodeId> set(NodeId::from_int(100), NodeId::from_int(1000100));
+    EXPECT_EQ(1000000, set.size());
+    EXPECT_EQ(1, set.num_runs());
+    EXPECT_EQ(1, set.count(NodeId::from_int(100)));
+    EXPECT_EQ(0, set.count(NodeId::from_int(1000100)));
+
+    set.insert_range(NodeId::from_int(0), NodeId::from_int(50));
+    EXPECT_EQ(1000050, set.size());
+    EXPECT_EQ(2, set.num_runs());
+}
+
+TEST(UtilTest, RangeSetFromKeys) {
+    RangeSet<NodeId> set = RangeSet<NodeId>::from_keys({
+        NodeId::from_int(4), NodeId::from_int(1), NodeId::from_int(3),
+        NodeId::from_int(4), NodeId::from_int(8), NodeId::from_int(1)});
+    EXPECT_EQ(std::vector<int>({1, 3, 4, 8}), range_set_to_ints(set));
+    EXPECT_EQ(3, set.num_runs());
+}
+
+TEST(UtilTest, RangeSetUnionIntersection) {
+    RangeSet<NodeId> a(NodeId::from_int(0), NodeId::from_int(10));
+    a.insert_range(NodeId::from_int(20), NodeId::from_int(30));
+    RangeSet<NodeId> b(NodeId::from_int(5), NodeId::from_int(25));
+
+    RangeSet<NodeId> u = a | b;
+    EXPECT_EQ(RangeSet<NodeId>(NodeId::from_int(0), NodeId::from_int(30)), u);
+    EXPECT_EQ(30, u.size());
+
+    RangeSet<NodeId> i = a & b;
+    EXPECT_EQ(2, i.num_runs());
+    EXPECT_EQ(10, i.size());
+    EXPECT_EQ(1, i.count(NodeId::from_int(5)));
+    EXPECT_EQ(0, i.count(NodeId::from_int(10)));
+    EXPECT_EQ(1, i.count(NodeId::from_int(24)));
+
+    /* Appending in increasing order, and out of order */
+    RangeSet<NodeId> c;
+    c |= RangeSet<NodeId>(NodeId::from_int(10), NodeId::from_int(20));
+    c |= RangeSet<NodeId>(NodeId::from_int(20), NodeId::from_int(25));
+    EXPECT_EQ(1, c.num_runs());
+    c |= RangeSet<NodeId>(NodeId::from_int(0), NodeId::from_int(5));
+    EXPECT_EQ(2, c.num_runs());
+    EXPECT_EQ(20, c.size());
+    EXPECT_EQ(0, c.runs_begin()->begin);
+}
+
+TEST(UtilTest, RangeSetFaceIds) {
+    RangeSet<FaceId> set;
+    set.insert(FaceId(ElementId::from_int(3), 2));
+    set.insert(FaceId(ElementId::from_int(1), 0));
+    EXPECT_EQ(1, set.count(FaceId(ElementId::from_int(3), 2)));
+    EXPECT_EQ(0, set.count(FaceId(ElementId::from_int(3), 1)));
+    EXPECT_TRUE(*set.begin() == FaceId(ElementId::from_int(1), 0));
+}
+
+static std::string read_file(const FilePath &path) {
+    std::ifstream stream(path);
+    std::stringstream contents;
+    contents << stream.rdbuf();
+    return contents.str();
+}
+
+TEST(UtilTest, WriteFileIfChanged) {
+    TempDir temp_dir("./test_write_fileXXXXXX", TempDir::AutoCleanup::Yes);
+    FilePath path = temp_dir.path() + "/file.inp";
+
+    EXPECT_TRUE(write_file_if_changed(path, "hello\n"));
+    EXPECT_EQ("hello\n", read_file(path));
+    EXPECT_FALSE(write_file_if_changed(path, "hello\n"));
+    EXPECT_TRUE(write_file_if_changed(path, "world\n"));
+    EXPECT_EQ("world\n", read_file(path));
+
+    /* If the file is changed behind our back, it gets rewritten */
+    std::ofstream(path) << "x";
+    EXPECT_TRUE(write_file_if_changed(path, "world\n"));
+    EXPECT_EQ("world\n", read_file(path));
+}
+
+TEST(UtilTest, WriteFileIfInputsChanged) {
+    TempDir temp_dir("./test_write_fileXXXXXX", TempDir::AutoCleanup::Yes);
+    FilePath path = temp_dir.path() + "/file.inp";
+
+    int num_writes = 0;
+    auto write = [&](const std::string &contents) {
+        return [&num_writes, contents](std::ostream &stream) {
+            ++num_writes;
+            stream << contents;
+        };
+    };
+
+    EXPECT_TRUE(write_file_if_inputs_changed(path, "a", write("hello\n")));
+    EXPECT_EQ("hello\n", read_file(path));
+    EXPECT_EQ(1, num_writes);
+
+    /* Same inputs: the contents aren't even formatted */
+    EXPECT_FALSE(write_file_if_inputs_changed(path, "a", write("hello\n")));
+    EXPECT_EQ(1, num_writes);
+
+    /* New inputs that give the same contents: formatted, but not replaced */
+    EXPECT_FALSE(write_file_if_inputs_changed(path, "b", write("hello\n")));
+    EXPECT_EQ(2, num_writes);
+    EXPECT_FALSE(write_file_if_inputs_changed(path, "b", write("hello\n")));
+    EXPECT_EQ(2, num_writes);
+
+    EXPECT_TRUE(write_file_if_inputs_changed(path, "c", write("world\n")));
+    EXPECT_EQ("world\n", read_file(path));
+
+    /* If the file is changed behind our back, it gets rewritten */
+    std::ofstream(path) << "x";
+    EXPECT_TRUE(write_file_if_inputs_changed(path, "c", write("world\n")));
+    EXPECT_EQ("world\n", read_file(path));
+
+    /* Writing without a key forgets the old one only if the contents change */
+    EXPECT_TRUE(write_file_if_changed(path, "other\n"));
+    EXPECT_TRUE(write_file_if_inputs_changed(path, "c", write("world\n")));
+}
+
+TEST(UtilTest, InputsHash) {
+    InputsHash a, b, c;
+    a.add_int(1);
+    a.add_double(2.5);
+    b.add_int(1);
+    b.add_double(2.5);
+    c.add_double(2.5);
+    c.add_int(1);
+    EXPECT_EQ(a.key(), b.key());
+    EXPECT_NE(a.key(), c.key());
+}
+
+TEST(UtilTest, BackgroundWorker) {
+    std::vector<int> order;
+    std::promise<std::thread::id> done;
+    std::atomic<bool> finished(false);
+    {
+        BackgroundWorker worker;
+        worker.post([&]() { order.push_back(1); });
+        worker.post([&]() { order.push_back(2); });
+        worker.post([&]() {
+            order.push_back(3);
+            done.set_value(std::this_thread::get_id());
+        });
+        EXPECT_NE(std::this_thread::get_id(), done.get_future().get());
+        EXPECT_EQ(std::vector<int>({1, 2, 3}), order);
+
+        /* The destructor waits for a job that's running */
+        std::promise<void> started;
+        worker.post([&]() {
+            started.set_value();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            finished = true;
+        });
+        started.get_future().wait();
+    }
+    EXPECT_TRUE(finished);
+}
+
+TEST(UtilTest, QuantileSketch) {
+    /* The numbers 0 to n-1, in a scrambled order */
+    int n = 100000;
+    auto value = [&](int i) { return (i * 7919) % n; };
+
+    QuantileSketch<double> whole;
+    for (int i = 0; i < n; ++i) {
+        whole.insert(value(i));
+    }
+    EXPECT_EQ(n, whole.count());
+    EXPECT_EQ(0, whole.percentile(0));
+    EXPECT_EQ(n - 1, whole.percentile(100));
+    for (int p : {1, 10, 50, 90, 99}) {
+        EXPECT_NEAR(n * p / 100, whole.percentile(p), n / 100);
+    }
+
+    /* Merging sketches of the parts is about as good as a sketch of the whole,
+    and the results don't depend on anything but the inputs */
+    QuantileSketch<double> merged, merged_again;
+    for (int part = 0; part < 7; ++part) {
+        QuantileSketch<double> sketch;
+        for (int i = part * n / 7; i < (part + 1) * n / 7; ++i) {
+            sketch.insert(value(i));
+        }
+        merged.merge(sketch);
+        merged_again.merge(sketch);
+    }
+    EXPECT_EQ(n, merged.count());
+    for (int p : {1, 10, 50, 90, 99}) {
+        EXPECT_NEAR(n * p / 100, merged.percentile(p), n / 100);
+        EXPECT_EQ(merged.percentile(p), merged_again.percentile(p));
+    }
+}
+
+} /* namespace os2cx */